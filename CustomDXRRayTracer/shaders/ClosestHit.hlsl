@@ -32,12 +32,32 @@
 [shader("closesthit")]
 void ClosestHit(inout HitInfo payload, Attributes attrib)
 {
-	uint triangleIndex = PrimitiveIndex();
+	uint triangleIndex = PrimitiveIndex() + triangleOffset;
 	float3 barycentrics = float3((1.0f - attrib.uv.x - attrib.uv.y), attrib.uv.x, attrib.uv.y);
 	VertexAttributes vertex = GetVertexAttributes(triangleIndex, barycentrics);
 
-	int2 coord = floor(vertex.uv * textureResolution.x);
-	float3 color = albedo.Load(int3(coord, 0)).rgb;
+	// Point-sample the mip level whose texels best match the ray cone's footprint
+	MaterialRecord material = materials[materialIndex];
+	uint level = (uint)clamp(round(GetTextureLod(triangleIndex, float2(material.textureSize))), 0.f, material.textureLevels - 1.f);
+	if (material.virtualTexture.x != 0) level = GetVirtualTextureLevel(material.virtualTexture, vertex.uv, material.textureSize, level);
+	uint2 size = max(material.textureSize >> level, 1);
+	int2 coord = floor(vertex.uv * size);
+	float3 color = albedo[NonUniformResourceIndex(material.textureIndex)].Load(int3(coord, level)).rgb;
 
-	payload.ShadedColorAndHitT = float4(color, RayTCurrent());
+	// Two-sided: the interpolated smooth normal is turned toward the ray
+	float3 normal = normalize(mul((float3x3)ObjectToWorld3x4(), vertex.normal));
+	if (dot(normal, WorldRayDirection()) > 0.f) normal = -normal;
+
+	// Lit by the environment map when there is one, by a headlight otherwise
+	float3 lighting;
+	if (environmentSamples != 0)
+	{
+		lighting = GetEnvironmentLighting(WorldRayOrigin() + WorldRayDirection() * RayTCurrent(), normal);
+	}
+	else
+	{
+		lighting = 0.2f + 0.8f * dot(normal, -WorldRayDirection());
+	}
+
+	payload.ShadedColorAndHitT = float4(color * lighting, RayTCurrent());
 }
\ No newline at end of file
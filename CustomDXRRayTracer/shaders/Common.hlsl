@@ -37,6 +37,23 @@ struct Attributes
 	float2 uv;
 };
 
+// Indexed by the geometry's material index; mirrors MaterialRecord in Structures.h
+struct MaterialRecord
+{
+	uint textureIndex;
+	uint2 textureSize;
+	uint textureLevels;
+	uint4 virtualTexture;
+};
+
+// One slot of the environment's alias tables; mirrors AliasEntry in EnvironmentMap.h
+struct AliasEntry
+{
+	float probability;
+	uint alias;
+	float pdf;
+};
+
 // ---[ Constant Buffers ]---
 
 cbuffer ViewCB : register(b0)
@@ -44,21 +61,38 @@ cbuffer ViewCB : register(b0)
 	matrix view;
 	float4 viewOriginAndTanHalfFovY;
 	float2 resolution;
+	uint frameNumber;
+	uint environmentSamples;
+	uint environmentWidth;
+	uint environmentHeight;
+	uint environmentBlock;
 };
 
-cbuffer MaterialCB : register(b1)
+cbuffer GeometryCB : register(b2)
 {
-	float4 textureResolution;
+	float3 positionScale;
+	uint triangleOffset;
+	float3 positionBias;
+	uint materialIndex;
+	float2 uvScale;
+	float2 uvBias;
 };
 
 // ---[ Resources ]---
 
 RWTexture2D<float4> RTOutput				: register(u0);
+RWByteAddressBuffer tileFeedback			: register(u1);
 RaytracingAccelerationStructure SceneBVH	: register(t0);
+StructuredBuffer<MaterialRecord> materials	: register(t1);
+ByteAddressBuffer tileResidency				: register(t2);
+Texture2D<float4> environment				: register(t3);
+StructuredBuffer<AliasEntry> environmentTable	: register(t4);
+
+ByteAddressBuffer indices					: register(t0, space1);
+ByteAddressBuffer vertices					: register(t1, space1);
+ByteAddressBuffer frames					: register(t2, space1);
 
-ByteAddressBuffer indices					: register(t1);
-ByteAddressBuffer vertices					: register(t2);
-Texture2D<float4> albedo					: register(t3);
+Texture2D<float4> albedo[]					: register(t0, space3);
 
 // ---[ Helper Functions ]---
 
@@ -66,6 +100,8 @@ struct VertexAttributes
 {
 	float3 position;
 	float2 uv;
+	float3 normal;
+	float4 tangent;
 };
 
 uint3 GetIndices(uint triangleIndex)
@@ -75,20 +111,224 @@ uint3 GetIndices(uint triangleIndex)
 	return indices.Load3(address);
 }
 
+void LoadPositionAndUv(uint index, out float3 position, out float2 uv)
+{
+#ifdef COMPACT_VERTICES
+	// int16 snorm xyz + padding, then uint16 unorm uv: 12 bytes per vertex
+	uint3 packed = vertices.Load3(index * 12);
+	int3 quantized = int3(int(packed.x << 16) >> 16, int(packed.x) >> 16, int(packed.y << 16) >> 16);
+	position = max(float3(quantized) / 32767.f, -1.f) * positionScale + positionBias;
+	uv = float2(packed.z & 0xFFFF, packed.z >> 16) / 65535.f * uvScale + uvBias;
+#else
+	int address = (index * 5) * 4;
+	position = asfloat(vertices.Load3(address));
+	uv = asfloat(vertices.Load2(address + (3 * 4)));
+#endif
+}
+
 VertexAttributes GetVertexAttributes(uint triangleIndex, float3 barycentrics)
 {
 	uint3 indices = GetIndices(triangleIndex);
 	VertexAttributes v;
 	v.position = float3(0, 0, 0);
 	v.uv = float2(0, 0);
+	v.normal = float3(0, 0, 0);
+	v.tangent = float4(0, 0, 0, 0);
 
 	for (uint i = 0; i < 3; i++)
 	{
-		int address = (indices[i] * 5) * 4;
-		v.position += asfloat(vertices.Load3(address)) * barycentrics[i];
-		address += (3 * 4);
-		v.uv += asfloat(vertices.Load2(address)) * barycentrics[i];
+		float3 position;
+		float2 uv;
+		LoadPositionAndUv(indices[i], position, uv);
+		v.position += position * barycentrics[i];
+		v.uv += uv * barycentrics[i];
+
+		// float3 normal + float4 tangent: 28 bytes per vertex
+		int frameAddress = (indices[i] * 7) * 4;
+		v.normal += asfloat(frames.Load3(frameAddress)) * barycentrics[i];
+		v.tangent.xyz += asfloat(frames.Load3(frameAddress + 12)) * barycentrics[i];
+		v.tangent.w = asfloat(frames.Load(frameAddress + 24));
 	}
 
+	v.normal = normalize(v.normal);
+	v.tangent.xyz = normalize(v.tangent.xyz);
 	return v;
+}
+
+// Ray cone texture LOD (Akenine-Moller et al., "Texture Level of Detail Strategies for Real-Time Ray Tracing").
+// The primary ray's cone widens by one pixel's spread angle, and the triangle's texel to world area ratio turns the
+// cone's width where it hits the surface into a footprint in texels.
+float GetTextureLod(uint triangleIndex, float2 textureSize)
+{
+	uint3 indices = GetIndices(triangleIndex);
+	float3 p0, p1, p2;
+	float2 uv0, uv1, uv2;
+	LoadPositionAndUv(indices.x, p0, uv0);
+	LoadPositionAndUv(indices.y, p1, uv1);
+	LoadPositionAndUv(indices.z, p2, uv2);
+
+	float3 worldNormal = cross(mul((float3x3)ObjectToWorld3x4(), p1 - p0), mul((float3x3)ObjectToWorld3x4(), p2 - p0));
+	float worldArea = length(worldNormal);
+	float2 t1 = (uv1 - uv0) * textureSize;
+	float2 t2 = (uv2 - uv0) * textureSize;
+	float texelArea = abs(t1.x * t2.y - t2.x * t1.y);
+	if (worldArea <= 0.f || texelArea <= 0.f) return 0.f;
+
+	float spreadAngle = 2.f * viewOriginAndTanHalfFovY.w / resolution.y;
+	float coneWidth = RayTCurrent() * spreadAngle;
+	float cosine = max(abs(dot(worldNormal / worldArea, WorldRayDirection())), 1e-4f);
+
+	return 0.5f * log2(texelArea / worldArea) + log2(coneWidth / cosine);
+}
+
+// Virtual textures stream their finer levels in as tiles. The tile the hit would like to read is stamped with the
+// frame number for the residency manager, and the level actually read is the finest one resident over the top
+// level tile around uv. virtualTexture holds the first feedback tile plus one, the residency map offset, the tile
+// size packed in 16 bits each, and the number of streamed levels.
+uint GetVirtualTextureLevel(uint4 info, float2 uv, uint2 size, uint level)
+{
+	uint2 tileSize = uint2(info.z & 0xFFFF, info.z >> 16);
+	uint streamedLevels = info.w;
+	uv = saturate(uv);
+
+	if (level < streamedLevels)
+	{
+		uint tile = info.x - 1;
+		for (uint i = 0; i < level; i++)
+		{
+			uint2 levelTiles = (max(size >> i, 1) + tileSize - 1) / tileSize;
+			tile += levelTiles.x * levelTiles.y;
+		}
+
+		uint2 levelSize = max(size >> level, 1);
+		uint2 tiles = (levelSize + tileSize - 1) / tileSize;
+		uint2 coord = min(uint2(uv * levelSize) / tileSize, tiles - 1);
+		tileFeedback.Store((tile + coord.y * tiles.x + coord.x) * 4, frameNumber);
+	}
+
+	uint2 topTiles = (size + tileSize - 1) / tileSize;
+	uint2 topCoord = min(uint2(uv * size) / tileSize, topTiles - 1);
+	return max(level, tileResidency.Load((info.y + topCoord.y * topTiles.x + topCoord.x) * 4));
+}
+
+// ---[ Environment ]---
+
+static const float PI = 3.14159265f;
+
+// PCG hash (Jarzynski and Olano, "Hash Functions for GPU Rendering")
+uint Hash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+float Random(inout uint seed)
+{
+	seed = Hash(seed);
+	return (seed >> 8) * (1.f / 16777216.f);
+}
+
+// Lat-long mapping of EnvironmentMap::GetDirection: rows from +y down to -y, columns once around y starting at -z
+float3 GetEnvironmentDirection(float2 uv)
+{
+	float theta = uv.y * PI;
+	float phi = uv.x * 2.f * PI;
+	return float3(sin(theta) * sin(phi), cos(theta), -sin(theta) * cos(phi));
+}
+
+float2 GetEnvironmentUv(float3 direction)
+{
+	return float2(frac(atan2(direction.x, -direction.z) / (2.f * PI) + 1.f), acos(clamp(direction.y, -1.f, 1.f)) / PI);
+}
+
+float3 GetEnvironmentRadiance(float3 direction)
+{
+	uint2 size = uint2(environmentWidth, environmentHeight);
+	uint2 coord = min(uint2(GetEnvironmentUv(direction) * size), size - 1);
+	return environment.Load(int3(coord, 0)).rgb;
+}
+
+// Picks an index with the alias table at offset, then rescales u to a fresh uniform number from what the choice left unused
+uint SampleAlias(uint offset, uint count, inout float u)
+{
+	float scaled = u * count;
+	uint index = min(uint(scaled), count - 1);
+	float remainder = min(scaled - index, 1.f);
+
+	AliasEntry entry = environmentTable[offset + index];
+	if (remainder < entry.probability)
+	{
+		u = remainder / entry.probability;
+		return index;
+	}
+
+	u = (remainder - entry.probability) / (1.f - entry.probability);
+	return entry.alias;
+}
+
+// Picks a row from the marginal table and a cell from that row's table in constant time, then a direction uniformly
+// over the cell's texels. Returns the direction's solid angle pdf, which EnvironmentMap::Sample matches on the CPU.
+float3 SampleEnvironment(float u0, float u1, out float pdf)
+{
+	uint2 size = uint2(environmentWidth, environmentHeight);
+	uint2 tableSize = (size + environmentBlock - 1) / environmentBlock;
+
+	uint row = SampleAlias(0, tableSize.y, u0);
+	uint rowOffset = tableSize.y + row * tableSize.x;
+	uint column = SampleAlias(rowOffset, tableSize.x, u1);
+	float cellPdf = environmentTable[row].pdf * environmentTable[rowOffset + column].pdf;
+
+	uint2 corner = uint2(column, row) * environmentBlock;
+	float2 cellSize = float2(min(corner + environmentBlock, size) - corner);
+	float2 uv = (corner + float2(u1, u0) * cellSize) / size;
+	float area = cellSize.x * cellSize.y / (float(size.x) * size.y);
+	float sine = sin(uv.y * PI);
+
+	pdf = (sine > 0.f) ? cellPdf / (area * 2.f * PI * PI * sine) : 0.f;
+	return GetEnvironmentDirection(uv);
+}
+
+// Diffuse lighting from the environment, over pi so it scales albedo directly. Each importance-sampled direction is
+// traced as a shadow ray that skips closest hit shaders: occluded rays keep the black payload, and the miss shader
+// returns the environment's radiance for the rest.
+float3 GetEnvironmentLighting(float3 position, float3 normal)
+{
+	uint2 pixel = DispatchRaysIndex().xy;
+	uint seed = Hash(pixel.y * DispatchRaysDimensions().x + pixel.x) ^ Hash(frameNumber);
+
+	float3 irradiance = float3(0.f, 0.f, 0.f);
+	for (uint i = 0; i < environmentSamples; i++)
+	{
+		float u0 = Random(seed);
+		float u1 = Random(seed);
+		float pdf;
+		float3 direction = SampleEnvironment(u0, u1, pdf);
+
+		float cosine = dot(normal, direction);
+		if (cosine <= 0.f || pdf <= 0.f) continue;
+
+		RayDesc ray;
+		ray.Origin = position + normal * 1e-3f;
+		ray.Direction = direction;
+		ray.TMin = 0.f;
+		ray.TMax = 1000.f;
+
+		HitInfo shadow;
+		shadow.ShadedColorAndHitT = float4(0.f, 0.f, 0.f, 1.f);
+
+		TraceRay(
+			SceneBVH,
+			RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+			0xFF,
+			0,
+			1,
+			0,
+			ray,
+			shadow);
+
+		irradiance += shadow.ShadedColorAndHitT.rgb * (cosine / pdf);
+	}
+
+	return irradiance / (environmentSamples * PI);
 }
\ No newline at end of file
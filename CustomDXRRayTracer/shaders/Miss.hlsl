@@ -32,5 +32,7 @@
 [shader("miss")]
 void Miss(inout HitInfo payload)
 {
-    payload.ShadedColorAndHitT = float4(0.2f, 0.2f, 0.2f, -1.f);
+	// Without an environment map the background stays a flat gray
+	float3 color = (environmentSamples != 0) ? GetEnvironmentRadiance(WorldRayDirection()) : float3(0.2f, 0.2f, 0.2f);
+	payload.ShadedColorAndHitT = float4(color, -1.f);
 }
\ No newline at end of file
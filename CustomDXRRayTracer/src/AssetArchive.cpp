@@ -0,0 +1,476 @@
+#include "AssetArchive.h"
+#include "BlockCompressor.h"
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "MipGenerator.h"
+#include "SceneLoader.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+	const char ArchiveMagic[4] = { 'D', 'X', 'R', 'A' };
+	const UINT32 ArchiveVersion = 2;
+	const UINT32 NoTexture = 0xFFFFFFFF;
+
+	struct ArchiveHeader
+	{
+		char magic[4];
+		UINT32 version;
+		UINT32 pageSize;
+		UINT32 vertexStride;
+		UINT32 modelCount;
+		UINT32 textureCount;
+		UINT32 materialCount;
+		UINT32 materialBytes;
+	};
+
+	struct ArchiveModel
+	{
+		UINT64 vertexOffset;
+		UINT64 vertexCount;
+		UINT64 indexOffset;
+		UINT64 indexCount;
+		UINT64 frameOffset;
+		UINT64 submeshOffset;
+		UINT64 submeshCount;
+		UINT64 clusterOffset;
+		UINT64 clusterCount;
+		UINT64 lodOffset;
+		UINT64 lodCount;
+		UINT64 instanceOffset;
+		UINT64 instanceCount;
+	};
+
+	// Texels are the full mip chain in its GPU format, each level placed as TextureCache::GetLayout does
+	struct ArchiveTexture
+	{
+		UINT64 texelOffset;
+		UINT64 texelBytes;
+		UINT32 width;
+		UINT32 height;
+		UINT32 mipLevels;
+		UINT32 format;
+	};
+
+	struct BakedSource
+	{
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<Material> materials;
+		std::string error;
+	};
+
+	UINT64 Reserve(UINT64& end, UINT64 size)
+	{
+		const UINT64 offset = ALIGN(AssetArchive::ArchivePageSize, end);
+		end = offset + size;
+		return offset;
+	}
+
+	// Pads with zeros from the current end of the file up to the blob offset, then writes the blob
+	bool WriteBlob(Utils::OutputFile& file, UINT64& offset, UINT64 blobOffset, const void* data, UINT64 size)
+	{
+		static const UINT8 zeros[AssetArchive::ArchivePageSize] = {};
+		const UINT64 padding = blobOffset - offset;
+
+		offset = blobOffset + size;
+		return file.Write(zeros, padding) && file.Write(data, size);
+	}
+
+	// Writes a texture in the placed layout: a texture mapped from the cache already is, while the tightly packed
+	// levels of a freshly built one are padded a level at a time
+	bool WriteTexture(Utils::OutputFile& file, UINT64& offset, UINT64 blobOffset, const TextureInfo& texture)
+	{
+		if (texture.mappedPixels) return WriteBlob(file, offset, blobOffset, texture.mappedPixels, texture.mappedSize);
+
+		std::vector<TextureLevelLayout> levels;
+		const UINT64 size = TextureCache::GetLayout(static_cast<UINT>(texture.width), static_cast<UINT>(texture.height), texture.mipLevels, texture.format, levels);
+
+		std::vector<UINT8> staging;
+		const UINT8* level = texture.pixels.data();
+		bool result = true;
+		for (size_t i = 0; i < levels.size() && result; i++)
+		{
+			const TextureLevelLayout& layout = levels[i];
+			const UINT64 end = (i + 1 < levels.size()) ? levels[i + 1].offset : size;
+
+			staging.assign(static_cast<size_t>(end - layout.offset), 0);
+			for (UINT row = 0; row < layout.rowCount; row++)
+			{
+				memcpy(staging.data() + static_cast<size_t>(row) * layout.rowPitch, level + static_cast<size_t>(row) * layout.rowSize, layout.rowSize);
+			}
+			level += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+
+			result = WriteBlob(file, offset, blobOffset + layout.offset, staging.data(), staging.size());
+		}
+
+		return result;
+	}
+
+	bool IsArchiveFormat(UINT32 format)
+	{
+		return format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC7_UNORM;
+	}
+
+	void AppendString(std::vector<UINT8>& buffer, const std::string& value)
+	{
+		const UINT32 length = static_cast<UINT32>(value.size());
+		buffer.insert(buffer.end(), reinterpret_cast<const UINT8*>(&length), reinterpret_cast<const UINT8*>(&length) + sizeof(length));
+		buffer.insert(buffer.end(), value.begin(), value.end());
+	}
+
+	void AppendInt(std::vector<UINT8>& buffer, UINT32 value)
+	{
+		buffer.insert(buffer.end(), reinterpret_cast<const UINT8*>(&value), reinterpret_cast<const UINT8*>(&value) + sizeof(value));
+	}
+
+	bool ReadString(const char*& p, const char* end, std::string& value)
+	{
+		UINT32 length = 0;
+		if (static_cast<size_t>(end - p) < sizeof(length)) return false;
+		memcpy(&length, p, sizeof(length));
+		p += sizeof(length);
+
+		if (static_cast<size_t>(end - p) < length) return false;
+		value.assign(p, length);
+		p += length;
+		return true;
+	}
+
+	bool ReadInt(const char*& p, const char* end, UINT32& value)
+	{
+		if (static_cast<size_t>(end - p) < sizeof(value)) return false;
+		memcpy(&value, p, sizeof(value));
+		p += sizeof(value);
+		return true;
+	}
+
+	bool InFile(UINT64 offset, UINT64 count, UINT64 stride, UINT64 fileSize)
+	{
+		return offset <= fileSize && count <= (fileSize - offset) / stride;
+	}
+}
+
+namespace AssetArchive
+{
+	bool IsArchive(const std::string& filepath)
+	{
+		if (filepath.size() < 5) return false;
+
+		std::string extension = filepath.substr(filepath.size() - 5);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+		return extension == ".dxra";
+	}
+
+	BakeStats Bake(const std::string& archivePath, const std::vector<std::string>& modelPaths, const TextureOptions& options)
+	{
+		Utils::Timer timer;
+
+		// Exceptions cannot leave a worker thread, so each source keeps its error until every load has finished
+		std::vector<BakedSource> sources(modelPaths.size());
+		Utils::ParallelFor(static_cast<UINT>(modelPaths.size()), [&](UINT i)
+		{
+			try
+			{
+				if (SceneLoader::IsScene(modelPaths[i]))
+				{
+					SceneLoader::LoadScene(modelPaths[i], sources[i].models, sources[i].materials);
+				}
+				else if (GltfLoader::IsGlb(modelPaths[i]))
+				{
+					GltfLoader::LoadGlb(modelPaths[i], sources[i].models, sources[i].materials);
+				}
+				else
+				{
+					std::shared_ptr<Model> model = std::make_shared<Model>();
+					Utils::LoadModel(modelPaths[i], *model, sources[i].materials);
+					sources[i].models.push_back(model);
+				}
+			}
+			catch (const std::exception& e)
+			{
+				sources[i].error = e.what();
+			}
+		});
+
+		std::vector<Material> materials;
+		std::vector<UINT32> materialTextures;
+		std::vector<const Material*> textureSources;
+		std::map<std::string, UINT32> texturesByPath;
+		std::vector<UINT32> materialBases;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			if (!sources[i].error.empty()) throw std::runtime_error(sources[i].error);
+
+			materialBases.push_back(static_cast<UINT32>(materials.size()));
+			for (const Material& material : sources[i].materials)
+			{
+				UINT32 texture = NoTexture;
+				if (material.embeddedTexture)
+				{
+					texture = static_cast<UINT32>(textureSources.size());
+					textureSources.push_back(&material);
+				}
+				else if (!material.texturePath.empty())
+				{
+					std::map<std::string, UINT32>::iterator it = texturesByPath.find(material.texturePath);
+					if (it == texturesByPath.end())
+					{
+						it = texturesByPath.emplace(material.texturePath, static_cast<UINT32>(textureSources.size())).first;
+						textureSources.push_back(&material);
+					}
+					texture = it->second;
+				}
+
+				materials.push_back(material);
+				materialTextures.push_back(texture);
+			}
+		}
+
+		std::vector<TextureInfo> textures(textureSources.size());
+		std::vector<std::string> textureErrors(textureSources.size());
+		Utils::ParallelFor(static_cast<UINT>(textureSources.size()), [&](UINT i)
+		{
+			try
+			{
+				TextureLoadStats textureStats;
+				textures[i] = Utils::LoadTexture(*textureSources[i], options, textureStats);
+			}
+			catch (const std::exception& e)
+			{
+				textureErrors[i] = e.what();
+			}
+		});
+
+		for (const std::string& error : textureErrors)
+		{
+			if (!error.empty()) throw std::runtime_error(error);
+		}
+
+		std::vector<UINT8> materialData;
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			const UINT32 texture = materialTextures[i];
+			AppendString(materialData, materials[i].name);
+			AppendString(materialData, materials[i].texturePath);
+			AppendInt(materialData, static_cast<UINT32>(texture == NoTexture ? materials[i].textureResolution : textures[texture].width));
+			AppendInt(materialData, texture);
+		}
+
+		std::vector<const Model*> models;
+		std::vector<std::vector<Submesh>> submeshes;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			for (const std::shared_ptr<Model>& model : sources[i].models)
+			{
+				if (!model->mappedFrames && model->frames.size() != model->VertexCount())
+				{
+					throw std::runtime_error("Error: model " + modelPaths[i] + " has no vertex frames to bake");
+				}
+
+				models.push_back(model.get());
+				submeshes.push_back(model->submeshes);
+				for (Submesh& submesh : submeshes.back()) submesh.materialIndex += materialBases[i];
+			}
+		}
+
+		ArchiveHeader header = {};
+		memcpy(header.magic, ArchiveMagic, sizeof(ArchiveMagic));
+		header.version = ArchiveVersion;
+		header.pageSize = static_cast<UINT32>(ArchivePageSize);
+		header.vertexStride = sizeof(Vertex);
+		header.modelCount = static_cast<UINT32>(models.size());
+		header.textureCount = static_cast<UINT32>(textures.size());
+		header.materialCount = static_cast<UINT32>(materials.size());
+		header.materialBytes = static_cast<UINT32>(materialData.size());
+
+		// The table of contents sits in front of the blobs, so offsets are laid out before anything is written
+		UINT64 end = sizeof(ArchiveHeader) + models.size() * sizeof(ArchiveModel) + textures.size() * sizeof(ArchiveTexture) + materialData.size();
+		std::vector<ArchiveModel> modelEntries(models.size());
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			const Model& model = *models[i];
+			ArchiveModel& entry = modelEntries[i];
+			entry.vertexCount = model.VertexCount();
+			entry.indexCount = model.IndexCount();
+			entry.submeshCount = submeshes[i].size();
+			entry.clusterCount = model.clusters.size();
+			entry.lodCount = model.lods.size();
+			entry.instanceCount = model.instances.size();
+
+			entry.vertexOffset = Reserve(end, entry.vertexCount * sizeof(Vertex));
+			entry.indexOffset = Reserve(end, entry.indexCount * sizeof(uint32_t));
+			entry.frameOffset = Reserve(end, entry.vertexCount * sizeof(VertexFrame));
+			entry.submeshOffset = Reserve(end, entry.submeshCount * sizeof(Submesh));
+			entry.clusterOffset = end;
+			end += entry.clusterCount * sizeof(Cluster);
+			entry.lodOffset = end;
+			end += entry.lodCount * sizeof(ClusterLod);
+			entry.instanceOffset = end;
+			end += entry.instanceCount * sizeof(DirectX::XMFLOAT3X4);
+		}
+
+		std::vector<ArchiveTexture> textureEntries(textures.size());
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			std::vector<TextureLevelLayout> levels;
+			ArchiveTexture& entry = textureEntries[i];
+			entry.width = static_cast<UINT32>(textures[i].width);
+			entry.height = static_cast<UINT32>(textures[i].height);
+			entry.mipLevels = static_cast<UINT32>(textures[i].mipLevels);
+			entry.format = static_cast<UINT32>(textures[i].format);
+			entry.texelBytes = TextureCache::GetLayout(entry.width, entry.height, entry.mipLevels, textures[i].format, levels);
+			entry.texelOffset = Reserve(end, entry.texelBytes);
+		}
+
+		Utils::OutputFile file;
+		if (!file.Open(archivePath))
+		{
+			throw std::runtime_error("Error: failed to create archive " + archivePath);
+		}
+
+		UINT64 offset = sizeof(header);
+		bool result = file.Write(&header, sizeof(header));
+		result = result && file.Write(modelEntries.data(), modelEntries.size() * sizeof(ArchiveModel));
+		result = result && file.Write(textureEntries.data(), textureEntries.size() * sizeof(ArchiveTexture));
+		result = result && file.Write(materialData.data(), materialData.size());
+		offset += modelEntries.size() * sizeof(ArchiveModel) + textureEntries.size() * sizeof(ArchiveTexture) + materialData.size();
+
+		for (size_t i = 0; i < models.size() && result; i++)
+		{
+			const Model& model = *models[i];
+			const ArchiveModel& entry = modelEntries[i];
+			result = result && WriteBlob(file, offset, entry.vertexOffset, model.VertexData(), entry.vertexCount * sizeof(Vertex));
+			result = result && WriteBlob(file, offset, entry.indexOffset, model.IndexData(), entry.indexCount * sizeof(uint32_t));
+			result = result && WriteBlob(file, offset, entry.frameOffset, model.FrameData(), entry.vertexCount * sizeof(VertexFrame));
+			result = result && WriteBlob(file, offset, entry.submeshOffset, submeshes[i].data(), entry.submeshCount * sizeof(Submesh));
+			result = result && WriteBlob(file, offset, entry.clusterOffset, model.clusters.data(), entry.clusterCount * sizeof(Cluster));
+			result = result && WriteBlob(file, offset, entry.lodOffset, model.lods.data(), entry.lodCount * sizeof(ClusterLod));
+			result = result && WriteBlob(file, offset, entry.instanceOffset, model.instances.data(), entry.instanceCount * sizeof(DirectX::XMFLOAT3X4));
+		}
+
+		for (size_t i = 0; i < textures.size() && result; i++)
+		{
+			result = WriteTexture(file, offset, textureEntries[i].texelOffset, textures[i]);
+		}
+
+		// A failed write leaves any previous archive in place
+		if (!result || !file.Commit())
+		{
+			throw std::runtime_error("Error: failed to write archive " + archivePath);
+		}
+
+		BakeStats stats;
+		stats.modelCount = models.size();
+		stats.materialCount = materials.size();
+		stats.textureCount = textures.size();
+		stats.archiveBytes = offset;
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+
+	void Load(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials)
+	{
+		Utils::Timer timer;
+
+		std::shared_ptr<Utils::MappedFile> file = std::make_shared<Utils::MappedFile>();
+		if (!file->Open(filepath))
+		{
+			throw std::runtime_error("Error: failed to open archive " + filepath);
+		}
+
+		const std::runtime_error invalid("Error: invalid archive " + filepath);
+		const UINT64 size = file->Size();
+		if (size < sizeof(ArchiveHeader)) throw invalid;
+
+		ArchiveHeader header;
+		memcpy(&header, file->Data(), sizeof(header));
+		if (memcmp(header.magic, ArchiveMagic, sizeof(ArchiveMagic)) != 0) throw invalid;
+		if (header.version != ArchiveVersion || header.pageSize != ArchivePageSize || header.vertexStride != sizeof(Vertex)) throw invalid;
+
+		const UINT64 tocSize = sizeof(ArchiveHeader) + header.modelCount * sizeof(ArchiveModel) + header.textureCount * sizeof(ArchiveTexture) + header.materialBytes;
+		if (tocSize > size) throw invalid;
+
+		std::vector<ArchiveModel> modelEntries(header.modelCount);
+		std::vector<ArchiveTexture> textureEntries(header.textureCount);
+		const char* p = file->Data() + sizeof(ArchiveHeader);
+		memcpy(modelEntries.data(), p, modelEntries.size() * sizeof(ArchiveModel));
+		p += modelEntries.size() * sizeof(ArchiveModel);
+		memcpy(textureEntries.data(), p, textureEntries.size() * sizeof(ArchiveTexture));
+		p += textureEntries.size() * sizeof(ArchiveTexture);
+
+		std::vector<Material> archiveMaterials(header.materialCount);
+		const char* end = p + header.materialBytes;
+		for (Material& material : archiveMaterials)
+		{
+			UINT32 resolution = 0;
+			UINT32 texture = 0;
+			if (!ReadString(p, end, material.name) || !ReadString(p, end, material.texturePath)) throw invalid;
+			if (!ReadInt(p, end, resolution) || !ReadInt(p, end, texture)) throw invalid;
+
+			material.textureResolution = static_cast<int>(resolution);
+			if (texture == NoTexture) continue;
+			if (texture >= textureEntries.size()) throw invalid;
+
+			const ArchiveTexture& entry = textureEntries[texture];
+			if (!IsArchiveFormat(entry.format) || entry.width == 0 || entry.height == 0) throw invalid;
+			if (entry.mipLevels == 0 || entry.mipLevels > MipGenerator::GetMipCount(entry.width, entry.height)) throw invalid;
+
+			std::vector<TextureLevelLayout> levels;
+			const UINT64 texelBytes = TextureCache::GetLayout(entry.width, entry.height, entry.mipLevels, static_cast<DXGI_FORMAT>(entry.format), levels);
+			if ((entry.texelOffset % ArchivePageSize) != 0 || entry.texelBytes != texelBytes || !InFile(entry.texelOffset, texelBytes, 1, size)) throw invalid;
+
+			material.mapping = file;
+			material.embeddedTexture = reinterpret_cast<const UINT8*>(file->Data() + entry.texelOffset);
+			material.embeddedTextureSize = static_cast<size_t>(texelBytes);
+			material.embeddedWidth = static_cast<int>(entry.width);
+			material.embeddedHeight = static_cast<int>(entry.height);
+			material.embeddedMipLevels = static_cast<int>(entry.mipLevels);
+			material.embeddedFormat = static_cast<DXGI_FORMAT>(entry.format);
+		}
+
+		std::vector<std::shared_ptr<Model>> archiveModels;
+		for (const ArchiveModel& entry : modelEntries)
+		{
+			if ((entry.vertexOffset % ArchivePageSize) != 0 || (entry.indexOffset % ArchivePageSize) != 0 || (entry.frameOffset % ArchivePageSize) != 0) throw invalid;
+			if (!InFile(entry.vertexOffset, entry.vertexCount, sizeof(Vertex), size) || !InFile(entry.indexOffset, entry.indexCount, sizeof(uint32_t), size)) throw invalid;
+			if (!InFile(entry.frameOffset, entry.vertexCount, sizeof(VertexFrame), size) || !InFile(entry.submeshOffset, entry.submeshCount, sizeof(Submesh), size)) throw invalid;
+			if (!InFile(entry.clusterOffset, entry.clusterCount, sizeof(Cluster), size) || !InFile(entry.lodOffset, entry.lodCount, sizeof(ClusterLod), size)) throw invalid;
+			if (!InFile(entry.instanceOffset, entry.instanceCount, sizeof(DirectX::XMFLOAT3X4), size)) throw invalid;
+
+			std::shared_ptr<Model> model = std::make_shared<Model>();
+			model->mappedVertices = reinterpret_cast<const Vertex*>(file->Data() + entry.vertexOffset);
+			model->mappedIndices = reinterpret_cast<const uint32_t*>(file->Data() + entry.indexOffset);
+			model->mappedFrames = reinterpret_cast<const VertexFrame*>(file->Data() + entry.frameOffset);
+			model->mappedVertexCount = static_cast<size_t>(entry.vertexCount);
+			model->mappedIndexCount = static_cast<size_t>(entry.indexCount);
+			model->mapping = file;
+
+			const Submesh* submeshes = reinterpret_cast<const Submesh*>(file->Data() + entry.submeshOffset);
+			model->submeshes.assign(submeshes, submeshes + entry.submeshCount);
+
+			const Cluster* clusters = reinterpret_cast<const Cluster*>(file->Data() + entry.clusterOffset);
+			model->clusters.assign(clusters, clusters + entry.clusterCount);
+
+			const ClusterLod* lods = reinterpret_cast<const ClusterLod*>(file->Data() + entry.lodOffset);
+			model->lods.assign(lods, lods + entry.lodCount);
+
+			const DirectX::XMFLOAT3X4* instances = reinterpret_cast<const DirectX::XMFLOAT3X4*>(file->Data() + entry.instanceOffset);
+			model->instances.assign(instances, instances + entry.instanceCount);
+
+			// The renderer indexes through every one of these ranges, so a damaged archive is rejected as a damaged mesh
+			// cache entry is
+			if (!MeshCache::IsInRange(*model, archiveMaterials.size())) throw invalid;
+
+			archiveModels.push_back(model);
+		}
+
+		models.insert(models.end(), archiveModels.begin(), archiveModels.end());
+		materials = archiveMaterials;
+
+		printf("Mapped archive %s with %zu models, %zu materials and %zu textures in %.2f ms\n", filepath.c_str(), archiveModels.size(), archiveMaterials.size(), textureEntries.size(), timer.ElapsedMillis());
+	}
+}
\ No newline at end of file
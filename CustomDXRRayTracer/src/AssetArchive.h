@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Structures.h"
+
+struct BakeStats
+{
+	size_t modelCount = 0;
+	size_t materialCount = 0;
+	size_t textureCount = 0;
+	UINT64 archiveBytes = 0;
+	float milliseconds = 0.f;
+};
+
+namespace AssetArchive
+{
+	static const UINT64 ArchivePageSize = 4096;
+
+	bool IsArchive(const std::string& filepath);
+
+	// Loads every model (OBJ, PLY, GLB or scene) and every texture they reference in parallel through the regular
+	// loaders, then writes one archive: a table of contents followed by page-aligned vertex, index, frame and texel
+	// blobs. Textures are stored in the GPU form the options give them, mip chain and block compression included, so
+	// the renderer uploads them as they are. Material indices are rewritten so all models share one material table.
+	BakeStats Bake(const std::string& archivePath, const std::vector<std::string>& modelPaths, const TextureOptions& options);
+
+	// Maps an archive and returns its models and materials pointing straight into the mapping
+	void Load(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials);
+}
\ No newline at end of file
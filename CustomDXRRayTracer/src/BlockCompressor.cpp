@@ -0,0 +1,815 @@
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+namespace
+{
+	const size_t BlocksPerTask = 1024;
+	const int PowerIterations = 8;
+
+	const int Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Two-subset partitions as masks of the texels in the second subset, and the anchor texel of that subset
+	const UINT16 Bc7Partitions2[64] =
+	{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	const UINT8 Bc7Anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+
+	// Endpoint precision, without the p-bit, and index precision of the modes the encoder uses
+	struct Bc7Mode
+	{
+		int colorBits;
+		int alphaBits;
+		bool sharedPBit;
+		int indexBits;
+		const int* weights;
+	};
+
+	const Bc7Mode Mode1 = { 6, 0, true, 3, Bc7Weights3 };
+	const Bc7Mode Mode6 = { 7, 7, false, 4, Bc7Weights4 };
+
+	struct QualitySettings
+	{
+		int refineIterations;
+		bool searchPBits;
+		int partitionCandidates;
+	};
+
+	QualitySettings GetQualitySettings(CompressionQuality quality)
+	{
+		if (quality == CompressionQuality::Fast) return { 0, false, 0 };
+		if (quality == CompressionQuality::Normal) return { 1, true, 4 };
+		return { 3, true, 16 };
+	}
+
+	struct SubsetFit
+	{
+		int endpoints[2][4];
+		int pBits[2];
+		UINT8 indices[16];
+		float error;
+	};
+
+	class BitWriter
+	{
+	public:
+		BitWriter(UINT8* block, size_t size) : m_Block(block)
+		{
+			memset(block, 0, size);
+		}
+
+		void Write(UINT value, int count)
+		{
+			for (int i = 0; i < count; i++, m_Position++)
+			{
+				m_Block[m_Position >> 3] |= static_cast<UINT8>(((value >> i) & 1) << (m_Position & 7));
+			}
+		}
+
+	private:
+		UINT8* m_Block;
+		int m_Position = 0;
+	};
+
+	// Principal axis of the texels' covariance by power iteration, or zero if they are all the same
+	void FindPrincipalAxis(const float (*texels)[4], int count, int channels, float mean[4], float axis[4])
+	{
+		for (int c = 0; c < 4; c++) mean[c] = axis[c] = 0.f;
+		for (int i = 0; i < count; i++)
+		{
+			for (int c = 0; c < channels; c++) mean[c] += texels[i][c];
+		}
+		for (int c = 0; c < channels; c++) mean[c] /= count;
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < count; i++)
+		{
+			for (int a = 0; a < channels; a++)
+			{
+				for (int b = a; b < channels; b++) covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+			}
+		}
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < a; b++) covariance[a][b] = covariance[b][a];
+		}
+
+		// Start from the covariance row of the widest channel, which cannot be orthogonal to the principal axis
+		int widest = 0;
+		for (int c = 1; c < channels; c++)
+		{
+			if (covariance[c][c] > covariance[widest][widest]) widest = c;
+		}
+
+		float vector[4];
+		for (int c = 0; c < 4; c++) vector[c] = covariance[widest][c];
+
+		for (int iteration = 0; iteration < PowerIterations; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.f;
+			for (int a = 0; a < channels; a++)
+			{
+				for (int b = 0; b < channels; b++) next[a] += covariance[a][b] * vector[b];
+				length += next[a] * next[a];
+			}
+
+			if (length < 1e-12f) return;
+
+			length = 1.f / sqrtf(length);
+			for (int a = 0; a < channels; a++) vector[a] = next[a] * length;
+		}
+
+		for (int c = 0; c < channels; c++) axis[c] = vector[c];
+	}
+
+	// Endpoints spanning the texels' projections onto their principal axis
+	void FitLine(const float (*texels)[4], int count, int channels, float low[4], float high[4])
+	{
+		float mean[4];
+		float axis[4];
+		FindPrincipalAxis(texels, count, channels, mean, axis);
+
+		float minimum = 0.f;
+		float maximum = 0.f;
+		for (int i = 0; i < count; i++)
+		{
+			float t = 0.f;
+			for (int c = 0; c < channels; c++) t += (texels[i][c] - mean[c]) * axis[c];
+			minimum = (std::min)(minimum, t);
+			maximum = (std::max)(maximum, t);
+		}
+
+		for (int c = 0; c < 4; c++)
+		{
+			low[c] = (std::min)((std::max)(mean[c] + axis[c] * minimum, 0.f), 255.f);
+			high[c] = (std::min)((std::max)(mean[c] + axis[c] * maximum, 0.f), 255.f);
+		}
+	}
+
+	// Least-squares endpoints for fixed interpolation weights; returns false when every texel uses one weight
+	bool RefineEndpoints(const float (*texels)[4], int count, int channels, const float* weights, float low[4], float high[4])
+	{
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ax[4] = {}, bx[4] = {};
+		for (int i = 0; i < count; i++)
+		{
+			const float b = weights[i];
+			const float a = 1.f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < channels; c++)
+			{
+				ax[c] += a * texels[i][c];
+				bx[c] += b * texels[i][c];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f) return false;
+
+		for (int c = 0; c < channels; c++)
+		{
+			low[c] = (std::min)((std::max)((bb * ax[c] - ab * bx[c]) / determinant, 0.f), 255.f);
+			high[c] = (std::min)((std::max)((aa * bx[c] - ab * ax[c]) / determinant, 0.f), 255.f);
+		}
+		return true;
+	}
+
+	inline int ExpandBc7(int quantized, int pBit, int bits)
+	{
+		const int value = (quantized << 1) | pBit;
+		return (value << (8 - bits)) | (value >> (2 * bits - 8));
+	}
+
+	// Nearest quantised value for a channel once the p-bit is appended and the result expanded to 8 bits
+	int QuantizeBc7(float value, int pBit, int bits, int& error)
+	{
+		const int maximum = (1 << bits) - 1;
+		const int guess = static_cast<int>(((value / 255.f) * ((1 << (bits + 1)) - 1) - pBit) * 0.5f + 0.5f);
+
+		int best = 0;
+		error = INT_MAX;
+		for (int q = (std::max)(guess - 1, 0); q <= (std::min)(guess + 1, maximum); q++)
+		{
+			const int difference = ExpandBc7(q, pBit, bits + 1) - static_cast<int>(value + 0.5f);
+			if (difference * difference < error)
+			{
+				error = difference * difference;
+				best = q;
+			}
+		}
+		return best;
+	}
+
+	// Quantises both endpoints with the given p-bits, then picks each texel's nearest palette entry
+	void EvaluateBc7(const float (*texels)[4], int count, const Bc7Mode& mode, const float low[4], const float high[4], const int pBits[2], SubsetFit& fit)
+	{
+		const int channels = mode.alphaBits ? 4 : 3;
+		const float* endpoints[2] = { low, high };
+
+		int expanded[2][4];
+		for (int e = 0; e < 2; e++)
+		{
+			fit.pBits[e] = pBits[e];
+			for (int c = 0; c < 4; c++)
+			{
+				int error;
+				const int bits = (c < 3) ? mode.colorBits : mode.alphaBits;
+				fit.endpoints[e][c] = (c < channels) ? QuantizeBc7(endpoints[e][c], pBits[e], bits, error) : 0;
+				expanded[e][c] = (c < channels) ? ExpandBc7(fit.endpoints[e][c], pBits[e], bits + 1) : 255;
+			}
+		}
+
+		const int paletteSize = 1 << mode.indexBits;
+		int palette[16][4];
+		for (int k = 0; k < paletteSize; k++)
+		{
+			for (int c = 0; c < 4; c++) palette[k][c] = ((64 - mode.weights[k]) * expanded[0][c] + mode.weights[k] * expanded[1][c] + 32) >> 6;
+		}
+
+		// Project each texel onto the endpoint line for the nearest weight, then check the entries either side of it
+		float direction[4];
+		float lengthSquared = 0.f;
+		for (int c = 0; c < 4; c++)
+		{
+			direction[c] = static_cast<float>(expanded[1][c] - expanded[0][c]);
+			lengthSquared += direction[c] * direction[c];
+		}
+		const float scale = (lengthSquared > 0.f) ? 64.f / lengthSquared : 0.f;
+
+		fit.error = 0.f;
+		for (int i = 0; i < count; i++)
+		{
+			float t = 0.f;
+			for (int c = 0; c < 4; c++) t += (texels[i][c] - expanded[0][c]) * direction[c];
+
+			const int weight = (std::min)((std::max)(static_cast<int>(t * scale + 0.5f), 0), 64);
+			int guess = 0;
+			while (guess + 1 < paletteSize && mode.weights[guess + 1] <= weight) guess++;
+
+			float bestError = FLT_MAX;
+			for (int k = (std::max)(guess - 1, 0); k <= (std::min)(guess + 1, paletteSize - 1); k++)
+			{
+				float error = 0.f;
+				for (int c = 0; c < 4; c++)
+				{
+					const float difference = texels[i][c] - palette[k][c];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					fit.indices[i] = static_cast<UINT8>(k);
+				}
+			}
+			fit.error += bestError;
+		}
+	}
+
+	// p-bits that keep the endpoints closest to their unquantised values, for the fast preset
+	void ChoosePBits(const Bc7Mode& mode, const float low[4], const float high[4], int pBits[2])
+	{
+		const int channels = mode.alphaBits ? 4 : 3;
+		const float* endpoints[2] = { low, high };
+
+		int errors[2][2] = {};
+		for (int e = 0; e < 2; e++)
+		{
+			for (int p = 0; p < 2; p++)
+			{
+				for (int c = 0; c < channels; c++)
+				{
+					int error;
+					QuantizeBc7(endpoints[e][c], p, (c < 3) ? mode.colorBits : mode.alphaBits, error);
+					errors[e][p] += error;
+				}
+			}
+		}
+
+		if (mode.sharedPBit)
+		{
+			pBits[0] = pBits[1] = (errors[0][1] + errors[1][1] < errors[0][0] + errors[1][0]) ? 1 : 0;
+		}
+		else
+		{
+			pBits[0] = (errors[0][1] < errors[0][0]) ? 1 : 0;
+			pBits[1] = (errors[1][1] < errors[1][0]) ? 1 : 0;
+		}
+	}
+
+	SubsetFit FitBc7Subset(const float (*texels)[4], int count, const Bc7Mode& mode, const QualitySettings& settings)
+	{
+		const int channels = mode.alphaBits ? 4 : 3;
+		float low[4];
+		float high[4];
+		FitLine(texels, count, channels, low, high);
+
+		SubsetFit best;
+		best.error = FLT_MAX;
+		for (int iteration = 0; iteration <= settings.refineIterations; iteration++)
+		{
+			if (settings.searchPBits)
+			{
+				const int combinations = mode.sharedPBit ? 2 : 4;
+				for (int combination = 0; combination < combinations; combination++)
+				{
+					const int pBits[2] = { mode.sharedPBit ? combination : (combination & 1), mode.sharedPBit ? combination : (combination >> 1) };
+
+					SubsetFit fit;
+					EvaluateBc7(texels, count, mode, low, high, pBits, fit);
+					if (fit.error < best.error) best = fit;
+				}
+			}
+			else
+			{
+				int pBits[2];
+				ChoosePBits(mode, low, high, pBits);
+
+				SubsetFit fit;
+				EvaluateBc7(texels, count, mode, low, high, pBits, fit);
+				if (fit.error < best.error) best = fit;
+			}
+
+			if (best.error == 0.f || iteration == settings.refineIterations) break;
+
+			float weights[16];
+			for (int i = 0; i < count; i++) weights[i] = mode.weights[best.indices[i]] / 64.f;
+			if (!RefineEndpoints(texels, count, channels, weights, low, high)) break;
+		}
+
+		return best;
+	}
+
+	// Swaps a subset's endpoints and inverts its indices so its anchor texel's index has a zero top bit
+	void FixAnchor(SubsetFit& fit, int anchor, int indexBits)
+	{
+		const int top = 1 << (indexBits - 1);
+		if (fit.indices[anchor] < top) return;
+
+		for (int c = 0; c < 4; c++) std::swap(fit.endpoints[0][c], fit.endpoints[1][c]);
+		std::swap(fit.pBits[0], fit.pBits[1]);
+		for (UINT8& index : fit.indices) index = static_cast<UINT8>(((1 << indexBits) - 1) - index);
+	}
+
+	void WriteMode6(SubsetFit fit, UINT8* block)
+	{
+		FixAnchor(fit, 0, Mode6.indexBits);
+
+		BitWriter writer(block, 16);
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(fit.endpoints[0][c], 7);
+			writer.Write(fit.endpoints[1][c], 7);
+		}
+		writer.Write(fit.pBits[0], 1);
+		writer.Write(fit.pBits[1], 1);
+		for (int i = 0; i < 16; i++) writer.Write(fit.indices[i], (i == 0) ? 3 : 4);
+	}
+
+	void WriteMode1(SubsetFit subsets[2], const int (*texelSubset)[2], int partition, UINT8* block)
+	{
+		// Subset indices are stored in subset order, so each anchor texel is looked up by its slot in its subset
+		const int anchorSlots[2] = { 0, texelSubset[Bc7Anchors2[partition]][1] };
+		FixAnchor(subsets[0], anchorSlots[0], Mode1.indexBits);
+		FixAnchor(subsets[1], anchorSlots[1], Mode1.indexBits);
+
+		BitWriter writer(block, 16);
+		writer.Write(1 << 1, 2);
+		writer.Write(partition, 6);
+		for (int c = 0; c < 3; c++)
+		{
+			for (int s = 0; s < 2; s++)
+			{
+				writer.Write(subsets[s].endpoints[0][c], 6);
+				writer.Write(subsets[s].endpoints[1][c], 6);
+			}
+		}
+		writer.Write(subsets[0].pBits[0], 1);
+		writer.Write(subsets[1].pBits[0], 1);
+		for (int i = 0; i < 16; i++)
+		{
+			const bool anchor = (i == 0 || i == Bc7Anchors2[partition]);
+			writer.Write(subsets[texelSubset[i][0]].indices[texelSubset[i][1]], anchor ? 2 : 3);
+		}
+	}
+
+	// Colour sums and second moments of one texel, or summed over a set of texels
+	struct Moments
+	{
+		float values[9];
+
+		void Add(const float* texel, float sign)
+		{
+			values[0] += sign * texel[0];
+			values[1] += sign * texel[1];
+			values[2] += sign * texel[2];
+			values[3] += sign * texel[0] * texel[0];
+			values[4] += sign * texel[0] * texel[1];
+			values[5] += sign * texel[0] * texel[2];
+			values[6] += sign * texel[1] * texel[1];
+			values[7] += sign * texel[1] * texel[2];
+			values[8] += sign * texel[2] * texel[2];
+		}
+	};
+
+	// Squared distance of a subset's texels from their principal line: the variance left off the largest eigenvalue
+	float LineResidual(const Moments& moments, int count)
+	{
+		const float* m = moments.values;
+		const float n = 1.f / count;
+		const float covariance[3][3] =
+		{
+			{ m[3] - m[0] * m[0] * n, m[4] - m[0] * m[1] * n, m[5] - m[0] * m[2] * n },
+			{ m[4] - m[0] * m[1] * n, m[6] - m[1] * m[1] * n, m[7] - m[1] * m[2] * n },
+			{ m[5] - m[0] * m[2] * n, m[7] - m[1] * m[2] * n, m[8] - m[2] * m[2] * n }
+		};
+		const float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+
+		int widest = 0;
+		for (int c = 1; c < 3; c++)
+		{
+			if (covariance[c][c] > covariance[widest][widest]) widest = c;
+		}
+
+		float vector[3] = { covariance[widest][0], covariance[widest][1], covariance[widest][2] };
+		float eigenvalue = 0.f;
+		for (int iteration = 0; iteration < 4; iteration++)
+		{
+			float next[3];
+			for (int a = 0; a < 3; a++) next[a] = covariance[a][0] * vector[0] + covariance[a][1] * vector[1] + covariance[a][2] * vector[2];
+
+			const float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length < 1e-6f) return trace;
+
+			eigenvalue = length;
+			for (int a = 0; a < 3; a++) vector[a] = next[a] / length;
+		}
+		return (std::max)(trace - eigenvalue, 0.f);
+	}
+
+	// Estimates every two-subset partition from moment sums, so the whole ranking costs about one pass over the texels
+	void RankPartitions(const float (*texels)[4], std::pair<float, int> ranked[64])
+	{
+		Moments total = {};
+		for (int i = 0; i < 16; i++) total.Add(texels[i], 1.f);
+
+		for (int p = 0; p < 64; p++)
+		{
+			Moments second = {};
+			int count = 0;
+			for (int i = 0; i < 16; i++)
+			{
+				if ((Bc7Partitions2[p] >> i) & 1)
+				{
+					second.Add(texels[i], 1.f);
+					count++;
+				}
+			}
+
+			Moments first = total;
+			for (int k = 0; k < 9; k++) first.values[k] -= second.values[k];
+
+			ranked[p] = std::make_pair(LineResidual(first, 16 - count) + LineResidual(second, count), p);
+		}
+	}
+
+	inline UINT16 PackRgb565(const float color[4])
+	{
+		const int r = static_cast<int>(color[0] * 31.f / 255.f + 0.5f);
+		const int g = static_cast<int>(color[1] * 63.f / 255.f + 0.5f);
+		const int b = static_cast<int>(color[2] * 31.f / 255.f + 0.5f);
+		return static_cast<UINT16>((r << 11) | (g << 5) | b);
+	}
+
+	inline void UnpackRgb565(UINT16 packed, int color[3])
+	{
+		const int r = (packed >> 11) & 31;
+		const int g = (packed >> 5) & 63;
+		const int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	struct Bc1Fit
+	{
+		UINT16 colors[2];
+		UINT8 indices[16];
+		float error;
+	};
+
+	// Palette of a BC1 block in four-colour mode (colour 0 above colour 1) or three-colour mode with transparency
+	void EvaluateBc1(const float (*texels)[4], const bool* transparent, UINT16 color0, UINT16 color1, bool threeColor, Bc1Fit& fit)
+	{
+		int endpoints[2][3];
+		UnpackRgb565(color0, endpoints[0]);
+		UnpackRgb565(color1, endpoints[1]);
+
+		int palette[4][3];
+		for (int c = 0; c < 3; c++)
+		{
+			palette[0][c] = endpoints[0][c];
+			palette[1][c] = endpoints[1][c];
+			palette[2][c] = threeColor ? (endpoints[0][c] + endpoints[1][c]) / 2 : (2 * endpoints[0][c] + endpoints[1][c]) / 3;
+			palette[3][c] = threeColor ? 0 : (endpoints[0][c] + 2 * endpoints[1][c]) / 3;
+		}
+
+		fit.colors[0] = color0;
+		fit.colors[1] = color1;
+		fit.error = 0.f;
+		for (int i = 0; i < 16; i++)
+		{
+			if (transparent[i])
+			{
+				fit.indices[i] = 3;
+				continue;
+			}
+
+			float bestError = FLT_MAX;
+			for (int k = 0; k < (threeColor ? 3 : 4); k++)
+			{
+				float error = 0.f;
+				for (int c = 0; c < 3; c++)
+				{
+					const float difference = texels[i][c] - palette[k][c];
+					error += difference * difference;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					fit.indices[i] = static_cast<UINT8>(k);
+				}
+			}
+			fit.error += bestError;
+		}
+	}
+}
+
+namespace BlockCompressor
+{
+	DXGI_FORMAT GetFormat(TextureCompression compression)
+	{
+		if (compression == TextureCompression::BC1) return DXGI_FORMAT_BC1_UNORM;
+		if (compression == TextureCompression::BC7) return DXGI_FORMAT_BC7_UNORM;
+		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+
+	UINT GetBlockBytes(DXGI_FORMAT format)
+	{
+		return (format == DXGI_FORMAT_BC1_UNORM) ? 8 : 16;
+	}
+
+	bool IsCompressed(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC7_UNORM;
+	}
+
+	bool CanCompress(const TextureInfo& texture)
+	{
+		return texture.format == DXGI_FORMAT_R8G8B8A8_UNORM && texture.stride == 4 && (texture.width % BlockSize) == 0 && (texture.height % BlockSize) == 0;
+	}
+
+	void EncodeBc1Block(const UINT8* texels, UINT8* block, CompressionQuality quality)
+	{
+		const QualitySettings settings = GetQualitySettings(quality);
+
+		float colors[16][4];
+		bool transparent[16];
+		int opaqueCount = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			transparent[i] = texels[i * 4 + 3] < 128;
+			if (transparent[i]) continue;
+
+			for (int c = 0; c < 4; c++) colors[opaqueCount][c] = texels[i * 4 + c];
+			opaqueCount++;
+		}
+
+		// The texels the endpoints are fitted to skip transparent ones, but evaluation needs all 16 in place
+		float all[16][4];
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++) all[i][c] = texels[i * 4 + c];
+		}
+
+		const bool threeColor = opaqueCount < 16;
+		Bc1Fit best;
+		if (opaqueCount == 0)
+		{
+			EvaluateBc1(all, transparent, 0, 0, true, best);
+		}
+		else
+		{
+			float low[4];
+			float high[4];
+			FitLine(colors, opaqueCount, 3, low, high);
+
+			best.error = FLT_MAX;
+			for (int iteration = 0; iteration <= settings.refineIterations; iteration++)
+			{
+				Bc1Fit fit;
+				EvaluateBc1(all, transparent, PackRgb565(high), PackRgb565(low), threeColor, fit);
+				if (fit.error < best.error) best = fit;
+
+				if (best.error == 0.f || iteration == settings.refineIterations) break;
+
+				static const float FourColorWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+				static const float ThreeColorWeights[4] = { 0.f, 1.f, 0.5f, 0.f };
+				float weights[16];
+				int count = 0;
+				for (int i = 0; i < 16; i++)
+				{
+					if (!transparent[i]) weights[count++] = (threeColor ? ThreeColorWeights : FourColorWeights)[best.indices[i]];
+				}
+
+				// Weights run from colour 0 to colour 1, so the refined line comes back as (high, low)
+				if (!RefineEndpoints(colors, opaqueCount, 3, weights, high, low)) break;
+			}
+		}
+
+		// Four-colour blocks need colour 0 above colour 1 and three-colour blocks the reverse
+		if (threeColor ? (best.colors[0] > best.colors[1]) : (best.colors[0] < best.colors[1]))
+		{
+			std::swap(best.colors[0], best.colors[1]);
+			for (UINT8& index : best.indices)
+			{
+				if (index < 2) index ^= 1;
+				else if (!threeColor) index ^= 1;
+			}
+		}
+		else if (!threeColor && best.colors[0] == best.colors[1])
+		{
+			memset(best.indices, 0, sizeof(best.indices));
+		}
+
+		UINT32 indices = 0;
+		for (int i = 0; i < 16; i++) indices |= static_cast<UINT32>(best.indices[i]) << (i * 2);
+
+		memcpy(block, &best.colors[0], 2);
+		memcpy(block + 2, &best.colors[1], 2);
+		memcpy(block + 4, &indices, 4);
+	}
+
+	void EncodeBc7Block(const UINT8* texels, UINT8* block, CompressionQuality quality)
+	{
+		const QualitySettings settings = GetQualitySettings(quality);
+
+		float colors[16][4];
+		bool opaque = true;
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++) colors[i][c] = texels[i * 4 + c];
+			opaque = opaque && texels[i * 4 + 3] == 255;
+		}
+
+		const SubsetFit single = FitBc7Subset(colors, 16, Mode6, settings);
+		if (!opaque || settings.partitionCandidates == 0 || single.error == 0.f)
+		{
+			WriteMode6(single, block);
+			return;
+		}
+
+		// Rank the partitions by how well a line fits each subset, then encode only the most promising ones
+		std::pair<float, int> ranked[64];
+		RankPartitions(colors, ranked);
+		std::partial_sort(ranked, ranked + settings.partitionCandidates, ranked + 64);
+
+		float bestError = single.error;
+		int bestPartition = -1;
+		SubsetFit bestSubsets[2];
+		int bestTexelSubset[16][2];
+		for (int candidate = 0; candidate < settings.partitionCandidates; candidate++)
+		{
+			const int partition = ranked[candidate].second;
+
+			float subsetColors[2][16][4];
+			int counts[2] = { 0, 0 };
+			int texelSubset[16][2];
+			for (int i = 0; i < 16; i++)
+			{
+				const int s = (Bc7Partitions2[partition] >> i) & 1;
+				texelSubset[i][0] = s;
+				texelSubset[i][1] = counts[s];
+				memcpy(subsetColors[s][counts[s]++], colors[i], sizeof(colors[0]));
+			}
+
+			SubsetFit subsets[2] = { FitBc7Subset(subsetColors[0], counts[0], Mode1, settings), FitBc7Subset(subsetColors[1], counts[1], Mode1, settings) };
+			const float error = subsets[0].error + subsets[1].error;
+			if (error < bestError)
+			{
+				bestError = error;
+				bestPartition = partition;
+				bestSubsets[0] = subsets[0];
+				bestSubsets[1] = subsets[1];
+				memcpy(bestTexelSubset, texelSubset, sizeof(texelSubset));
+			}
+		}
+
+		if (bestPartition < 0) WriteMode6(single, block);
+		else WriteMode1(bestSubsets, bestTexelSubset, bestPartition, block);
+	}
+
+	CompressStats Compress(TextureInfo& texture, TextureCompression compression, CompressionQuality quality)
+	{
+		Utils::Timer timer;
+		CompressStats stats;
+
+		if (compression == TextureCompression::None) return stats;
+		if (!CanCompress(texture))
+		{
+			throw std::runtime_error("Error: block compression needs an RGBA8 texture whose size is a multiple of 4");
+		}
+
+		const DXGI_FORMAT format = GetFormat(compression);
+		const UINT blockBytes = GetBlockBytes(format);
+		const UINT width = static_cast<UINT>(texture.width);
+		const UINT height = static_cast<UINT>(texture.height);
+		const UINT levelCount = static_cast<UINT>(texture.mipLevels);
+
+		// One task per run of block rows within a level
+		struct BlockRows
+		{
+			UINT level;
+			UINT firstRow;
+			UINT rowCount;
+			size_t outputOffset;
+		};
+
+		std::vector<BlockRows> tasks;
+		size_t outputSize = 0;
+		for (UINT level = 0; level < levelCount; level++)
+		{
+			const UINT blocksWide = (MipGenerator::GetMipSize(width, level) + BlockSize - 1) / BlockSize;
+			const UINT blocksHigh = (MipGenerator::GetMipSize(height, level) + BlockSize - 1) / BlockSize;
+			const UINT rowsPerTask = static_cast<UINT>((std::max)(static_cast<size_t>(1), BlocksPerTask / blocksWide));
+			for (UINT row = 0; row < blocksHigh; row += rowsPerTask)
+			{
+				const UINT rowCount = (std::min)(rowsPerTask, blocksHigh - row);
+				tasks.push_back({ level, row, rowCount, outputSize });
+				outputSize += static_cast<size_t>(rowCount) * blocksWide * blockBytes;
+			}
+			stats.blockCount += static_cast<size_t>(blocksWide) * blocksHigh;
+		}
+
+		std::vector<UINT8> output(outputSize);
+		Utils::ParallelFor(static_cast<UINT>(tasks.size()), [&](UINT t)
+		{
+			const BlockRows& task = tasks[t];
+			const UINT levelWidth = MipGenerator::GetMipSize(width, task.level);
+			const UINT levelHeight = MipGenerator::GetMipSize(height, task.level);
+			const UINT blocksWide = (levelWidth + BlockSize - 1) / BlockSize;
+			const UINT8* source = &texture.pixels[MipGenerator::GetMipOffset(width, height, task.level)];
+			UINT8* destination = &output[task.outputOffset];
+
+			UINT8 texels[64];
+			for (UINT row = task.firstRow; row < task.firstRow + task.rowCount; row++)
+			{
+				for (UINT column = 0; column < blocksWide; column++)
+				{
+					for (UINT i = 0; i < 16; i++)
+					{
+						const UINT x = (std::min)(column * BlockSize + (i & 3), levelWidth - 1);
+						const UINT y = (std::min)(row * BlockSize + (i >> 2), levelHeight - 1);
+						memcpy(&texels[i * 4], source + (static_cast<size_t>(y) * levelWidth + x) * 4, 4);
+					}
+
+					if (compression == TextureCompression::BC1) EncodeBc1Block(texels, destination, quality);
+					else EncodeBc7Block(texels, destination, quality);
+					destination += blockBytes;
+				}
+			}
+		});
+
+		stats.inputBytes = texture.pixels.size();
+		stats.outputBytes = output.size();
+
+		texture.pixels.swap(output);
+		texture.format = format;
+		texture.stride = 0;
+
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Structures.h"
+
+struct CompressStats
+{
+	size_t blockCount = 0;
+	size_t inputBytes = 0;
+	size_t outputBytes = 0;
+	float milliseconds = 0.f;
+};
+
+namespace BlockCompressor
+{
+	static const UINT BlockSize = 4;
+
+	DXGI_FORMAT GetFormat(TextureCompression compression);
+
+	UINT GetBlockBytes(DXGI_FORMAT format);
+
+	bool IsCompressed(DXGI_FORMAT format);
+
+	// D3D12 requires the top level of a block-compressed texture to be a whole number of blocks
+	bool CanCompress(const TextureInfo& texture);
+
+	// Encode one 4x4 block of RGBA8 texels, given row by row. BC1 keeps 1-bit alpha by switching blocks with texels
+	// below half alpha to its three-colour mode. BC7 uses mode 6 and, for opaque blocks above the fast preset, mode 1
+	// with the best of the two-subset partitions, whichever reconstructs the block more closely.
+	void EncodeBc1Block(const UINT8* texels, UINT8* block, CompressionQuality quality);
+
+	void EncodeBc7Block(const UINT8* texels, UINT8* block, CompressionQuality quality);
+
+	// Replaces every level of an RGBA8 chain with BC1 or BC7 blocks, packed level after level like the RGBA8 chain.
+	// Block rows of all levels are encoded in parallel; blocks overhanging levels smaller than 4 texels repeat the
+	// last row and column.
+	CompressStats Compress(TextureInfo& texture, TextureCompression compression, CompressionQuality quality);
+}
\ No newline at end of file
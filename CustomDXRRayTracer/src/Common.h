@@ -1,5 +1,7 @@
 #pragma once
 
+#ifdef _WIN32
+
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -13,6 +15,13 @@
 #include <dxc/dxcapi.h>
 #include <dxc/dxcapi.use.h>
 
+#else
+
+#include "Portable.h"
+
+#endif
+
+#include <memory>
 #include <string>
 #include <vector>
 
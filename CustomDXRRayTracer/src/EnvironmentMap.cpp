@@ -0,0 +1,277 @@
+#include "EnvironmentMap.h"
+#include "Utils.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <stb_image.h>
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+
+	// Largest value R9G9B9E5 holds: a full 9-bit mantissa at the largest exponent
+	const float Rgb9e5Max = 65408.f;
+
+	inline float Exp2(int exponent)
+	{
+		const UINT32 bits = static_cast<UINT32>(exponent + 127) << 23;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Luminance times weight and RGB9E5 encoding of a row of RGBA float texels, four texels at a time. Negative and
+	// NaN channels count as zero, as in EncodeRgb9e5, which the vector encoding matches bit for bit.
+	void ConvertRow(const float* texels, UINT width, float weight, float* luminance, UINT32* encoded)
+	{
+		const __m128 r = _mm_set1_ps(0.2126f * weight);
+		const __m128 g = _mm_set1_ps(0.7152f * weight);
+		const __m128 b = _mm_set1_ps(0.0722f * weight);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 largest = _mm_set1_ps(Rgb9e5Max);
+		const __m128 smallest = _mm_set1_ps(1.f / 65536.f);
+
+		UINT x = 0;
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128 t0 = _mm_loadu_ps(texels + x * 4);
+			__m128 t1 = _mm_loadu_ps(texels + x * 4 + 4);
+			__m128 t2 = _mm_loadu_ps(texels + x * 4 + 8);
+			__m128 t3 = _mm_loadu_ps(texels + x * 4 + 12);
+			_MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+			const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(t0, r), _mm_mul_ps(t1, g)), _mm_mul_ps(t2, b));
+			_mm_storeu_ps(luminance + x, _mm_max_ps(sum, zero));
+
+			// The shared exponent of the largest channel, clamped below at 2^-16, is biased so 2^-16 maps to zero
+			const __m128 red = _mm_min_ps(_mm_max_ps(t0, zero), largest);
+			const __m128 green = _mm_min_ps(_mm_max_ps(t1, zero), largest);
+			const __m128 blue = _mm_min_ps(_mm_max_ps(t2, zero), largest);
+			const __m128 maxChannel = _mm_max_ps(_mm_max_ps(_mm_max_ps(red, green), blue), smallest);
+
+			__m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxChannel), 23), _mm_set1_epi32(111));
+			__m128i scale = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(151), exponent), 23);
+
+			const __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxChannel, _mm_castsi128_ps(scale)), half));
+			const __m128i bump = _mm_cmpeq_epi32(rounded, _mm_set1_epi32(512));
+			exponent = _mm_sub_epi32(exponent, bump);
+			scale = _mm_sub_epi32(scale, _mm_and_si128(bump, _mm_set1_epi32(1 << 23)));
+
+			const __m128 multiplier = _mm_castsi128_ps(scale);
+			const __m128i mantissaRed = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(red, multiplier), half));
+			const __m128i mantissaGreen = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(green, multiplier), half));
+			const __m128i mantissaBlue = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(blue, multiplier), half));
+
+			const __m128i packed = _mm_or_si128(_mm_or_si128(mantissaRed, _mm_slli_epi32(mantissaGreen, 9)), _mm_or_si128(_mm_slli_epi32(mantissaBlue, 18), _mm_slli_epi32(exponent, 27)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(encoded + x), packed);
+		}
+
+		for (; x < width; x++)
+		{
+			const float* texel = texels + x * 4;
+			const float sum = texel[0] * 0.2126f * weight + texel[1] * 0.7152f * weight + texel[2] * 0.0722f * weight;
+			luminance[x] = (sum > 0.f) ? sum : 0.f;
+			encoded[x] = EnvironmentMap::EncodeRgb9e5(texel[0], texel[1], texel[2]);
+		}
+	}
+
+	// Picks an index with the alias table, then rescales u to a fresh uniform number from what the choice left unused
+	UINT SampleAlias(const AliasEntry* table, UINT count, float& u)
+	{
+		const float scaled = u * count;
+		const UINT index = (std::min)(static_cast<UINT>(scaled), count - 1);
+		const float remainder = (std::min)(scaled - index, 1.f);
+
+		const AliasEntry& entry = table[index];
+		if (remainder < entry.probability)
+		{
+			u = remainder / entry.probability;
+			return index;
+		}
+
+		u = (remainder - entry.probability) / (1.f - entry.probability);
+		return entry.alias;
+	}
+}
+
+namespace EnvironmentMap
+{
+	bool Load(const std::string& filepath, EnvironmentInfo& environment, EnvironmentStats& stats)
+	{
+		Utils::Timer timer;
+
+		Utils::MappedFile file;
+		if (!file.Open(filepath)) return false;
+
+		int width = 0, height = 0, channels = 0;
+		float* texels = stbi_loadf_from_memory(reinterpret_cast<const stbi_uc*>(file.Data()), static_cast<int>(file.Size()), &width, &height, &channels, 4);
+		if (!texels) return false;
+
+		stats.decodeMilliseconds = timer.ElapsedMillis();
+
+		Build(texels, static_cast<UINT>(width), static_cast<UINT>(height), environment, stats);
+		stbi_image_free(texels);
+
+		stats.milliseconds = timer.ElapsedMillis();
+		return true;
+	}
+
+	void Build(const float* texels, UINT width, UINT height, EnvironmentInfo& environment, EnvironmentStats& stats)
+	{
+		Utils::Timer timer;
+
+		TextureInfo& texture = environment.texture;
+		texture.width = static_cast<int>(width);
+		texture.height = static_cast<int>(height);
+		texture.stride = 4;
+		texture.mipLevels = 1;
+		texture.format = DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+		texture.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		environment.block = (width + EnvironmentTableMaxWidth - 1) / EnvironmentTableMaxWidth;
+		environment.tableWidth = (width + environment.block - 1) / environment.block;
+		environment.tableHeight = (height + environment.block - 1) / environment.block;
+
+		const UINT tableWidth = environment.tableWidth;
+		const UINT tableHeight = environment.tableHeight;
+		environment.table.assign(tableHeight + static_cast<size_t>(tableHeight) * tableWidth, AliasEntry());
+
+		// Each table row encodes its texels, sums their weights into cells and builds its conditional table on its own
+		std::vector<float> weights(static_cast<size_t>(tableWidth) * tableHeight, 0.f);
+		std::vector<float> rowWeights(tableHeight, 0.f);
+		Utils::ParallelFor(tableHeight, [&](UINT tableRow)
+		{
+			std::vector<float> luminance(width);
+			float* cells = weights.data() + static_cast<size_t>(tableRow) * tableWidth;
+			UINT32* encoded = reinterpret_cast<UINT32*>(texture.pixels.data());
+
+			const UINT lastRow = (std::min)((tableRow + 1) * environment.block, height);
+			for (UINT y = tableRow * environment.block; y < lastRow; y++)
+			{
+				const float* row = texels + static_cast<size_t>(y) * width * 4;
+				ConvertRow(row, width, sinf((y + 0.5f) / height * Pi), luminance.data(), encoded + static_cast<size_t>(y) * width);
+
+				for (UINT x = 0, cell = 0; x < width; x += environment.block, cell++)
+				{
+					const UINT last = (std::min)(x + environment.block, width);
+					for (UINT i = x; i < last; i++) cells[cell] += luminance[i];
+				}
+			}
+
+			double sum = 0.0;
+			for (UINT x = 0; x < tableWidth; x++) sum += cells[x];
+			rowWeights[tableRow] = static_cast<float>(sum);
+
+			BuildAliasTable(cells, tableWidth, environment.table.data() + tableHeight + static_cast<size_t>(tableRow) * tableWidth);
+		});
+
+		BuildAliasTable(rowWeights.data(), tableHeight, environment.table.data());
+
+		stats.tableMilliseconds = timer.ElapsedMillis();
+	}
+
+	void BuildAliasTable(const float* weights, UINT count, AliasEntry* table)
+	{
+		double sum = 0.0;
+		for (UINT i = 0; i < count; i++) sum += (std::max)(weights[i], 0.f);
+
+		std::vector<double> scaled(count);
+		std::vector<UINT> small, large;
+		for (UINT i = 0; i < count; i++)
+		{
+			const double pdf = (sum > 0.0) ? (std::max)(weights[i], 0.f) / sum : 1.0 / count;
+			table[i].pdf = static_cast<float>(pdf);
+			table[i].probability = 1.f;
+			table[i].alias = i;
+
+			scaled[i] = pdf * count;
+			if (scaled[i] < 1.0) small.push_back(i);
+			else large.push_back(i);
+		}
+
+		// Vose's method: each underfull slot is topped up from an overfull index, which then joins the lists again.
+		// Whatever is left over once either list runs dry is full up to rounding.
+		while (!small.empty() && !large.empty())
+		{
+			const UINT less = small.back();
+			const UINT more = large.back();
+			small.pop_back();
+
+			table[less].probability = static_cast<float>(scaled[less]);
+			table[less].alias = more;
+
+			scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+			if (scaled[more] < 1.0)
+			{
+				large.pop_back();
+				small.push_back(more);
+			}
+		}
+	}
+
+	UINT32 EncodeRgb9e5(float r, float g, float b)
+	{
+		r = (r > 0.f) ? (std::min)(r, Rgb9e5Max) : 0.f;
+		g = (g > 0.f) ? (std::min)(g, Rgb9e5Max) : 0.f;
+		b = (b > 0.f) ? (std::min)(b, Rgb9e5Max) : 0.f;
+
+		const float maxChannel = (std::max)((std::max)(r, g), b);
+		UINT32 bits;
+		memcpy(&bits, &maxChannel, sizeof(bits));
+
+		// Shared exponent from floor(log2) of the largest channel, biased by 15, then one up if it rounds to 512
+		int exponent = (std::max)(-16, static_cast<int>(bits >> 23) - 127) + 16;
+		float scale = Exp2(24 - exponent);
+		if (static_cast<int>(maxChannel * scale + 0.5f) == 512)
+		{
+			exponent++;
+			scale *= 0.5f;
+		}
+
+		const UINT32 red = static_cast<UINT32>(r * scale + 0.5f);
+		const UINT32 green = static_cast<UINT32>(g * scale + 0.5f);
+		const UINT32 blue = static_cast<UINT32>(b * scale + 0.5f);
+		return red | (green << 9) | (blue << 18) | (static_cast<UINT32>(exponent) << 27);
+	}
+
+	DirectX::XMFLOAT3 DecodeRgb9e5(UINT32 value)
+	{
+		const float scale = Exp2(static_cast<int>(value >> 27) - 24);
+		return DirectX::XMFLOAT3((value & 0x1FF) * scale, ((value >> 9) & 0x1FF) * scale, ((value >> 18) & 0x1FF) * scale);
+	}
+
+	DirectX::XMFLOAT3 GetDirection(float u, float v)
+	{
+		const float theta = v * Pi;
+		const float phi = u * 2.f * Pi;
+		return DirectX::XMFLOAT3(sinf(theta) * sinf(phi), cosf(theta), -sinf(theta) * cosf(phi));
+	}
+
+	DirectX::XMFLOAT3 Sample(const EnvironmentInfo& environment, float u0, float u1, float& pdf)
+	{
+		const UINT tableWidth = environment.tableWidth;
+		const UINT tableHeight = environment.tableHeight;
+		const AliasEntry* columns = environment.table.data() + tableHeight;
+
+		const UINT row = SampleAlias(environment.table.data(), tableHeight, u0);
+		const UINT column = SampleAlias(columns + static_cast<size_t>(row) * tableWidth, tableWidth, u1);
+		const float cellPdf = environment.table[row].pdf * columns[static_cast<size_t>(row) * tableWidth + column].pdf;
+
+		// The direction is uniform over the texels of the cell, which the table weighted as a whole
+		const UINT width = static_cast<UINT>(environment.texture.width);
+		const UINT height = static_cast<UINT>(environment.texture.height);
+		const UINT x0 = column * environment.block;
+		const UINT y0 = row * environment.block;
+		const UINT cellWidth = (std::min)(x0 + environment.block, width) - x0;
+		const UINT cellHeight = (std::min)(y0 + environment.block, height) - y0;
+
+		const float u = (x0 + u1 * cellWidth) / width;
+		const float v = (y0 + u0 * cellHeight) / height;
+		const float area = static_cast<float>(cellWidth) * cellHeight / (static_cast<float>(width) * height);
+		const float sine = sinf(v * Pi);
+
+		pdf = (sine > 0.f) ? cellPdf / (area * 2.f * Pi * Pi * sine) : 0.f;
+		return GetDirection(u, v);
+	}
+}
\ No newline at end of file
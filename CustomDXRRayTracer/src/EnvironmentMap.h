@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Structures.h"
+
+// Cells of the sampling table per row at most; wider maps are covered by square blocks of texels per cell
+static const UINT EnvironmentTableMaxWidth = 2048;
+// Directions importance-sampled from the environment at every hit
+static const UINT EnvironmentSamples = 4;
+
+// One slot of an alias table. A slot picked uniformly keeps its own index with the given probability and takes its
+// alias otherwise; pdf is the probability of the slot's own index. Mirrored by AliasEntry in Common.hlsl.
+struct AliasEntry
+{
+	float probability = 1.f;
+	UINT alias = 0;
+	float pdf = 0.f;
+};
+
+struct EnvironmentStats
+{
+	float decodeMilliseconds = 0.f;
+	float tableMilliseconds = 0.f;
+	float milliseconds = 0.f;
+};
+
+// A lat-long environment map and the table its directions are importance-sampled from. Rows run from +y down to -y,
+// columns once around y starting at -z.
+struct EnvironmentInfo
+{
+	TextureInfo texture;	// R9G9B9E5 texels, one level
+
+	UINT block = 1;
+	UINT tableWidth = 0;
+	UINT tableHeight = 0;
+
+	// The marginal table over rows, then one conditional table over the columns of each row. A cell covers a block of
+	// texels and is weighted by their luminance times the solid angle of their row.
+	std::vector<AliasEntry> table;
+};
+
+namespace EnvironmentMap
+{
+	// Decodes a Radiance .hdr, or any image stbi_loadf reads, and builds its sampling table
+	bool Load(const std::string& filepath, EnvironmentInfo& environment, EnvironmentStats& stats);
+
+	// Builds the texels and sampling table from RGBA float texels. Table rows are weighted and built in parallel.
+	void Build(const float* texels, UINT width, UINT height, EnvironmentInfo& environment, EnvironmentStats& stats);
+
+	// Builds an alias table over weights that need not be normalized. With no weight at all every index is equally likely.
+	void BuildAliasTable(const float* weights, UINT count, AliasEntry* table);
+
+	UINT32 EncodeRgb9e5(float r, float g, float b);
+
+	DirectX::XMFLOAT3 DecodeRgb9e5(UINT32 value);
+
+	DirectX::XMFLOAT3 GetDirection(float u, float v);
+
+	// Samples a direction from two uniform numbers as the closest hit shader does, returning its solid angle pdf
+	DirectX::XMFLOAT3 Sample(const EnvironmentInfo& environment, float u0, float u1, float& pdf);
+}
\ No newline at end of file
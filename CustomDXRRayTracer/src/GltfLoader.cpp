@@ -0,0 +1,793 @@
+#include "GltfLoader.h"
+#include "MeshSimplifier.h"
+#include "TangentSpace.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdlib>
+
+namespace
+{
+	const UINT32 GlbMagic = 0x46546C67;
+	const UINT32 GlbChunkJson = 0x4E4F534A;
+	const UINT32 GlbChunkBin = 0x004E4942;
+	const int MaxJsonDepth = 64;
+
+	enum ComponentType
+	{
+		ComponentByte = 5120,
+		ComponentUnsignedByte = 5121,
+		ComponentShort = 5122,
+		ComponentUnsignedShort = 5123,
+		ComponentUnsignedInt = 5125,
+		ComponentFloat = 5126
+	};
+
+	struct GlbHeader
+	{
+		UINT32 magic;
+		UINT32 version;
+		UINT32 length;
+	};
+
+	struct GlbChunkHeader
+	{
+		UINT32 length;
+		UINT32 type;
+	};
+
+	struct JsonValue
+	{
+		enum Type { Null, Bool, Number, String, Array, Object };
+
+		Type type = Null;
+		double number = 0.0;
+		std::string string;
+		std::vector<std::string> keys;
+		std::vector<JsonValue> items;
+
+		const JsonValue* Find(const char* key) const
+		{
+			if (type != Object) return nullptr;
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				if (keys[i] == key) return &items[i];
+			}
+			return nullptr;
+		}
+
+		const JsonValue* At(int index) const
+		{
+			if (type != Array || index < 0 || static_cast<size_t>(index) >= items.size()) return nullptr;
+			return &items[index];
+		}
+
+		size_t Size() const
+		{
+			return (type == Array) ? items.size() : 0;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* begin, const char* end) : m_P(begin), m_End(end) {}
+
+		void Parse(JsonValue& value)
+		{
+			ParseValue(value, 0);
+			SkipWhitespace();
+			if (m_P != m_End) Fail();
+		}
+
+	private:
+		void Fail()
+		{
+			throw std::runtime_error("Error: malformed glTF JSON");
+		}
+
+		void SkipWhitespace()
+		{
+			while (m_P < m_End && (*m_P == ' ' || *m_P == '\t' || *m_P == '\n' || *m_P == '\r')) m_P++;
+		}
+
+		bool Consume(const char* literal)
+		{
+			const size_t length = strlen(literal);
+			if (static_cast<size_t>(m_End - m_P) < length || memcmp(m_P, literal, length) != 0) return false;
+			m_P += length;
+			return true;
+		}
+
+		void ParseValue(JsonValue& value, int depth)
+		{
+			if (depth > MaxJsonDepth) Fail();
+
+			SkipWhitespace();
+			if (m_P >= m_End) Fail();
+
+			if (*m_P == '{')
+			{
+				value.type = JsonValue::Object;
+				m_P++;
+				SkipWhitespace();
+				if (m_P < m_End && *m_P == '}')
+				{
+					m_P++;
+					return;
+				}
+
+				for (;;)
+				{
+					SkipWhitespace();
+					value.keys.emplace_back();
+					ParseString(value.keys.back());
+
+					SkipWhitespace();
+					if (m_P >= m_End || *m_P++ != ':') Fail();
+
+					value.items.emplace_back();
+					ParseValue(value.items.back(), depth + 1);
+
+					SkipWhitespace();
+					if (m_P >= m_End) Fail();
+					if (*m_P == ',') { m_P++; continue; }
+					if (*m_P++ == '}') return;
+					Fail();
+				}
+			}
+
+			if (*m_P == '[')
+			{
+				value.type = JsonValue::Array;
+				m_P++;
+				SkipWhitespace();
+				if (m_P < m_End && *m_P == ']')
+				{
+					m_P++;
+					return;
+				}
+
+				for (;;)
+				{
+					value.items.emplace_back();
+					ParseValue(value.items.back(), depth + 1);
+
+					SkipWhitespace();
+					if (m_P >= m_End) Fail();
+					if (*m_P == ',') { m_P++; continue; }
+					if (*m_P++ == ']') return;
+					Fail();
+				}
+			}
+
+			if (*m_P == '"')
+			{
+				value.type = JsonValue::String;
+				ParseString(value.string);
+				return;
+			}
+
+			if (Consume("true")) { value.type = JsonValue::Bool; value.number = 1.0; return; }
+			if (Consume("false")) { value.type = JsonValue::Bool; return; }
+			if (Consume("null")) return;
+
+			// The JSON chunk is copied into a std::string, so strtod always stops at a terminator
+			char* numberEnd = nullptr;
+			value.type = JsonValue::Number;
+			value.number = strtod(m_P, &numberEnd);
+			if (numberEnd == m_P || numberEnd > m_End) Fail();
+			m_P = numberEnd;
+		}
+
+		void ParseString(std::string& out)
+		{
+			if (m_P >= m_End || *m_P++ != '"') Fail();
+
+			while (m_P < m_End && *m_P != '"')
+			{
+				if (*m_P != '\\')
+				{
+					out.push_back(*m_P++);
+					continue;
+				}
+
+				if (++m_P >= m_End) Fail();
+				const char escape = *m_P++;
+				switch (escape)
+				{
+				case '"': out.push_back('"'); break;
+				case '\\': out.push_back('\\'); break;
+				case '/': out.push_back('/'); break;
+				case 'b': out.push_back('\b'); break;
+				case 'f': out.push_back('\f'); break;
+				case 'n': out.push_back('\n'); break;
+				case 'r': out.push_back('\r'); break;
+				case 't': out.push_back('\t'); break;
+				case 'u':
+				{
+					UINT32 code = ParseHex4();
+					if (code >= 0xD800 && code < 0xDC00 && Consume("\\u"))
+					{
+						const UINT32 low = ParseHex4();
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(code, out);
+					break;
+				}
+				default: Fail();
+				}
+			}
+
+			if (m_P >= m_End) Fail();
+			m_P++;
+		}
+
+		UINT32 ParseHex4()
+		{
+			if (m_End - m_P < 4) Fail();
+
+			UINT32 code = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				const char c = *m_P++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= c - '0';
+				else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+				else Fail();
+			}
+			return code;
+		}
+
+		void AppendUtf8(UINT32 code, std::string& out)
+		{
+			if (code < 0x80)
+			{
+				out.push_back(static_cast<char>(code));
+			}
+			else if (code < 0x800)
+			{
+				out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			else if (code < 0x10000)
+			{
+				out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+			else
+			{
+				out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+			}
+		}
+
+		const char* m_P;
+		const char* m_End;
+	};
+
+	int GetInt(const JsonValue* object, const char* key, int fallback)
+	{
+		const JsonValue* value = object ? object->Find(key) : nullptr;
+		return (value && value->type == JsonValue::Number) ? static_cast<int>(value->number) : fallback;
+	}
+
+	UINT64 GetUInt64(const JsonValue* object, const char* key, UINT64 fallback)
+	{
+		const JsonValue* value = object ? object->Find(key) : nullptr;
+		return (value && value->type == JsonValue::Number && value->number >= 0.0) ? static_cast<UINT64>(value->number) : fallback;
+	}
+
+	bool GetFloats(const JsonValue* object, const char* key, float* out, size_t count)
+	{
+		const JsonValue* value = object ? object->Find(key) : nullptr;
+		if (!value || value->Size() != count) return false;
+
+		for (size_t i = 0; i < count; i++) out[i] = static_cast<float>(value->items[i].number);
+		return true;
+	}
+
+	struct GlbFile
+	{
+		std::shared_ptr<Utils::MappedFile> file;
+		JsonValue root;
+		const UINT8* bin = nullptr;
+		UINT64 binSize = 0;
+		std::string directory;
+	};
+
+	struct AccessorView
+	{
+		const UINT8* data = nullptr;
+		size_t stride = 0;
+		size_t count = 0;
+		int componentType = 0;
+		int components = 0;
+		bool normalized = false;
+	};
+
+	size_t GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case ComponentByte:
+		case ComponentUnsignedByte: return 1;
+		case ComponentShort:
+		case ComponentUnsignedShort: return 2;
+		case ComponentUnsignedInt:
+		case ComponentFloat: return 4;
+		default: return 0;
+		}
+	}
+
+	int GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	// Resolves a buffer view to a range of the GLB binary chunk; external buffers are not supported
+	bool GetBufferView(const GlbFile& glb, int index, const UINT8*& data, UINT64& size, size_t& stride)
+	{
+		const JsonValue* views = glb.root.Find("bufferViews");
+		const JsonValue* view = views ? views->At(index) : nullptr;
+		if (!view || GetInt(view, "buffer", 0) != 0 || !glb.bin) return false;
+
+		const UINT64 offset = GetUInt64(view, "byteOffset", 0);
+		size = GetUInt64(view, "byteLength", 0);
+		stride = static_cast<size_t>(GetUInt64(view, "byteStride", 0));
+		if (offset > glb.binSize || size > glb.binSize - offset) return false;
+
+		data = glb.bin + offset;
+		return true;
+	}
+
+	bool GetAccessor(const GlbFile& glb, int index, AccessorView& result)
+	{
+		const JsonValue* accessors = glb.root.Find("accessors");
+		const JsonValue* accessor = accessors ? accessors->At(index) : nullptr;
+		if (!accessor) return false;
+
+		const JsonValue* type = accessor->Find("type");
+		result.componentType = GetInt(accessor, "componentType", 0);
+		result.components = type ? GetComponentCount(type->string) : 0;
+		result.count = static_cast<size_t>(GetUInt64(accessor, "count", 0));
+		const JsonValue* normalized = accessor->Find("normalized");
+		result.normalized = normalized && normalized->number != 0.0;
+
+		const size_t elementSize = GetComponentSize(result.componentType) * result.components;
+		if (elementSize == 0 || result.count == 0) return false;
+
+		const UINT8* viewData = nullptr;
+		UINT64 viewSize = 0;
+		size_t viewStride = 0;
+		if (!GetBufferView(glb, GetInt(accessor, "bufferView", -1), viewData, viewSize, viewStride)) return false;
+
+		const UINT64 offset = GetUInt64(accessor, "byteOffset", 0);
+		result.stride = viewStride ? viewStride : elementSize;
+		if (result.stride < elementSize) return false;
+		if (offset > viewSize || (result.count - 1) * static_cast<UINT64>(result.stride) + elementSize > viewSize - offset) return false;
+
+		result.data = viewData + offset;
+		return true;
+	}
+
+	float ReadComponent(const AccessorView& view, size_t element, int component)
+	{
+		const UINT8* p = view.data + element * view.stride + component * GetComponentSize(view.componentType);
+		switch (view.componentType)
+		{
+		case ComponentFloat: { float v; memcpy(&v, p, 4); return v; }
+		case ComponentUnsignedByte: return view.normalized ? (*p / 255.f) : *p;
+		case ComponentByte: { const INT8 v = static_cast<INT8>(*p); return view.normalized ? (std::max)(v / 127.f, -1.f) : v; }
+		case ComponentUnsignedShort: { UINT16 v; memcpy(&v, p, 2); return view.normalized ? (v / 65535.f) : v; }
+		case ComponentShort: { INT16 v; memcpy(&v, p, 2); return view.normalized ? (std::max)(v / 32767.f, -1.f) : v; }
+		case ComponentUnsignedInt: { UINT32 v; memcpy(&v, p, 4); return static_cast<float>(v); }
+		default: return 0.f;
+		}
+	}
+
+	UINT32 ReadIndex(const AccessorView& view, size_t element)
+	{
+		const UINT8* p = view.data + element * view.stride;
+		switch (view.componentType)
+		{
+		case ComponentUnsignedByte: return *p;
+		case ComponentUnsignedShort: { UINT16 v; memcpy(&v, p, 2); return v; }
+		case ComponentUnsignedInt: { UINT32 v; memcpy(&v, p, 4); return v; }
+		default: return 0;
+		}
+	}
+
+	// Column-major 4x4 matrices, as stored by glTF
+	void Multiply(const float* a, const float* b, float* result)
+	{
+		float m[16];
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				m[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] + a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+			}
+		}
+		memcpy(result, m, sizeof(m));
+	}
+
+	void GetLocalTransform(const JsonValue& node, float* m)
+	{
+		if (GetFloats(&node, "matrix", m, 16)) return;
+
+		float t[3] = { 0.f, 0.f, 0.f };
+		float q[4] = { 0.f, 0.f, 0.f, 1.f };
+		float s[3] = { 1.f, 1.f, 1.f };
+		GetFloats(&node, "translation", t, 3);
+		GetFloats(&node, "rotation", q, 4);
+		GetFloats(&node, "scale", s, 3);
+
+		const float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+		const float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+		const float wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+		m[0] = (1.f - 2.f * (yy + zz)) * s[0];
+		m[1] = 2.f * (xy + wz) * s[0];
+		m[2] = 2.f * (xz - wy) * s[0];
+		m[3] = 0.f;
+		m[4] = 2.f * (xy - wz) * s[1];
+		m[5] = (1.f - 2.f * (xx + zz)) * s[1];
+		m[6] = 2.f * (yz + wx) * s[1];
+		m[7] = 0.f;
+		m[8] = 2.f * (xz + wy) * s[2];
+		m[9] = 2.f * (yz - wx) * s[2];
+		m[10] = (1.f - 2.f * (xx + yy)) * s[2];
+		m[11] = 0.f;
+		m[12] = t[0];
+		m[13] = t[1];
+		m[14] = t[2];
+		m[15] = 1.f;
+	}
+
+	// The OBJ path swaps x and z when it builds vertices. Folding the same swap into the instance transform
+	// keeps both formats in one coordinate frame without touching vertex data that is used in place.
+	DirectX::XMFLOAT3X4 ToInstanceTransform(const float* m)
+	{
+		DirectX::XMFLOAT3X4 result;
+		for (int c = 0; c < 4; c++)
+		{
+			result.m[0][c] = m[c * 4 + 2];
+			result.m[1][c] = m[c * 4 + 1];
+			result.m[2][c] = m[c * 4 + 0];
+		}
+		return result;
+	}
+
+	void CollectInstances(const GlbFile& glb, std::vector<std::vector<DirectX::XMFLOAT3X4>>& meshInstances)
+	{
+		const JsonValue* nodes = glb.root.Find("nodes");
+		if (!nodes) return;
+
+		std::vector<int> roots;
+		const JsonValue* scenes = glb.root.Find("scenes");
+		const JsonValue* scene = scenes ? scenes->At(GetInt(&glb.root, "scene", 0)) : nullptr;
+		const JsonValue* sceneNodes = scene ? scene->Find("nodes") : nullptr;
+		if (sceneNodes)
+		{
+			for (const JsonValue& node : sceneNodes->items) roots.push_back(static_cast<int>(node.number));
+		}
+		else
+		{
+			// Without a scene, every node that is nobody's child is a root
+			std::vector<bool> isChild(nodes->Size(), false);
+			for (const JsonValue& node : nodes->items)
+			{
+				const JsonValue* children = node.Find("children");
+				if (!children) continue;
+				for (const JsonValue& child : children->items)
+				{
+					const int index = static_cast<int>(child.number);
+					if (index >= 0 && static_cast<size_t>(index) < isChild.size()) isChild[index] = true;
+				}
+			}
+			for (size_t i = 0; i < isChild.size(); i++)
+			{
+				if (!isChild[i]) roots.push_back(static_cast<int>(i));
+			}
+		}
+
+		struct PendingNode
+		{
+			int index;
+			float parent[16];
+		};
+
+		std::vector<PendingNode> stack;
+		for (int root : roots)
+		{
+			PendingNode pending = { root, { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f } };
+			stack.push_back(pending);
+		}
+
+		// A valid node graph is a forest; the visit budget stops malformed files with cycles
+		size_t budget = nodes->Size() * 4 + 16;
+		while (!stack.empty() && budget-- > 0)
+		{
+			PendingNode pending = stack.back();
+			stack.pop_back();
+
+			const JsonValue* node = nodes->At(pending.index);
+			if (!node) continue;
+
+			float local[16];
+			float world[16];
+			GetLocalTransform(*node, local);
+			Multiply(pending.parent, local, world);
+
+			const int mesh = GetInt(node, "mesh", -1);
+			if (mesh >= 0 && static_cast<size_t>(mesh) < meshInstances.size())
+			{
+				meshInstances[mesh].push_back(ToInstanceTransform(world));
+			}
+
+			const JsonValue* children = node->Find("children");
+			if (!children) continue;
+			for (const JsonValue& child : children->items)
+			{
+				PendingNode next;
+				next.index = static_cast<int>(child.number);
+				memcpy(next.parent, world, sizeof(world));
+				stack.push_back(next);
+			}
+		}
+	}
+
+	void LoadMaterials(const GlbFile& glb, std::vector<Material>& materials)
+	{
+		const JsonValue* gltfMaterials = glb.root.Find("materials");
+		const JsonValue* textures = glb.root.Find("textures");
+		const JsonValue* images = glb.root.Find("images");
+
+		for (size_t i = 0; gltfMaterials && i < gltfMaterials->Size(); i++)
+		{
+			const JsonValue& gltfMaterial = gltfMaterials->items[i];
+
+			Material material;
+			const JsonValue* name = gltfMaterial.Find("name");
+			material.name = (name && !name->string.empty()) ? name->string : ("material" + std::to_string(i));
+
+			const JsonValue* pbr = gltfMaterial.Find("pbrMetallicRoughness");
+			const JsonValue* baseColor = pbr ? pbr->Find("baseColorTexture") : nullptr;
+			const JsonValue* texture = (baseColor && textures) ? textures->At(GetInt(baseColor, "index", -1)) : nullptr;
+			const JsonValue* image = (texture && images) ? images->At(GetInt(texture, "source", -1)) : nullptr;
+
+			if (image)
+			{
+				const UINT8* data = nullptr;
+				UINT64 size = 0;
+				size_t stride = 0;
+				const JsonValue* uri = image->Find("uri");
+				if (GetBufferView(glb, GetInt(image, "bufferView", -1), data, size, stride))
+				{
+					material.mapping = glb.file;
+					material.embeddedTexture = data;
+					material.embeddedTextureSize = static_cast<size_t>(size);
+				}
+				else if (uri && uri->string.compare(0, 5, "data:") != 0)
+				{
+					material.texturePath = glb.directory + uri->string;
+				}
+			}
+
+			materials.push_back(material);
+		}
+	}
+
+	std::shared_ptr<Model> LoadPrimitive(const GlbFile& glb, const JsonValue& primitive, UINT32 materialIndex, bool& zeroCopy)
+	{
+		const JsonValue* attributes = primitive.Find("attributes");
+
+		AccessorView positions;
+		if (!GetAccessor(glb, GetInt(attributes, "POSITION", -1), positions)) return nullptr;
+		if (positions.components != 3) return nullptr;
+
+		AccessorView texcoords;
+		const bool hasTexcoords = GetAccessor(glb, GetInt(attributes, "TEXCOORD_0", -1), texcoords) && texcoords.components == 2 && texcoords.count == positions.count;
+
+		std::shared_ptr<Model> model = std::make_shared<Model>();
+		model->mapping = glb.file;
+
+		// Interleaved float position + uv with a 20 byte stride is exactly the Vertex layout
+		const bool vertexInPlace = hasTexcoords &&
+			positions.componentType == ComponentFloat && texcoords.componentType == ComponentFloat &&
+			positions.stride == sizeof(Vertex) && texcoords.stride == sizeof(Vertex) &&
+			texcoords.data == positions.data + offsetof(Vertex, uv) &&
+			(reinterpret_cast<uintptr_t>(positions.data) % alignof(Vertex)) == 0;
+
+		if (vertexInPlace)
+		{
+			model->mappedVertices = reinterpret_cast<const Vertex*>(positions.data);
+			model->mappedVertexCount = positions.count;
+		}
+		else
+		{
+			model->vertices.resize(positions.count);
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				Vertex& vertex = model->vertices[i];
+				vertex.position = { ReadComponent(positions, i, 0), ReadComponent(positions, i, 1), ReadComponent(positions, i, 2) };
+				vertex.uv = hasTexcoords ? DirectX::XMFLOAT2(ReadComponent(texcoords, i, 0), ReadComponent(texcoords, i, 1)) : DirectX::XMFLOAT2(0.f, 0.f);
+			}
+		}
+
+		AccessorView indices;
+		const bool hasIndices = GetAccessor(glb, GetInt(&primitive, "indices", -1), indices) && indices.components == 1;
+		const bool indexInPlace = hasIndices &&
+			indices.componentType == ComponentUnsignedInt && indices.stride == sizeof(uint32_t) &&
+			(reinterpret_cast<uintptr_t>(indices.data) % alignof(uint32_t)) == 0;
+
+		if (indexInPlace)
+		{
+			model->mappedIndices = reinterpret_cast<const uint32_t*>(indices.data);
+			model->mappedIndexCount = indices.count - (indices.count % 3);
+		}
+		else
+		{
+			const size_t count = hasIndices ? indices.count : positions.count;
+			model->indices.resize(count - (count % 3));
+			for (size_t i = 0; i < model->indices.size(); i++) model->indices[i] = hasIndices ? ReadIndex(indices, i) : static_cast<uint32_t>(i);
+		}
+
+		const size_t vertexCount = model->VertexCount();
+		const uint32_t* modelIndices = model->IndexData();
+		for (size_t i = 0; i < model->IndexCount(); i++)
+		{
+			if (modelIndices[i] >= vertexCount) throw std::runtime_error("Error: glTF index out of range");
+		}
+
+		// Crease splits copy the vertex data; smooth primitives keep using the mapping in place
+		TangentSpace::Generate(*model);
+
+		Cluster cluster;
+		cluster.submeshCount = 1;
+		cluster.boundsMin = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		cluster.boundsMax = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		const Vertex* vertices = model->VertexData();
+		for (size_t i = 0; i < model->VertexCount(); i++)
+		{
+			const DirectX::XMFLOAT3& p = vertices[i].position;
+			cluster.boundsMin = DirectX::XMFLOAT3((std::min)(cluster.boundsMin.x, p.x), (std::min)(cluster.boundsMin.y, p.y), (std::min)(cluster.boundsMin.z, p.z));
+			cluster.boundsMax = DirectX::XMFLOAT3((std::max)(cluster.boundsMax.x, p.x), (std::max)(cluster.boundsMax.y, p.y), (std::max)(cluster.boundsMax.z, p.z));
+		}
+
+		Submesh submesh;
+		submesh.indexCount = static_cast<uint32_t>(model->IndexCount());
+		submesh.materialIndex = materialIndex;
+		model->submeshes.push_back(submesh);
+		model->clusters.push_back(cluster);
+
+		// Levels are appended to the index data, so a primitive large enough to get them no longer maps its indices
+		MeshSimplifier::BuildLods(*model);
+
+		zeroCopy = model->mappedVertices && model->mappedIndices;
+		return model;
+	}
+}
+
+namespace GltfLoader
+{
+	bool IsGlb(const std::string& filepath)
+	{
+		if (filepath.size() < 4) return false;
+
+		std::string extension = filepath.substr(filepath.size() - 4);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+		return extension == ".glb";
+	}
+
+	void LoadGlb(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials)
+	{
+		Utils::Timer timer;
+
+		GlbFile glb;
+		glb.file = std::make_shared<Utils::MappedFile>();
+		if (!glb.file->Open(filepath))
+		{
+			throw std::runtime_error("Error: failed to open model " + filepath);
+		}
+
+		const size_t separator = filepath.find_last_of("/\\");
+		glb.directory = (separator == std::string::npos) ? "" : filepath.substr(0, separator + 1);
+
+		const UINT8* data = reinterpret_cast<const UINT8*>(glb.file->Data());
+		const UINT64 size = glb.file->Size();
+
+		GlbHeader header;
+		if (size < sizeof(header)) throw std::runtime_error("Error: truncated GLB file");
+		memcpy(&header, data, sizeof(header));
+		if (header.magic != GlbMagic || header.version != 2) throw std::runtime_error("Error: not a glTF 2.0 binary file");
+
+		std::string json;
+		UINT64 offset = sizeof(header);
+		const UINT64 end = (std::min)(size, static_cast<UINT64>(header.length));
+		while (offset + sizeof(GlbChunkHeader) <= end)
+		{
+			GlbChunkHeader chunk;
+			memcpy(&chunk, data + offset, sizeof(chunk));
+			offset += sizeof(chunk);
+			if (chunk.length > end - offset) throw std::runtime_error("Error: truncated GLB chunk");
+
+			if (chunk.type == GlbChunkJson && json.empty())
+			{
+				json.assign(reinterpret_cast<const char*>(data + offset), chunk.length);
+			}
+			else if (chunk.type == GlbChunkBin && !glb.bin)
+			{
+				glb.bin = data + offset;
+				glb.binSize = chunk.length;
+			}
+
+			offset += (chunk.length + 3) & ~3ull;
+		}
+
+		if (json.empty()) throw std::runtime_error("Error: GLB file has no JSON chunk");
+		JsonParser(json.data(), json.data() + json.size()).Parse(glb.root);
+
+		materials.clear();
+		LoadMaterials(glb, materials);
+
+		const JsonValue* meshes = glb.root.Find("meshes");
+		std::vector<std::vector<DirectX::XMFLOAT3X4>> meshInstances(meshes ? meshes->Size() : 0);
+		CollectInstances(glb, meshInstances);
+
+		// Primitives without a material share one default entry at the end of the table
+		UINT32 defaultMaterial = UINT32_MAX;
+
+		size_t primitiveCount = 0;
+		size_t zeroCopyCount = 0;
+		size_t instanceCount = 0;
+		for (size_t m = 0; m < meshInstances.size(); m++)
+		{
+			if (meshInstances[m].empty()) continue;
+
+			const JsonValue* primitives = meshes->items[m].Find("primitives");
+			for (size_t p = 0; primitives && p < primitives->Size(); p++)
+			{
+				const JsonValue& primitive = primitives->items[p];
+				if (GetInt(&primitive, "mode", 4) != 4) continue;
+
+				UINT32 materialIndex = static_cast<UINT32>(GetInt(&primitive, "material", -1));
+				if (materialIndex >= materials.size())
+				{
+					if (defaultMaterial == UINT32_MAX)
+					{
+						defaultMaterial = static_cast<UINT32>(materials.size());
+						materials.push_back(Material());
+					}
+					materialIndex = defaultMaterial;
+				}
+
+				bool zeroCopy = false;
+				std::shared_ptr<Model> model = LoadPrimitive(glb, primitive, materialIndex, zeroCopy);
+				if (!model || model->IndexCount() == 0) continue;
+
+				model->instances = meshInstances[m];
+				models.push_back(model);
+
+				primitiveCount++;
+				instanceCount += meshInstances[m].size();
+				if (zeroCopy) zeroCopyCount++;
+			}
+		}
+
+		if (materials.empty()) materials.push_back(Material());
+
+		printf("Loaded %s in %.2f ms: %zu primitives (%zu used in place), %zu instances, %zu materials\n", filepath.c_str(), timer.ElapsedMillis(), primitiveCount, zeroCopyCount, instanceCount, materials.size());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Structures.h"
+
+namespace GltfLoader
+{
+	bool IsGlb(const std::string& filepath);
+
+	// Loads a binary glTF. Each triangle primitive becomes one model, instanced once per node that references its mesh.
+	// Accessors that already match the Vertex or uint32 index layout are used in place from the mapped file.
+	void LoadGlb(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials);
+}
\ No newline at end of file
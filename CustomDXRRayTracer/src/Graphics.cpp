@@ -2,7 +2,13 @@
 #include <atlcomcli.h>
 
 #include "Graphics.h"
+#include "EnvironmentMap.h"
+#include "MaterialTable.h"
+#include "TextureStream.h"
+#include "UploadManager.h"
 #include "Utils.h"
+#include "VertexCodec.h"
+#include "VirtualTextures.h"
 
 namespace D3DResources
 {
@@ -30,89 +36,288 @@ namespace D3DResources
 		Utils::Validate(hr, L"Error: failed to create buffer resource");
 	}
 
-	void Create_Texture(D3D12Global& d3d, D3D12Resources& resources, Material& material)
+	void Create_Upload_Manager(D3D12Global& d3d, D3D12Resources& resources)
 	{
-		TextureInfo texture = Utils::LoadTexture(material.texturePath);
-		material.textureResolution = texture.width;
+		resources.upload = std::make_shared<UploadManager>();
+		resources.upload->Init(d3d.device, d3d.cmdQueue);
+	}
+
+	void Create_Virtual_Textures(D3D12Global& d3d, D3D12Resources& resources)
+	{
+		// Without tier 2 tiled resources large textures are loaded whole, like the rest
+		D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+		HRESULT hr = d3d.device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+		if (FAILED(hr) || options.TiledResourcesTier < D3D12_TILED_RESOURCES_TIER_2) return;
+
+		resources.virtualTextures = std::make_shared<VirtualTextures>();
+		resources.virtualTextures->Init(d3d.device, d3d.cmdQueue, static_cast<UINT64>(d3d.tileBudget) << 20);
+	}
+
+	void Create_Textures(D3D12Global& d3d, D3D12Resources& resources, std::vector<Material>& materials)
+	{
+		// Materials that sample the same image share one texture, and one descriptor in the bindless range
+		std::vector<UINT> sources;
+		MaterialTable::AssignTextures(materials, resources.materialTextures, sources);
+		resources.textures.resize(sources.size(), nullptr);
+
+		TextureOptions options;
+		options.mipFilter = d3d.mipFilter;
+		options.compression = d3d.textureCompression;
+		options.quality = d3d.compressionQuality;
+
+		// Every slot shows a 1x1 gray placeholder until its texture has been loaded in the background
+		TextureInfo placeholder;
+		TextureLoadStats placeholderStats;
+		placeholder.width = 1;
+		placeholder.height = 1;
+		placeholder.stride = 4;
+		placeholder.pixels = { 0x80, 0x80, 0x80, 0xFF };
+		Utils::BuildTexture(placeholder, TextureOptions(), placeholderStats);
+		Create_Texture(d3d, resources, placeholder, &resources.placeholderTexture);
+
+		// Textures too large to keep whole are turned into tile files and streamed. Their reserved resources must all
+		// exist before the tile heap is created, so they are set up here; with a cached tile file that is only a mapping.
+		std::vector<TextureRequest> requests;
+		std::vector<UINT> tiled;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			const Material& material = materials[sources[i]];
+			int width = 0, height = 0;
+			if (resources.virtualTextures && !material.embeddedTexture && !material.texturePath.empty() && Utils::GetTextureSize(material.texturePath, width, height) &&
+				static_cast<UINT>((std::max)(width, height)) > VirtualTextureMinSize)
+			{
+				tiled.push_back(static_cast<UINT>(i));
+				continue;
+			}
+
+			TextureRequest request;
+			request.index = static_cast<UINT>(i);
+			request.source = material;
+			requests.push_back(request);
+		}
+
+		std::vector<TextureLoadStats> stats(tiled.size());
+		std::vector<std::string> tileFiles(tiled.size());
+		std::vector<std::string> errors(tiled.size());
+		Utils::ParallelFor(static_cast<UINT>(tiled.size()), [&](UINT i)
+		{
+			try
+			{
+				tileFiles[i] = Utils::LoadTileFile(materials[sources[tiled[i]]].texturePath, options, stats[i]);
+			}
+			catch (const std::exception& e)
+			{
+				errors[i] = e.what();
+			}
+		});
+
+		for (const std::string& error : errors)
+		{
+			if (!error.empty()) throw std::runtime_error(error);
+		}
+
+		for (size_t i = 0; i < tiled.size(); i++)
+		{
+			resources.textures[tiled[i]] = resources.virtualTextures->AddTexture(tileFiles[i], tiled[i]);
+			printf("  %-48s %8.2f ms, streamed from %s%s\n", materials[sources[tiled[i]]].texturePath.c_str(), stats[i].milliseconds, tileFiles[i].c_str(), stats[i].cacheHit ? "" : " (built)");
+		}
+
+		resources.upload->Submit();
+
+		if (resources.virtualTextures)
+		{
+			resources.virtualTextures->Create(d3d.cmdList);
+			if (resources.virtualTextures->GetTextureCount() > 0)
+			{
+				printf("Streaming %u textures through %u tiles (%u MB)\n", resources.virtualTextures->GetTextureCount(), resources.virtualTextures->GetSlotCount(), d3d.tileBudget);
+			}
+		}
+
+		if (requests.empty()) return;
+
+		resources.textureStream = std::make_shared<TextureStream>();
+		resources.textureStream->Start(requests, options);
+		printf("Loading %zu textures for %zu materials in the background on %u workers\n", requests.size(), materials.size(), resources.textureStream->GetStats().workerCount);
+	}
 
+	void Create_Texture(D3D12Global& d3d, D3D12Resources& resources, TextureInfo& texture, ID3D12Resource** ppResource)
+	{
 		D3D12_RESOURCE_DESC textureDesc = {};
 		textureDesc.Width = texture.width;
 		textureDesc.Height = texture.height;
-		textureDesc.MipLevels = 1;
+		textureDesc.MipLevels = static_cast<UINT16>(texture.mipLevels);
 		textureDesc.DepthOrArraySize = 1;
 		textureDesc.SampleDesc.Count = 1;
-		textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		textureDesc.Format = texture.format;
 		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		
-		HRESULT hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resources.texture));
+
+		HRESULT hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(ppResource));
 		Utils::Validate(hr, L"Error: failed to create texture");
 
 #if NAME_D3D_RESOURCES
-		resources.texture->SetName(L"Texture");
+		(*ppResource)->SetName(L"Texture");
 #endif
 
-		D3D12_RESOURCE_DESC resourceDesc = {};
-		resourceDesc.Width = texture.width * texture.height * texture.stride;
-		resourceDesc.Height = 1;
-		resourceDesc.DepthOrArraySize = 1;
-		resourceDesc.MipLevels = 1;
-		resourceDesc.SampleDesc.Count = 1;
-		resourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-		resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		resourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		// Large textures go through the upload ring in row bands, so no upload buffer the size of the texture is needed
+		resources.upload->UploadTexture(*ppResource, texture);
+		std::vector<UINT8>().swap(texture.pixels);
+		texture.mapping.reset();
+	}
 
-		hr = d3d.device->CreateCommittedResource(&UploadHeapProperties, D3D12_HEAP_FLAG_NONE, &resourceDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&resources.textureUploadResource));
-		Utils::Validate(hr, L"Error: failed to create texture upload heap");
+	void Create_Texture_Descriptor(D3D12Global& d3d, D3D12Resources& resources, UINT index)
+	{
+		// Slots past the textures, and textures still loading, show the placeholder
+		ID3D12Resource* texture = (index < resources.textures.size() && resources.textures[index]) ? resources.textures[index] : resources.placeholderTexture;
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC textureSRVDesc = {};
+		textureSRVDesc.Format = texture->GetDesc().Format;
+		textureSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		textureSRVDesc.Texture2D.MipLevels = static_cast<UINT>(-1);
+		textureSRVDesc.Texture2D.MostDetailedMip = 0;
+		textureSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = resources.descriptorHeap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += (TextureDescriptorBase + index) * d3d.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		d3d.device->CreateShaderResourceView(texture, &textureSRVDesc, handle);
+	}
+
+	void Create_Environment(D3D12Global& d3d, D3D12Resources& resources, const std::string& filepath)
+	{
+		if (filepath.empty()) return;
+
+		EnvironmentInfo environment;
+		EnvironmentStats stats;
+		if (!EnvironmentMap::Load(filepath, environment, stats))
+		{
+			throw std::runtime_error("Error: failed to load environment map " + filepath);
+		}
+
+		TextureInfo& texture = environment.texture;
+
+		D3D12_RESOURCE_DESC textureDesc = {};
+		textureDesc.Width = texture.width;
+		textureDesc.Height = texture.height;
+		textureDesc.MipLevels = 1;
+		textureDesc.DepthOrArraySize = 1;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Format = texture.format;
+		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+		HRESULT hr = d3d.device->CreateCommittedResource(&DefaultHeapProperties, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resources.environment));
+		Utils::Validate(hr, L"Error: failed to create environment texture");
+
+		const UINT64 tableSize = environment.table.size() * sizeof(AliasEntry);
+		D3D12BufferCreateInfo info(tableSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON);
+		Create_Buffer(d3d, info, &resources.environmentTable);
 
 #if NAME_D3D_RESOURCES
-		resources.texture->SetName(L"Texture Upload Buffer");
+		resources.environment->SetName(L"Environment Map");
+		resources.environmentTable->SetName(L"Environment Table");
 #endif
 
-		Upload_Texture(d3d, resources.texture, resources.textureUploadResource, texture);
+		resources.upload->UploadTexture(resources.environment, texture);
+		resources.upload->UploadBuffer(resources.environmentTable, environment.table.data(), tableSize);
+		resources.upload->Submit();
+
+		resources.viewCBData.environmentSamples = EnvironmentSamples;
+		resources.viewCBData.environmentWidth = static_cast<UINT>(texture.width);
+		resources.viewCBData.environmentHeight = static_cast<UINT>(texture.height);
+		resources.viewCBData.environmentBlock = environment.block;
+
+		printf("Environment %s: %dx%d, %ux%u table cells, decoded in %.2f ms, table built in %.2f ms, %.2f ms total\n", filepath.c_str(), texture.width, texture.height,
+			environment.tableWidth, environment.tableHeight, stats.decodeMilliseconds, stats.tableMilliseconds, stats.milliseconds);
 	}
 
-	void Create_Vertex_Buffer(D3D12Global& d3d, D3D12Resources& resources, Model& model)
+	void Create_Vertex_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry)
 	{
-		D3D12BufferCreateInfo info(((UINT)model.vertices.size() * sizeof(Vertex)), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
-		Create_Buffer(d3d, info, &resources.vertexBuffer);
+		const Model& model = *geometry.model;
+		const UINT stride = d3d.compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+
+		D3D12BufferCreateInfo info(((UINT)model.VertexCount() * stride), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON);
+		Create_Buffer(d3d, info, &geometry.vertexBuffer);
 
 #if NAME_D3D_RESOURCES
-		resources.vertexBuffer->SetName(L"Vertex Buffer");
+		geometry.vertexBuffer->SetName(L"Vertex Buffer");
 #endif
 
-		UINT8* pVertexDataBegin;
-		D3D12_RANGE readRange = {};
-		HRESULT hr = resources.vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin));
-		Utils::Validate(hr, L"Error: failed to map vertex buffer");
+		// Vertices are encoded straight into the upload ring, a chunk at a time
+		if (d3d.compactVertices)
+		{
+			geometry.vertexQuantization = VertexCodec::ComputeQuantization(model.VertexData(), model.VertexCount());
+			resources.upload->UploadBuffer(geometry.vertexBuffer, model.VertexCount(), stride, [&](UINT8* data, size_t first, size_t count)
+			{
+				VertexCodec::Encode(model.VertexData() + first, count, geometry.vertexQuantization, reinterpret_cast<CompactVertex*>(data));
+			});
+		}
+		else
+		{
+			resources.upload->UploadBuffer(geometry.vertexBuffer, model.VertexData(), info.size);
+		}
+
+		geometry.vertexBufferView.BufferLocation = geometry.vertexBuffer->GetGPUVirtualAddress();
+		geometry.vertexBufferView.StrideInBytes = stride;
+		geometry.vertexBufferView.SizeInBytes = static_cast<UINT>(info.size);
 
-		memcpy(pVertexDataBegin, model.vertices.data(), info.size);
-		resources.vertexBuffer->Unmap(0, nullptr);
+		if (!d3d.compactVertices) return;
+
+		// The BLAS reads quantized positions directly and applies this transform to restore object space
+		const VertexQuantization& quantization = geometry.vertexQuantization;
+		const float transform[3][4] =
+		{
+			{ quantization.scale.x, 0.f, 0.f, quantization.bias.x },
+			{ 0.f, quantization.scale.y, 0.f, quantization.bias.y },
+			{ 0.f, 0.f, quantization.scale.z, quantization.bias.z }
+		};
 
-		resources.vertexBufferView.BufferLocation = resources.vertexBuffer->GetGPUVirtualAddress();
-		resources.vertexBufferView.StrideInBytes = sizeof(Vertex);
-		resources.vertexBufferView.SizeInBytes = static_cast<UINT>(info.size);
+		D3D12BufferCreateInfo transformInfo(sizeof(transform), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+		Create_Buffer(d3d, transformInfo, &geometry.vertexTransform);
+
+#if NAME_D3D_RESOURCES
+		geometry.vertexTransform->SetName(L"Vertex Dequantization Transform");
+#endif
+
+		UINT8* pTransformDataBegin;
+		D3D12_RANGE readRange = {};
+		HRESULT hr = geometry.vertexTransform->Map(0, &readRange, reinterpret_cast<void**>(&pTransformDataBegin));
+		Utils::Validate(hr, L"Error: failed to map vertex transform buffer");
+
+		memcpy(pTransformDataBegin, transform, sizeof(transform));
+		geometry.vertexTransform->Unmap(0, nullptr);
 	}
 
-	void Create_Index_Buffer(D3D12Global& d3d, D3D12Resources& resources, Model& model)
+	void Create_Index_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry)
 	{
-		D3D12BufferCreateInfo info(((UINT)model.indices.size() * sizeof(UINT)), D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
-		Create_Buffer(d3d, info, &resources.indexBuffer);
+		const Model& model = *geometry.model;
+		D3D12BufferCreateInfo info(((UINT)model.IndexCount() * sizeof(UINT)), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON);
+		Create_Buffer(d3d, info, &geometry.indexBuffer);
 
 #if NAME_D3D_RESOURCES
-		resources.indexBuffer->SetName(L"Index Buffer");
+		geometry.indexBuffer->SetName(L"Index Buffer");
 #endif
 
-		UINT8* pIndexDataBegin;
-		D3D12_RANGE readRange = {};
-		HRESULT hr = resources.indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin));
-		Utils::Validate(hr, L"Error: failed to map index buffer");
+		resources.upload->UploadBuffer(geometry.indexBuffer, model.IndexData(), info.size);
+
+		geometry.indexBufferView.BufferLocation = geometry.indexBuffer->GetGPUVirtualAddress();
+		geometry.indexBufferView.SizeInBytes = static_cast<UINT>(info.size);
+		geometry.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+	}
+
+	void Create_Frame_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry)
+	{
+		const Model& model = *geometry.model;
+		D3D12BufferCreateInfo info(((UINT)model.VertexCount() * sizeof(VertexFrame)), D3D12_HEAP_TYPE_DEFAULT, D3D12_RESOURCE_STATE_COMMON);
+		Create_Buffer(d3d, info, &geometry.frameBuffer);
 
-		memcpy(pIndexDataBegin, model.indices.data(), info.size);
-		resources.indexBuffer->Unmap(0, nullptr);
+#if NAME_D3D_RESOURCES
+		geometry.frameBuffer->SetName(L"Vertex Frame Buffer");
+#endif
 
-		resources.indexBufferView.BufferLocation = resources.indexBuffer->GetGPUVirtualAddress();
-		resources.indexBufferView.SizeInBytes = static_cast<UINT>(info.size);
-		resources.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+		const bool hasFrames = model.mappedFrames || model.frames.size() == model.VertexCount();
+		resources.upload->UploadBuffer(geometry.frameBuffer, model.VertexCount(), sizeof(VertexFrame), [&](UINT8* data, size_t first, size_t count)
+		{
+			if (hasFrames) memcpy(data, model.FrameData() + first, count * sizeof(VertexFrame));
+			else std::fill_n(reinterpret_cast<VertexFrame*>(data), count, VertexFrame());
+		});
 	}
 
 	void Create_Constant_Buffer(D3D12Global& d3d, ID3D12Resource** buffer, UINT64 size)
@@ -145,7 +350,7 @@ namespace D3DResources
 
 	void Create_View_CB(D3D12Global& d3d, D3D12Resources& resources)
 	{
-		Create_Constant_Buffer(d3d, &resources.viewCB, sizeof(MaterialCB));
+		Create_Constant_Buffer(d3d, &resources.viewCB, sizeof(ViewCB));
 
 #if NAME_D3D_RESOURCES
 		resources.viewCB->SetName(L"View Constant Buffer");
@@ -157,20 +362,22 @@ namespace D3DResources
 		memcpy(resources.viewCBStart, &resources.viewCBData, sizeof(resources.viewCBData));
 	}
 
-	void Create_Material_CB(D3D12Global& d3d, D3D12Resources& resources, const Material& material)
+	void Create_Material_Buffer(D3D12Global& d3d, D3D12Resources& resources)
 	{
-		Create_Constant_Buffer(d3d, &resources.materialCB, sizeof(MaterialCB));
+		Update_Material_Buffer(resources);
+
+		const UINT64 size = resources.materialRecords.size() * sizeof(MaterialRecord);
+		D3D12BufferCreateInfo info(size, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
+		Create_Buffer(d3d, info, &resources.materialBuffer);
 
 #if NAME_D3D_RESOURCES
-		resources.materialCB->SetName(L"Material Constant Buffer");
+		resources.materialBuffer->SetName(L"Material Buffer");
 #endif
 
-		resources.materialCBData.resolution = DirectX::XMFLOAT4((float)material.textureResolution, 0.f, 0.f, 0.f);
-
-		HRESULT hr = resources.materialCB->Map(0, nullptr, reinterpret_cast<void**>(&resources.materialCBStart));
-		Utils::Validate(hr, L"Error: failed to map material constant buffer");
+		HRESULT hr = resources.materialBuffer->Map(0, nullptr, reinterpret_cast<void**>(&resources.materialBufferStart));
+		Utils::Validate(hr, L"Error: failed to map material buffer");
 
-		memcpy(resources.materialCBStart, &resources.materialCBData, sizeof(resources.materialCBData));
+		memcpy(resources.materialBufferStart, resources.materialRecords.data(), size);
 	}
 
 	void Create_Descriptor_Heaps(D3D12Global& d3d, D3D12Resources& resources)
@@ -227,68 +434,133 @@ namespace D3DResources
 		resources.viewCBData.view = DirectX::XMMatrixTranspose(invView);
 		resources.viewCBData.viewOriginAndTanHalfFovY = DirectX::XMFLOAT4(eye.x, eye.y, eye.z, tanf(fov * 0.5f));
 		resources.viewCBData.resolution = DirectX::XMFLOAT2((float)d3d.width, (float)d3d.height);
+		resources.viewCBData.frameNumber++;
 
 		memcpy(resources.viewCBStart, &resources.viewCBData, sizeof(resources.viewCBData));
 	}
 
-	void Upload_Texture(D3D12Global& d3d, ID3D12Resource* destResource, ID3D12Resource* srcResource, const TextureInfo& texture)
+	void Update_Virtual_Textures(D3D12Global& d3d, D3D12Resources& resources)
 	{
-		UINT8* pData;
+		if (resources.virtualTextures) resources.virtualTextures->Update(d3d.cmdList);
+	}
 
-		HRESULT hr = srcResource->Map(0, nullptr, reinterpret_cast<void**>(&pData));
+	void Update_Material_Buffer(D3D12Resources& resources)
+	{
+		// Each texture's size and virtual texture constants, copied into the records of the materials sampling it.
+		// Textures still loading are described by the placeholder their slot shows.
+		std::vector<MaterialRecord> textures(resources.textures.size());
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			const D3D12_RESOURCE_DESC desc = (resources.textures[i] ? resources.textures[i] : resources.placeholderTexture)->GetDesc();
+			textures[i].textureWidth = static_cast<UINT>(desc.Width);
+			textures[i].textureHeight = desc.Height;
+			textures[i].textureLevels = desc.MipLevels;
+		}
 
-		memcpy(pData, texture.pixels.data(), texture.width * texture.height * texture.stride);
+		if (resources.virtualTextures) resources.virtualTextures->SetTextureRecords(textures);
 
-		srcResource->Unmap(0, nullptr);
+		MaterialTable::Pack(resources.materialTextures, textures, resources.materialRecords);
 
-		D3D12_SUBRESOURCE_FOOTPRINT subresource = {};
-		subresource.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		subresource.Width = texture.width;
-		subresource.Height = texture.height;
-		subresource.RowPitch = texture.width * texture.stride;
-		subresource.Depth = 1;
+		if (resources.materialBufferStart)
+		{
+			memcpy(resources.materialBufferStart, resources.materialRecords.data(), resources.materialRecords.size() * sizeof(MaterialRecord));
+		}
+	}
 
-		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
-		footprint.Offset = texture.offset;
-		footprint.Footprint = subresource;
+	void Update_Textures(D3D12Global& d3d, D3D12Resources& resources)
+	{
+		if (!resources.textureStream) return;
 
-		D3D12_TEXTURE_COPY_LOCATION source = {};
-		source.pResource = srcResource;
-		source.PlacedFootprint = footprint;
-		source.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+		// Descriptors and material records are only rewritten once no frame on the GPU reads them. While one still
+		// does, the swap waits for the next frame rather than the frame waiting for the GPU.
+		if (d3d.fence->GetCompletedValue() + 1 < d3d.fenceValues[d3d.frameIndex]) return;
 
-		D3D12_TEXTURE_COPY_LOCATION destination = {};
-		destination.pResource = destResource;
-		destination.SubresourceIndex = 0;
-		destination.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+		std::vector<StreamedTexture> streamed;
+		if (resources.textureStream->Poll(streamed))
+		{
+			for (StreamedTexture& entry : streamed)
+			{
+				TextureInfo& texture = entry.texture;
+				Create_Texture(d3d, resources, texture, &resources.textures[entry.index]);
+				Create_Texture_Descriptor(d3d, resources, entry.index);
 
-		D3D12_RESOURCE_BARRIER barrier = {};
-		barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-		barrier.Transition.pResource = destResource;
-		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
-		barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+				if (entry.stats.cacheHit)
+				{
+					printf("  texture %-4u %5d x %-5d %8.2f ms, %2d mips from texture cache\n", entry.index, texture.width, texture.height, entry.stats.milliseconds, texture.mipLevels);
+				}
+				else if (entry.stats.compression.blockCount > 0)
+				{
+					printf("  texture %-4u %5d x %-5d %8.2f ms, %2u mips in %8.2f ms, %zu blocks in %8.2f ms (%zu -> %zu bytes)\n", entry.index, texture.width, texture.height, entry.stats.decodeMilliseconds,
+						entry.stats.mips.levelCount, entry.stats.mips.milliseconds, entry.stats.compression.blockCount, entry.stats.compression.milliseconds, entry.stats.compression.inputBytes, entry.stats.compression.outputBytes);
+				}
+				else
+				{
+					printf("  texture %-4u %5d x %-5d %8.2f ms, %2u mips in %8.2f ms\n", entry.index, texture.width, texture.height, entry.stats.decodeMilliseconds, entry.stats.mips.levelCount, entry.stats.mips.milliseconds);
+				}
+			}
+
+			// The copies go ahead of this frame's command list on the same queue, so the frame samples finished textures
+			resources.upload->Submit();
+			Update_Material_Buffer(resources);
+		}
+
+		if (resources.textureStream->IsFinished())
+		{
+			const TextureStreamStats stats = resources.textureStream->GetStats();
+			printf("Loaded %u textures (%.2f MB) on %u workers, %u from texture cache, first after %.2f ms, last after %.2f ms\n", stats.textureCount, stats.bytes / (1024.0 * 1024.0), stats.workerCount,
+				stats.cacheHits, stats.firstMilliseconds, stats.milliseconds);
+			resources.textureStream.reset();
+		}
+	}
+
+	void Release_Uploads(D3D12Resources& resources)
+	{
+		// Textures still loading in the background keep the ring
+		if (!resources.upload || resources.textureStream) return;
+
+		resources.upload->Release();
 
-		d3d.cmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
-		d3d.cmdList->ResourceBarrier(1, &barrier);
+		const UploadStats& stats = resources.upload->GetStats();
+		if (stats.chunkCount == 0) return;
+
+		printf("Uploaded %.2f MB in %u chunks and %u submissions through a %llu MB ring, %u stalls waiting %.2f ms\n", stats.bytes / (1024.0 * 1024.0), stats.chunkCount, stats.submitCount,
+			static_cast<unsigned long long>(UploadRingBytes >> 20), stats.stallCount, stats.milliseconds);
+		resources.upload->ResetStats();
 	}
 
 	void Destroy(D3D12Resources& resources)
 	{
 		if (resources.viewCB) resources.viewCB->Unmap(0, nullptr);
 		if (resources.viewCBStart) resources.viewCBStart = nullptr;
-		if (resources.materialCB) resources.materialCB->Unmap(0, nullptr);
-		if (resources.materialCBStart) resources.materialCBStart = nullptr;
+		if (resources.materialBuffer) resources.materialBuffer->Unmap(0, nullptr);
+		if (resources.materialBufferStart) resources.materialBufferStart = nullptr;
+
+		if (resources.virtualTextures && resources.virtualTextures->GetTextureCount() > 0)
+		{
+			const VirtualTextureStats& stats = resources.virtualTextures->GetStats();
+			printf("Streamed %llu tiles over %u frames, %llu evicted, %llu deferred, peak %u of %u resident, %.2f ms\n", static_cast<unsigned long long>(stats.tilesLoaded), stats.frameCount,
+				static_cast<unsigned long long>(stats.tilesEvicted), static_cast<unsigned long long>(stats.tilesDeferred), stats.peakResident, resources.virtualTextures->GetSlotCount(), stats.milliseconds);
+		}
+		resources.virtualTextures.reset();
+		resources.textureStream.reset();
 
 		SAFE_RELEASE(resources.DXROutput);
-		SAFE_RELEASE(resources.vertexBuffer);
-		SAFE_RELEASE(resources.indexBuffer);
+		for (GeometryBuffers& geometry : resources.geometry)
+		{
+			SAFE_RELEASE(geometry.vertexBuffer);
+			SAFE_RELEASE(geometry.vertexTransform);
+			SAFE_RELEASE(geometry.indexBuffer);
+			SAFE_RELEASE(geometry.frameBuffer);
+		}
 		SAFE_RELEASE(resources.viewCB);
-		SAFE_RELEASE(resources.materialCB);
+		SAFE_RELEASE(resources.materialBuffer);
 		SAFE_RELEASE(resources.rtvHeap);
 		SAFE_RELEASE(resources.descriptorHeap);
-		SAFE_RELEASE(resources.texture);
-		SAFE_RELEASE(resources.textureUploadResource);
+		for (auto& texture : resources.textures) SAFE_RELEASE(texture);
+		SAFE_RELEASE(resources.placeholderTexture);
+		SAFE_RELEASE(resources.environment);
+		SAFE_RELEASE(resources.environmentTable);
+		resources.upload.reset();
 	}
 }
 
@@ -600,77 +872,198 @@ namespace D3D12
 
 namespace DXR
 {
-	void Create_Bottom_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, Model& model)
+	void Create_Bottom_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, GeometryBuffers& geometry)
 	{
-		D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc;
-		geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-		geometryDesc.Triangles.VertexBuffer.StartAddress = resources.vertexBuffer->GetGPUVirtualAddress();
-		geometryDesc.Triangles.VertexBuffer.StrideInBytes = resources.vertexBufferView.StrideInBytes;
-		geometryDesc.Triangles.VertexCount = static_cast<UINT>(model.vertices.size());
-		geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-		geometryDesc.Triangles.IndexBuffer = resources.indexBuffer->GetGPUVirtualAddress();
-		geometryDesc.Triangles.IndexFormat = resources.indexBufferView.Format;
-		geometryDesc.Triangles.IndexCount = static_cast<UINT>(model.indices.size());
-		geometryDesc.Triangles.Transform3x4 = 0;
-		geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+		const Model& model = *geometry.model;
 
-		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+		// One geometry per submesh so each can select its own hit group record
+		std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs(model.submeshes.size());
+		for (size_t i = 0; i < model.submeshes.size(); i++)
+		{
+			D3D12_RAYTRACING_GEOMETRY_DESC& geometryDesc = geometryDescs[i];
+			geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
+			geometryDesc.Triangles.VertexBuffer.StartAddress = geometry.vertexBuffer->GetGPUVirtualAddress();
+			geometryDesc.Triangles.VertexBuffer.StrideInBytes = geometry.vertexBufferView.StrideInBytes;
+			geometryDesc.Triangles.VertexCount = static_cast<UINT>(model.VertexCount());
+			geometryDesc.Triangles.VertexFormat = d3d.compactVertices ? DXGI_FORMAT_R16G16B16A16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+			geometryDesc.Triangles.IndexBuffer = geometry.indexBuffer->GetGPUVirtualAddress() + model.submeshes[i].indexOffset * sizeof(uint32_t);
+			geometryDesc.Triangles.IndexFormat = geometry.indexBufferView.Format;
+			geometryDesc.Triangles.IndexCount = model.submeshes[i].indexCount;
+			geometryDesc.Triangles.Transform3x4 = geometry.vertexTransform ? geometry.vertexTransform->GetGPUVirtualAddress() : 0;
+			geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
+		}
 
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS ASInputs = {};
-		ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
-		ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-		ASInputs.pGeometryDescs = &geometryDesc;
-		ASInputs.NumDescs = 1;
-		ASInputs.Flags = buildFlags;
+		// Each cluster and each of its coarser levels gets its own BLAS over its slice of the geometry descriptors.
+		// The full-resolution clusters come first, followed by the levels in the order of Model::lods.
+		const size_t clusterCount = model.clusters.size() + model.lods.size();
+		std::vector<D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS> clusterInputs(clusterCount);
+		std::vector<UINT64> scratchSizes(clusterCount);
 
-		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASPreBuildInfo = {};
-		d3d.device->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASPreBuildInfo);
+		geometry.firstBLAS = static_cast<UINT>(dxr.BLAS.size());
+		dxr.BLAS.resize(dxr.BLAS.size() + clusterCount);
 
-		ASPreBuildInfo.ScratchDataSizeInBytes = ALIGN(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, ASPreBuildInfo.ScratchDataSizeInBytes);
-		ASPreBuildInfo.ResultDataMaxSizeInBytes = ALIGN(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, ASPreBuildInfo.ResultDataMaxSizeInBytes);
+		for (size_t i = 0; i < clusterCount; i++)
+		{
+			AccelerationStructureBuffer& blas = dxr.BLAS[geometry.firstBLAS + i];
+			const bool isLod = (i >= model.clusters.size());
 
-		D3D12BufferCreateInfo bufferInfo(ASPreBuildInfo.ScratchDataSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		bufferInfo.alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-		D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.BLAS.pScratch);
+			D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS& ASInputs = clusterInputs[i];
+			ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+			ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+			ASInputs.pGeometryDescs = geometryDescs.data() + (isLod ? model.lods[i - model.clusters.size()].submeshOffset : model.clusters[i].submeshOffset);
+			ASInputs.NumDescs = isLod ? model.lods[i - model.clusters.size()].submeshCount : model.clusters[i].submeshCount;
+			ASInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
 
-#if NAME_D3D_RESOURCES
-		dxr.BLAS.pScratch->SetName(L"DXR BLAS Scratch");
-#endif
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASPreBuildInfo = {};
+			d3d.device->GetRaytracingAccelerationStructurePrebuildInfo(&ASInputs, &ASPreBuildInfo);
 
-		bufferInfo.size = ASPreBuildInfo.ResultDataMaxSizeInBytes;
-		bufferInfo.state = D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE;
-		D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.BLAS.pResult);
+			scratchSizes[i] = ALIGN(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, ASPreBuildInfo.ScratchDataSizeInBytes);
+			ASPreBuildInfo.ResultDataMaxSizeInBytes = ALIGN(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, ASPreBuildInfo.ResultDataMaxSizeInBytes);
+
+			D3D12BufferCreateInfo bufferInfo(ASPreBuildInfo.ResultDataMaxSizeInBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE);
+			bufferInfo.alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+			D3DResources::Create_Buffer(d3d, bufferInfo, &blas.pResult);
 
 #if NAME_D3D_RESOURCES
-		dxr.BLAS.pResult->SetName(L"DXR BLAS");
+			blas.pResult->SetName(L"DXR BLAS");
 #endif
+		}
 
-		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
-		buildDesc.Inputs = ASInputs;
-		buildDesc.ScratchAccelerationStructureData = dxr.BLAS.pScratch->GetGPUVirtualAddress();
-		buildDesc.DestAccelerationStructureData = dxr.BLAS.pResult->GetGPUVirtualAddress();
+		// Batch consecutive builds into one shared scratch buffer, never exceeding the budget unless a single build needs more
+		std::vector<size_t> batchStarts;
+		UINT64 scratchSize = 0;
+		UINT64 batchSize = 0;
+		for (size_t i = 0; i < clusterCount; i++)
+		{
+			if (i == 0 || batchSize + scratchSizes[i] > BLASScratchBudget)
+			{
+				batchStarts.push_back(i);
+				batchSize = 0;
+			}
+			batchSize += scratchSizes[i];
+			scratchSize = (std::max)(scratchSize, batchSize);
+		}
+		batchStarts.push_back(clusterCount);
 
-		d3d.cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+		// Scratch only grows; a smaller buffer may still be referenced by builds recorded this frame
+		if (!dxr.blasScratch || dxr.blasScratch->GetDesc().Width < scratchSize)
+		{
+			if (dxr.blasScratch) dxr.retiredResources.push_back(dxr.blasScratch);
+
+			D3D12BufferCreateInfo bufferInfo(scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			bufferInfo.alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+			D3DResources::Create_Buffer(d3d, bufferInfo, &dxr.blasScratch);
+
+#if NAME_D3D_RESOURCES
+			dxr.blasScratch->SetName(L"DXR BLAS Scratch");
+#endif
+		}
 
 		D3D12_RESOURCE_BARRIER uavBarrier;
 		uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-		uavBarrier.UAV.pResource = dxr.BLAS.pResult;
+		uavBarrier.UAV.pResource = nullptr;
 		uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-		d3d.cmdList->ResourceBarrier(1, &uavBarrier);
+
+		for (size_t batch = 0; batch + 1 < batchStarts.size(); batch++)
+		{
+			D3D12_GPU_VIRTUAL_ADDRESS scratch = dxr.blasScratch->GetGPUVirtualAddress();
+			for (size_t i = batchStarts[batch]; i < batchStarts[batch + 1]; i++)
+			{
+				D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
+				buildDesc.Inputs = clusterInputs[i];
+				buildDesc.ScratchAccelerationStructureData = scratch;
+				buildDesc.DestAccelerationStructureData = dxr.BLAS[geometry.firstBLAS + i].pResult->GetGPUVirtualAddress();
+
+				d3d.cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+				scratch += scratchSizes[i];
+			}
+
+			// The next batch reuses the scratch memory, and the TLAS build reads the results
+			d3d.cmdList->ResourceBarrier(1, &uavBarrier);
+		}
+	}
+
+	void Append_Geometry(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, const std::shared_ptr<Model>& model)
+	{
+		if (model->IndexCount() == 0) return;
+
+		GeometryBuffers geometry;
+		geometry.model = model;
+		if (!resources.geometry.empty())
+		{
+			const GeometryBuffers& previous = resources.geometry.back();
+			geometry.firstHitGroup = previous.firstHitGroup + static_cast<UINT>(previous.model->submeshes.size());
+		}
+
+		D3DResources::Create_Vertex_Buffer(d3d, resources, geometry);
+		D3DResources::Create_Index_Buffer(d3d, resources, geometry);
+		D3DResources::Create_Frame_Buffer(d3d, resources, geometry);
+
+		// The copies reach the queue ahead of the command list that builds the BLAS from them
+		resources.upload->Submit();
+		Create_Bottom_Level_AS(d3d, dxr, geometry);
+
+		resources.geometry.push_back(geometry);
 	}
 
 	void Create_Top_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources)
 	{
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
-		instanceDesc.InstanceID = 0;
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 0xFF;
-		instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1;
-		instanceDesc.AccelerationStructure = dxr.BLAS.pResult->GetGPUVirtualAddress();
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+		// The TLAS is rebuilt whenever geometry is appended; the old buffers are released once the GPU is idle
+		if (dxr.TLAS.pScratch) dxr.retiredResources.push_back(dxr.TLAS.pScratch);
+		if (dxr.TLAS.pResult) dxr.retiredResources.push_back(dxr.TLAS.pResult);
+		if (dxr.TLAS.pInstanceDesc) dxr.retiredResources.push_back(dxr.TLAS.pInstanceDesc);
+		dxr.TLAS = AccelerationStructureBuffer();
+
+		// One instance per cluster and placement; its hit group records start at the first submesh of the level
+		// selected for it. Placements of the same model share its BLAS and hit group records.
+		size_t instanceCount = 0;
+		for (const GeometryBuffers& geometry : resources.geometry)
+		{
+			instanceCount += (std::max)(geometry.model->instances.size(), static_cast<size_t>(1)) * geometry.model->clusters.size();
+		}
+
+		if (instanceCount > D3D12_RAYTRACING_MAX_INSTANCES_PER_TOP_LEVEL_ACCELERATION_STRUCTURE)
+		{
+			Utils::Validate(E_FAIL, L"Error: scene has more TLAS instances than D3D12 allows");
+		}
+
+		std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+		instanceDescs.reserve(instanceCount);
+		for (const GeometryBuffers& geometry : resources.geometry)
+		{
+			const std::vector<Cluster>& clusters = geometry.model->clusters;
+			const std::vector<DirectX::XMFLOAT3X4>& placements = geometry.model->instances;
+			const size_t placementCount = (std::max)(placements.size(), static_cast<size_t>(1));
+			for (size_t p = 0; p < placementCount; p++)
+			{
+				for (size_t i = 0; i < clusters.size(); i++)
+				{
+					const size_t selection = p * clusters.size() + i;
+					const UINT level = (selection < geometry.lodSelection.size()) ? geometry.lodSelection[selection] : 0;
+					const UINT blas = (level == 0) ? static_cast<UINT>(i) : static_cast<UINT>(clusters.size()) + clusters[i].lodOffset + level - 1;
+					const UINT submeshOffset = (level == 0) ? clusters[i].submeshOffset : geometry.model->lods[clusters[i].lodOffset + level - 1].submeshOffset;
+
+					D3D12_RAYTRACING_INSTANCE_DESC instanceDesc = {};
+					instanceDesc.InstanceID = static_cast<UINT>(instanceDescs.size());
+					instanceDesc.InstanceContributionToHitGroupIndex = geometry.firstHitGroup + submeshOffset;
+					instanceDesc.InstanceMask = 0xFF;
+					if (placements.empty())
+					{
+						instanceDesc.Transform[0][0] = instanceDesc.Transform[1][1] = instanceDesc.Transform[2][2] = 1;
+					}
+					else
+					{
+						memcpy(instanceDesc.Transform, &placements[p], sizeof(instanceDesc.Transform));
+					}
+					instanceDesc.AccelerationStructure = dxr.BLAS[geometry.firstBLAS + blas].pResult->GetGPUVirtualAddress();
+					instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE;
+					instanceDescs.push_back(instanceDesc);
+				}
+			}
+		}
 
 		D3D12BufferCreateInfo instanceBufferInfo;
-		instanceBufferInfo.size = sizeof(instanceDesc);
+		instanceBufferInfo.size = (std::max)(instanceDescs.size(), static_cast<size_t>(1)) * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
 		instanceBufferInfo.heapType = D3D12_HEAP_TYPE_UPLOAD;
 		instanceBufferInfo.flags = D3D12_RESOURCE_FLAG_NONE;
 		instanceBufferInfo.state = D3D12_RESOURCE_STATE_GENERIC_READ;
@@ -682,7 +1075,7 @@ namespace DXR
 
 		UINT8* pData;
 		dxr.TLAS.pInstanceDesc->Map(0, nullptr, (void**)&pData);
-		memcpy(pData, &instanceDesc, sizeof(instanceDesc));
+		memcpy(pData, instanceDescs.data(), instanceDescs.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC));
 		dxr.TLAS.pInstanceDesc->Unmap(0, nullptr);
 
 		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS buildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
@@ -691,7 +1084,7 @@ namespace DXR
 		ASInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 		ASInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 		ASInputs.InstanceDescs = dxr.TLAS.pInstanceDesc->GetGPUVirtualAddress();
-		ASInputs.NumDescs = 1;
+		ASInputs.NumDescs = static_cast<UINT>(instanceDescs.size());
 		ASInputs.Flags = buildFlags;
 
 		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO ASPreBuildInfo = {};
@@ -730,6 +1123,83 @@ namespace DXR
 		uavBarrier.UAV.pResource = dxr.TLAS.pResult;
 		uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 		d3d.cmdList->ResourceBarrier(1, &uavBarrier);
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.RaytracingAccelerationStructure.Location = dxr.TLAS.pResult->GetGPUVirtualAddress();
+
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = resources.descriptorHeap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += TLASDescriptor * d3d.device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		d3d.device->CreateShaderResourceView(nullptr, &srvDesc, handle);
+	}
+
+	bool Select_Lods(D3D12Global& d3d, D3D12Resources& resources)
+	{
+		const DirectX::XMFLOAT4& view = resources.viewCBData.viewOriginAndTanHalfFovY;
+		const float pixelAngle = 2.f * view.w / static_cast<float>(d3d.height);
+		if (pixelAngle <= 0.f) return false;
+
+		bool changed = false;
+		for (GeometryBuffers& geometry : resources.geometry)
+		{
+			const Model& model = *geometry.model;
+			if (model.lods.empty()) continue;
+
+			const std::vector<DirectX::XMFLOAT3X4>& placements = model.instances;
+			const size_t placementCount = (std::max)(placements.size(), static_cast<size_t>(1));
+			geometry.lodSelection.resize(placementCount * model.clusters.size(), 0);
+
+			for (size_t p = 0; p < placementCount; p++)
+			{
+				DirectX::XMFLOAT3X4 transform(1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f);
+				if (!placements.empty()) transform = placements[p];
+
+				float scale = 0.f;
+				for (int column = 0; column < 3; column++)
+				{
+					const float length = sqrtf(transform.m[0][column] * transform.m[0][column] + transform.m[1][column] * transform.m[1][column] + transform.m[2][column] * transform.m[2][column]);
+					scale = (std::max)(scale, length);
+				}
+
+				for (size_t i = 0; i < model.clusters.size(); i++)
+				{
+					const Cluster& cluster = model.clusters[i];
+					const DirectX::XMFLOAT3 center((cluster.boundsMin.x + cluster.boundsMax.x) * 0.5f, (cluster.boundsMin.y + cluster.boundsMax.y) * 0.5f, (cluster.boundsMin.z + cluster.boundsMax.z) * 0.5f);
+					const DirectX::XMFLOAT3 extent(cluster.boundsMax.x - center.x, cluster.boundsMax.y - center.y, cluster.boundsMax.z - center.z);
+
+					float offset[3];
+					for (int row = 0; row < 3; row++)
+					{
+						const float world = transform.m[row][0] * center.x + transform.m[row][1] * center.y + transform.m[row][2] * center.z + transform.m[row][3];
+						offset[row] = world - ((row == 0) ? view.x : ((row == 1) ? view.y : view.z));
+					}
+
+					const float radius = scale * sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+					const float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]) - radius;
+
+					// Coarsest level whose error stays below LodPixelError on screen. Coarser levels than the current
+					// one must be clearly below it, so a cluster near the threshold does not switch every frame.
+					UINT8& selected = geometry.lodSelection[p * model.clusters.size() + i];
+					UINT level = 0;
+					for (UINT l = 1; l <= cluster.lodCount && distance > 0.f; l++)
+					{
+						const float pixels = model.lods[cluster.lodOffset + l - 1].error * scale / (distance * pixelAngle);
+						if (pixels > ((l > selected) ? LodPixelError * LodHysteresis : LodPixelError)) break;
+						level = l;
+					}
+
+					if (level != selected)
+					{
+						selected = static_cast<UINT8>(level);
+						changed = true;
+					}
+				}
+			}
+		}
+
+		return changed;
 	}
 
 	void Create_RayGen_Program(D3D12Global& d3d, DXRGlobal& dxr, D3D12ShaderCompilerInfo& shaderCompiler)
@@ -737,33 +1207,60 @@ namespace DXR
 		dxr.rgs = RtProgram(D3D12ShaderInfo(L"shaders\\RayGen.hlsl", L"", L"lib_6_3"));
 		D3DShaders::Compile_Shader(shaderCompiler, dxr.rgs);
 
-		D3D12_DESCRIPTOR_RANGE ranges[3];
+		D3D12_DESCRIPTOR_RANGE ranges[4];
 
 		ranges[0].BaseShaderRegister = 0;
-		ranges[0].NumDescriptors = 2;
+		ranges[0].NumDescriptors = 1;
 		ranges[0].RegisterSpace = 0;
 		ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
 		ranges[0].OffsetInDescriptorsFromTableStart = 0;
 
 		ranges[1].BaseShaderRegister = 0;
-		ranges[1].NumDescriptors = 1;
+		ranges[1].NumDescriptors = 2;
 		ranges[1].RegisterSpace = 0;
 		ranges[1].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-		ranges[1].OffsetInDescriptorsFromTableStart = 2;
+		ranges[1].OffsetInDescriptorsFromTableStart = 1;
 
 		ranges[2].BaseShaderRegister = 0;
-		ranges[2].NumDescriptors = 4;
+		ranges[2].NumDescriptors = 5;
 		ranges[2].RegisterSpace = 0;
 		ranges[2].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 		ranges[2].OffsetInDescriptorsFromTableStart = 3;
 
+		// Every texture, indexed by the material records; the range runs to the end of the heap
+		ranges[3].BaseShaderRegister = 0;
+		ranges[3].NumDescriptors = UINT_MAX;
+		ranges[3].RegisterSpace = 3;
+		ranges[3].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+		ranges[3].OffsetInDescriptorsFromTableStart = TextureDescriptorBase;
+
 		D3D12_ROOT_PARAMETER param0 = {};
 		param0.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
 		param0.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 		param0.DescriptorTable.NumDescriptorRanges = _countof(ranges);
 		param0.DescriptorTable.pDescriptorRanges = ranges;
 
-		D3D12_ROOT_PARAMETER rootParams[1] = { param0 };
+		D3D12_ROOT_PARAMETER param1 = {};
+		param1.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+		param1.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		param1.Constants.ShaderRegister = 2;
+		param1.Constants.RegisterSpace = 0;
+		param1.Constants.Num32BitValues = sizeof(GeometryCB) / sizeof(UINT);
+
+		// Each hit record points at its batch's index, vertex and frame buffers directly
+		D3D12_ROOT_PARAMETER param2 = {};
+		param2.ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+		param2.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		param2.Descriptor.ShaderRegister = 0;
+		param2.Descriptor.RegisterSpace = 1;
+
+		D3D12_ROOT_PARAMETER param3 = param2;
+		param3.Descriptor.ShaderRegister = 1;
+
+		D3D12_ROOT_PARAMETER param4 = param2;
+		param4.Descriptor.ShaderRegister = 2;
+
+		D3D12_ROOT_PARAMETER rootParams[5] = { param0, param1, param2, param3, param4 };
 
 		D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
 		rootDesc.NumParameters = _countof(rootParams);
@@ -787,6 +1284,14 @@ namespace DXR
 	{
 		dxr.hit = HitProgram(L"Hit");
 		dxr.hit.chs = RtProgram(D3D12ShaderInfo(L"shaders\\ClosestHit.hlsl", L"", L"lib_6_3"));
+
+		DxcDefine compactVertices = { L"COMPACT_VERTICES", L"1" };
+		if (d3d.compactVertices)
+		{
+			dxr.hit.chs.info.defines = &compactVertices;
+			dxr.hit.chs.info.defineCount = 1;
+		}
+
 		D3DShaders::Compile_Shader(shaderCompiler, dxr.hit.chs);
 	}
 
@@ -906,7 +1411,7 @@ namespace DXR
 		subObjects[index++] = globalRootSig;
 
 		D3D12_RAYTRACING_PIPELINE_CONFIG pipelineConfig = {};
-		pipelineConfig.MaxTraceRecursionDepth = 1;
+		pipelineConfig.MaxTraceRecursionDepth = 2;
 
 		D3D12_STATE_SUBOBJECT pipelineConfigObject = {};
 		pipelineConfigObject.Type = D3D12_STATE_SUBOBJECT_TYPE_RAYTRACING_PIPELINE_CONFIG;
@@ -935,11 +1440,19 @@ namespace DXR
 		uint32_t shaderIdSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
 		uint32_t shaderTableSize = 0;
 
+		if (dxr.shaderTable) dxr.retiredResources.push_back(dxr.shaderTable);
+		dxr.shaderTable = nullptr;
+
 		dxr.shaderTableRecordSize = shaderIdSize;
 		dxr.shaderTableRecordSize += 8;
+		dxr.shaderTableRecordSize += sizeof(GeometryCB);
+		dxr.shaderTableRecordSize += 8 * 3;
 		dxr.shaderTableRecordSize = ALIGN(D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT, dxr.shaderTableRecordSize);
 
-		shaderTableSize = dxr.shaderTableRecordSize * 3;
+		dxr.hitGroupRecordCount = 0;
+		for (const GeometryBuffers& geometry : resources.geometry) dxr.hitGroupRecordCount += static_cast<uint32_t>(geometry.model->submeshes.size());
+
+		shaderTableSize = dxr.shaderTableRecordSize * (2 + dxr.hitGroupRecordCount);
 		shaderTableSize = ALIGN(D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT, shaderTableSize);
 
 		D3D12BufferCreateInfo bufferInfo(shaderTableSize, D3D12_HEAP_TYPE_UPLOAD, D3D12_RESOURCE_STATE_GENERIC_READ);
@@ -953,6 +1466,7 @@ namespace DXR
 		HRESULT hr = dxr.shaderTable->Map(0, nullptr, (void**)&pData);
 		Utils::Validate(hr, L"Error: failed to map shader table");
 
+		memset(pData, 0, shaderTableSize);
 		memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"RayGen_12"), shaderIdSize);
 
 		*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pData + shaderIdSize) = resources.descriptorHeap->GetGPUDescriptorHandleForHeapStart();
@@ -960,18 +1474,46 @@ namespace DXR
 		pData += dxr.shaderTableRecordSize;
 		memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"Miss_5"), shaderIdSize);
 
-		pData += dxr.shaderTableRecordSize;
-		memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"HitGroup"), shaderIdSize);
-
+		// The miss shader samples the environment map through the same descriptor table as the ray generation shader
 		*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pData + shaderIdSize) = resources.descriptorHeap->GetGPUDescriptorHandleForHeapStart();
 
+		// One hit group record per BLAS geometry, carrying the submesh's triangle offset, material and buffers
+		for (const GeometryBuffers& geometry : resources.geometry)
+		{
+			for (const Submesh& submesh : geometry.model->submeshes)
+			{
+				pData += dxr.shaderTableRecordSize;
+				memcpy(pData, dxr.rtpsoInfo->GetShaderIdentifier(L"HitGroup"), shaderIdSize);
+
+				uint8_t* pArguments = pData + shaderIdSize;
+				*reinterpret_cast<D3D12_GPU_DESCRIPTOR_HANDLE*>(pArguments) = resources.descriptorHeap->GetGPUDescriptorHandleForHeapStart();
+				pArguments += 8;
+
+				GeometryCB geometryCB;
+				geometryCB.positionScale = geometry.vertexQuantization.scale;
+				geometryCB.positionBias = geometry.vertexQuantization.bias;
+				geometryCB.uvScale = geometry.vertexQuantization.uvScale;
+				geometryCB.uvBias = geometry.vertexQuantization.uvBias;
+				geometryCB.triangleOffset = submesh.indexOffset / 3;
+				geometryCB.materialIndex = submesh.materialIndex;
+				memcpy(pArguments, &geometryCB, sizeof(geometryCB));
+				pArguments += sizeof(geometryCB);
+
+				*reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS*>(pArguments) = geometry.indexBuffer->GetGPUVirtualAddress();
+				pArguments += 8;
+				*reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS*>(pArguments) = geometry.vertexBuffer->GetGPUVirtualAddress();
+				pArguments += 8;
+				*reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS*>(pArguments) = geometry.frameBuffer->GetGPUVirtualAddress();
+			}
+		}
+
 		dxr.shaderTable->Unmap(0, nullptr);
 	}
 
-	void Create_Descriptor_Heaps(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, const Model& model)
+	void Create_Descriptor_Heaps(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources)
 	{
 		D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-		desc.NumDescriptors = 7;
+		desc.NumDescriptors = TextureDescriptorBase + (std::max)(static_cast<UINT>(resources.textures.size()), 1u);
 		desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 		desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
@@ -991,60 +1533,72 @@ namespace DXR
 
 		d3d.device->CreateConstantBufferView(&cbvDesc, handle);
 
-		cbvDesc.SizeInBytes = ALIGN(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, sizeof(resources.materialCBData));
-		cbvDesc.BufferLocation = resources.materialCB->GetGPUVirtualAddress();
-
-		handle.ptr += handleIncrement;
-		d3d.device->CreateConstantBufferView(&cbvDesc, handle);
-
 		D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 		uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
 
 		handle.ptr += handleIncrement;
 		d3d.device->CreateUnorderedAccessView(resources.DXROutput, nullptr, &uavDesc, handle);
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.RaytracingAccelerationStructure.Location = dxr.TLAS.pResult->GetGPUVirtualAddress();
+		// Raw views of the tile feedback and residency buffers, null when nothing is streamed
+		const std::shared_ptr<VirtualTextures>& virtualTextures = resources.virtualTextures;
+
+		D3D12_UNORDERED_ACCESS_VIEW_DESC feedbackDesc = {};
+		feedbackDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		feedbackDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+		feedbackDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+		feedbackDesc.Buffer.NumElements = virtualTextures ? virtualTextures->GetFeedbackCount() : 1;
 
 		handle.ptr += handleIncrement;
-		d3d.device->CreateShaderResourceView(nullptr, &srvDesc, handle);
+		d3d.device->CreateUnorderedAccessView(virtualTextures ? virtualTextures->GetFeedbackBuffer() : nullptr, nullptr, &feedbackDesc, handle);
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC indexSRVDesc = {};
-		indexSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-		indexSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		indexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-		indexSRVDesc.Buffer.StructureByteStride = 0;
-		indexSRVDesc.Buffer.FirstElement = 0;
-		indexSRVDesc.Buffer.NumElements = (static_cast<UINT>(model.indices.size()) * sizeof(UINT)) / sizeof(float);
-		indexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		// The TLAS slot is written by Create_Top_Level_AS each time it is rebuilt
+		handle.ptr += handleIncrement;
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC materialDesc = {};
+		materialDesc.Format = DXGI_FORMAT_UNKNOWN;
+		materialDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		materialDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		materialDesc.Buffer.NumElements = static_cast<UINT>(resources.materialRecords.size());
+		materialDesc.Buffer.StructureByteStride = sizeof(MaterialRecord);
 
 		handle.ptr += handleIncrement;
-		d3d.device->CreateShaderResourceView(resources.indexBuffer, &indexSRVDesc, handle);
+		d3d.device->CreateShaderResourceView(resources.materialBuffer, &materialDesc, handle);
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC vertexSRVDesc = {};
-		vertexSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-		vertexSRVDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-		vertexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-		vertexSRVDesc.Buffer.StructureByteStride = 0;
-		vertexSRVDesc.Buffer.FirstElement = 0;
-		vertexSRVDesc.Buffer.NumElements = (static_cast<UINT>(model.vertices.size()) * sizeof(Vertex)) / sizeof(float);
-		vertexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		D3D12_SHADER_RESOURCE_VIEW_DESC residencyDesc = {};
+		residencyDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		residencyDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		residencyDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		residencyDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+		residencyDesc.Buffer.NumElements = virtualTextures ? virtualTextures->GetResidencyCount() : 1;
 
 		handle.ptr += handleIncrement;
-		d3d.device->CreateShaderResourceView(resources.vertexBuffer, &vertexSRVDesc, handle);
+		d3d.device->CreateShaderResourceView(virtualTextures ? virtualTextures->GetResidencyBuffer() : nullptr, &residencyDesc, handle);
 
-		D3D12_SHADER_RESOURCE_VIEW_DESC textureSRVDesc = {};
-		textureSRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		textureSRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-		textureSRVDesc.Texture2D.MipLevels = 1;
-		textureSRVDesc.Texture2D.MostDetailedMip = 0;
-		textureSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		// The environment map and its sampling table, null without one
+		D3D12_SHADER_RESOURCE_VIEW_DESC environmentDesc = {};
+		environmentDesc.Format = DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+		environmentDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		environmentDesc.Texture2D.MipLevels = 1;
+		environmentDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+		handle.ptr += handleIncrement;
+		d3d.device->CreateShaderResourceView(resources.environment, &environmentDesc, handle);
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC tableDesc = {};
+		tableDesc.Format = DXGI_FORMAT_UNKNOWN;
+		tableDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		tableDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		tableDesc.Buffer.NumElements = resources.environmentTable ? static_cast<UINT>(resources.environmentTable->GetDesc().Width / sizeof(AliasEntry)) : 1;
+		tableDesc.Buffer.StructureByteStride = sizeof(AliasEntry);
 
 		handle.ptr += handleIncrement;
-		d3d.device->CreateShaderResourceView(resources.texture, &textureSRVDesc, handle);
+		d3d.device->CreateShaderResourceView(resources.environmentTable, &tableDesc, handle);
+
+		// A model without materials still gets one texture descriptor, so the range is never empty
+		for (UINT i = 0; i < desc.NumDescriptors - TextureDescriptorBase; i++)
+		{
+			D3DResources::Create_Texture_Descriptor(d3d, resources, i);
+		}
 	}
 
 	void Create_DXR_Output(D3D12Global& d3d, D3D12Resources& resources)
@@ -1099,7 +1653,7 @@ namespace DXR
 		desc.MissShaderTable.StrideInBytes = dxr.shaderTableRecordSize;
 
 		desc.HitGroupTable.StartAddress = dxr.shaderTable->GetGPUVirtualAddress() + dxr.shaderTableRecordSize * 2;
-		desc.HitGroupTable.SizeInBytes = dxr.shaderTableRecordSize;
+		desc.HitGroupTable.SizeInBytes = dxr.shaderTableRecordSize * dxr.hitGroupRecordCount;
 		desc.HitGroupTable.StrideInBytes = dxr.shaderTableRecordSize;
 
 		desc.Width = d3d.width;
@@ -1109,6 +1663,8 @@ namespace DXR
 		d3d.cmdList->SetPipelineState1(dxr.rtpso);
 		d3d.cmdList->DispatchRays(&desc);
 
+		if (resources.virtualTextures) resources.virtualTextures->CopyFeedback(d3d.cmdList, resources.viewCBData.frameNumber);
+
 		outputBarriers[1].Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
 		outputBarriers[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
 
@@ -1125,14 +1681,21 @@ namespace DXR
 		D3D12::WaitForGPU(d3d);
 	}
 
+	void Release_Retired_Resources(DXRGlobal& dxr)
+	{
+		for (auto& resource : dxr.retiredResources) SAFE_RELEASE(resource);
+		dxr.retiredResources.clear();
+	}
+
 	void Destroy(DXRGlobal& dxr)
 	{
 		SAFE_RELEASE(dxr.TLAS.pScratch);
 		SAFE_RELEASE(dxr.TLAS.pResult);
 		SAFE_RELEASE(dxr.TLAS.pInstanceDesc);
-		SAFE_RELEASE(dxr.BLAS.pScratch);
-		SAFE_RELEASE(dxr.BLAS.pResult);
-		SAFE_RELEASE(dxr.BLAS.pInstanceDesc);
+		SAFE_RELEASE(dxr.blasScratch);
+		for (auto& blas : dxr.BLAS) SAFE_RELEASE(blas.pResult);
+		SAFE_RELEASE(dxr.shaderTable);
+		Release_Retired_Resources(dxr);
 		SAFE_RELEASE(dxr.rgs.blob);
 		SAFE_RELEASE(dxr.rgs.pRootSignature);
 		SAFE_RELEASE(dxr.miss.blob);
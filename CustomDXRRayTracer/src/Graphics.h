@@ -1,6 +1,6 @@
 #pragma once
 
-#include "structures.h"
+#include "Structures.h"
 
 static const D3D12_HEAP_PROPERTIES UploadHeapProperties =
 {
@@ -20,21 +20,52 @@ static const D3D12_HEAP_PROPERTIES DefaultHeapProperties =
 	0
 };
 
+static const D3D12_HEAP_PROPERTIES ReadbackHeapProperties =
+{
+	D3D12_HEAP_TYPE_READBACK,
+	D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+	D3D12_MEMORY_POOL_UNKNOWN,
+	0,
+	0
+};
+
+static const UINT64 BLASScratchBudget = (256ull << 20);
+
+// Slots of the DXR descriptor heap: the view constants, output and tile feedback UAVs, then the TLAS, material buffer,
+// tile residency, environment map and environment table SRVs, and from TextureDescriptorBase on the unbounded range
+// of textures
+static const UINT TLASDescriptor = 3;
+static const UINT TextureDescriptorBase = 8;
+
+// Largest on-screen error, in pixels, of the level picked for a cluster
+static const float LodPixelError = 1.f;
+// Fraction of that error a coarser level must stay under before it replaces a finer one
+static const float LodHysteresis = 0.75f;
+
 namespace D3DResources
 {
 	void Create_Buffer(D3D12Global& d3d, D3D12BufferCreateInfo& info, ID3D12Resource** ppResource);
-	void Create_Texture(D3D12Global& d3d, D3D12Resources& resources, Material& material);
-	void Create_Vertex_Buffer(D3D12Global& d3d, D3D12Resources& resources, Model& model);
-	void Create_Index_Buffer(D3D12Global& d3d, D3D12Resources& resources, Model& model);
+	void Create_Upload_Manager(D3D12Global& d3d, D3D12Resources& resources);
+	void Create_Virtual_Textures(D3D12Global& d3d, D3D12Resources& resources);
+	void Create_Textures(D3D12Global& d3d, D3D12Resources& resources, std::vector<Material>& materials);
+	void Create_Texture(D3D12Global& d3d, D3D12Resources& resources, TextureInfo& texture, ID3D12Resource** ppResource);
+	void Create_Texture_Descriptor(D3D12Global& d3d, D3D12Resources& resources, UINT index);
+	void Create_Environment(D3D12Global& d3d, D3D12Resources& resources, const std::string& filepath);
+	void Create_Vertex_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry);
+	void Create_Index_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry);
+	void Create_Frame_Buffer(D3D12Global& d3d, D3D12Resources& resources, GeometryBuffers& geometry);
 	void Create_Constant_Buffer(D3D12Global& d3d, ID3D12Resource** buffer, UINT64 size);
 	void Create_BackBuffer_RTV(D3D12Global& d3d, D3D12Resources& resources);
 	void Create_View_CB(D3D12Global& d3d, D3D12Resources& resources);
-	void Create_Material_CB(D3D12Global& d3d, D3D12Resources& resources, const Material& material);
+	void Create_Material_Buffer(D3D12Global& d3d, D3D12Resources& resources);
 	void Create_Descriptor_Heaps(D3D12Global& d3d, D3D12Resources& resources);
 
 	void Update_View_CB(D3D12Global& d3d, D3D12Resources& resources);
+	void Update_Virtual_Textures(D3D12Global& d3d, D3D12Resources& resources);
+	void Update_Material_Buffer(D3D12Resources& resources);
+	void Update_Textures(D3D12Global& d3d, D3D12Resources& resources);
 
-	void Upload_Texture(D3D12Global& d3d, ID3D12Resource* destResource, ID3D12Resource* srcResource, const TextureInfo& texture);
+	void Release_Uploads(D3D12Resources& resources);
 
 	void Destroy(D3D12Resources& resources);
 }
@@ -69,17 +100,21 @@ namespace D3D12
 
 namespace DXR
 {
-	void Create_Bottom_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, Model& model);
+	void Create_Bottom_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, GeometryBuffers& geometry);
+	void Append_Geometry(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, const std::shared_ptr<Model>& model);
 	void Create_Top_Level_AS(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources);
+	bool Select_Lods(D3D12Global& d3d, D3D12Resources& resources);
 	void Create_RayGen_Program(D3D12Global& d3d, DXRGlobal& dxr, D3D12ShaderCompilerInfo& shaderCompiler);
 	void Create_Miss_Program(D3D12Global& d3d, DXRGlobal& dxr, D3D12ShaderCompilerInfo& shaderCompiler);
 	void Create_Closest_Hit_Program(D3D12Global& d3d, DXRGlobal& dxr, D3D12ShaderCompilerInfo& shaderCompiler);
 	void Create_Pipeline_State_Object(D3D12Global& d3d, DXRGlobal& dxr);
 	void Create_Shader_Table(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources);
-	void Create_Descriptor_Heaps(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources, const Model& model);
+	void Create_Descriptor_Heaps(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources);
 	void Create_DXR_Output(D3D12Global& d3d, D3D12Resources& resources);
 
 	void Build_Command_List(D3D12Global& d3d, DXRGlobal& dxr, D3D12Resources& resources);
 
+	void Release_Retired_Resources(DXRGlobal& dxr);
+
 	void Destroy(DXRGlobal& dxr);
 }
\ No newline at end of file
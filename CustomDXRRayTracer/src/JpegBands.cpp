@@ -0,0 +1,205 @@
+#include "JpegBands.h"
+#include "TexelConvert.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <stb_image.h>
+
+namespace
+{
+	const UINT8 MarkerSoi = 0xD8;
+	const UINT8 MarkerEoi = 0xD9;
+	const UINT8 MarkerSos = 0xDA;
+	const UINT8 MarkerDri = 0xDD;
+	const UINT8 MarkerSof0 = 0xC0;
+	const UINT8 MarkerSof1 = 0xC1;
+	const UINT8 MarkerDht = 0xC4;
+	const UINT8 MarkerRst0 = 0xD0;
+
+	struct JpegLayout
+	{
+		UINT width = 0;
+		UINT height = 0;
+		UINT mcuWidth = 0;
+		UINT mcuHeight = 0;
+		UINT restartInterval = 0;
+		size_t heightOffset = 0;
+		size_t headerSize = 0;
+		std::vector<size_t> segmentBegins;
+		std::vector<size_t> segmentEnds;
+	};
+
+	inline UINT ReadBigEndian16(const UINT8* p)
+	{
+		return (static_cast<UINT>(p[0]) << 8) | p[1];
+	}
+
+	inline bool IsRestart(UINT8 marker)
+	{
+		return marker >= MarkerRst0 && marker < MarkerRst0 + 8;
+	}
+
+	// Walks the markers up to the scan, accepting only baseline or extended Huffman frames with a single interleaved scan
+	bool ParseHeaders(const UINT8* data, size_t size, JpegLayout& layout)
+	{
+		if (size < 4 || data[0] != 0xFF || data[1] != MarkerSoi) return false;
+
+		UINT componentCount = 0;
+		size_t p = 2;
+		while (true)
+		{
+			while (p < size && data[p] == 0xFF && p + 1 < size && data[p + 1] == 0xFF) p++;
+			if (p + 4 > size || data[p] != 0xFF) return false;
+
+			const UINT8 marker = data[p + 1];
+			const size_t length = ReadBigEndian16(data + p + 2);
+			if (length < 2 || p + 2 + length > size) return false;
+
+			const UINT8* segment = data + p + 4;
+			if (marker == MarkerSof0 || marker == MarkerSof1)
+			{
+				if (length < 8) return false;
+
+				layout.heightOffset = p + 5;
+				layout.height = ReadBigEndian16(segment + 1);
+				layout.width = ReadBigEndian16(segment + 3);
+				componentCount = segment[5];
+				if (length < 8 + componentCount * 3 || layout.width == 0 || layout.height == 0) return false;
+
+				UINT maxH = 1;
+				UINT maxV = 1;
+				for (UINT c = 0; c < componentCount; c++)
+				{
+					maxH = (std::max)(maxH, static_cast<UINT>(segment[7 + c * 3] >> 4));
+					maxV = (std::max)(maxV, static_cast<UINT>(segment[7 + c * 3] & 0xF));
+				}
+
+				// A single-component scan is never interleaved, so its MCU is one block whatever the sampling factors say
+				layout.mcuWidth = (componentCount == 1) ? 8 : 8 * maxH;
+				layout.mcuHeight = (componentCount == 1) ? 8 : 8 * maxV;
+			}
+			else if ((marker >= 0xC2 && marker <= 0xCF && marker != MarkerDht && marker != 0xC8 && marker != 0xCC))
+			{
+				return false;
+			}
+			else if (marker == MarkerDri)
+			{
+				if (length < 4) return false;
+				layout.restartInterval = ReadBigEndian16(segment);
+			}
+			else if (marker == MarkerSos)
+			{
+				if (componentCount == 0 || segment[0] != componentCount) return false;
+
+				layout.headerSize = p + 2 + length;
+				return true;
+			}
+
+			p += 2 + length;
+		}
+	}
+
+	// Splits the entropy-coded data at its restart markers; stuffed 0xFF00 bytes and fill bytes are not markers
+	bool FindSegments(const UINT8* data, size_t size, JpegLayout& layout)
+	{
+		size_t begin = layout.headerSize;
+		size_t p = begin;
+		while (true)
+		{
+			const void* found = memchr(data + p, 0xFF, size - p);
+			if (!found) return false;
+
+			p = static_cast<const UINT8*>(found) - data;
+			if (p + 1 >= size) return false;
+
+			const UINT8 next = data[p + 1];
+			if (next == 0x00 || next == 0xFF)
+			{
+				p += 1 + (next == 0x00);
+				continue;
+			}
+
+			layout.segmentBegins.push_back(begin);
+			layout.segmentEnds.push_back(p);
+			if (!IsRestart(next)) return next == MarkerEoi;
+
+			begin = p + 2;
+			p = begin;
+		}
+	}
+}
+
+namespace JpegBands
+{
+	bool Decode(const UINT8* data, size_t size, TextureInfo& result)
+	{
+		JpegLayout layout;
+		if (!ParseHeaders(data, size, layout) || layout.restartInterval == 0) return false;
+
+		// Any MCU row boundary must also be a restart boundary for a band to start there
+		const UINT mcusPerRow = (layout.width + layout.mcuWidth - 1) / layout.mcuWidth;
+		const UINT mcuRows = (layout.height + layout.mcuHeight - 1) / layout.mcuHeight;
+		if (mcusPerRow % layout.restartInterval != 0) return false;
+
+		const UINT bandCount = (std::min)(Utils::GetWorkerCount(), mcuRows / MinBandMcuRows);
+		if (bandCount <= 1) return false;
+
+		if (!FindSegments(data, size, layout)) return false;
+
+		const size_t segmentsPerRow = mcusPerRow / layout.restartInterval;
+		if (layout.segmentBegins.size() != static_cast<size_t>(mcuRows) * segmentsPerRow) return false;
+
+		result.width = static_cast<int>(layout.width);
+		result.height = static_cast<int>(layout.height);
+		result.stride = 4;
+		result.pixels.resize(static_cast<size_t>(layout.width) * layout.height * 4);
+
+		std::vector<UINT8> succeeded(bandCount, 0);
+		Utils::ParallelFor(bandCount, [&](UINT band)
+		{
+			const UINT firstRow = (mcuRows * band) / bandCount;
+			const UINT lastRow = (mcuRows * (band + 1)) / bandCount;
+			const UINT decodeFirst = (firstRow > 0) ? firstRow - 1 : 0;
+			const UINT decodeLast = (std::min)(lastRow + 1, mcuRows);
+			const UINT decodeHeight = (std::min)(layout.height, decodeLast * layout.mcuHeight) - decodeFirst * layout.mcuHeight;
+
+			std::vector<UINT8> jpeg(data, data + layout.headerSize);
+			jpeg[layout.heightOffset] = static_cast<UINT8>(decodeHeight >> 8);
+			jpeg[layout.heightOffset + 1] = static_cast<UINT8>(decodeHeight & 0xFF);
+
+			const size_t firstSegment = decodeFirst * segmentsPerRow;
+			const size_t lastSegment = decodeLast * segmentsPerRow;
+			for (size_t s = firstSegment; s < lastSegment; s++)
+			{
+				jpeg.insert(jpeg.end(), data + layout.segmentBegins[s], data + layout.segmentEnds[s]);
+				if (s + 1 < lastSegment)
+				{
+					jpeg.push_back(0xFF);
+					jpeg.push_back(static_cast<UINT8>(MarkerRst0 + (s - firstSegment) % 8));
+				}
+			}
+			jpeg.push_back(0xFF);
+			jpeg.push_back(MarkerEoi);
+
+			int width = 0;
+			int height = 0;
+			int channels = 0;
+			UINT8* pixels = stbi_load_from_memory(jpeg.data(), static_cast<int>(jpeg.size()), &width, &height, &channels, STBI_default);
+			if (!pixels) return;
+
+			if (width == static_cast<int>(layout.width) && height == static_cast<int>(decodeHeight))
+			{
+				const size_t skipRows = static_cast<size_t>(firstRow - decodeFirst) * layout.mcuHeight;
+				const size_t rowBegin = static_cast<size_t>(firstRow) * layout.mcuHeight;
+				const size_t rowEnd = (std::min)(static_cast<size_t>(layout.height), static_cast<size_t>(lastRow) * layout.mcuHeight);
+
+				TexelConvert::ToRgba8(pixels + skipRows * width * channels, channels, result.pixels.data() + rowBegin * width * 4, width, static_cast<UINT>(rowEnd - rowBegin));
+				succeeded[band] = 1;
+			}
+
+			stbi_image_free(pixels);
+		});
+
+		return std::find(succeeded.begin(), succeeded.end(), 0) == succeeded.end();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Structures.h"
+
+namespace JpegBands
+{
+	static const UINT MinBandMcuRows = 16;
+
+	// Decodes a large baseline JPEG whose restart intervals line up with MCU rows as horizontal bands in parallel.
+	// Each band is rebuilt as a standalone JPEG from the shared headers and its restart segments, plus one MCU row
+	// on either side so chroma upsampling at the seams matches a whole-image decode. The result is RGBA8.
+	// Returns false when the file cannot be split, leaving the caller to decode it whole.
+	bool Decode(const UINT8* data, size_t size, TextureInfo& result);
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "LoadQueue.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void LoadQueue::Start(uint32_t itemCount, uint32_t workerCount, const std::function<uint64_t(uint32_t)>& load)
+{
+	Stop();
+
+	m_Load = load;
+	m_ItemCount = itemCount;
+	m_Next = 0;
+	m_Stop = false;
+	m_Finished.clear();
+	m_Remaining = itemCount;
+	m_Error.clear();
+	m_Stats = LoadQueueStats();
+	m_Start = std::chrono::steady_clock::now();
+
+	workerCount = (std::min)((std::max)(workerCount, 1u), itemCount);
+	m_Stats.workerCount = workerCount;
+
+	for (uint32_t i = 0; i < workerCount; i++) m_Threads.emplace_back(&LoadQueue::Work, this);
+}
+
+void LoadQueue::Work()
+{
+	for (uint32_t i = m_Next++; i < m_ItemCount && !m_Stop; i = m_Next++)
+	{
+		uint64_t bytes = 0;
+		try
+		{
+			bytes = m_Load(i);
+		}
+		catch (const std::exception& e)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Error.empty()) m_Error = e.what();
+			m_Remaining--;
+			m_Ready.notify_all();
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Stats.itemCount == 0) m_Stats.firstMilliseconds = GetElapsedMillis();
+		m_Stats.itemCount++;
+		m_Stats.bytes += bytes;
+		m_Stats.milliseconds = GetElapsedMillis();
+
+		FinishedItem finished;
+		finished.item = i;
+		finished.bytes = bytes;
+		m_Finished.push_back(finished);
+		m_Remaining--;
+		m_Ready.notify_all();
+	}
+}
+
+void LoadQueue::RethrowError()
+{
+	if (m_Error.empty()) return;
+
+	const std::string error = m_Error;
+	m_Error.clear();
+	throw std::runtime_error(error);
+}
+
+float LoadQueue::GetElapsedMillis() const
+{
+	return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+}
+
+bool LoadQueue::Poll(std::vector<uint32_t>& items, uint64_t maxBytes)
+{
+	items.clear();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	RethrowError();
+
+	uint64_t bytes = 0;
+	while (!m_Finished.empty() && (items.empty() || bytes + m_Finished.front().bytes <= maxBytes))
+	{
+		bytes += m_Finished.front().bytes;
+		items.push_back(m_Finished.front().item);
+		m_Finished.pop_front();
+	}
+
+	return !items.empty();
+}
+
+bool LoadQueue::Wait(uint32_t& item)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Ready.wait(lock, [this]() { return !m_Finished.empty() || m_Remaining == 0 || !m_Error.empty(); });
+
+	RethrowError();
+	if (m_Finished.empty()) return false;
+
+	item = m_Finished.front().item;
+	m_Finished.pop_front();
+	return true;
+}
+
+void LoadQueue::Stop()
+{
+	m_Stop = true;
+	for (std::thread& thread : m_Threads) thread.join();
+	m_Threads.clear();
+}
+
+bool LoadQueue::IsFinished()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Remaining == 0 && m_Finished.empty() && m_Error.empty();
+}
+
+LoadQueueStats LoadQueue::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
\ No newline at end of file
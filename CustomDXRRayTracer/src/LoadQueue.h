@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LoadQueueStats
+{
+	uint32_t itemCount = 0;
+	uint32_t workerCount = 0;
+	uint64_t bytes = 0;
+	float firstMilliseconds = 0.f;	// Until the first item was ready
+	float milliseconds = 0.f;		// Until the last one was
+};
+
+// Runs a load for each of a fixed number of items on background threads and hands the finished ones, by index, to the
+// thread that polls for them, in the order they finished. The queue holds no results itself: the caller keeps one slot
+// per item, which only the load of that item writes before handing it over.
+class LoadQueue
+{
+public:
+	LoadQueue() {}
+
+	~LoadQueue()
+	{
+		Stop();
+	}
+
+	LoadQueue(const LoadQueue&) = delete;
+	LoadQueue& operator=(const LoadQueue&) = delete;
+
+	// Starts workerCount threads, at most one per item, that call load for every item and take the bytes it returns
+	// as the item's size. A load that throws hands nothing over; its error is rethrown by the next Poll or Wait.
+	void Start(uint32_t itemCount, uint32_t workerCount, const std::function<uint64_t(uint32_t)>& load);
+
+	// Takes finished items, up to maxBytes of them but at least one
+	bool Poll(std::vector<uint32_t>& items, uint64_t maxBytes);
+
+	// Blocks until an item is finished, or returns false once none is left to come
+	bool Wait(uint32_t& item);
+
+	// Returns once the loads in progress are done; items not yet started are dropped
+	void Stop();
+
+	// Every item has been loaded and taken
+	bool IsFinished();
+
+	LoadQueueStats GetStats();
+
+private:
+	struct FinishedItem
+	{
+		uint32_t item;
+		uint64_t bytes;
+	};
+
+	void Work();
+	void RethrowError();
+	float GetElapsedMillis() const;
+
+	std::function<uint64_t(uint32_t)> m_Load;
+	uint32_t m_ItemCount = 0;
+	std::chrono::steady_clock::time_point m_Start;
+
+	std::vector<std::thread> m_Threads;
+	std::atomic<uint32_t> m_Next{ 0 };
+	std::atomic<bool> m_Stop{ false };
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Ready;
+	std::deque<FinishedItem> m_Finished;
+	uint32_t m_Remaining = 0;
+	std::string m_Error;
+	LoadQueueStats m_Stats;
+};
\ No newline at end of file
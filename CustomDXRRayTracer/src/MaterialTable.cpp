@@ -0,0 +1,41 @@
+#include "MaterialTable.h"
+#include "Utils.h"
+
+#include <map>
+
+namespace MaterialTable
+{
+	void AssignTextures(const std::vector<Material>& materials, std::vector<UINT>& textureIndices, std::vector<UINT>& sources)
+	{
+		textureIndices.resize(materials.size());
+		sources.clear();
+
+		// Embedded images are told apart by their bytes in the mapped file, the rest by path; the empty key is the white texture
+		std::map<std::pair<const UINT8*, std::string>, UINT> textures;
+		for (size_t i = 0; i < materials.size(); i++)
+		{
+			const Material& material = materials[i];
+			const std::pair<const UINT8*, std::string> key = material.embeddedTexture ? std::make_pair(material.embeddedTexture, std::string()) : std::make_pair(static_cast<const UINT8*>(nullptr), material.texturePath);
+
+			auto it = textures.find(key);
+			if (it == textures.end())
+			{
+				it = textures.emplace(key, static_cast<UINT>(sources.size())).first;
+				sources.push_back(static_cast<UINT>(i));
+			}
+
+			textureIndices[i] = it->second;
+		}
+	}
+
+	void Pack(const std::vector<UINT>& textureIndices, const std::vector<MaterialRecord>& textures, std::vector<MaterialRecord>& records)
+	{
+		// The buffer always holds a record, so its view is never empty
+		records.assign((std::max)(textureIndices.size(), static_cast<size_t>(1)), MaterialRecord());
+		for (size_t i = 0; i < textureIndices.size(); i++)
+		{
+			records[i] = textures[textureIndices[i]];
+			records[i].textureIndex = textureIndices[i];
+		}
+	}
+}
\ No newline at end of file
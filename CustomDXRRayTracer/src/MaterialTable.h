@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Structures.h"
+
+// Materials are read by the closest hit shader from a structured buffer indexed by the geometry's material index, and
+// their textures from an unbounded descriptor range indexed by the record's texture index
+namespace MaterialTable
+{
+	// Gives every material the index of the texture it samples. Materials naming the same image share a texture, as do
+	// all materials without one. sources receives, for each texture, the first material using it, which it is loaded from.
+	void AssignTextures(const std::vector<Material>& materials, std::vector<UINT>& textureIndices, std::vector<UINT>& sources);
+
+	// Packs one record per material from the record of the texture it samples, which holds the texture's size and
+	// virtual texture constants
+	void Pack(const std::vector<UINT>& textureIndices, const std::vector<MaterialRecord>& textures, std::vector<MaterialRecord>& records);
+}
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "MeshCache.h"
+#include "Utils.h"
+
+namespace
+{
+	const char MeshCacheMagic[4] = { 'D', 'X', 'R', 'M' };
+	const UINT32 MeshCacheVersion = 9;
+	const UINT64 MeshCacheAlignment = 64;
+	const UINT64 HashBlockSize = (64 << 20);
+
+	struct MeshCacheHeader
+	{
+		char magic[4];
+		UINT32 version;
+		UINT64 key;
+		UINT32 vertexStride;
+		UINT32 indexStride;
+		UINT64 vertexOffset;
+		UINT64 vertexCount;
+		UINT64 indexOffset;
+		UINT64 indexCount;
+		UINT64 materialOffset;
+		UINT64 materialCount;
+		UINT64 submeshOffset;
+		UINT64 submeshCount;
+		UINT64 clusterOffset;
+		UINT64 clusterCount;
+		UINT64 lodOffset;
+		UINT64 lodCount;
+		UINT64 frameOffset;
+		UINT64 frameCount;
+		UINT64 dependencyOffset;
+		UINT64 dependencyCount;
+	};
+
+	// What a file the model was built from looked like when the model was saved
+	struct FileStamp
+	{
+		UINT64 size;
+		UINT64 modifiedTime;
+		UINT64 hash;
+	};
+
+	const UINT64 MissingFileSize = ~0ull;
+
+	FileStamp ReadStamp(const std::string& path)
+	{
+		FileStamp stamp = { MissingFileSize, 0, 0 };
+
+		Utils::MappedFile file;
+		if (!file.Open(path)) return stamp;
+
+		stamp.size = file.Size();
+		stamp.modifiedTime = file.ModifiedTime();
+		stamp.hash = Utils::Hash(file.Data(), static_cast<size_t>(file.Size()), 0);
+		return stamp;
+	}
+
+	// Names the file that remembers the key of a source file with a given path, size and modified time
+	std::string GetKeyPath(const std::string& filepath)
+	{
+		Utils::MappedFile file;
+		if (!file.Open(filepath)) return std::string();
+
+		const UINT64 stamp = Utils::Hash(filepath.data(), filepath.size(), file.ModifiedTime() ^ file.Size());
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(stamp));
+		return std::string("cache/") + name + ".key";
+	}
+
+	bool WritePadding(Utils::OutputFile& file, UINT64& offset)
+	{
+		static const UINT8 zeros[MeshCacheAlignment] = {};
+		const UINT64 aligned = ALIGN(MeshCacheAlignment, offset);
+		const UINT64 padding = aligned - offset;
+
+		offset = aligned;
+		return file.Write(zeros, padding);
+	}
+
+	void AppendString(std::vector<UINT8>& buffer, const std::string& value)
+	{
+		const UINT32 length = static_cast<UINT32>(value.size());
+		buffer.insert(buffer.end(), reinterpret_cast<const UINT8*>(&length), reinterpret_cast<const UINT8*>(&length) + sizeof(length));
+		buffer.insert(buffer.end(), value.begin(), value.end());
+	}
+
+	bool ReadString(const char*& p, const char* end, std::string& value)
+	{
+		UINT32 length = 0;
+		if (static_cast<size_t>(end - p) < sizeof(length)) return false;
+		memcpy(&length, p, sizeof(length));
+		p += sizeof(length);
+
+		if (static_cast<size_t>(end - p) < length) return false;
+		value.assign(p, length);
+		p += length;
+		return true;
+	}
+
+	const size_t IndexBlockSize = (1 << 20);
+
+	template<typename T>
+	bool IndicesInRange(const T& range, UINT64 count)
+	{
+		return static_cast<UINT64>(range.indexOffset) + range.indexCount <= count;
+	}
+
+	template<typename T>
+	bool SubmeshesInRange(const T& range, UINT64 count)
+	{
+		return static_cast<UINT64>(range.submeshOffset) + range.submeshCount <= count;
+	}
+}
+
+namespace MeshCache
+{
+	UINT64 ComputeKey(const std::string& filepath)
+	{
+		Utils::MappedFile file;
+		if (!file.Open(filepath)) return 0;
+
+		const UINT blockCount = static_cast<UINT>((file.Size() + HashBlockSize - 1) / HashBlockSize);
+		std::vector<UINT64> blockHashes(blockCount);
+
+		Utils::ParallelFor(blockCount, [&](UINT i)
+		{
+			const UINT64 offset = i * HashBlockSize;
+			const UINT64 size = (std::min)(HashBlockSize, file.Size() - offset);
+			blockHashes[i] = Utils::Hash(file.Data() + offset, static_cast<size_t>(size), i);
+		});
+
+		const UINT64 key = Utils::Hash(blockHashes.data(), blockHashes.size() * sizeof(UINT64), file.ModifiedTime() ^ file.Size());
+		return key ? key : 1;
+	}
+
+	std::string GetCachePath(UINT64 key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+		return std::string("cache/") + name + ".mesh";
+	}
+
+	UINT64 FindKey(const std::string& filepath)
+	{
+		const std::string keyPath = GetKeyPath(filepath);
+		if (keyPath.empty()) return 0;
+
+		Utils::MappedFile file;
+		UINT64 key = 0;
+		if (!file.Open(keyPath) || file.Size() != sizeof(key)) return 0;
+
+		memcpy(&key, file.Data(), sizeof(key));
+		return key;
+	}
+
+	bool SaveKey(const std::string& filepath, UINT64 key)
+	{
+		const std::string keyPath = GetKeyPath(filepath);
+		if (keyPath.empty()) return false;
+
+		Utils::OutputFile file;
+		return file.Open(keyPath) && file.Write(&key, sizeof(key)) && file.Commit();
+	}
+
+	bool Load(UINT64 key, Model& model, std::vector<Material>& materials)
+	{
+		std::shared_ptr<Utils::MappedFile> file = std::make_shared<Utils::MappedFile>();
+		if (!file->Open(GetCachePath(key))) return false;
+		if (file->Size() < sizeof(MeshCacheHeader)) return false;
+
+		MeshCacheHeader header;
+		memcpy(&header, file->Data(), sizeof(header));
+
+		if (memcmp(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0) return false;
+		if (header.version != MeshCacheVersion || header.key != key) return false;
+		if (header.vertexStride != sizeof(Vertex) || header.indexStride != sizeof(uint32_t)) return false;
+		if ((header.vertexOffset % MeshCacheAlignment) != 0 || (header.indexOffset % MeshCacheAlignment) != 0) return false;
+		if (header.vertexOffset + header.vertexCount * sizeof(Vertex) > file->Size()) return false;
+		if (header.indexOffset + header.indexCount * sizeof(uint32_t) > file->Size()) return false;
+		if (header.materialOffset > file->Size()) return false;
+		if (header.submeshOffset + header.submeshCount * sizeof(Submesh) > file->Size()) return false;
+		if (header.clusterOffset + header.clusterCount * sizeof(Cluster) > file->Size()) return false;
+		if (header.lodOffset + header.lodCount * sizeof(ClusterLod) > file->Size()) return false;
+		if (header.frameCount != header.vertexCount || (header.frameOffset % MeshCacheAlignment) != 0) return false;
+		if (header.frameOffset + header.frameCount * sizeof(VertexFrame) > file->Size()) return false;
+		if (header.dependencyOffset > file->Size()) return false;
+
+		const Submesh* submeshes = reinterpret_cast<const Submesh*>(file->Data() + header.submeshOffset);
+		const Cluster* clusters = reinterpret_cast<const Cluster*>(file->Data() + header.clusterOffset);
+		const ClusterLod* lods = reinterpret_cast<const ClusterLod*>(file->Data() + header.lodOffset);
+
+		// A material library that changed, appeared or disappeared since the save makes the entry stale
+		const char* end = file->Data() + file->Size();
+		const char* p = file->Data() + header.dependencyOffset;
+		for (UINT64 i = 0; i < header.dependencyCount; i++)
+		{
+			std::string path;
+			FileStamp stamp;
+			if (!ReadString(p, end, path) || static_cast<size_t>(end - p) < sizeof(stamp)) return false;
+
+			memcpy(&stamp, p, sizeof(stamp));
+			p += sizeof(stamp);
+
+			const FileStamp current = ReadStamp(path);
+			if (current.size != stamp.size || current.modifiedTime != stamp.modifiedTime || current.hash != stamp.hash) return false;
+		}
+
+		std::vector<Material> cachedMaterials(static_cast<size_t>(header.materialCount));
+		p = file->Data() + header.materialOffset;
+		for (Material& material : cachedMaterials)
+		{
+			INT32 resolution = 0;
+			if (!ReadString(p, end, material.name) || !ReadString(p, end, material.texturePath)) return false;
+			if (static_cast<size_t>(end - p) < sizeof(resolution)) return false;
+
+			memcpy(&resolution, p, sizeof(resolution));
+			p += sizeof(resolution);
+			material.textureResolution = resolution;
+		}
+
+		Model loaded;
+		loaded.mappedVertices = reinterpret_cast<const Vertex*>(file->Data() + header.vertexOffset);
+		loaded.mappedIndices = reinterpret_cast<const uint32_t*>(file->Data() + header.indexOffset);
+		loaded.mappedFrames = reinterpret_cast<const VertexFrame*>(file->Data() + header.frameOffset);
+		loaded.mappedVertexCount = static_cast<size_t>(header.vertexCount);
+		loaded.mappedIndexCount = static_cast<size_t>(header.indexCount);
+		loaded.mapping = file;
+		loaded.submeshes.assign(submeshes, submeshes + header.submeshCount);
+		loaded.clusters.assign(clusters, clusters + header.clusterCount);
+		loaded.lods.assign(lods, lods + header.lodCount);
+		if (!IsInRange(loaded, cachedMaterials.size())) return false;
+
+		loaded.instances = std::move(model.instances);
+		model = std::move(loaded);
+		materials = cachedMaterials;
+		return true;
+	}
+
+	bool IsInRange(const Model& model, size_t materialCount)
+	{
+		const UINT64 indexCount = model.IndexCount();
+		for (const Submesh& submesh : model.submeshes)
+		{
+			if (!IndicesInRange(submesh, indexCount) || submesh.materialIndex >= materialCount) return false;
+		}
+
+		for (const Cluster& cluster : model.clusters)
+		{
+			if (!SubmeshesInRange(cluster, model.submeshes.size())) return false;
+			if (static_cast<UINT64>(cluster.lodOffset) + cluster.lodCount > model.lods.size()) return false;
+		}
+
+		for (const ClusterLod& lod : model.lods)
+		{
+			if (!SubmeshesInRange(lod, model.submeshes.size())) return false;
+		}
+
+		// Every index must name a vertex. The largest of each block of the index buffer is found in parallel.
+		const uint32_t* indices = model.IndexData();
+		const UINT blockCount = static_cast<UINT>((indexCount + IndexBlockSize - 1) / IndexBlockSize);
+		std::vector<uint32_t> largest(blockCount, 0);
+		Utils::ParallelFor(blockCount, [&](UINT block)
+		{
+			const size_t begin = static_cast<size_t>(block) * IndexBlockSize;
+			const size_t end = (std::min)(begin + IndexBlockSize, static_cast<size_t>(indexCount));
+
+			uint32_t value = 0;
+			for (size_t i = begin; i < end; i++) value = (std::max)(value, indices[i]);
+			largest[block] = value;
+		});
+
+		for (uint32_t value : largest)
+		{
+			if (value >= model.VertexCount()) return false;
+		}
+
+		return true;
+	}
+
+	bool Save(UINT64 key, const Model& model, const std::vector<Material>& materials, const std::vector<std::string>& dependencies)
+	{
+		if (!model.mappedFrames && model.frames.size() != model.VertexCount()) return false;
+
+		Utils::OutputFile file;
+		if (!file.Open(GetCachePath(key))) return false;
+
+		std::vector<UINT8> materialData;
+		for (const Material& material : materials)
+		{
+			const INT32 resolution = material.textureResolution;
+			AppendString(materialData, material.name);
+			AppendString(materialData, material.texturePath);
+			materialData.insert(materialData.end(), reinterpret_cast<const UINT8*>(&resolution), reinterpret_cast<const UINT8*>(&resolution) + sizeof(resolution));
+		}
+
+		std::vector<UINT8> dependencyData;
+		for (const std::string& path : dependencies)
+		{
+			const FileStamp stamp = ReadStamp(path);
+			AppendString(dependencyData, path);
+			dependencyData.insert(dependencyData.end(), reinterpret_cast<const UINT8*>(&stamp), reinterpret_cast<const UINT8*>(&stamp) + sizeof(stamp));
+		}
+
+		MeshCacheHeader header = {};
+		memcpy(header.magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+		header.version = MeshCacheVersion;
+		header.key = key;
+		header.vertexStride = sizeof(Vertex);
+		header.indexStride = sizeof(uint32_t);
+		header.vertexCount = model.VertexCount();
+		header.indexCount = model.IndexCount();
+		header.vertexOffset = ALIGN(MeshCacheAlignment, sizeof(MeshCacheHeader));
+		header.indexOffset = ALIGN(MeshCacheAlignment, header.vertexOffset + header.vertexCount * sizeof(Vertex));
+		header.materialOffset = header.indexOffset + header.indexCount * sizeof(uint32_t);
+		header.materialCount = materials.size();
+		header.submeshOffset = ALIGN(MeshCacheAlignment, header.materialOffset + materialData.size());
+		header.submeshCount = model.submeshes.size();
+		header.clusterOffset = header.submeshOffset + header.submeshCount * sizeof(Submesh);
+		header.clusterCount = model.clusters.size();
+		header.lodOffset = header.clusterOffset + header.clusterCount * sizeof(Cluster);
+		header.lodCount = model.lods.size();
+		header.frameOffset = ALIGN(MeshCacheAlignment, header.lodOffset + header.lodCount * sizeof(ClusterLod));
+		header.frameCount = model.VertexCount();
+		header.dependencyOffset = header.frameOffset + header.frameCount * sizeof(VertexFrame);
+		header.dependencyCount = dependencies.size();
+
+		UINT64 offset = sizeof(header);
+		bool result = file.Write(&header, sizeof(header));
+		result = result && WritePadding(file, offset);
+		result = result && file.Write(model.VertexData(), header.vertexCount * sizeof(Vertex));
+
+		offset += header.vertexCount * sizeof(Vertex);
+		result = result && WritePadding(file, offset);
+		result = result && file.Write(model.IndexData(), header.indexCount * sizeof(uint32_t));
+		result = result && file.Write(materialData.data(), materialData.size());
+
+		offset = header.materialOffset + materialData.size();
+		result = result && WritePadding(file, offset);
+		result = result && file.Write(model.submeshes.data(), header.submeshCount * sizeof(Submesh));
+		result = result && file.Write(model.clusters.data(), header.clusterCount * sizeof(Cluster));
+		result = result && file.Write(model.lods.data(), header.lodCount * sizeof(ClusterLod));
+
+		offset = header.lodOffset + header.lodCount * sizeof(ClusterLod);
+		result = result && WritePadding(file, offset);
+		result = result && file.Write(model.FrameData(), header.frameCount * sizeof(VertexFrame));
+		result = result && file.Write(dependencyData.data(), dependencyData.size());
+
+		return result && file.Commit();
+	}
+}
\ No newline at end of file
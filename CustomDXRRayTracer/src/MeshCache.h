@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Structures.h"
+
+namespace MeshCache
+{
+	UINT64 ComputeKey(const std::string& filepath);
+
+	std::string GetCachePath(UINT64 key);
+
+	// The key last saved for the file at this path with its current size and modified time, or 0. This only reads the
+	// file's metadata, so unlike ComputeKey it is cheap enough to call before the first frame.
+	UINT64 FindKey(const std::string& filepath);
+
+	bool SaveKey(const std::string& filepath, UINT64 key);
+
+	// Rejects an entry whose ranges, indices or material indices would reach past the arrays they refer to, so a damaged
+	// file cannot send the renderer past them
+	bool Load(UINT64 key, Model& model, std::vector<Material>& materials);
+
+	// Whether the submesh, cluster and LOD ranges, every index and every submesh material index of a model read from a
+	// file stay inside the arrays they refer to
+	bool IsInRange(const Model& model, size_t materialCount);
+
+	// Dependencies are the other files the model was built from, such as its material libraries. Load rejects the entry
+	// once any of them changes, appears or disappears.
+	bool Save(UINT64 key, const Model& model, const std::vector<Material>& materials, const std::vector<std::string>& dependencies);
+}
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "MeshCleaner.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const UINT32 EmptySlot = 0xFFFFFFFF;
+	const size_t VerticesPerTask = (1 << 16);
+	const float CellTolerances = 4.f;
+	const double MaxCellCoordinate = 4e18;
+
+	struct CellKey
+	{
+		INT64 x;
+		INT64 y;
+		INT64 z;
+
+		bool operator==(const CellKey& rhs) const
+		{
+			return x == rhs.x && y == rhs.y && z == rhs.z;
+		}
+	};
+
+	struct CellSlot
+	{
+		CellKey key;
+		UINT32 head;
+	};
+
+	struct TriangleSlot
+	{
+		UINT32 corners[3];
+		bool used;
+	};
+
+	inline UINT64 Mix(UINT64 hash, UINT64 value)
+	{
+		hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		return hash * 0xC2B2AE3D27D4EB4Full;
+	}
+
+	inline UINT64 HashCell(const CellKey& key)
+	{
+		return Mix(Mix(Mix(0, static_cast<UINT64>(key.x)), static_cast<UINT64>(key.y)), static_cast<UINT64>(key.z));
+	}
+
+	inline INT64 CellCoordinate(double value, double inverseCellSize)
+	{
+		return static_cast<INT64>(floor((std::max)(-MaxCellCoordinate, (std::min)(MaxCellCoordinate, value * inverseCellSize))));
+	}
+
+	// With no tolerance only equal positions weld, so each position is its own cell. Both zeros compare equal and
+	// share one.
+	inline INT64 ExactCoordinate(float value)
+	{
+		if (value == 0.f) value = 0.f;
+
+		UINT32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline CellKey ExactCell(const DirectX::XMFLOAT3& p)
+	{
+		return CellKey{ ExactCoordinate(p.x), ExactCoordinate(p.y), ExactCoordinate(p.z) };
+	}
+
+	size_t NextPowerOfTwo(size_t value)
+	{
+		size_t result = 1;
+		while (result < value) result <<= 1;
+		return result;
+	}
+
+	// Open addressing map from grid cell to the most recent representative vertex inside it
+	class CellGrid
+	{
+	public:
+		explicit CellGrid(size_t capacity)
+		{
+			m_Slots.resize(NextPowerOfTwo(capacity * 2), CellSlot{ CellKey{ 0, 0, 0 }, EmptySlot });
+			m_Mask = m_Slots.size() - 1;
+		}
+
+		UINT32 Find(const CellKey& key) const
+		{
+			for (size_t slot = HashCell(key) & m_Mask;; slot = (slot + 1) & m_Mask)
+			{
+				const CellSlot& entry = m_Slots[slot];
+				if (entry.head == EmptySlot) return EmptySlot;
+				if (entry.key == key) return entry.head;
+			}
+		}
+
+		UINT32& Insert(const CellKey& key)
+		{
+			for (size_t slot = HashCell(key) & m_Mask;; slot = (slot + 1) & m_Mask)
+			{
+				CellSlot& entry = m_Slots[slot];
+				if (entry.head == EmptySlot) entry.key = key;
+				if (entry.key == key) return entry.head;
+			}
+		}
+
+	private:
+		std::vector<CellSlot> m_Slots;
+		size_t m_Mask = 0;
+	};
+
+	inline bool IsNear(const Vertex& lhs, const Vertex& rhs, float positionTolerance, float uvTolerance)
+	{
+		return fabsf(lhs.position.x - rhs.position.x) <= positionTolerance &&
+			fabsf(lhs.position.y - rhs.position.y) <= positionTolerance &&
+			fabsf(lhs.position.z - rhs.position.z) <= positionTolerance &&
+			fabsf(lhs.uv.x - rhs.uv.x) <= uvTolerance &&
+			fabsf(lhs.uv.y - rhs.uv.y) <= uvTolerance;
+	}
+
+	// Triangles whose height over their longest edge is within the tolerance cover no area worth tracing
+	bool IsDegenerate(const Vertex* vertices, const uint32_t* triangle, float tolerance)
+	{
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) return true;
+
+		const DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&vertices[triangle[0]].position);
+		const DirectX::XMVECTOR b = DirectX::XMLoadFloat3(&vertices[triangle[1]].position);
+		const DirectX::XMVECTOR c = DirectX::XMLoadFloat3(&vertices[triangle[2]].position);
+		const DirectX::XMVECTOR ab = DirectX::XMVectorSubtract(b, a);
+		const DirectX::XMVECTOR ac = DirectX::XMVectorSubtract(c, a);
+		const DirectX::XMVECTOR bc = DirectX::XMVectorSubtract(c, b);
+
+		const float area = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVector3Cross(ab, ac)));
+		const float longest = (std::max)((std::max)(DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(ab)), DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(ac))), DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(bc)));
+		return area <= tolerance * tolerance * longest;
+	}
+}
+
+namespace MeshCleaner
+{
+	CleanupStats Clean(Model& model, float positionTolerance, float uvTolerance)
+	{
+		Utils::Timer timer;
+
+		CleanupStats stats;
+		stats.inputVertices = model.vertices.size();
+		stats.inputTriangles = model.indices.size() / 3;
+
+		const size_t vertexCount = model.vertices.size();
+		const UINT taskCount = static_cast<UINT>((vertexCount + VerticesPerTask - 1) / VerticesPerTask);
+
+		// Any vertex within the tolerance of another lies in the cells its tolerance box overlaps, at most two per axis
+		if (!(positionTolerance > 0.f)) positionTolerance = 0.f;
+		const bool exact = (positionTolerance == 0.f);
+		const double inverseCellSize = exact ? 0.0 : 1.0 / (static_cast<double>(positionTolerance) * CellTolerances);
+		std::vector<CellKey> lowCells(vertexCount);
+		std::vector<CellKey> highCells(vertexCount);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * VerticesPerTask;
+			const size_t end = (std::min)(begin + VerticesPerTask, vertexCount);
+
+			for (size_t v = begin; v < end; v++)
+			{
+				const DirectX::XMFLOAT3& p = model.vertices[v].position;
+				if (exact)
+				{
+					lowCells[v] = ExactCell(p);
+					highCells[v] = lowCells[v];
+					continue;
+				}
+
+				lowCells[v] = CellKey{ CellCoordinate(p.x - positionTolerance, inverseCellSize), CellCoordinate(p.y - positionTolerance, inverseCellSize), CellCoordinate(p.z - positionTolerance, inverseCellSize) };
+				highCells[v] = CellKey{ CellCoordinate(p.x + positionTolerance, inverseCellSize), CellCoordinate(p.y + positionTolerance, inverseCellSize), CellCoordinate(p.z + positionTolerance, inverseCellSize) };
+			}
+		});
+
+		// Every vertex joins the first earlier representative it is near, otherwise it becomes one. Representatives
+		// never move, so a welded vertex is always within the tolerance of the vertex it now shares.
+		std::vector<UINT32> representatives(vertexCount);
+		std::vector<UINT32> next(vertexCount, EmptySlot);
+		CellGrid grid(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const Vertex& vertex = model.vertices[v];
+			const CellKey& low = lowCells[v];
+			const CellKey& high = highCells[v];
+
+			UINT32 match = EmptySlot;
+			for (INT64 x = low.x; x <= high.x && match == EmptySlot; x++)
+			{
+				for (INT64 y = low.y; y <= high.y && match == EmptySlot; y++)
+				{
+					for (INT64 z = low.z; z <= high.z && match == EmptySlot; z++)
+					{
+						for (UINT32 r = grid.Find(CellKey{ x, y, z }); r != EmptySlot; r = next[r])
+						{
+							if (IsNear(model.vertices[r], vertex, positionTolerance, uvTolerance))
+							{
+								match = r;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if (match != EmptySlot)
+			{
+				representatives[v] = match;
+				continue;
+			}
+
+			const DirectX::XMFLOAT3& p = vertex.position;
+			UINT32& head = grid.Insert(exact ? low : CellKey{ CellCoordinate(p.x, inverseCellSize), CellCoordinate(p.y, inverseCellSize), CellCoordinate(p.z, inverseCellSize) });
+			next[v] = head;
+			head = static_cast<UINT32>(v);
+			representatives[v] = static_cast<UINT32>(v);
+		}
+
+		std::vector<UINT32> remap(vertexCount);
+		std::vector<Vertex> vertices;
+		vertices.reserve(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (representatives[v] != v) continue;
+
+			remap[v] = static_cast<UINT32>(vertices.size());
+			vertices.push_back(model.vertices[v]);
+		}
+		model.vertices.swap(vertices);
+		stats.outputVertices = model.vertices.size();
+
+		// Submeshes are cleaned independently; a triangle repeated under another material is kept
+		std::vector<std::vector<uint32_t>> kept(model.submeshes.size());
+		std::vector<size_t> degenerate(model.submeshes.size(), 0);
+		std::vector<size_t> duplicate(model.submeshes.size(), 0);
+		Utils::ParallelFor(static_cast<UINT>(model.submeshes.size()), [&](UINT s)
+		{
+			const Submesh& submesh = model.submeshes[s];
+			std::vector<uint32_t>& output = kept[s];
+			output.reserve(submesh.indexCount);
+
+			const size_t mask = NextPowerOfTwo(static_cast<size_t>(submesh.indexCount / 3) * 2) - 1;
+			std::vector<TriangleSlot> table(mask + 1, TriangleSlot{ { 0, 0, 0 }, false });
+
+			for (uint32_t i = submesh.indexOffset; i + 2 < submesh.indexOffset + submesh.indexCount; i += 3)
+			{
+				uint32_t triangle[3] = { remap[representatives[model.indices[i]]], remap[representatives[model.indices[i + 1]]], remap[representatives[model.indices[i + 2]]] };
+				if (IsDegenerate(model.vertices.data(), triangle, positionTolerance))
+				{
+					degenerate[s]++;
+					continue;
+				}
+
+				// Rotate the smallest index first so every cyclic order of the same triangle shares one key
+				const int first = (triangle[0] < triangle[1]) ? ((triangle[0] < triangle[2]) ? 0 : 2) : ((triangle[1] < triangle[2]) ? 1 : 2);
+				const UINT32 key[3] = { triangle[first], triangle[(first + 1) % 3], triangle[(first + 2) % 3] };
+
+				bool repeated = false;
+				for (size_t slot = Mix(Mix(Mix(0, key[0]), key[1]), key[2]) & mask;; slot = (slot + 1) & mask)
+				{
+					TriangleSlot& entry = table[slot];
+					if (!entry.used)
+					{
+						memcpy(entry.corners, key, sizeof(key));
+						entry.used = true;
+						break;
+					}
+
+					if (memcmp(entry.corners, key, sizeof(key)) == 0)
+					{
+						repeated = true;
+						break;
+					}
+				}
+
+				if (repeated)
+				{
+					duplicate[s]++;
+					continue;
+				}
+
+				output.insert(output.end(), triangle, triangle + 3);
+			}
+		});
+
+		std::vector<uint32_t> indices;
+		indices.reserve(model.indices.size());
+		std::vector<Submesh> submeshes;
+		for (size_t s = 0; s < model.submeshes.size(); s++)
+		{
+			stats.degenerateTriangles += degenerate[s];
+			stats.duplicateTriangles += duplicate[s];
+			if (kept[s].empty()) continue;
+
+			Submesh submesh = model.submeshes[s];
+			submesh.indexOffset = static_cast<uint32_t>(indices.size());
+			submesh.indexCount = static_cast<uint32_t>(kept[s].size());
+			submeshes.push_back(submesh);
+			indices.insert(indices.end(), kept[s].begin(), kept[s].end());
+		}
+
+		model.indices.swap(indices);
+		model.submeshes.swap(submeshes);
+
+		stats.outputTriangles = model.indices.size() / 3;
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Structures.h"
+
+struct CleanupStats
+{
+	size_t inputVertices = 0;
+	size_t outputVertices = 0;
+	size_t inputTriangles = 0;
+	size_t degenerateTriangles = 0;
+	size_t duplicateTriangles = 0;
+	size_t outputTriangles = 0;
+	float milliseconds = 0.f;
+};
+
+namespace MeshCleaner
+{
+	// Same per-component tolerances CompareVector3WithEpsilon and CompareVector2WithEpsilon use
+	static const float WeldPositionTolerance = 0.00001f;
+	static const float WeldUvTolerance = 0.00001f;
+
+	// Welds vertices whose positions and uvs are within the tolerances of an earlier vertex, using a uniform grid
+	// so only nearby cells are searched. Afterwards drops triangles that have repeated vertices or are thinner than
+	// the position tolerance, and triangles that repeat another one of the same submesh with the same winding. A zero
+	// position tolerance welds only equal positions.
+	CleanupStats Clean(Model& model, float positionTolerance = WeldPositionTolerance, float uvTolerance = WeldUvTolerance);
+}
\ No newline at end of file
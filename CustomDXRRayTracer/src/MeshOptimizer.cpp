@@ -0,0 +1,145 @@
+#include "MeshOptimizer.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+namespace
+{
+	const size_t TrianglesPerTask = (1 << 16);
+	const UINT32 UnusedVertex = 0xFFFFFFFF;
+
+	inline UINT32 SpreadBits(UINT32 value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	inline UINT32 MortonCode(float x, float y, float z)
+	{
+		const UINT32 ix = static_cast<UINT32>((std::min)((std::max)(x * 1024.f, 0.f), 1023.f));
+		const UINT32 iy = static_cast<UINT32>((std::min)((std::max)(y * 1024.f, 0.f), 1023.f));
+		const UINT32 iz = static_cast<UINT32>((std::min)((std::max)(z * 1024.f, 0.f), 1023.f));
+		return (SpreadBits(ix) << 2) | (SpreadBits(iy) << 1) | SpreadBits(iz);
+	}
+}
+
+namespace MeshOptimizer
+{
+	float AverageFetchStride(const std::vector<uint32_t>& indices)
+	{
+		if (indices.size() < 2) return 0.f;
+
+		double total = 0.0;
+		for (size_t i = 1; i < indices.size(); i++)
+		{
+			const INT64 delta = static_cast<INT64>(indices[i]) - static_cast<INT64>(indices[i - 1]);
+			total += static_cast<double>(delta < 0 ? -delta : delta);
+		}
+
+		return static_cast<float>(total / (indices.size() - 1) * sizeof(Vertex));
+	}
+
+	OptimizeStats Optimize(Model& model)
+	{
+		Utils::Timer timer;
+
+		OptimizeStats stats;
+		stats.fetchStrideBefore = AverageFetchStride(model.indices);
+
+		const size_t triangleCount = model.indices.size() / 3;
+		const UINT taskCount = static_cast<UINT>((triangleCount + TrianglesPerTask - 1) / TrianglesPerTask);
+		if (triangleCount == 0 || model.vertices.empty()) return stats;
+
+		// Quantize triangle centroids against the model bounds
+		DirectX::XMFLOAT3 boundsMin = model.vertices[0].position;
+		DirectX::XMFLOAT3 boundsMax = model.vertices[0].position;
+		for (const Vertex& vertex : model.vertices)
+		{
+			boundsMin.x = (std::min)(boundsMin.x, vertex.position.x);
+			boundsMin.y = (std::min)(boundsMin.y, vertex.position.y);
+			boundsMin.z = (std::min)(boundsMin.z, vertex.position.z);
+			boundsMax.x = (std::max)(boundsMax.x, vertex.position.x);
+			boundsMax.y = (std::max)(boundsMax.y, vertex.position.y);
+			boundsMax.z = (std::max)(boundsMax.z, vertex.position.z);
+		}
+
+		const float extent = (std::max)((std::max)(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+		const float scale = (extent > 0.f) ? (1.f / extent) : 0.f;
+
+		std::vector<UINT64> keys(triangleCount);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * TrianglesPerTask;
+			const size_t end = (std::min)(begin + TrianglesPerTask, triangleCount);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const DirectX::XMFLOAT3& a = model.vertices[model.indices[i * 3 + 0]].position;
+				const DirectX::XMFLOAT3& b = model.vertices[model.indices[i * 3 + 1]].position;
+				const DirectX::XMFLOAT3& c = model.vertices[model.indices[i * 3 + 2]].position;
+
+				const float x = ((a.x + b.x + c.x) / 3.f - boundsMin.x) * scale;
+				const float y = ((a.y + b.y + c.y) / 3.f - boundsMin.y) * scale;
+				const float z = ((a.z + b.z + c.z) / 3.f - boundsMin.z) * scale;
+
+				keys[i] = (static_cast<UINT64>(MortonCode(x, y, z)) << 32) | static_cast<UINT64>(i);
+			}
+		});
+
+		// Sort triangles within each submesh so material ranges stay intact
+		Utils::ParallelFor(static_cast<UINT>(model.submeshes.size()), [&](UINT i)
+		{
+			const size_t begin = model.submeshes[i].indexOffset / 3;
+			const size_t end = begin + model.submeshes[i].indexCount / 3;
+			std::sort(keys.begin() + begin, keys.begin() + end);
+		});
+
+		std::vector<uint32_t> sortedIndices(model.indices.size());
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * TrianglesPerTask;
+			const size_t end = (std::min)(begin + TrianglesPerTask, triangleCount);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const size_t triangle = static_cast<size_t>(keys[i] & 0xFFFFFFFF);
+				sortedIndices[i * 3 + 0] = model.indices[triangle * 3 + 0];
+				sortedIndices[i * 3 + 1] = model.indices[triangle * 3 + 1];
+				sortedIndices[i * 3 + 2] = model.indices[triangle * 3 + 2];
+			}
+		});
+
+		// Renumber vertices in the order the sorted triangles first reference them
+		std::vector<uint32_t> remap(model.vertices.size(), UnusedVertex);
+		std::vector<Vertex> sortedVertices;
+		sortedVertices.reserve(model.vertices.size());
+
+		// The frame stream is parallel to the vertices and follows the same renumbering
+		const bool hasFrames = model.frames.size() == model.vertices.size();
+		std::vector<VertexFrame> sortedFrames;
+		if (hasFrames) sortedFrames.reserve(model.frames.size());
+
+		for (uint32_t& index : sortedIndices)
+		{
+			if (remap[index] == UnusedVertex)
+			{
+				remap[index] = static_cast<uint32_t>(sortedVertices.size());
+				sortedVertices.push_back(model.vertices[index]);
+				if (hasFrames) sortedFrames.push_back(model.frames[index]);
+			}
+			index = remap[index];
+		}
+
+		model.vertices.swap(sortedVertices);
+		model.indices.swap(sortedIndices);
+		if (hasFrames) model.frames.swap(sortedFrames);
+
+		stats.fetchStrideAfter = AverageFetchStride(model.indices);
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
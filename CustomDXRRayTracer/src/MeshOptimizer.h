@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Structures.h"
+
+struct OptimizeStats
+{
+	float fetchStrideBefore = 0.f;
+	float fetchStrideAfter = 0.f;
+	float milliseconds = 0.f;
+};
+
+namespace MeshOptimizer
+{
+	float AverageFetchStride(const std::vector<uint32_t>& indices);
+
+	OptimizeStats Optimize(Model& model);
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "MeshPartitioner.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	const size_t TrianglesPerTask = (1 << 16);
+
+	struct Range
+	{
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 min = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		DirectX::XMFLOAT3 max = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Grow(const DirectX::XMFLOAT3& point)
+		{
+			min.x = (std::min)(min.x, point.x);
+			min.y = (std::min)(min.y, point.y);
+			min.z = (std::min)(min.z, point.z);
+			max.x = (std::max)(max.x, point.x);
+			max.y = (std::max)(max.y, point.y);
+			max.z = (std::max)(max.z, point.z);
+		}
+
+		float Volume() const
+		{
+			if (max.x < min.x) return 0.f;
+			return (max.x - min.x) * (max.y - min.y) * (max.z - min.z);
+		}
+	};
+
+	inline float Axis(const DirectX::XMFLOAT3& point, int axis)
+	{
+		return (axis == 0) ? point.x : ((axis == 1) ? point.y : point.z);
+	}
+}
+
+namespace MeshPartitioner
+{
+	PartitionStats Partition(Model& model, uint32_t maxClusterTriangles)
+	{
+		Utils::Timer timer;
+
+		PartitionStats stats;
+		model.clusters.clear();
+		model.lods.clear();
+
+		const uint32_t triangleCount = static_cast<uint32_t>(model.indices.size() / 3);
+		const UINT taskCount = static_cast<UINT>((triangleCount + TrianglesPerTask - 1) / TrianglesPerTask);
+		if (triangleCount == 0) return stats;
+
+		std::vector<uint32_t> materials(triangleCount, 0);
+		for (const Submesh& submesh : model.submeshes)
+		{
+			std::fill(materials.begin() + submesh.indexOffset / 3, materials.begin() + (submesh.indexOffset + submesh.indexCount) / 3, submesh.materialIndex);
+		}
+
+		std::vector<DirectX::XMFLOAT3> centroids(triangleCount);
+		std::vector<uint32_t> order(triangleCount);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * TrianglesPerTask;
+			const size_t end = (std::min)(begin + TrianglesPerTask, static_cast<size_t>(triangleCount));
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const DirectX::XMFLOAT3& a = model.vertices[model.indices[i * 3 + 0]].position;
+				const DirectX::XMFLOAT3& b = model.vertices[model.indices[i * 3 + 1]].position;
+				const DirectX::XMFLOAT3& c = model.vertices[model.indices[i * 3 + 2]].position;
+				centroids[i] = DirectX::XMFLOAT3((a.x + b.x + c.x) / 3.f, (a.y + b.y + c.y) / 3.f, (a.z + b.z + c.z) / 3.f);
+				order[i] = static_cast<uint32_t>(i);
+			}
+		});
+
+		// Median split on the longest centroid axis, one level at a time so sibling ranges split in parallel
+		std::vector<Range> leaves;
+		std::vector<Range> pending;
+		if (triangleCount > maxClusterTriangles) pending.push_back(Range{ 0, triangleCount });
+		else leaves.push_back(Range{ 0, triangleCount });
+		while (!pending.empty())
+		{
+			std::vector<Range> children(pending.size() * 2);
+			Utils::ParallelFor(static_cast<UINT>(pending.size()), [&](UINT i)
+			{
+				const Range range = pending[i];
+
+				Bounds bounds;
+				for (uint32_t t = range.begin; t < range.end; t++) bounds.Grow(centroids[order[t]]);
+
+				const float extentX = bounds.max.x - bounds.min.x;
+				const float extentY = bounds.max.y - bounds.min.y;
+				const float extentZ = bounds.max.z - bounds.min.z;
+				const int axis = (extentX >= extentY && extentX >= extentZ) ? 0 : ((extentY >= extentZ) ? 1 : 2);
+
+				const uint32_t middle = range.begin + (range.end - range.begin) / 2;
+				std::nth_element(order.begin() + range.begin, order.begin() + middle, order.begin() + range.end, [&](uint32_t lhs, uint32_t rhs)
+				{
+					return Axis(centroids[lhs], axis) < Axis(centroids[rhs], axis);
+				});
+
+				children[i * 2 + 0] = Range{ range.begin, middle };
+				children[i * 2 + 1] = Range{ middle, range.end };
+			});
+
+			pending.clear();
+			for (const Range& child : children)
+			{
+				if (child.end - child.begin > maxClusterTriangles) pending.push_back(child);
+				else leaves.push_back(child);
+			}
+		}
+
+		std::sort(leaves.begin(), leaves.end(), [](const Range& lhs, const Range& rhs) { return lhs.begin < rhs.begin; });
+
+		// Group each cluster's triangles by material so every material becomes one contiguous submesh
+		Utils::ParallelFor(static_cast<UINT>(leaves.size()), [&](UINT i)
+		{
+			std::stable_sort(order.begin() + leaves[i].begin, order.begin() + leaves[i].end, [&](uint32_t lhs, uint32_t rhs)
+			{
+				return materials[lhs] < materials[rhs];
+			});
+		});
+
+		std::vector<uint32_t> indices(model.indices.size());
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * TrianglesPerTask;
+			const size_t end = (std::min)(begin + TrianglesPerTask, static_cast<size_t>(triangleCount));
+
+			for (size_t i = begin; i < end; i++)
+			{
+				indices[i * 3 + 0] = model.indices[order[i] * 3 + 0];
+				indices[i * 3 + 1] = model.indices[order[i] * 3 + 1];
+				indices[i * 3 + 2] = model.indices[order[i] * 3 + 2];
+			}
+		});
+
+		std::vector<Bounds> clusterBounds(leaves.size());
+		Utils::ParallelFor(static_cast<UINT>(leaves.size()), [&](UINT i)
+		{
+			for (uint32_t t = leaves[i].begin * 3; t < leaves[i].end * 3; t++) clusterBounds[i].Grow(model.vertices[indices[t]].position);
+		});
+
+		model.indices.swap(indices);
+		model.submeshes.clear();
+		model.clusters.resize(leaves.size());
+
+		Bounds modelBounds;
+		float clusterVolume = 0.f;
+		for (size_t i = 0; i < leaves.size(); i++)
+		{
+			Cluster& cluster = model.clusters[i];
+			cluster.submeshOffset = static_cast<uint32_t>(model.submeshes.size());
+			cluster.boundsMin = clusterBounds[i].min;
+			cluster.boundsMax = clusterBounds[i].max;
+
+			for (uint32_t t = leaves[i].begin; t < leaves[i].end; t++)
+			{
+				const uint32_t material = materials[order[t]];
+				if (t == leaves[i].begin || model.submeshes.back().materialIndex != material)
+				{
+					Submesh submesh;
+					submesh.indexOffset = t * 3;
+					submesh.materialIndex = material;
+					model.submeshes.push_back(submesh);
+				}
+				model.submeshes.back().indexCount += 3;
+			}
+
+			cluster.submeshCount = static_cast<uint32_t>(model.submeshes.size()) - cluster.submeshOffset;
+
+			modelBounds.Grow(cluster.boundsMin);
+			modelBounds.Grow(cluster.boundsMax);
+			clusterVolume += clusterBounds[i].Volume();
+			stats.largestCluster = (std::max)(stats.largestCluster, static_cast<size_t>(leaves[i].end - leaves[i].begin));
+		}
+
+		stats.clusterCount = model.clusters.size();
+		stats.overlapRatio = (modelBounds.Volume() > 0.f) ? (clusterVolume / modelBounds.Volume()) : 0.f;
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Structures.h"
+
+struct PartitionStats
+{
+	size_t clusterCount = 0;
+	size_t largestCluster = 0;
+	float overlapRatio = 0.f;
+	float milliseconds = 0.f;
+};
+
+namespace MeshPartitioner
+{
+	static const uint32_t MaxClusterTriangles = (1 << 18);
+
+	PartitionStats Partition(Model& model, uint32_t maxClusterTriangles = MaxClusterTriangles);
+}
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include "MeshSimplifier.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const float LodMinReduction = 0.85f;
+	const float MaxRelativeError = 0.05f;
+	const float FlipThreshold = 0.25f;
+
+	// Sum of squared distances to a set of planes
+	struct Quadric
+	{
+		double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+		double b2 = 0.0, bc = 0.0, bd = 0.0;
+		double c2 = 0.0, cd = 0.0;
+		double d2 = 0.0;
+
+		void AddPlane(double a, double b, double c, double d)
+		{
+			a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+			b2 += b * b; bc += b * c; bd += b * d;
+			c2 += c * c; cd += c * d;
+			d2 += d * d;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+		}
+
+		double Evaluate(const XMFLOAT3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			return a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z) + d2;
+		}
+	};
+
+	struct Collapse
+	{
+		float error;
+		uint32_t from;
+		uint32_t to;
+
+		bool operator<(const Collapse& rhs) const
+		{
+			if (error != rhs.error) return error < rhs.error;
+			if (from != rhs.from) return from < rhs.from;
+			return to < rhs.to;
+		}
+	};
+
+	XMVECTOR TriangleNormal(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		const XMVECTOR p = XMLoadFloat3(&a);
+		return XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b), p), XMVectorSubtract(XMLoadFloat3(&c), p));
+	}
+
+	// Simplifies one submesh of one cluster. Vertices are renumbered locally so the per-vertex state
+	// only covers what the submesh references.
+	class SubmeshSimplifier
+	{
+	public:
+		SubmeshSimplifier(const Vertex* vertices, const uint32_t* indices, uint32_t indexCount, float maxError) : m_MaxError(maxError)
+		{
+			m_Globals.assign(indices, indices + indexCount);
+			std::sort(m_Globals.begin(), m_Globals.end());
+			m_Globals.erase(std::unique(m_Globals.begin(), m_Globals.end()), m_Globals.end());
+
+			m_Triangles.resize(indexCount);
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				m_Triangles[i] = static_cast<uint32_t>(std::lower_bound(m_Globals.begin(), m_Globals.end(), indices[i]) - m_Globals.begin());
+			}
+
+			const size_t vertexCount = m_Globals.size();
+			m_Positions.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++) m_Positions[v] = vertices[m_Globals[v]].position;
+
+			// Edges that do not have exactly two triangles are borders, seams or non-manifold; their vertices stay put
+			std::vector<UINT64> edges;
+			edges.reserve(indexCount);
+			for (uint32_t t = 0; t < indexCount; t += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					const uint32_t a = m_Triangles[t + e];
+					const uint32_t b = m_Triangles[t + (e + 1) % 3];
+					edges.push_back((static_cast<UINT64>((std::min)(a, b)) << 32) | (std::max)(a, b));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+
+			m_Locked.assign(vertexCount, 0);
+			for (size_t i = 0; i < edges.size();)
+			{
+				size_t j = i + 1;
+				while (j < edges.size() && edges[j] == edges[i]) j++;
+				if (j - i != 2)
+				{
+					m_Locked[edges[i] >> 32] = 1;
+					m_Locked[edges[i] & 0xFFFFFFFF] = 1;
+				}
+				i = j;
+			}
+
+			m_Quadrics.resize(vertexCount);
+			for (uint32_t t = 0; t < indexCount; t += 3)
+			{
+				const XMVECTOR normal = TriangleNormal(m_Positions[m_Triangles[t]], m_Positions[m_Triangles[t + 1]], m_Positions[m_Triangles[t + 2]]);
+				if (XMVectorGetX(XMVector3LengthSq(normal)) <= 0.f) continue;
+
+				XMFLOAT3 n;
+				XMStoreFloat3(&n, XMVector3Normalize(normal));
+				const XMFLOAT3& p = m_Positions[m_Triangles[t]];
+				const double d = -(static_cast<double>(n.x) * p.x + static_cast<double>(n.y) * p.y + static_cast<double>(n.z) * p.z);
+				for (int corner = 0; corner < 3; corner++) m_Quadrics[m_Triangles[t + corner]].AddPlane(n.x, n.y, n.z, d);
+			}
+		}
+
+		// Collapses edges until at most targetTriangles remain or no collapse stays within the error limit
+		void Simplify(size_t targetTriangles)
+		{
+			while (TriangleCount() > targetTriangles)
+			{
+				if (!CollapsePass(targetTriangles)) break;
+			}
+		}
+
+		size_t TriangleCount() const
+		{
+			return m_Triangles.size() / 3;
+		}
+
+		float Error() const
+		{
+			return m_Error;
+		}
+
+		void AppendIndices(std::vector<uint32_t>& indices) const
+		{
+			for (uint32_t index : m_Triangles) indices.push_back(m_Globals[index]);
+		}
+
+	private:
+		// Applies the cheapest collapses whose neighbourhoods do not overlap, so each one can be validated
+		// against triangles no other collapse in the pass has changed
+		bool CollapsePass(size_t targetTriangles)
+		{
+			const size_t vertexCount = m_Positions.size();
+			const size_t triangleCount = TriangleCount();
+
+			std::vector<uint32_t> offsets(vertexCount + 1, 0);
+			for (uint32_t index : m_Triangles) offsets[index + 1]++;
+			for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] += offsets[v];
+
+			std::vector<uint32_t> adjacency(m_Triangles.size());
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < m_Triangles.size(); i++) adjacency[cursor[m_Triangles[i]]++] = static_cast<uint32_t>(i / 3);
+
+			// Only the cheapest collapse of each vertex is considered in a pass
+			std::vector<Collapse> best(vertexCount, Collapse{ FLT_MAX, 0, 0 });
+			for (size_t i = 0; i < m_Triangles.size(); i++)
+			{
+				const uint32_t a = m_Triangles[i];
+				const uint32_t b = m_Triangles[(i % 3 == 2) ? i - 2 : i + 1];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					const uint32_t from = direction ? b : a;
+					const uint32_t to = direction ? a : b;
+					if (m_Locked[from]) continue;
+
+					const double cost = m_Quadrics[from].Evaluate(m_Positions[to]) + m_Quadrics[to].Evaluate(m_Positions[to]);
+					const Collapse collapse = { static_cast<float>(sqrt((std::max)(cost, 0.0))), from, to };
+					if (collapse.error <= m_MaxError && collapse < best[from]) best[from] = collapse;
+				}
+			}
+
+			std::vector<Collapse> collapses;
+			for (const Collapse& collapse : best)
+			{
+				if (collapse.error != FLT_MAX) collapses.push_back(collapse);
+			}
+			std::sort(collapses.begin(), collapses.end());
+
+			std::vector<uint32_t> remap(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++) remap[v] = static_cast<uint32_t>(v);
+			std::vector<UINT8> touched(vertexCount, 0);
+
+			const size_t removable = triangleCount - targetTriangles;
+			size_t removed = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (removed >= removable) break;
+				if (touched[collapse.from] || touched[collapse.to]) continue;
+
+				// Reject collapses that would fold a surviving triangle over
+				size_t degenerate = 0;
+				bool flips = false;
+				for (uint32_t i = offsets[collapse.from]; i < offsets[collapse.from + 1] && !flips; i++)
+				{
+					const uint32_t* triangle = &m_Triangles[adjacency[i] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+					{
+						degenerate++;
+						continue;
+					}
+
+					XMFLOAT3 moved[3];
+					for (int corner = 0; corner < 3; corner++) moved[corner] = m_Positions[(triangle[corner] == collapse.from) ? collapse.to : triangle[corner]];
+
+					const XMVECTOR before = TriangleNormal(m_Positions[triangle[0]], m_Positions[triangle[1]], m_Positions[triangle[2]]);
+					const XMVECTOR after = TriangleNormal(moved[0], moved[1], moved[2]);
+					const float lengths = sqrtf(XMVectorGetX(XMVector3LengthSq(before)) * XMVectorGetX(XMVector3LengthSq(after)));
+					flips = (lengths <= 0.f) || (XMVectorGetX(XMVector3Dot(before, after)) < FlipThreshold * lengths);
+				}
+				if (flips || degenerate == 0) continue;
+
+				remap[collapse.from] = collapse.to;
+				m_Quadrics[collapse.to].Add(m_Quadrics[collapse.from]);
+				m_Error = (std::max)(m_Error, collapse.error);
+				removed += degenerate;
+
+				for (uint32_t i = offsets[collapse.from]; i < offsets[collapse.from + 1]; i++)
+				{
+					const uint32_t* triangle = &m_Triangles[adjacency[i] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+				}
+			}
+
+			if (removed == 0) return false;
+
+			size_t write = 0;
+			for (size_t t = 0; t < m_Triangles.size(); t += 3)
+			{
+				const uint32_t a = remap[m_Triangles[t]];
+				const uint32_t b = remap[m_Triangles[t + 1]];
+				const uint32_t c = remap[m_Triangles[t + 2]];
+				if (a == b || b == c || a == c) continue;
+
+				m_Triangles[write++] = a;
+				m_Triangles[write++] = b;
+				m_Triangles[write++] = c;
+			}
+			m_Triangles.resize(write);
+			return true;
+		}
+
+		std::vector<uint32_t> m_Globals;
+		std::vector<XMFLOAT3> m_Positions;
+		std::vector<Quadric> m_Quadrics;
+		std::vector<UINT8> m_Locked;
+		std::vector<uint32_t> m_Triangles;
+		float m_MaxError;
+		float m_Error = 0.f;
+	};
+
+	struct LodChain
+	{
+		std::vector<std::vector<uint32_t>> levels;
+		std::vector<float> errors;
+	};
+}
+
+namespace MeshSimplifier
+{
+	SimplifyStats BuildLods(Model& model, float reduction, uint32_t maxLevels)
+	{
+		Utils::Timer timer;
+
+		SimplifyStats stats;
+		stats.baseTriangles = model.IndexCount() / 3;
+		model.lods.clear();
+
+		// The error limit scales with the cluster so that small parts are not flattened away
+		std::vector<float> errorLimits(model.submeshes.size(), 0.f);
+		for (Cluster& cluster : model.clusters)
+		{
+			cluster.lodOffset = 0;
+			cluster.lodCount = 0;
+
+			const XMVECTOR extent = XMVectorSubtract(XMLoadFloat3(&cluster.boundsMax), XMLoadFloat3(&cluster.boundsMin));
+			const float limit = MaxRelativeError * sqrtf(XMVectorGetX(XMVector3LengthSq(extent)));
+			for (uint32_t s = 0; s < cluster.submeshCount; s++) errorLimits[cluster.submeshOffset + s] = limit;
+		}
+
+		const Vertex* vertices = model.VertexData();
+		const uint32_t* indices = model.IndexData();
+
+		std::vector<LodChain> chains(model.submeshes.size());
+		Utils::ParallelFor(static_cast<UINT>(model.submeshes.size()), [&](UINT s)
+		{
+			const Submesh& submesh = model.submeshes[s];
+			if (submesh.indexCount / 3 < MinLodTriangles) return;
+
+			SubmeshSimplifier simplifier(vertices, indices + submesh.indexOffset, submesh.indexCount, errorLimits[s]);
+			for (uint32_t level = 0; level < maxLevels; level++)
+			{
+				const size_t previous = simplifier.TriangleCount();
+				simplifier.Simplify(static_cast<size_t>(previous * reduction));
+				if (simplifier.TriangleCount() > previous * LodMinReduction) break;
+
+				chains[s].levels.emplace_back();
+				simplifier.AppendIndices(chains[s].levels.back());
+				chains[s].errors.push_back(simplifier.Error());
+
+				if (simplifier.TriangleCount() < MinLodTriangles) break;
+			}
+		});
+
+		// A cluster level takes each submesh's matching level, or its coarsest one when its chain is shorter.
+		// Levels that would not shrink the whole cluster enough are dropped.
+		std::vector<uint32_t> lodIndices;
+		std::vector<Submesh> lodSubmeshes;
+		const uint32_t baseIndexCount = static_cast<uint32_t>(model.IndexCount());
+		const uint32_t baseSubmeshCount = static_cast<uint32_t>(model.submeshes.size());
+		for (Cluster& cluster : model.clusters)
+		{
+			size_t previousTriangles = 0;
+			for (uint32_t s = 0; s < cluster.submeshCount; s++) previousTriangles += model.submeshes[cluster.submeshOffset + s].indexCount / 3;
+
+			cluster.lodOffset = static_cast<uint32_t>(model.lods.size());
+			for (uint32_t level = 0; level < maxLevels; level++)
+			{
+				size_t triangles = 0;
+				bool simplified = false;
+				ClusterLod lod;
+				for (uint32_t s = 0; s < cluster.submeshCount; s++)
+				{
+					const LodChain& chain = chains[cluster.submeshOffset + s];
+					if (chain.levels.empty())
+					{
+						triangles += model.submeshes[cluster.submeshOffset + s].indexCount / 3;
+						continue;
+					}
+
+					const size_t chainLevel = (std::min)(static_cast<size_t>(level), chain.levels.size() - 1);
+					simplified = simplified || (chainLevel == level);
+					triangles += chain.levels[chainLevel].size() / 3;
+					lod.error = (std::max)(lod.error, chain.errors[chainLevel]);
+				}
+
+				if (!simplified || triangles > previousTriangles * LodMinReduction) break;
+
+				lod.submeshOffset = baseSubmeshCount + static_cast<uint32_t>(lodSubmeshes.size());
+				for (uint32_t s = 0; s < cluster.submeshCount; s++)
+				{
+					const Submesh& source = model.submeshes[cluster.submeshOffset + s];
+					const LodChain& chain = chains[cluster.submeshOffset + s];
+
+					Submesh submesh;
+					submesh.indexOffset = baseIndexCount + static_cast<uint32_t>(lodIndices.size());
+					submesh.materialIndex = source.materialIndex;
+					if (chain.levels.empty())
+					{
+						lodIndices.insert(lodIndices.end(), indices + source.indexOffset, indices + source.indexOffset + source.indexCount);
+					}
+					else
+					{
+						const std::vector<uint32_t>& levelIndices = chain.levels[(std::min)(static_cast<size_t>(level), chain.levels.size() - 1)];
+						lodIndices.insert(lodIndices.end(), levelIndices.begin(), levelIndices.end());
+					}
+
+					submesh.indexCount = baseIndexCount + static_cast<uint32_t>(lodIndices.size()) - submesh.indexOffset;
+					if (submesh.indexCount > 0) lodSubmeshes.push_back(submesh);
+				}
+				lod.submeshCount = baseSubmeshCount + static_cast<uint32_t>(lodSubmeshes.size()) - lod.submeshOffset;
+
+				model.lods.push_back(lod);
+				cluster.lodCount++;
+				previousTriangles = triangles;
+				stats.maxError = (std::max)(stats.maxError, lod.error);
+			}
+
+			stats.levelCount = (std::max)(stats.levelCount, static_cast<size_t>(cluster.lodCount));
+			stats.coarsestTriangles += previousTriangles;
+		}
+
+		// Levels live after the full-resolution indices, so mapped indices have to be copied first
+		if (!lodIndices.empty())
+		{
+			if (model.mappedIndices)
+			{
+				model.indices.assign(model.mappedIndices, model.mappedIndices + model.mappedIndexCount);
+				model.mappedIndices = nullptr;
+			}
+
+			model.indices.insert(model.indices.end(), lodIndices.begin(), lodIndices.end());
+			model.submeshes.insert(model.submeshes.end(), lodSubmeshes.begin(), lodSubmeshes.end());
+		}
+
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
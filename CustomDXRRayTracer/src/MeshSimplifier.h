@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Structures.h"
+
+struct SimplifyStats
+{
+	size_t levelCount = 0;
+	size_t baseTriangles = 0;
+	size_t coarsestTriangles = 0;
+	float maxError = 0.f;
+	float milliseconds = 0.f;
+};
+
+namespace MeshSimplifier
+{
+	static const uint32_t MaxLodLevels = 6;
+	static const uint32_t MinLodTriangles = 512;
+	static const float LodReduction = 0.5f;
+
+	// Appends a chain of coarser levels to every cluster using quadric error edge collapses. Collapses only
+	// merge vertices into existing ones, so every level shares the vertex and frame buffers of the full mesh.
+	// Open edges are locked, which keeps submesh and cluster borders, uv seams and crease splits intact, so
+	// neighbouring clusters never crack whichever level each of them uses. Submeshes are simplified in parallel
+	// on the Utils thread pool, and the levels do not depend on its number of workers.
+	SimplifyStats BuildLods(Model& model, float reduction = LodReduction, uint32_t maxLevels = MaxLodLevels);
+}
\ No newline at end of file
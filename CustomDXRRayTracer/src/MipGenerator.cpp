@@ -0,0 +1,339 @@
+#include "MipGenerator.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	const size_t BandTexels = (1 << 16);
+	const float Pi = 3.14159265358979f;
+	const float KaiserWidth = 3.f;
+	const float KaiserAlpha = 4.f;
+	const float LanczosWidth = 3.f;
+	const int EncodeSteps = 65536;
+
+	// Byte to float decodes, and 16-bit fixed point to byte encodes, for sRGB and for linear data
+	struct ColorTables
+	{
+		float decode[2][256];
+		UINT8 encode[2][EncodeSteps];
+
+		ColorTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				const double value = i / 255.0;
+				decode[0][i] = static_cast<float>(value);
+				decode[1][i] = static_cast<float>((value <= 0.04045) ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+			}
+
+			for (int i = 0; i < EncodeSteps; i++)
+			{
+				const double value = i / static_cast<double>(EncodeSteps - 1);
+				const double encoded = (value <= 0.0031308) ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+				encode[0][i] = static_cast<UINT8>(value * 255.0 + 0.5);
+				encode[1][i] = static_cast<UINT8>((std::min)(encoded, 1.0) * 255.0 + 0.5);
+			}
+		}
+	};
+
+	const ColorTables& GetColorTables()
+	{
+		static const ColorTables tables;
+		return tables;
+	}
+
+	// Source texels [first, first + count) and their normalised weights for each destination texel along one axis
+	struct AxisWeights
+	{
+		std::vector<int> first;
+		std::vector<int> count;
+		std::vector<float> weights;
+		int stride = 0;
+	};
+
+	float Sinc(float x)
+	{
+		if (fabsf(x) < 1e-6f) return 1.f;
+		return sinf(Pi * x) / (Pi * x);
+	}
+
+	float BesselI0(float x)
+	{
+		float sum = 1.f;
+		float term = 1.f;
+		for (int k = 1; k < 32 && term > sum * 1e-8f; k++)
+		{
+			term *= (x * x) / (4.f * k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float FilterRadius(MipFilter filter)
+	{
+		if (filter == MipFilter::Kaiser) return KaiserWidth;
+		if (filter == MipFilter::Lanczos) return LanczosWidth;
+		return 0.5f;
+	}
+
+	float EvaluateFilter(MipFilter filter, float x)
+	{
+		if (filter == MipFilter::Kaiser)
+		{
+			const float t = x / KaiserWidth;
+			if (t * t >= 1.f) return 0.f;
+			return Sinc(x) * BesselI0(KaiserAlpha * sqrtf(1.f - t * t)) / BesselI0(KaiserAlpha);
+		}
+
+		if (fabsf(x) >= LanczosWidth) return 0.f;
+		return Sinc(x) * Sinc(x / LanczosWidth);
+	}
+
+	// The filter is stretched by the size ratio so each destination texel covers the source texels it replaces.
+	// Box weights are the overlap of each source texel with that span; taps past the edges are clamped onto them.
+	AxisWeights BuildWeights(UINT sourceSize, UINT destinationSize, MipFilter filter)
+	{
+		const float scale = static_cast<float>(sourceSize) / destinationSize;
+		const float radius = FilterRadius(filter) * scale;
+
+		AxisWeights axis;
+		axis.stride = static_cast<int>(ceilf(radius * 2.f)) + 2;
+		axis.first.resize(destinationSize);
+		axis.count.resize(destinationSize);
+		axis.weights.assign(static_cast<size_t>(destinationSize) * axis.stride, 0.f);
+
+		std::vector<float> taps(axis.stride);
+		for (UINT i = 0; i < destinationSize; i++)
+		{
+			const float center = (i + 0.5f) * scale;
+			const int lo = static_cast<int>(floorf(center - radius));
+			const int hi = (std::min)(lo + axis.stride, static_cast<int>(ceilf(center + radius)));
+
+			const int first = (std::max)(lo, 0);
+			const int last = (std::min)(hi, static_cast<int>(sourceSize));
+			std::fill(taps.begin(), taps.end(), 0.f);
+
+			float sum = 0.f;
+			for (int j = lo; j < hi; j++)
+			{
+				float weight;
+				if (filter == MipFilter::Box)
+				{
+					weight = (std::max)(0.f, (std::min)(j + 1.f, center + radius) - (std::max)(static_cast<float>(j), center - radius));
+				}
+				else
+				{
+					weight = EvaluateFilter(filter, (j + 0.5f - center) / scale);
+				}
+
+				const int clamped = (std::min)((std::max)(j, first), last - 1);
+				taps[clamped - first] += weight;
+				sum += weight;
+			}
+
+			axis.first[i] = first;
+			axis.count[i] = last - first;
+			for (int k = 0; k < axis.count[i]; k++)
+			{
+				axis.weights[static_cast<size_t>(i) * axis.stride + k] = taps[k] / sum;
+			}
+		}
+
+		return axis;
+	}
+
+	void DecodeRow(const UINT8* source, UINT width, const float* colorTable, const float* alphaTable, float* destination)
+	{
+		for (UINT x = 0; x < width; x++)
+		{
+			const UINT8* texel = source + x * 4;
+			_mm_storeu_ps(destination + x * 4, _mm_set_ps(alphaTable[texel[3]], colorTable[texel[2]], colorTable[texel[1]], colorTable[texel[0]]));
+		}
+	}
+
+	void FilterRow(const float* source, const AxisWeights& axis, UINT width, float* destination)
+	{
+		for (UINT x = 0; x < width; x++)
+		{
+			const float* weights = &axis.weights[static_cast<size_t>(x) * axis.stride];
+			const float* texel = source + axis.first[x] * 4;
+
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < axis.count[x]; k++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(texel + k * 4)));
+			}
+			_mm_storeu_ps(destination + x * 4, sum);
+		}
+	}
+
+	void EncodeRow(const float* source, UINT width, const UINT8* colorTable, const UINT8* alphaTable, UINT8* destination)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 steps = _mm_set1_ps(static_cast<float>(EncodeSteps - 1));
+		const __m128 half = _mm_set1_ps(0.5f);
+
+		alignas(16) int indices[4];
+		for (UINT x = 0; x < width; x++)
+		{
+			// Negative lobes can overshoot, so clamp before quantising to the table index
+			const __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + x * 4), zero), one);
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, steps), half)));
+
+			destination[x * 4 + 0] = colorTable[indices[0]];
+			destination[x * 4 + 1] = colorTable[indices[1]];
+			destination[x * 4 + 2] = colorTable[indices[2]];
+			destination[x * 4 + 3] = alphaTable[indices[3]];
+		}
+	}
+
+	// The common case of a box filter halving both sides reads each 2x2 block straight from the source bytes
+	void DownsampleHalfBox(const UINT8* source, UINT sourceWidth, UINT8* destination, UINT width, UINT height, bool srgb)
+	{
+		const ColorTables& tables = GetColorTables();
+		const float* colorTable = tables.decode[srgb ? 1 : 0];
+		const float* alphaTable = tables.decode[0];
+		const __m128 quarter = _mm_set1_ps(0.25f);
+
+		const UINT rowsPerBand = static_cast<UINT>((std::max)(static_cast<size_t>(1), BandTexels / width));
+		const UINT bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+		Utils::ParallelFor(bandCount, [&](UINT band)
+		{
+			std::vector<float> row(static_cast<size_t>(width) * 4);
+			const UINT lastRow = (std::min)((band + 1) * rowsPerBand, height);
+			for (UINT y = band * rowsPerBand; y < lastRow; y++)
+			{
+				const UINT8* top = source + static_cast<size_t>(y) * 2 * sourceWidth * 4;
+				const UINT8* bottom = top + static_cast<size_t>(sourceWidth) * 4;
+				for (UINT x = 0; x < width; x++)
+				{
+					const UINT8* t = top + x * 8;
+					const UINT8* b = bottom + x * 8;
+					const __m128 sum = _mm_set_ps(
+						alphaTable[t[3]] + alphaTable[t[7]] + alphaTable[b[3]] + alphaTable[b[7]],
+						colorTable[t[2]] + colorTable[t[6]] + colorTable[b[2]] + colorTable[b[6]],
+						colorTable[t[1]] + colorTable[t[5]] + colorTable[b[1]] + colorTable[b[5]],
+						colorTable[t[0]] + colorTable[t[4]] + colorTable[b[0]] + colorTable[b[4]]);
+					_mm_storeu_ps(&row[x * 4], _mm_mul_ps(sum, quarter));
+				}
+
+				EncodeRow(row.data(), width, tables.encode[srgb ? 1 : 0], tables.encode[0], destination + static_cast<size_t>(y) * width * 4);
+			}
+		});
+	}
+
+	// Filters horizontally into a float buffer holding only the source rows a band of destination rows reads, then
+	// vertically by accumulating those rows, so every band works independently
+	void Downsample(const UINT8* source, UINT sourceWidth, UINT sourceHeight, UINT8* destination, UINT width, UINT height, MipFilter filter, bool srgb)
+	{
+		if (filter == MipFilter::Box && sourceWidth == width * 2 && sourceHeight == height * 2)
+		{
+			DownsampleHalfBox(source, sourceWidth, destination, width, height, srgb);
+			return;
+		}
+
+		const AxisWeights horizontal = BuildWeights(sourceWidth, width, filter);
+		const AxisWeights vertical = BuildWeights(sourceHeight, height, filter);
+		const ColorTables& tables = GetColorTables();
+		const int colorIndex = srgb ? 1 : 0;
+
+		const UINT rowsPerBand = static_cast<UINT>((std::max)(static_cast<size_t>(1), BandTexels / width));
+		const UINT bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+		Utils::ParallelFor(bandCount, [&](UINT band)
+		{
+			const UINT firstRow = band * rowsPerBand;
+			const UINT lastRow = (std::min)(firstRow + rowsPerBand, height);
+
+			int sourceBegin = vertical.first[firstRow];
+			int sourceEnd = sourceBegin;
+			for (UINT y = firstRow; y < lastRow; y++)
+			{
+				sourceBegin = (std::min)(sourceBegin, vertical.first[y]);
+				sourceEnd = (std::max)(sourceEnd, vertical.first[y] + vertical.count[y]);
+			}
+
+			std::vector<float> decoded(static_cast<size_t>(sourceWidth) * 4);
+			std::vector<float> filtered(static_cast<size_t>(sourceEnd - sourceBegin) * width * 4);
+			for (int y = sourceBegin; y < sourceEnd; y++)
+			{
+				DecodeRow(source + static_cast<size_t>(y) * sourceWidth * 4, sourceWidth, tables.decode[colorIndex], tables.decode[0], decoded.data());
+				FilterRow(decoded.data(), horizontal, width, &filtered[static_cast<size_t>(y - sourceBegin) * width * 4]);
+			}
+
+			std::vector<float> row(static_cast<size_t>(width) * 4);
+			for (UINT y = firstRow; y < lastRow; y++)
+			{
+				std::fill(row.begin(), row.end(), 0.f);
+				for (int k = 0; k < vertical.count[y]; k++)
+				{
+					const __m128 weight = _mm_set1_ps(vertical.weights[static_cast<size_t>(y) * vertical.stride + k]);
+					const float* input = &filtered[static_cast<size_t>(vertical.first[y] + k - sourceBegin) * width * 4];
+					for (UINT x = 0; x < width * 4; x += 4)
+					{
+						_mm_storeu_ps(&row[x], _mm_add_ps(_mm_loadu_ps(&row[x]), _mm_mul_ps(weight, _mm_loadu_ps(input + x))));
+					}
+				}
+
+				EncodeRow(row.data(), width, tables.encode[colorIndex], tables.encode[0], destination + static_cast<size_t>(y) * width * 4);
+			}
+		});
+	}
+}
+
+namespace MipGenerator
+{
+	UINT GetMipCount(UINT width, UINT height)
+	{
+		UINT count = 1;
+		for (UINT size = (std::max)(width, height); size > 1; size >>= 1) count++;
+		return count;
+	}
+
+	UINT GetMipSize(UINT size, UINT level)
+	{
+		return (std::max)(1u, size >> level);
+	}
+
+	size_t GetMipOffset(UINT width, UINT height, UINT level)
+	{
+		size_t offset = 0;
+		for (UINT i = 0; i < level; i++)
+		{
+			offset += static_cast<size_t>(GetMipSize(width, i)) * GetMipSize(height, i) * 4;
+		}
+		return offset;
+	}
+
+	MipStats Generate(TextureInfo& texture, MipFilter filter, bool srgb)
+	{
+		Utils::Timer timer;
+		MipStats stats;
+
+		if (texture.stride != 4 || texture.width <= 0 || texture.height <= 0)
+		{
+			throw std::runtime_error("Error: mip generation needs an RGBA8 texture");
+		}
+
+		const UINT width = static_cast<UINT>(texture.width);
+		const UINT height = static_cast<UINT>(texture.height);
+		const UINT levelCount = GetMipCount(width, height);
+
+		texture.pixels.resize(GetMipOffset(width, height, levelCount));
+		for (UINT level = 1; level < levelCount; level++)
+		{
+			Downsample(&texture.pixels[GetMipOffset(width, height, level - 1)], GetMipSize(width, level - 1), GetMipSize(height, level - 1),
+				&texture.pixels[GetMipOffset(width, height, level)], GetMipSize(width, level), GetMipSize(height, level), filter, srgb);
+		}
+
+		texture.mipLevels = static_cast<int>(levelCount);
+
+		stats.levelCount = levelCount;
+		stats.bytes = texture.pixels.size();
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
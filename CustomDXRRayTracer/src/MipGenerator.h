@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Structures.h"
+
+struct MipStats
+{
+	UINT levelCount = 0;
+	size_t bytes = 0;
+	float milliseconds = 0.f;
+};
+
+namespace MipGenerator
+{
+	// Number of levels in a full chain, down to 1x1, halving each side and rounding down as D3D does
+	UINT GetMipCount(UINT width, UINT height);
+
+	UINT GetMipSize(UINT size, UINT level);
+
+	// Byte offset of a level within TextureInfo::pixels, where the levels of an RGBA8 chain are packed tightly in order
+	size_t GetMipOffset(UINT width, UINT height, UINT level);
+
+	// Appends the full mip chain of an RGBA8 texture to its pixels. Every level is resampled from the one above with
+	// a separable filter scaled to the exact size ratio, so odd sizes are weighted correctly. With srgb set the colour
+	// channels are filtered in linear space and encoded back to sRGB; alpha is always filtered as stored.
+	MipStats Generate(TextureInfo& texture, MipFilter filter = MipFilter::Box, bool srgb = true);
+}
\ No newline at end of file
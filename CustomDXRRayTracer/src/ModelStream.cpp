@@ -0,0 +1,243 @@
+#include "ModelStream.h"
+#include "AssetArchive.h"
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "PlyLoader.h"
+#include "SceneLoader.h"
+#include "Utils.h"
+
+void ModelStream::Start(const std::string& filepath, std::vector<Material>& materials, UINT64 firstBatchBytes, UINT64 batchBytes)
+{
+	Stop();
+
+	Utils::Timer timer;
+	m_Filepath = filepath;
+	m_Materials.clear();
+	m_Libraries.clear();
+	m_Produced.clear();
+	m_Mesh = ObjMesh();
+	m_Indices.clear();
+	m_Groups.clear();
+	m_Error.clear();
+	m_Stop = false;
+	m_Finished = false;
+
+	// GLB buffers and baked archives are already in render layout, and scenes load each of their files through the
+	// mesh cache, so all of them are loaded at once
+	if (GltfLoader::IsGlb(filepath) || AssetArchive::IsArchive(filepath) || SceneLoader::IsScene(filepath))
+	{
+		std::vector<std::shared_ptr<Model>> models;
+		if (AssetArchive::IsArchive(filepath)) AssetArchive::Load(filepath, models, m_Materials);
+		else if (SceneLoader::IsScene(filepath)) SceneLoader::LoadScene(filepath, models, m_Materials);
+		else GltfLoader::LoadGlb(filepath, models, m_Materials);
+
+		materials = m_Materials;
+		for (const std::shared_ptr<Model>& model : models) Push(model);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Finished = true;
+		return;
+	}
+
+	// Hashing the whole file would hold up the first frame, so only a key remembered for this path, size and modified
+	// time is tried here; the producer computes the full key
+	const UINT64 knownKey = MeshCache::FindKey(filepath);
+
+	std::shared_ptr<Model> cached = std::make_shared<Model>();
+	if (knownKey && MeshCache::Load(knownKey, *cached, m_Materials))
+	{
+		printf("Loaded %s from mesh cache in %.2f ms\n", filepath.c_str(), timer.ElapsedMillis());
+
+		materials = m_Materials;
+		Push(cached);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Finished = true;
+		return;
+	}
+
+	// PLY files carry no materials, so the whole conversion can run in the background from the start
+	if (PlyLoader::IsPly(filepath))
+	{
+		m_Materials.push_back(Material());
+		materials = m_Materials;
+
+		m_Thread = std::thread(&ModelStream::Produce, this, batchBytes);
+		return;
+	}
+
+	if (!m_Reader.Open(filepath))
+	{
+		throw std::runtime_error("Error: failed to open model " + filepath);
+	}
+
+	// Material libraries are resolved from the first batch, so mtllib must appear near the top of the file
+	m_Reader.ReadBatch(m_Mesh, firstBatchBytes);
+	m_Libraries = Utils::GetMaterialLibraryPaths(m_Mesh);
+	Utils::LoadMaterials(m_Mesh, m_Materials);
+	materials = m_Materials;
+
+	AppendBatch();
+	if (!m_Mesh.indices.empty())
+	{
+		std::shared_ptr<Model> batch = std::make_shared<Model>();
+		Utils::BuildModel(m_Mesh, m_Materials, *batch);
+		Push(batch);
+	}
+
+	printf("Streamed first batch of %s in %.2f ms\n", filepath.c_str(), timer.ElapsedMillis());
+
+	m_Thread = std::thread(&ModelStream::Produce, this, batchBytes);
+}
+
+void ModelStream::Produce(UINT64 batchBytes)
+{
+	Utils::Timer timer;
+
+	try
+	{
+		if (PlyLoader::IsPly(m_Filepath))
+		{
+			std::shared_ptr<Model> model = std::make_shared<Model>();
+			PlyLoader::LoadPly(m_Filepath, *model);
+			Push(model);
+		}
+		else
+		{
+			while (!m_Stop)
+			{
+				if (!m_Reader.ReadBatch(m_Mesh, batchBytes)) break;
+				if (m_Mesh.indices.empty()) continue;
+
+				AppendBatch();
+
+				std::shared_ptr<Model> batch = std::make_shared<Model>();
+				Utils::BuildModel(m_Mesh, m_Materials, *batch);
+				Push(batch);
+			}
+		}
+
+		if (!m_Stop) SaveToCache();
+
+		printf("Finished streaming %s in %.2f ms\n", m_Filepath.c_str(), timer.ElapsedMillis());
+	}
+	catch (const std::exception& e)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Error = e.what();
+	}
+
+	m_Mesh = ObjMesh();
+	m_Indices.clear();
+	m_Groups.clear();
+	m_Produced.clear();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Finished = true;
+	m_Ready.notify_all();
+}
+
+void ModelStream::SaveToCache()
+{
+	const UINT64 key = MeshCache::ComputeKey(m_Filepath);
+	if (!key) return;
+
+	// The entry may exist from a run where the file had another path or timestamp
+	Model cached;
+	std::vector<Material> cachedMaterials;
+	if (!MeshCache::Load(key, cached, cachedMaterials))
+	{
+		if (m_Produced.size() == 1)
+		{
+			// A single batch is the whole file, built exactly as LoadModel builds it
+			MeshCache::Save(key, *m_Produced[0], m_Materials, m_Libraries);
+		}
+		else
+		{
+			// Batches are welded, partitioned and simplified on their own, so their concatenation is not the model LoadModel
+			// builds under this key. Build that model from the faces of every batch, which together are what ParseObj reads
+			// from the whole file; group boundaries at batch ends fall between submeshes of one material, which BuildModel
+			// merges. The positions and texcoords are no longer needed by the stream, so they move over.
+			ObjMesh mesh;
+			mesh.positions.swap(m_Mesh.positions);
+			mesh.texcoords.swap(m_Mesh.texcoords);
+			mesh.indices.swap(m_Indices);
+			mesh.groups.swap(m_Groups);
+			mesh.materialLibraries = m_Mesh.materialLibraries;
+
+			std::vector<Material> materials;
+			Utils::LoadMaterials(mesh, materials);
+
+			Model model;
+			Utils::BuildModel(mesh, materials, model);
+			MeshCache::Save(key, model, materials, Utils::GetMaterialLibraryPaths(mesh));
+		}
+	}
+
+	MeshCache::SaveKey(m_Filepath, key);
+}
+
+void ModelStream::AppendBatch()
+{
+	for (ObjGroup group : m_Mesh.groups)
+	{
+		group.indexOffset += m_Indices.size();
+		m_Groups.push_back(group);
+	}
+	m_Indices.insert(m_Indices.end(), m_Mesh.indices.begin(), m_Mesh.indices.end());
+}
+
+void ModelStream::Push(const std::shared_ptr<Model>& batch)
+{
+	m_Produced.push_back(batch);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Batches.push_back(batch);
+	m_Ready.notify_all();
+}
+
+bool ModelStream::Poll(std::vector<std::shared_ptr<Model>>& batches)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (!m_Error.empty())
+	{
+		const std::string error = m_Error;
+		m_Error.clear();
+		throw std::runtime_error(error);
+	}
+
+	batches.assign(m_Batches.begin(), m_Batches.end());
+	m_Batches.clear();
+	return !batches.empty();
+}
+
+bool ModelStream::Wait(std::shared_ptr<Model>& batch)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Ready.wait(lock, [this]() { return !m_Batches.empty() || m_Finished || !m_Error.empty(); });
+
+	if (!m_Error.empty())
+	{
+		const std::string error = m_Error;
+		m_Error.clear();
+		throw std::runtime_error(error);
+	}
+
+	if (m_Batches.empty()) return false;
+
+	batch = m_Batches.front();
+	m_Batches.pop_front();
+	return true;
+}
+
+void ModelStream::Stop()
+{
+	m_Stop = true;
+	if (m_Thread.joinable()) m_Thread.join();
+}
+
+bool ModelStream::IsFinished()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Finished && m_Batches.empty();
+}
\ No newline at end of file
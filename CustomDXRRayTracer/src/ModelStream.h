@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Structures.h"
+#include "ObjParser.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+static const UINT64 FirstBatchBytes = (8 << 20);
+static const UINT64 StreamBatchBytes = (64 << 20);
+
+// Loads a model as a sequence of self-contained batches. The first batch is produced on the
+// calling thread so materials are known up front; the rest arrive from a background thread.
+class ModelStream
+{
+public:
+	ModelStream() {}
+
+	~ModelStream()
+	{
+		Stop();
+	}
+
+	ModelStream(const ModelStream&) = delete;
+	ModelStream& operator=(const ModelStream&) = delete;
+
+	void Start(const std::string& filepath, std::vector<Material>& materials, UINT64 firstBatchBytes = FirstBatchBytes, UINT64 batchBytes = StreamBatchBytes);
+
+	bool Poll(std::vector<std::shared_ptr<Model>>& batches);
+
+	bool Wait(std::shared_ptr<Model>& batch);
+
+	void Stop();
+
+	bool IsFinished();
+
+private:
+	void Produce(UINT64 batchBytes);
+
+	void SaveToCache();
+
+	// Keeps the faces of the batch just read, so the whole model can be built for the mesh cache without reading the
+	// file again
+	void AppendBatch();
+
+	void Push(const std::shared_ptr<Model>& batch);
+
+	std::string m_Filepath;
+	std::vector<Material> m_Materials;
+	std::vector<std::string> m_Libraries;
+
+	ObjParser::ObjReader m_Reader;
+	ObjMesh m_Mesh;
+	std::vector<ObjIndex> m_Indices;
+	std::vector<ObjGroup> m_Groups;
+	std::vector<std::shared_ptr<Model>> m_Produced;
+
+	std::thread m_Thread;
+	std::mutex m_Mutex;
+	std::condition_variable m_Ready;
+	std::deque<std::shared_ptr<Model>> m_Batches;
+	std::atomic<bool> m_Stop{ false };
+	bool m_Finished = true;
+	std::string m_Error;
+};
\ No newline at end of file
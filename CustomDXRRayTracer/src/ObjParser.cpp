@@ -0,0 +1,618 @@
+#include "ObjParser.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const UINT64 MinChunkSize = (1 << 20);
+
+	struct FaceVertex
+	{
+		ObjIndex index;
+		bool relativePosition = false;
+		bool relativeTexcoord = false;
+	};
+
+	struct ChunkGroup
+	{
+		size_t indexOffset = 0;
+		std::string material;
+		bool inheritMaterial = true;
+	};
+
+	struct ObjChunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		std::vector<float> positions;
+		std::vector<float> texcoords;
+		std::vector<ObjIndex> indices;
+		std::vector<size_t> relativePositions;
+		std::vector<size_t> relativeTexcoords;
+		std::vector<ChunkGroup> groups;
+		std::vector<std::string> materialLibraries;
+		std::string error;
+
+		size_t positionOffset = 0;
+		size_t texcoordOffset = 0;
+		size_t indexOffset = 0;
+	};
+
+	inline bool IsSpace(char c)
+	{
+		return (c == ' ' || c == '\t');
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return (c >= '0' && c <= '9');
+	}
+
+	inline bool IsTokenEnd(char c)
+	{
+		return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+	}
+
+	inline void SkipSpace(const char*& p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+	}
+
+	inline const char* FindLineEnd(const char* p, const char* end)
+	{
+		const void* newline = memchr(p, '\n', static_cast<size_t>(end - p));
+		return newline ? static_cast<const char*>(newline) : end;
+	}
+
+	inline bool StartsWithKeyword(const char* p, const char* end, const char* keyword, size_t length)
+	{
+		return (static_cast<size_t>(end - p) > length) && (strncmp(p, keyword, length) == 0) && IsSpace(p[length]);
+	}
+
+	// Mirrors tinyobj's tryParseDouble so the parsed values are bit-identical to the previous loader
+	bool ParseDouble(const char*& p, const char* end, double& result)
+	{
+		static const double powLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+		const int lutEntries = sizeof(powLut) / sizeof(powLut[0]);
+
+		const char* curr = p;
+		bool negative = false;
+		if (curr < end && (*curr == '+' || *curr == '-'))
+		{
+			negative = (*curr == '-');
+			curr++;
+		}
+
+		double mantissa = 0.0;
+		int read = 0;
+		while (curr < end && IsDigit(*curr))
+		{
+			mantissa *= 10;
+			mantissa += static_cast<int>(*curr - '0');
+			curr++;
+			read++;
+		}
+
+		if (curr < end && *curr == '.')
+		{
+			curr++;
+			int digit = 1;
+			while (curr < end && IsDigit(*curr))
+			{
+				mantissa += static_cast<int>(*curr - '0') * (digit < lutEntries ? powLut[digit] : pow(10.0, -digit));
+				curr++;
+				digit++;
+				read++;
+			}
+		}
+
+		if (read == 0) return false;
+
+		int exponent = 0;
+		if (curr < end && (*curr == 'e' || *curr == 'E'))
+		{
+			curr++;
+			bool negativeExponent = false;
+			if (curr < end && (*curr == '+' || *curr == '-'))
+			{
+				negativeExponent = (*curr == '-');
+				curr++;
+			}
+
+			if (curr >= end || !IsDigit(*curr)) return false;
+
+			while (curr < end && IsDigit(*curr))
+			{
+				exponent *= 10;
+				exponent += static_cast<int>(*curr - '0');
+				curr++;
+			}
+
+			if (negativeExponent) exponent = -exponent;
+		}
+
+		result = (negative ? -1.0 : 1.0) * (exponent ? ldexp(mantissa * pow(5.0, exponent), exponent) : mantissa);
+		p = curr;
+		return true;
+	}
+
+	float ParseFloat(const char*& p, const char* end)
+	{
+		SkipSpace(p, end);
+
+		const char* tokenEnd = p;
+		while (tokenEnd < end && !IsTokenEnd(*tokenEnd)) tokenEnd++;
+
+		double value = 0.0;
+		const char* curr = p;
+		ParseDouble(curr, tokenEnd, value);
+
+		p = tokenEnd;
+		return static_cast<float>(value);
+	}
+
+	bool ParseFloat(const char*& p, const char* end, float& result)
+	{
+		SkipSpace(p, end);
+
+		const char* tokenEnd = p;
+		while (tokenEnd < end && !IsTokenEnd(*tokenEnd)) tokenEnd++;
+
+		double value = 0.0;
+		const char* curr = p;
+		if (!ParseDouble(curr, tokenEnd, value) || curr != tokenEnd) return false;
+
+		p = tokenEnd;
+		result = static_cast<float>(value);
+		return true;
+	}
+
+	bool ParseInt(const char*& p, const char* end, int& result)
+	{
+		const char* curr = p;
+		bool negative = false;
+		if (curr < end && (*curr == '+' || *curr == '-'))
+		{
+			negative = (*curr == '-');
+			curr++;
+		}
+
+		if (curr >= end || !IsDigit(*curr)) return false;
+
+		int value = 0;
+		while (curr < end && IsDigit(*curr))
+		{
+			value = value * 10 + static_cast<int>(*curr - '0');
+			curr++;
+		}
+
+		result = negative ? -value : value;
+		p = curr;
+		return true;
+	}
+
+	bool ResolveIndex(int index, size_t localCount, int& result, bool& relative)
+	{
+		if (index > 0)
+		{
+			result = index - 1;
+			relative = false;
+			return true;
+		}
+
+		if (index < 0)
+		{
+			result = static_cast<int>(localCount) + index;
+			relative = true;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool ParseFaceVertex(const char*& p, const char* end, ObjChunk& chunk, FaceVertex& vertex)
+	{
+		int position = 0;
+		if (!ParseInt(p, end, position)) return false;
+		if (!ResolveIndex(position, chunk.positions.size() / 3, vertex.index.position, vertex.relativePosition)) return false;
+
+		if (p < end && *p == '/')
+		{
+			p++;
+
+			int texcoord = 0;
+			if (ParseInt(p, end, texcoord))
+			{
+				if (!ResolveIndex(texcoord, chunk.texcoords.size() / 2, vertex.index.texcoord, vertex.relativeTexcoord)) return false;
+			}
+
+			if (p < end && *p == '/')
+			{
+				p++;
+
+				int normal = 0;
+				ParseInt(p, end, normal);
+			}
+		}
+
+		while (p < end && !IsTokenEnd(*p)) p++;
+		return true;
+	}
+
+	void PushFaceVertex(ObjChunk& chunk, const FaceVertex& vertex)
+	{
+		if (vertex.relativePosition) chunk.relativePositions.push_back(chunk.indices.size());
+		if (vertex.relativeTexcoord) chunk.relativeTexcoords.push_back(chunk.indices.size());
+		chunk.indices.push_back(vertex.index);
+	}
+
+	std::string ParseName(const char* p, const char* end)
+	{
+		SkipSpace(p, end);
+
+		const char* nameEnd = end;
+		while (nameEnd > p && IsTokenEnd(*(nameEnd - 1))) nameEnd--;
+		return std::string(p, nameEnd);
+	}
+
+	void ParseMaterialLibraries(const char* p, const char* end, std::vector<std::string>& libraries)
+	{
+		while (p < end)
+		{
+			SkipSpace(p, end);
+
+			const char* nameEnd = p;
+			while (nameEnd < end && !IsTokenEnd(*nameEnd)) nameEnd++;
+
+			if (nameEnd > p) libraries.push_back(std::string(p, nameEnd));
+			p = nameEnd;
+			while (p < end && (*p == '\r' || *p == '\n')) p++;
+		}
+	}
+
+	void ParseChunk(ObjChunk& chunk)
+	{
+		const size_t estimatedLines = static_cast<size_t>(chunk.end - chunk.begin) / 32;
+		chunk.positions.reserve(estimatedLines);
+		chunk.texcoords.reserve(estimatedLines);
+		chunk.indices.reserve(estimatedLines);
+
+		std::vector<FaceVertex> face;
+		chunk.groups.push_back(ChunkGroup());
+
+		const char* p = chunk.begin;
+		while (p < chunk.end)
+		{
+			const char* lineStart = p;
+			const char* lineEnd = FindLineEnd(p, chunk.end);
+			SkipSpace(p, lineEnd);
+
+			if (StartsWithKeyword(p, lineEnd, "v", 1))
+			{
+				p += 2;
+				chunk.positions.push_back(ParseFloat(p, lineEnd));
+				chunk.positions.push_back(ParseFloat(p, lineEnd));
+				chunk.positions.push_back(ParseFloat(p, lineEnd));
+			}
+			else if (StartsWithKeyword(p, lineEnd, "vt", 2))
+			{
+				p += 3;
+				chunk.texcoords.push_back(ParseFloat(p, lineEnd));
+				chunk.texcoords.push_back(ParseFloat(p, lineEnd));
+			}
+			else if (StartsWithKeyword(p, lineEnd, "f", 1))
+			{
+				p += 2;
+				face.clear();
+
+				SkipSpace(p, lineEnd);
+				while (p < lineEnd && *p != '\r')
+				{
+					FaceVertex vertex;
+					if (!ParseFaceVertex(p, lineEnd, chunk, vertex))
+					{
+						chunk.error = "Error: failed to parse face '" + std::string(lineStart, lineEnd) + "'";
+						return;
+					}
+
+					face.push_back(vertex);
+					SkipSpace(p, lineEnd);
+				}
+
+				for (size_t k = 2; k < face.size(); k++)
+				{
+					PushFaceVertex(chunk, face[0]);
+					PushFaceVertex(chunk, face[k - 1]);
+					PushFaceVertex(chunk, face[k]);
+				}
+			}
+			else if (StartsWithKeyword(p, lineEnd, "usemtl", 6))
+			{
+				ChunkGroup group;
+				group.indexOffset = chunk.indices.size();
+				group.material = ParseName(p + 7, lineEnd);
+				group.inheritMaterial = false;
+				chunk.groups.push_back(group);
+			}
+			else if (StartsWithKeyword(p, lineEnd, "o", 1) || StartsWithKeyword(p, lineEnd, "g", 1))
+			{
+				ChunkGroup group;
+				group.indexOffset = chunk.indices.size();
+				chunk.groups.push_back(group);
+			}
+			else if (StartsWithKeyword(p, lineEnd, "mtllib", 6))
+			{
+				ParseMaterialLibraries(p + 7, lineEnd, chunk.materialLibraries);
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+
+	void MergeChunk(const ObjChunk& chunk, ObjMesh& mesh)
+	{
+		const int positionCount = static_cast<int>(mesh.positions.size() / 3);
+		const int texcoordCount = static_cast<int>(mesh.texcoords.size() / 2);
+		const int positionBase = static_cast<int>(chunk.positionOffset / 3);
+		const int texcoordBase = static_cast<int>(chunk.texcoordOffset / 2);
+
+		if (!chunk.positions.empty()) memcpy(&mesh.positions[chunk.positionOffset], chunk.positions.data(), chunk.positions.size() * sizeof(float));
+		if (!chunk.texcoords.empty()) memcpy(&mesh.texcoords[chunk.texcoordOffset], chunk.texcoords.data(), chunk.texcoords.size() * sizeof(float));
+		if (chunk.indices.empty()) return;
+
+		ObjIndex* indices = &mesh.indices[chunk.indexOffset];
+		memcpy(indices, chunk.indices.data(), chunk.indices.size() * sizeof(ObjIndex));
+
+		for (size_t i : chunk.relativePositions) indices[i].position += positionBase;
+		for (size_t i : chunk.relativeTexcoords) indices[i].texcoord += texcoordBase;
+
+		for (size_t i = 0; i < chunk.indices.size(); i++)
+		{
+			if (indices[i].position < 0 || indices[i].position >= positionCount || indices[i].texcoord < -1 || indices[i].texcoord >= texcoordCount)
+			{
+				throw std::runtime_error("Error: face index out of range");
+			}
+		}
+	}
+
+	bool IsTextureOption(const char* p, const char* end, const char* option)
+	{
+		const size_t length = strlen(option);
+		return (static_cast<size_t>(end - p) >= length) && (strncmp(p, option, length) == 0) && (p + length == end || IsSpace(p[length]));
+	}
+
+	void SkipToken(const char*& p, const char* end)
+	{
+		SkipSpace(p, end);
+		while (p < end && !IsTokenEnd(*p)) p++;
+	}
+
+	bool IsNumberToken(const char* p, const char* end)
+	{
+		SkipSpace(p, end);
+		return (p < end) && (IsDigit(*p) || *p == '-' || *p == '+' || *p == '.');
+	}
+
+	std::string ParseTexturePath(const char* p, const char* end, int& textureResolution)
+	{
+		SkipSpace(p, end);
+		while (p < end && *p == '-')
+		{
+			const char* option = p;
+			SkipToken(p, end);
+
+			if (IsTextureOption(option, p, "-mm"))
+			{
+				SkipToken(p, end);
+				SkipToken(p, end);
+			}
+			else if (IsTextureOption(option, p, "-o") || IsTextureOption(option, p, "-s") || IsTextureOption(option, p, "-t"))
+			{
+				for (int i = 0; i < 3 && IsNumberToken(p, end); i++) SkipToken(p, end);
+			}
+			else if (IsTextureOption(option, p, "-texres"))
+			{
+				SkipSpace(p, end);
+
+				const char* value = p;
+				int resolution = 0;
+				if (ParseInt(value, end, resolution) && resolution > 0) textureResolution = resolution;
+				SkipToken(p, end);
+			}
+			else
+			{
+				SkipToken(p, end);
+			}
+
+			SkipSpace(p, end);
+		}
+
+		const char* pathEnd = end;
+		while (pathEnd > p && IsTokenEnd(*(pathEnd - 1))) pathEnd--;
+		return std::string(p, pathEnd);
+	}
+}
+
+namespace ObjParser
+{
+	bool ObjReader::Open(const std::string& filepath)
+	{
+		m_Offset = 0;
+		m_Material.clear();
+		return m_File.Open(filepath);
+	}
+
+	bool ObjReader::ReadBatch(ObjMesh& mesh, UINT64 batchSize)
+	{
+		mesh.indices.clear();
+		mesh.groups.clear();
+		if (m_Offset >= m_File.Size()) return false;
+
+		const char* data = m_File.Data() + m_Offset;
+		const char* dataEnd = m_File.Data() + m_File.Size();
+
+		// Batches always end on a line boundary, so each one is a self-contained piece of the file
+		const char* batchEnd = dataEnd;
+		if (batchSize < static_cast<UINT64>(dataEnd - data))
+		{
+			batchEnd = FindLineEnd(data + batchSize, dataEnd);
+			if (batchEnd < dataEnd) batchEnd++;
+		}
+
+		const UINT64 size = static_cast<UINT64>(batchEnd - data);
+		m_Offset += size;
+
+		UINT64 chunkCount = (size / MinChunkSize) + 1;
+		chunkCount = (std::min)(chunkCount, static_cast<UINT64>(Utils::GetWorkerCount() * 4));
+
+		std::vector<ObjChunk> chunks(static_cast<size_t>(chunkCount));
+
+		const char* begin = data;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			const char* end = batchEnd;
+			if (i + 1 < chunks.size())
+			{
+				const char* target = data + (size * (i + 1)) / chunkCount;
+				end = FindLineEnd((std::max)(target, begin), batchEnd);
+				if (end < batchEnd) end++;
+			}
+
+			chunks[i].begin = begin;
+			chunks[i].end = end;
+			begin = end;
+		}
+
+		Utils::ParallelFor(static_cast<UINT>(chunks.size()), [&](UINT i)
+		{
+			ParseChunk(chunks[i]);
+		});
+
+		size_t positionCount = mesh.positions.size();
+		size_t texcoordCount = mesh.texcoords.size();
+		size_t indexCount = 0;
+		for (ObjChunk& chunk : chunks)
+		{
+			if (!chunk.error.empty())
+			{
+				throw std::runtime_error(chunk.error);
+			}
+
+			chunk.positionOffset = positionCount;
+			chunk.texcoordOffset = texcoordCount;
+			chunk.indexOffset = indexCount;
+
+			positionCount += chunk.positions.size();
+			texcoordCount += chunk.texcoords.size();
+			indexCount += chunk.indices.size();
+
+			for (const std::string& library : chunk.materialLibraries)
+			{
+				if (std::find(mesh.materialLibraries.begin(), mesh.materialLibraries.end(), library) == mesh.materialLibraries.end())
+				{
+					mesh.materialLibraries.push_back(library);
+				}
+			}
+		}
+
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (const ChunkGroup& chunkGroup : chunk.groups)
+			{
+				if (!chunkGroup.inheritMaterial) m_Material = chunkGroup.material;
+
+				ObjGroup group;
+				group.indexOffset = chunk.indexOffset + chunkGroup.indexOffset;
+				group.material = m_Material;
+
+				if (!mesh.groups.empty() && mesh.groups.back().indexOffset == group.indexOffset)
+				{
+					mesh.groups.back() = group;
+				}
+				else
+				{
+					mesh.groups.push_back(group);
+				}
+			}
+		}
+
+		if (!mesh.groups.empty() && mesh.groups.back().indexOffset == indexCount) mesh.groups.pop_back();
+
+		mesh.positions.resize(positionCount);
+		mesh.texcoords.resize(texcoordCount);
+		mesh.indices.resize(indexCount);
+
+		std::vector<std::string> errors(chunks.size());
+		Utils::ParallelFor(static_cast<UINT>(chunks.size()), [&](UINT i)
+		{
+			try
+			{
+				MergeChunk(chunks[i], mesh);
+			}
+			catch (const std::exception& e)
+			{
+				errors[i] = e.what();
+			}
+		});
+
+		for (const std::string& error : errors)
+		{
+			if (!error.empty()) throw std::runtime_error(error);
+		}
+
+		return true;
+	}
+
+	void ParseObj(const std::string& filepath, ObjMesh& mesh)
+	{
+		ObjReader reader;
+		if (!reader.Open(filepath))
+		{
+			throw std::runtime_error("Error: failed to open model " + filepath);
+		}
+
+		reader.ReadBatch(mesh, reader.Size());
+	}
+
+	bool ParseMtl(const std::string& filepath, std::vector<Material>& materials)
+	{
+		Utils::MappedFile file;
+		if (!file.Open(filepath)) return false;
+
+		const char* p = file.Data();
+		const char* end = p + file.Size();
+		while (p < end)
+		{
+			const char* lineEnd = FindLineEnd(p, end);
+			SkipSpace(p, lineEnd);
+
+			if (StartsWithKeyword(p, lineEnd, "newmtl", 6))
+			{
+				Material material;
+				material.name = ParseName(p + 7, lineEnd);
+				materials.push_back(material);
+			}
+			else if (StartsWithKeyword(p, lineEnd, "map_Kd", 6) && !materials.empty())
+			{
+				materials.back().texturePath = ParseTexturePath(p + 7, lineEnd, materials.back().textureResolution);
+			}
+
+			p = lineEnd + 1;
+		}
+
+		return true;
+	}
+
+	float ParseFloat(const char*& p, const char* end)
+	{
+		return ::ParseFloat(p, end);
+	}
+
+	bool ParseFloat(const char*& p, const char* end, float& value)
+	{
+		return ::ParseFloat(p, end, value);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Structures.h"
+#include "Utils.h"
+
+struct ObjIndex
+{
+	int position = -1;
+	int texcoord = -1;
+};
+
+struct ObjGroup
+{
+	size_t indexOffset = 0;
+	std::string material;
+};
+
+struct ObjMesh
+{
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<ObjIndex> indices;
+	std::vector<ObjGroup> groups;
+	std::vector<std::string> materialLibraries;
+};
+
+namespace ObjParser
+{
+	// Parses an OBJ file in line-aligned batches. Positions and texcoords accumulate across batches
+	// so later faces can reference them; indices and groups only hold the most recent batch.
+	class ObjReader
+	{
+	public:
+		bool Open(const std::string& filepath);
+
+		bool ReadBatch(ObjMesh& mesh, UINT64 batchSize);
+
+		UINT64 Offset() const { return m_Offset; }
+		UINT64 Size() const { return m_File.Size(); }
+
+	private:
+		Utils::MappedFile m_File;
+		UINT64 m_Offset = 0;
+		std::string m_Material;
+	};
+
+	void ParseObj(const std::string& filepath, ObjMesh& mesh);
+
+	bool ParseMtl(const std::string& filepath, std::vector<Material>& materials);
+
+	// Parses the next whitespace-separated token as a float without going through the C runtime locale
+	float ParseFloat(const char*& p, const char* end);
+
+	// As above, but fails unless the whole token is a number, where OBJ lines read whatever prefix of it is one
+	bool ParseFloat(const char*& p, const char* end, float& value);
+}
\ No newline at end of file
@@ -0,0 +1,620 @@
+#include "PlyLoader.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <emmintrin.h>
+#include <sstream>
+
+namespace
+{
+	const size_t MaxHeaderSize = (1 << 16);
+	const UINT TaskShift = 16;
+	const size_t VerticesPerBlock = 1024;
+
+	enum PlyType
+	{
+		PlyInvalid,
+		PlyInt8,
+		PlyUInt8,
+		PlyInt16,
+		PlyUInt16,
+		PlyInt32,
+		PlyUInt32,
+		PlyFloat32,
+		PlyFloat64
+	};
+
+	struct PlyProperty
+	{
+		std::string name;
+		PlyType type = PlyInvalid;
+		PlyType countType = PlyInvalid;
+		size_t offset = 0;
+
+		bool IsList() const
+		{
+			return countType != PlyInvalid;
+		}
+	};
+
+	struct PlyElement
+	{
+		std::string name;
+		UINT64 count = 0;
+		std::vector<PlyProperty> properties;
+
+		// Byte size of one record, or 0 when a list property makes records variable sized
+		size_t stride = 0;
+
+		const PlyProperty* Find(const char* name) const
+		{
+			for (const PlyProperty& property : properties)
+			{
+				if (property.name == name) return &property;
+			}
+			return nullptr;
+		}
+	};
+
+	PlyType ParseType(const std::string& name)
+	{
+		if (name == "char" || name == "int8") return PlyInt8;
+		if (name == "uchar" || name == "uint8") return PlyUInt8;
+		if (name == "short" || name == "int16") return PlyInt16;
+		if (name == "ushort" || name == "uint16") return PlyUInt16;
+		if (name == "int" || name == "int32") return PlyInt32;
+		if (name == "uint" || name == "uint32") return PlyUInt32;
+		if (name == "float" || name == "float32") return PlyFloat32;
+		if (name == "double" || name == "float64") return PlyFloat64;
+		return PlyInvalid;
+	}
+
+	size_t GetTypeSize(PlyType type)
+	{
+		switch (type)
+		{
+		case PlyInt8:
+		case PlyUInt8: return 1;
+		case PlyInt16:
+		case PlyUInt16: return 2;
+		case PlyInt32:
+		case PlyUInt32:
+		case PlyFloat32: return 4;
+		case PlyFloat64: return 8;
+		default: return 0;
+		}
+	}
+
+	double ReadScalar(const UINT8* p, PlyType type)
+	{
+		switch (type)
+		{
+		case PlyInt8: return static_cast<INT8>(*p);
+		case PlyUInt8: return *p;
+		case PlyInt16: { INT16 v; memcpy(&v, p, 2); return v; }
+		case PlyUInt16: { UINT16 v; memcpy(&v, p, 2); return v; }
+		case PlyInt32: { INT32 v; memcpy(&v, p, 4); return v; }
+		case PlyUInt32: { UINT32 v; memcpy(&v, p, 4); return v; }
+		case PlyFloat32: { float v; memcpy(&v, p, 4); return v; }
+		case PlyFloat64: { double v; memcpy(&v, p, 8); return v; }
+		default: return 0.0;
+		}
+	}
+
+	// Returns UINT64_MAX for negative or non-integer indices so the range check rejects them
+	UINT64 ReadIndex(const UINT8* p, PlyType type)
+	{
+		switch (type)
+		{
+		case PlyUInt32: { UINT32 v; memcpy(&v, p, 4); return v; }
+		case PlyInt32: { INT32 v; memcpy(&v, p, 4); return (v < 0) ? UINT64_MAX : static_cast<UINT64>(v); }
+		case PlyUInt16: { UINT16 v; memcpy(&v, p, 2); return v; }
+		case PlyInt16: { INT16 v; memcpy(&v, p, 2); return (v < 0) ? UINT64_MAX : static_cast<UINT64>(v); }
+		case PlyUInt8: return *p;
+		case PlyInt8: return (static_cast<INT8>(*p) < 0) ? UINT64_MAX : *p;
+		default: return UINT64_MAX;
+		}
+	}
+
+	template<typename T>
+	inline T Load(const UINT8* p)
+	{
+		T value;
+		memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	// Four consecutive records' values of one property as floats
+	template<typename T>
+	inline __m128 LoadFour(const UINT8* record, size_t stride)
+	{
+		return _mm_cvtepi32_ps(_mm_setr_epi32(Load<T>(record), Load<T>(record + stride), Load<T>(record + 2 * stride), Load<T>(record + 3 * stride)));
+	}
+
+	template<>
+	inline __m128 LoadFour<UINT32>(const UINT8* record, size_t stride)
+	{
+		// SSE2 has no unsigned conversion; the 16-bit halves convert exactly and recombine with one rounding
+		const __m128i bits = _mm_setr_epi32(Load<INT32>(record), Load<INT32>(record + stride), Load<INT32>(record + 2 * stride), Load<INT32>(record + 3 * stride));
+		const __m128 high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(bits, 16)), _mm_set1_ps(65536.f));
+		const __m128 low = _mm_cvtepi32_ps(_mm_and_si128(bits, _mm_set1_epi32(0xFFFF)));
+		return _mm_add_ps(high, low);
+	}
+
+	template<>
+	inline __m128 LoadFour<float>(const UINT8* record, size_t stride)
+	{
+		return _mm_setr_ps(Load<float>(record), Load<float>(record + stride), Load<float>(record + 2 * stride), Load<float>(record + 3 * stride));
+	}
+
+	template<>
+	inline __m128 LoadFour<double>(const UINT8* record, size_t stride)
+	{
+		const __m128 low = _mm_cvtpd_ps(_mm_setr_pd(Load<double>(record), Load<double>(record + stride)));
+		const __m128 high = _mm_cvtpd_ps(_mm_setr_pd(Load<double>(record + 2 * stride), Load<double>(record + 3 * stride)));
+		return _mm_movelh_ps(low, high);
+	}
+
+	// Converts one property of count records, a multiple of four, to floats value * scale + bias. Resolving the type
+	// once per column keeps the switch out of the per-vertex loop.
+	template<typename T>
+	void ConvertColumn(const UINT8* record, size_t stride, size_t count, float scale, float bias, float* destination)
+	{
+		const __m128 scales = _mm_set1_ps(scale);
+		const __m128 biases = _mm_set1_ps(bias);
+		for (size_t i = 0; i < count; i += 4, record += 4 * stride)
+		{
+			_mm_storeu_ps(destination + i, _mm_add_ps(_mm_mul_ps(LoadFour<T>(record, stride), scales), biases));
+		}
+	}
+
+	void ConvertColumn(const PlyProperty* property, const UINT8* records, size_t stride, size_t count, float scale, float bias, float* destination)
+	{
+		if (!property)
+		{
+			std::fill(destination, destination + count, bias);
+			return;
+		}
+
+		const UINT8* record = records + property->offset;
+		switch (property->type)
+		{
+		case PlyInt8: ConvertColumn<INT8>(record, stride, count, scale, bias, destination); break;
+		case PlyUInt8: ConvertColumn<UINT8>(record, stride, count, scale, bias, destination); break;
+		case PlyInt16: ConvertColumn<INT16>(record, stride, count, scale, bias, destination); break;
+		case PlyUInt16: ConvertColumn<UINT16>(record, stride, count, scale, bias, destination); break;
+		case PlyInt32: ConvertColumn<INT32>(record, stride, count, scale, bias, destination); break;
+		case PlyUInt32: ConvertColumn<UINT32>(record, stride, count, scale, bias, destination); break;
+		case PlyFloat32: ConvertColumn<float>(record, stride, count, scale, bias, destination); break;
+		case PlyFloat64: ConvertColumn<double>(record, stride, count, scale, bias, destination); break;
+		default: break;
+		}
+	}
+
+	// Interleaves converted columns into vertices, four at a time: a transpose gives each vertex's position and u in
+	// one register, and v follows it
+	void InterleaveColumns(const float (&columns)[5][VerticesPerBlock], size_t count, Vertex* vertices)
+	{
+		float* destination = &vertices->position.x;
+		for (size_t i = 0; i < count; i += 4, destination += 20)
+		{
+			__m128 row0 = _mm_loadu_ps(columns[0] + i);
+			__m128 row1 = _mm_loadu_ps(columns[1] + i);
+			__m128 row2 = _mm_loadu_ps(columns[2] + i);
+			__m128 row3 = _mm_loadu_ps(columns[3] + i);
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+			_mm_storeu_ps(destination + 0, row0);
+			destination[4] = columns[4][i + 0];
+			_mm_storeu_ps(destination + 5, row1);
+			destination[9] = columns[4][i + 1];
+			_mm_storeu_ps(destination + 10, row2);
+			destination[14] = columns[4][i + 2];
+			_mm_storeu_ps(destination + 15, row3);
+			destination[19] = columns[4][i + 3];
+		}
+	}
+
+	// Reads count triangle records with a fixed layout, returning false at the first record that is not a triangle.
+	// Indices are checked against vertexCount as unsigned values, so negative signed ones fail too.
+	template<typename CountType, typename IndexType>
+	bool ReadTriangles(const UINT8* record, size_t stride, size_t count, size_t vertexCount, uint32_t* out, bool& outOfRange)
+	{
+		UINT64 largest = 0;
+		for (size_t i = 0; i < count; i++, record += stride, out += 3)
+		{
+			CountType cornerCount;
+			memcpy(&cornerCount, record, sizeof(CountType));
+			if (cornerCount != 3) return false;
+
+			IndexType indices[3];
+			memcpy(indices, record + sizeof(CountType), sizeof(indices));
+			for (int k = 0; k < 3; k++)
+			{
+				const UINT64 index = static_cast<UINT64>(static_cast<INT64>(indices[k]));
+				largest = (std::max)(largest, index);
+				out[k] = static_cast<uint32_t>(indices[k]);
+			}
+		}
+
+		if (largest >= vertexCount) outOfRange = true;
+		return true;
+	}
+
+	const char* ParseHeader(const char* data, UINT64 size, std::vector<PlyElement>& elements)
+	{
+		const char* end = data + (std::min)(size, static_cast<UINT64>(MaxHeaderSize));
+		const char* p = data;
+		bool binaryLittleEndian = false;
+
+		for (bool first = true; ; first = false)
+		{
+			const char* lineEnd = std::find(p, end, '\n');
+			if (lineEnd == end) throw std::runtime_error("Error: PLY header is missing end_header");
+
+			std::istringstream line(std::string(p, lineEnd));
+			p = lineEnd + 1;
+
+			std::string keyword;
+			line >> keyword;
+
+			if (first)
+			{
+				if (keyword != "ply") throw std::runtime_error("Error: not a PLY file");
+				continue;
+			}
+
+			if (keyword == "end_header") break;
+
+			if (keyword == "format")
+			{
+				std::string format;
+				line >> format;
+				binaryLittleEndian = (format == "binary_little_endian");
+			}
+			else if (keyword == "element")
+			{
+				PlyElement element;
+				line >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property")
+			{
+				if (elements.empty()) throw std::runtime_error("Error: PLY property outside an element");
+
+				PlyProperty property;
+				std::string type;
+				line >> type;
+				if (type == "list")
+				{
+					std::string countType;
+					line >> countType >> type;
+					property.countType = ParseType(countType);
+					if (property.countType == PlyInvalid || property.countType == PlyFloat32 || property.countType == PlyFloat64)
+					{
+						throw std::runtime_error("Error: unsupported PLY list count type " + countType);
+					}
+				}
+				property.type = ParseType(type);
+				line >> property.name;
+				if (property.type == PlyInvalid) throw std::runtime_error("Error: unsupported PLY property type " + type);
+
+				elements.back().properties.push_back(property);
+			}
+		}
+
+		if (!binaryLittleEndian) throw std::runtime_error("Error: only binary_little_endian PLY files are supported");
+
+		for (PlyElement& element : elements)
+		{
+			size_t offset = 0;
+			for (PlyProperty& property : element.properties)
+			{
+				property.offset = offset;
+				if (property.IsList())
+				{
+					offset = 0;
+					break;
+				}
+				offset += GetTypeSize(property.type);
+			}
+			element.stride = offset;
+		}
+
+		return p;
+	}
+
+	// Walks one record of a variable sized element, returning nullptr if it runs past the end of the file
+	const UINT8* SkipRecord(const PlyElement& element, const UINT8* p, const UINT8* end)
+	{
+		for (const PlyProperty& property : element.properties)
+		{
+			if (property.IsList())
+			{
+				if (static_cast<size_t>(end - p) < GetTypeSize(property.countType)) return nullptr;
+				const UINT64 count = ReadIndex(p, property.countType);
+				p += GetTypeSize(property.countType);
+				if (count == UINT64_MAX || count > static_cast<UINT64>(end - p) / GetTypeSize(property.type)) return nullptr;
+				p += count * GetTypeSize(property.type);
+			}
+			else
+			{
+				if (static_cast<size_t>(end - p) < GetTypeSize(property.type)) return nullptr;
+				p += GetTypeSize(property.type);
+			}
+		}
+		return p;
+	}
+
+	const UINT8* SkipElement(const PlyElement& element, const UINT8* p, const UINT8* end)
+	{
+		if (element.stride)
+		{
+			if (element.count > static_cast<UINT64>(end - p) / element.stride) throw std::runtime_error("Error: truncated PLY element " + element.name);
+			return p + element.count * element.stride;
+		}
+
+		for (UINT64 i = 0; i < element.count; i++)
+		{
+			p = SkipRecord(element, p, end);
+			if (!p) throw std::runtime_error("Error: truncated PLY element " + element.name);
+		}
+		return p;
+	}
+
+	const PlyProperty* FindAny(const PlyElement& element, std::initializer_list<const char*> names)
+	{
+		for (const char* name : names)
+		{
+			const PlyProperty* property = element.Find(name);
+			if (property && !property->IsList()) return property;
+		}
+		return nullptr;
+	}
+
+	const UINT8* ReadVertices(const PlyElement& element, const UINT8* data, const UINT8* end, std::vector<Vertex>& vertices)
+	{
+		if (!element.stride) throw std::runtime_error("Error: PLY vertex element has list properties");
+
+		const PlyProperty* x = FindAny(element, { "x" });
+		const PlyProperty* y = FindAny(element, { "y" });
+		const PlyProperty* z = FindAny(element, { "z" });
+		const PlyProperty* u = FindAny(element, { "u", "s", "texture_u", "texture_s" });
+		const PlyProperty* v = FindAny(element, { "v", "t", "texture_v", "texture_t" });
+		if (!x || !y || !z) throw std::runtime_error("Error: PLY vertex element has no position");
+		if (!u || !v) u = v = nullptr;
+
+		const UINT8* elementEnd = SkipElement(element, data, end);
+
+		// Float properties are copied record by record. Any other type is converted a block at a time with SSE2, one
+		// property after the other into columns that stay in cache, which are then interleaved into vertices. Axes are
+		// swapped and the texcoord flipped as in the OBJ path.
+		const bool floatOnly = x->type == PlyFloat32 && y->type == PlyFloat32 && z->type == PlyFloat32 && (!u || (u->type == PlyFloat32 && v->type == PlyFloat32));
+
+		vertices.resize(static_cast<size_t>(element.count));
+		const size_t vectorCount = floatOnly ? 0 : (vertices.size() & ~static_cast<size_t>(3));
+		const UINT taskCount = static_cast<UINT>((vertices.size() + (1ull << TaskShift) - 1) >> TaskShift);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = static_cast<size_t>(task) << TaskShift;
+			const size_t last = (std::min)(begin + (static_cast<size_t>(1) << TaskShift), vertices.size());
+			const size_t vectorLast = (std::min)(last, vectorCount);
+
+			float columns[5][VerticesPerBlock];
+			for (size_t block = begin; block < vectorLast; block += VerticesPerBlock)
+			{
+				const size_t count = (std::min)(VerticesPerBlock, vectorLast - block);
+				const UINT8* records = data + block * element.stride;
+
+				ConvertColumn(z, records, element.stride, count, 1.f, 0.f, columns[0]);
+				ConvertColumn(y, records, element.stride, count, 1.f, 0.f, columns[1]);
+				ConvertColumn(x, records, element.stride, count, 1.f, 0.f, columns[2]);
+				ConvertColumn(u, records, element.stride, count, 1.f, 0.f, columns[3]);
+				ConvertColumn(v, records, element.stride, count, -1.f, 1.f, columns[4]);
+				InterleaveColumns(columns, count, vertices.data() + block);
+			}
+
+			// Float records, and the last few records that do not fill a group of four
+			const UINT8* record = data + (std::max)(begin, vectorLast) * element.stride;
+			for (size_t i = (std::max)(begin, vectorLast); i < last; i++, record += element.stride)
+			{
+				Vertex& vertex = vertices[i];
+				if (floatOnly)
+				{
+					vertex.position.x = Load<float>(record + z->offset);
+					vertex.position.y = Load<float>(record + y->offset);
+					vertex.position.z = Load<float>(record + x->offset);
+					vertex.uv.x = u ? Load<float>(record + u->offset) : 0.f;
+					vertex.uv.y = 1 - (v ? Load<float>(record + v->offset) : 0.f);
+				}
+				else
+				{
+					vertex.position.x = static_cast<float>(ReadScalar(record + z->offset, z->type));
+					vertex.position.y = static_cast<float>(ReadScalar(record + y->offset, y->type));
+					vertex.position.z = static_cast<float>(ReadScalar(record + x->offset, x->type));
+					vertex.uv.x = u ? static_cast<float>(ReadScalar(record + u->offset, u->type)) : 0.f;
+					vertex.uv.y = 1 - (v ? static_cast<float>(ReadScalar(record + v->offset, v->type)) : 0.f);
+				}
+			}
+		});
+
+		return elementEnd;
+	}
+
+	const UINT8* ReadFaces(const PlyElement& element, const UINT8* data, const UINT8* end, size_t vertexCount, std::vector<uint32_t>& indices)
+	{
+		const PlyProperty* list = nullptr;
+		for (const PlyProperty& property : element.properties)
+		{
+			if (property.IsList() && (property.name == "vertex_indices" || property.name == "vertex_index")) list = &property;
+		}
+		if (!list || list->type == PlyFloat32 || list->type == PlyFloat64) throw std::runtime_error("Error: PLY face element has no vertex index list");
+
+		const size_t countSize = GetTypeSize(list->countType);
+		const size_t indexSize = GetTypeSize(list->type);
+
+		size_t before = 0;
+		size_t after = 0;
+		bool fixedOthers = true;
+		bool afterList = false;
+		for (const PlyProperty& property : element.properties)
+		{
+			if (&property == list) { afterList = true; continue; }
+			if (property.IsList()) fixedOthers = false;
+			(afterList ? after : before) += GetTypeSize(property.type);
+		}
+
+		// Fast path: assume every face is a triangle, which fixes the record size and lets the
+		// element be converted in parallel. Any record that is not a triangle falls back to a serial walk.
+		const size_t triangleStride = before + countSize + 3 * indexSize + after;
+		if (fixedOthers && element.count <= static_cast<UINT64>(end - data) / triangleStride)
+		{
+			std::atomic<bool> allTriangles(true);
+			std::atomic<bool> outOfRange(false);
+			indices.resize(static_cast<size_t>(element.count) * 3);
+
+			const UINT taskCount = static_cast<UINT>((element.count + (1ull << TaskShift) - 1) >> TaskShift);
+			Utils::ParallelFor(taskCount, [&](UINT task)
+			{
+				const size_t begin = static_cast<size_t>(task) << TaskShift;
+				const size_t last = (std::min)(begin + (static_cast<size_t>(1) << TaskShift), static_cast<size_t>(element.count));
+				const UINT8* record = data + begin * triangleStride + before;
+				uint32_t* out = indices.data() + begin * 3;
+				bool taskOutOfRange = false;
+
+				// Byte counts with 32-bit indices are what nearly every writer produces
+				bool triangles = true;
+				if (list->countType == PlyUInt8 && list->type == PlyInt32) triangles = ReadTriangles<UINT8, INT32>(record, triangleStride, last - begin, vertexCount, out, taskOutOfRange);
+				else if (list->countType == PlyUInt8 && list->type == PlyUInt32) triangles = ReadTriangles<UINT8, UINT32>(record, triangleStride, last - begin, vertexCount, out, taskOutOfRange);
+				else
+				{
+					for (size_t i = begin; i < last && triangles; i++, record += triangleStride)
+					{
+						triangles = (ReadIndex(record, list->countType) == 3);
+
+						const UINT8* p = record + countSize;
+						for (int k = 0; k < 3 && triangles; k++, p += indexSize)
+						{
+							const UINT64 index = ReadIndex(p, list->type);
+							if (index >= vertexCount) taskOutOfRange = true;
+							*out++ = static_cast<uint32_t>(index);
+						}
+					}
+				}
+
+				if (!triangles) allTriangles = false;
+				if (taskOutOfRange) outOfRange = true;
+			});
+
+			// Index checks are only meaningful once the triangle layout has been confirmed
+			if (allTriangles)
+			{
+				if (outOfRange) throw std::runtime_error("Error: PLY face index out of range");
+				return data + element.count * triangleStride;
+			}
+		}
+
+		indices.clear();
+		const UINT8* p = data;
+		for (UINT64 i = 0; i < element.count; i++)
+		{
+			const UINT8* record = p;
+			p = SkipRecord(element, p, end);
+			if (!p) throw std::runtime_error("Error: truncated PLY element " + element.name);
+
+			// Locate the index list inside this record; properties before it may themselves be lists
+			const UINT8* q = record;
+			for (const PlyProperty& property : element.properties)
+			{
+				if (&property == list) break;
+				if (property.IsList()) q += GetTypeSize(property.countType) + ReadIndex(q, property.countType) * GetTypeSize(property.type);
+				else q += GetTypeSize(property.type);
+			}
+
+			const UINT64 count = ReadIndex(q, list->countType);
+			q += countSize;
+			for (UINT64 k = 2; k < count; k++)
+			{
+				const UINT64 a = ReadIndex(q, list->type);
+				const UINT64 b = ReadIndex(q + (k - 1) * indexSize, list->type);
+				const UINT64 c = ReadIndex(q + k * indexSize, list->type);
+				if (a >= vertexCount || b >= vertexCount || c >= vertexCount) throw std::runtime_error("Error: PLY face index out of range");
+
+				indices.push_back(static_cast<uint32_t>(a));
+				indices.push_back(static_cast<uint32_t>(b));
+				indices.push_back(static_cast<uint32_t>(c));
+			}
+		}
+		return p;
+	}
+}
+
+namespace PlyLoader
+{
+	bool IsPly(const std::string& filepath)
+	{
+		if (filepath.size() < 4) return false;
+
+		std::string extension = filepath.substr(filepath.size() - 4);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+		return extension == ".ply";
+	}
+
+	PlyStats ReadPly(const std::string& filepath, Model& model)
+	{
+		Utils::Timer timer;
+
+		Utils::MappedFile file;
+		if (!file.Open(filepath))
+		{
+			throw std::runtime_error("Error: failed to open model " + filepath);
+		}
+
+		std::vector<PlyElement> elements;
+		const UINT8* p = reinterpret_cast<const UINT8*>(ParseHeader(file.Data(), file.Size(), elements));
+		const UINT8* end = reinterpret_cast<const UINT8*>(file.Data()) + file.Size();
+
+		model = Model();
+		bool hasVertices = false;
+		for (const PlyElement& element : elements)
+		{
+			if (element.name == "vertex" && !hasVertices)
+			{
+				p = ReadVertices(element, p, end, model.vertices);
+				hasVertices = true;
+			}
+			else if (element.name == "face" && hasVertices && model.indices.empty())
+			{
+				p = ReadFaces(element, p, end, model.vertices.size(), model.indices);
+			}
+			else
+			{
+				p = SkipElement(element, p, end);
+			}
+		}
+
+		PlyStats stats;
+		stats.vertexCount = model.vertices.size();
+		stats.triangleCount = model.indices.size() / 3;
+		stats.bytes = file.Size();
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+
+	void LoadPly(const std::string& filepath, Model& model)
+	{
+		const PlyStats stats = ReadPly(filepath, model);
+		printf("Converted %zu vertices and %zu triangles from %s in %.2f ms (%.0f MB/s)\n", stats.vertexCount, stats.triangleCount, filepath.c_str(), stats.milliseconds, stats.bytes / (1024.0 * 1024.0) / (std::max)(stats.milliseconds * 0.001, 1e-6));
+
+		if (!model.indices.empty())
+		{
+			Submesh submesh;
+			submesh.indexCount = static_cast<uint32_t>(model.indices.size());
+			model.submeshes.push_back(submesh);
+		}
+
+		Utils::FinalizeModel(model);
+	}
+}
\ No newline at end of file
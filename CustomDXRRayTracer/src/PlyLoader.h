@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Structures.h"
+
+struct PlyStats
+{
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	UINT64 bytes = 0;
+	float milliseconds = 0.f;
+};
+
+namespace PlyLoader
+{
+	bool IsPly(const std::string& filepath);
+
+	// Converts the vertices and faces of a PLY without cleaning, partitioning or simplifying them
+	PlyStats ReadPly(const std::string& filepath, Model& model);
+
+	// Loads a binary little-endian PLY into the same vertex and index layout as the OBJ path.
+	// Polygons are fan-triangulated; the file carries no materials, so every face uses material 0.
+	void LoadPly(const std::string& filepath, Model& model);
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+
+// Stand-ins for the Windows, DXGI and DirectXMath names the asset pipeline uses, so that it builds off Windows for the
+// bake tool and the tests. The renderer itself only builds on Windows.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+typedef int BOOL;
+typedef int INT;
+typedef int8_t INT8;
+typedef int16_t INT16;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef unsigned int UINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef long HRESULT;
+
+#ifndef NULL
+#define NULL 0
+#endif
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+	DXGI_FORMAT_R9G9B9E5_SHAREDEXP = 67,
+	DXGI_FORMAT_BC1_UNORM = 71,
+	DXGI_FORMAT_BC7_UNORM = 98
+};
+
+#define D3D12_TEXTURE_DATA_PITCH_ALIGNMENT 256
+#define D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT 512
+#define D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES 65536
+#define D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION 16384
+
+namespace DirectX
+{
+	const float XM_PI = 3.141592654f;
+
+	struct XMFLOAT2
+	{
+		float x, y;
+
+		XMFLOAT2() = default;
+		constexpr XMFLOAT2(float _x, float _y) : x(_x), y(_y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+
+		XMFLOAT3() = default;
+		constexpr XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+
+		XMFLOAT4() = default;
+		constexpr XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+
+	struct XMUINT4
+	{
+		uint32_t x, y, z, w;
+
+		XMUINT4() = default;
+		constexpr XMUINT4(uint32_t _x, uint32_t _y, uint32_t _z, uint32_t _w) : x(_x), y(_y), z(_z), w(_w) {}
+	};
+
+	struct XMFLOAT3X4
+	{
+		float m[3][4];
+
+		XMFLOAT3X4() = default;
+		XMFLOAT3X4(float m00, float m01, float m02, float m03, float m10, float m11, float m12, float m13, float m20, float m21, float m22, float m23)
+		{
+			m[0][0] = m00; m[0][1] = m01; m[0][2] = m02; m[0][3] = m03;
+			m[1][0] = m10; m[1][1] = m11; m[1][2] = m12; m[1][3] = m13;
+			m[2][0] = m20; m[2][1] = m21; m[2][2] = m22; m[2][3] = m23;
+		}
+	};
+
+	struct XMVECTOR
+	{
+		float v[4];
+	};
+
+	typedef const XMVECTOR FXMVECTOR;
+
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+	{
+		return XMVECTOR{ { x, y, z, w } };
+	}
+
+	inline XMVECTOR XMVectorReplicate(float value)
+	{
+		return XMVectorSet(value, value, value, value);
+	}
+
+	inline XMVECTOR XMVectorZero()
+	{
+		return XMVectorReplicate(0.f);
+	}
+
+	inline XMVECTOR XMLoadFloat2(const XMFLOAT2* source)
+	{
+		return XMVectorSet(source->x, source->y, 0.f, 0.f);
+	}
+
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* source)
+	{
+		return XMVectorSet(source->x, source->y, source->z, 0.f);
+	}
+
+	inline void XMStoreFloat3(XMFLOAT3* destination, XMVECTOR v)
+	{
+		*destination = XMFLOAT3(v.v[0], v.v[1], v.v[2]);
+	}
+
+	inline void XMStoreFloat4(XMFLOAT4* destination, XMVECTOR v)
+	{
+		*destination = XMFLOAT4(v.v[0], v.v[1], v.v[2], v.v[3]);
+	}
+
+	inline float XMVectorGetX(XMVECTOR v)
+	{
+		return v.v[0];
+	}
+
+	inline XMVECTOR XMVectorAdd(XMVECTOR a, XMVECTOR b)
+	{
+		return XMVectorSet(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]);
+	}
+
+	inline XMVECTOR XMVectorSubtract(XMVECTOR a, XMVECTOR b)
+	{
+		return XMVectorSet(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]);
+	}
+
+	inline XMVECTOR XMVectorScale(XMVECTOR v, float scale)
+	{
+		return XMVectorSet(v.v[0] * scale, v.v[1] * scale, v.v[2] * scale, v.v[3] * scale);
+	}
+
+	inline XMVECTOR XMVector3Dot(XMVECTOR a, XMVECTOR b)
+	{
+		return XMVectorReplicate(a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]);
+	}
+
+	inline XMVECTOR XMVector3LengthSq(XMVECTOR v)
+	{
+		return XMVector3Dot(v, v);
+	}
+
+	inline XMVECTOR XMVector3Cross(XMVECTOR a, XMVECTOR b)
+	{
+		return XMVectorSet(a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0], 0.f);
+	}
+
+	inline XMVECTOR XMVector3Normalize(XMVECTOR v)
+	{
+		const float length = sqrtf(XMVectorGetX(XMVector3LengthSq(v)));
+		return (length > 0.f) ? XMVectorScale(v, 1.f / length) : XMVectorZero();
+	}
+
+	inline bool XMVector2NearEqual(XMVECTOR a, XMVECTOR b, XMVECTOR epsilon)
+	{
+		return fabsf(a.v[0] - b.v[0]) <= epsilon.v[0] && fabsf(a.v[1] - b.v[1]) <= epsilon.v[1];
+	}
+
+	inline bool XMVector3NearEqual(XMVECTOR a, XMVECTOR b, XMVECTOR epsilon)
+	{
+		return XMVector2NearEqual(a, b, epsilon) && fabsf(a.v[2] - b.v[2]) <= epsilon.v[2];
+	}
+}
\ No newline at end of file
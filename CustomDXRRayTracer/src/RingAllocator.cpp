@@ -0,0 +1,70 @@
+#include "RingAllocator.h"
+
+void RingAllocator::Reset(uint64_t capacity)
+{
+	m_Capacity = capacity;
+	m_Head = 0;
+	m_Tail = 0;
+	m_Used = 0;
+	m_OpenBytes = 0;
+	m_Submissions.clear();
+}
+
+bool RingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+	if (size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) return false;
+
+	// An empty ring starts over at the beginning, so the largest allocations always fit
+	if (m_Used == 0)
+	{
+		m_Head = 0;
+		m_Tail = 0;
+	}
+
+	const uint64_t aligned = (m_Head + alignment - 1) & ~(alignment - 1);
+	uint64_t begin = aligned;
+	if (m_Used > 0 && m_Head <= m_Tail)
+	{
+		// The free space lies between the head and the oldest live byte
+		if (aligned + size > m_Tail) return false;
+	}
+	else if (aligned + size > m_Capacity)
+	{
+		// Not enough room before the end, so wrap and leave the tail unused
+		if (size > m_Tail) return false;
+		begin = 0;
+	}
+
+	const uint64_t end = begin + size;
+	const uint64_t consumed = (begin >= m_Head) ? end - m_Head : (m_Capacity - m_Head) + end;
+
+	m_Head = (end == m_Capacity) ? 0 : end;
+	m_Used += consumed;
+	m_OpenBytes += consumed;
+
+	offset = begin;
+	return true;
+}
+
+void RingAllocator::Submit(uint64_t fenceValue)
+{
+	if (m_OpenBytes == 0) return;
+
+	Submission submission;
+	submission.end = m_Head;
+	submission.bytes = m_OpenBytes;
+	submission.fenceValue = fenceValue;
+	m_Submissions.push_back(submission);
+
+	m_OpenBytes = 0;
+}
+
+void RingAllocator::Retire(uint64_t completedFenceValue)
+{
+	while (!m_Submissions.empty() && m_Submissions.front().fenceValue <= completedFenceValue)
+	{
+		m_Tail = m_Submissions.front().end;
+		m_Used -= m_Submissions.front().bytes;
+		m_Submissions.pop_front();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Hands out ranges of a fixed-size ring, such as an upload buffer, in allocation order. Allocations made between two
+// calls to Submit belong to one submission, which is freed as a whole once its fence value has been reached.
+// An allocation that would run past the end of the ring starts again at offset zero; the skipped tail stays
+// with its submission. The ring holds no memory itself, only offsets into it.
+class RingAllocator
+{
+public:
+	RingAllocator() {}
+
+	explicit RingAllocator(uint64_t capacity)
+	{
+		Reset(capacity);
+	}
+
+	void Reset(uint64_t capacity);
+
+	// Alignment must be a power of two. Returns false when the range does not fit until older submissions retire.
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+	// Closes the allocations made since the previous call, to be freed once fenceValue completes
+	void Submit(uint64_t fenceValue);
+
+	void Retire(uint64_t completedFenceValue);
+
+	// Fence value the oldest unretired submission waits for, or zero when none is waiting
+	uint64_t GetPendingFence() const
+	{
+		return m_Submissions.empty() ? 0 : m_Submissions.front().fenceValue;
+	}
+
+	// Bytes allocated since the previous call to Submit
+	uint64_t GetOpenBytes() const
+	{
+		return m_OpenBytes;
+	}
+
+	uint64_t GetCapacity() const
+	{
+		return m_Capacity;
+	}
+
+	// Bytes held by open and pending submissions, alignment and wrap padding included
+	uint64_t GetUsed() const
+	{
+		return m_Used;
+	}
+
+private:
+	struct Submission
+	{
+		uint64_t end;
+		uint64_t bytes;
+		uint64_t fenceValue;
+	};
+
+	uint64_t m_Capacity = 0;
+	uint64_t m_Head = 0;
+	uint64_t m_Tail = 0;
+	uint64_t m_Used = 0;
+	uint64_t m_OpenBytes = 0;
+	std::deque<Submission> m_Submissions;
+};
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "SceneLoader.h"
+#include "GltfLoader.h"
+#include "ObjParser.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+	const UINT64 MinChunkSize = (1 << 20);
+	const UINT32 NoMaterial = 0xFFFFFFFF;
+
+	struct SceneMesh
+	{
+		std::string name;
+		std::string path;
+		std::string material;
+	};
+
+	struct ScenePlacement
+	{
+		UINT32 mesh;	// Index into the chunk's names while parsing, into the scene's meshes once chunks are merged
+		DirectX::XMFLOAT3X4 transform;
+	};
+
+	struct SceneChunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		std::vector<std::string> libraries;
+		std::vector<SceneMesh> meshes;
+		std::vector<std::string> names;
+		std::vector<ScenePlacement> placements;
+		std::string error;
+	};
+
+	struct SceneSource
+	{
+		std::string path;
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<Material> materials;
+		UINT32 materialBase = NoMaterial;
+		UINT32 uses = 0;
+		std::string error;
+	};
+
+	inline bool IsSpace(char c)
+	{
+		return (c == ' ' || c == '\t');
+	}
+
+	inline bool IsTokenEnd(char c)
+	{
+		return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+	}
+
+	inline void SkipSpace(const char*& p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+	}
+
+	inline const char* FindLineEnd(const char* p, const char* end)
+	{
+		const void* newline = memchr(p, '\n', static_cast<size_t>(end - p));
+		return newline ? static_cast<const char*>(newline) : end;
+	}
+
+	inline bool StartsWithKeyword(const char* p, const char* end, const char* keyword, size_t length)
+	{
+		return (static_cast<size_t>(end - p) > length) && (strncmp(p, keyword, length) == 0) && IsSpace(p[length]);
+	}
+
+	inline bool AtLineEnd(const char* p, const char* end)
+	{
+		return p >= end || *p == '\r';
+	}
+
+	std::string ParseToken(const char*& p, const char* end)
+	{
+		SkipSpace(p, end);
+
+		const char* tokenEnd = p;
+		while (tokenEnd < end && !IsTokenEnd(*tokenEnd)) tokenEnd++;
+
+		std::string token(p, tokenEnd);
+		p = tokenEnd;
+		SkipSpace(p, end);
+		return token;
+	}
+
+	std::string NormalizePath(std::string path)
+	{
+		std::transform(path.begin(), path.end(), path.begin(), [](char c) { return (c == '/') ? '\\' : static_cast<char>(tolower(c)); });
+		return path;
+	}
+
+	DirectX::XMFLOAT3X4 Compose(const DirectX::XMFLOAT3X4& outer, const DirectX::XMFLOAT3X4& inner)
+	{
+		DirectX::XMFLOAT3X4 result;
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				float value = (column == 3) ? outer.m[row][3] : 0.f;
+				for (int k = 0; k < 3; k++) value += outer.m[row][k] * inner.m[k][column];
+				result.m[row][column] = value;
+			}
+		}
+
+		return result;
+	}
+
+	void ParseChunk(SceneChunk& chunk)
+	{
+		std::map<std::string, UINT32> names;
+
+		const char* p = chunk.begin;
+		while (p < chunk.end)
+		{
+			const char* lineStart = p;
+			const char* lineEnd = FindLineEnd(p, chunk.end);
+			SkipSpace(p, lineEnd);
+
+			if (StartsWithKeyword(p, lineEnd, "instance", 8))
+			{
+				p += 9;
+				const std::string name = ParseToken(p, lineEnd);
+
+				std::map<std::string, UINT32>::iterator it = names.find(name);
+				if (it == names.end())
+				{
+					it = names.emplace(name, static_cast<UINT32>(chunk.names.size())).first;
+					chunk.names.push_back(name);
+				}
+
+				ScenePlacement placement;
+				placement.mesh = it->second;
+
+				bool valid = !name.empty();
+				for (int i = 0; i < 12 && valid; i++)
+				{
+					valid = !AtLineEnd(p, lineEnd) && ObjParser::ParseFloat(p, lineEnd, placement.transform.m[i / 4][i % 4]);
+					SkipSpace(p, lineEnd);
+				}
+
+				if (!valid || !AtLineEnd(p, lineEnd))
+				{
+					chunk.error = "Error: failed to parse instance '" + std::string(lineStart, lineEnd) + "'";
+					return;
+				}
+
+				chunk.placements.push_back(placement);
+			}
+			else if (StartsWithKeyword(p, lineEnd, "mesh", 4))
+			{
+				p += 5;
+
+				SceneMesh mesh;
+				mesh.name = ParseToken(p, lineEnd);
+				mesh.path = ParseToken(p, lineEnd);
+				mesh.material = ParseToken(p, lineEnd);
+
+				if (mesh.name.empty() || mesh.path.empty() || !AtLineEnd(p, lineEnd))
+				{
+					chunk.error = "Error: failed to parse mesh '" + std::string(lineStart, lineEnd) + "'";
+					return;
+				}
+
+				chunk.meshes.push_back(mesh);
+			}
+			else if (StartsWithKeyword(p, lineEnd, "mtllib", 6))
+			{
+				p += 7;
+				while (!AtLineEnd(p, lineEnd)) chunk.libraries.push_back(ParseToken(p, lineEnd));
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+}
+
+namespace SceneLoader
+{
+	bool IsScene(const std::string& filepath)
+	{
+		if (filepath.size() < 6) return false;
+
+		std::string extension = filepath.substr(filepath.size() - 6);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+		return extension == ".scene";
+	}
+
+	void LoadScene(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials)
+	{
+		Utils::Timer timer;
+
+		Utils::MappedFile file;
+		if (!file.Open(filepath))
+		{
+			throw std::runtime_error("Error: failed to open scene " + filepath);
+		}
+
+		// Chunks end on line boundaries, so instance lines, which make up nearly all of a large scene, parse in parallel
+		const char* data = file.Data();
+		const UINT64 size = file.Size();
+		UINT64 chunkCount = (size / MinChunkSize) + 1;
+		chunkCount = (std::min)(chunkCount, static_cast<UINT64>(Utils::GetWorkerCount() * 4));
+
+		std::vector<SceneChunk> chunks(static_cast<size_t>(chunkCount));
+		const char* begin = data;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			const char* end = data + size;
+			if (i + 1 < chunks.size())
+			{
+				const char* target = data + (size * (i + 1)) / chunkCount;
+				end = FindLineEnd((std::max)(target, begin), data + size);
+				if (end < data + size) end++;
+			}
+
+			chunks[i].begin = begin;
+			chunks[i].end = end;
+			begin = end;
+		}
+
+		Utils::ParallelFor(static_cast<UINT>(chunks.size()), [&](UINT i)
+		{
+			ParseChunk(chunks[i]);
+		});
+
+		std::vector<Material> sceneMaterials;
+		std::vector<SceneMesh> meshes;
+		std::map<std::string, UINT32> meshesByName;
+		for (const SceneChunk& chunk : chunks)
+		{
+			if (!chunk.error.empty()) throw std::runtime_error(chunk.error);
+
+			for (const std::string& library : chunk.libraries)
+			{
+				if (!ObjParser::ParseMtl("materials/" + library, sceneMaterials))
+				{
+					throw std::runtime_error("Error: failed to open material library " + library);
+				}
+			}
+
+			for (const SceneMesh& mesh : chunk.meshes)
+			{
+				if (!meshesByName.emplace(mesh.name, static_cast<UINT32>(meshes.size())).second)
+				{
+					throw std::runtime_error("Error: mesh " + mesh.name + " is declared more than once");
+				}
+				meshes.push_back(mesh);
+			}
+		}
+
+		// Files are loaded once however many meshes name them; a mesh with its own material becomes a separate model
+		std::vector<SceneSource> sources;
+		std::map<std::string, UINT32> sourcesByPath;
+		std::vector<UINT32> meshVariants(meshes.size());
+		std::vector<std::pair<UINT32, UINT32>> variants;
+		std::map<std::pair<UINT32, UINT32>, UINT32> variantsByKey;
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			std::map<std::string, UINT32>::iterator source = sourcesByPath.find(NormalizePath(meshes[i].path));
+			if (source == sourcesByPath.end())
+			{
+				source = sourcesByPath.emplace(NormalizePath(meshes[i].path), static_cast<UINT32>(sources.size())).first;
+				sources.push_back(SceneSource());
+				sources.back().path = meshes[i].path;
+			}
+
+			UINT32 material = NoMaterial;
+			if (!meshes[i].material.empty())
+			{
+				std::vector<Material>::const_iterator it = std::find_if(sceneMaterials.begin(), sceneMaterials.end(), [&](const Material& m) { return m.name == meshes[i].material; });
+				if (it == sceneMaterials.end())
+				{
+					throw std::runtime_error("Error: mesh " + meshes[i].name + " uses unknown material " + meshes[i].material);
+				}
+				material = static_cast<UINT32>(it - sceneMaterials.begin());
+			}
+
+			const std::pair<UINT32, UINT32> key(source->second, material);
+			std::map<std::pair<UINT32, UINT32>, UINT32>::iterator variant = variantsByKey.find(key);
+			if (variant == variantsByKey.end())
+			{
+				variant = variantsByKey.emplace(key, static_cast<UINT32>(variants.size())).first;
+				variants.push_back(key);
+			}
+			meshVariants[i] = variant->second;
+		}
+
+		std::vector<std::vector<DirectX::XMFLOAT3X4>> placements(variants.size());
+		for (const SceneChunk& chunk : chunks)
+		{
+			std::vector<UINT32> chunkVariants(chunk.names.size());
+			for (size_t i = 0; i < chunk.names.size(); i++)
+			{
+				std::map<std::string, UINT32>::const_iterator mesh = meshesByName.find(chunk.names[i]);
+				if (mesh == meshesByName.end())
+				{
+					throw std::runtime_error("Error: instance of undeclared mesh " + chunk.names[i]);
+				}
+				chunkVariants[i] = meshVariants[mesh->second];
+			}
+
+			for (const ScenePlacement& placement : chunk.placements) placements[chunkVariants[placement.mesh]].push_back(placement.transform);
+		}
+
+		for (size_t v = 0; v < variants.size(); v++)
+		{
+			if (!placements[v].empty()) sources[variants[v].first].uses++;
+		}
+
+		// Exceptions cannot leave a worker thread, so each source keeps its error until every load has finished
+		Utils::ParallelFor(static_cast<UINT>(sources.size()), [&](UINT i)
+		{
+			if (sources[i].uses == 0) return;
+
+			try
+			{
+				if (GltfLoader::IsGlb(sources[i].path))
+				{
+					GltfLoader::LoadGlb(sources[i].path, sources[i].models, sources[i].materials);
+				}
+				else
+				{
+					std::shared_ptr<Model> model = std::make_shared<Model>();
+					Utils::LoadModel(sources[i].path, *model, sources[i].materials);
+					sources[i].models.push_back(model);
+				}
+			}
+			catch (const std::exception& e)
+			{
+				sources[i].error = e.what();
+			}
+		});
+
+		for (const SceneSource& source : sources)
+		{
+			if (!source.error.empty()) throw std::runtime_error(source.error);
+		}
+
+		std::vector<Material> result = sceneMaterials;
+		std::vector<std::shared_ptr<Model>> sceneModels;
+		size_t placementCount = 0;
+		for (size_t v = 0; v < variants.size(); v++)
+		{
+			if (placements[v].empty()) continue;
+
+			SceneSource& source = sources[variants[v].first];
+			const UINT32 material = variants[v].second;
+			if (material == NoMaterial && source.materialBase == NoMaterial)
+			{
+				source.materialBase = static_cast<UINT32>(result.size());
+				result.insert(result.end(), source.materials.begin(), source.materials.end());
+			}
+
+			for (const std::shared_ptr<Model>& sourceModel : source.models)
+			{
+				// The last variant of a file takes its models; earlier ones copy the tables and share the mapping
+				std::shared_ptr<Model> model = (source.uses > 1) ? std::make_shared<Model>(*sourceModel) : sourceModel;
+				for (Submesh& submesh : model->submeshes) submesh.materialIndex = (material == NoMaterial) ? submesh.materialIndex + source.materialBase : material;
+
+				// GLB nodes already place their primitives; every scene placement repeats all of them
+				const std::vector<DirectX::XMFLOAT3X4> nodes = model->instances;
+				if (nodes.empty())
+				{
+					model->instances = placements[v];
+				}
+				else
+				{
+					model->instances.clear();
+					model->instances.reserve(placements[v].size() * nodes.size());
+					for (const DirectX::XMFLOAT3X4& placement : placements[v])
+					{
+						for (const DirectX::XMFLOAT3X4& node : nodes) model->instances.push_back(Compose(placement, node));
+					}
+				}
+
+				placementCount += model->instances.size();
+				sceneModels.push_back(model);
+			}
+
+			source.uses--;
+		}
+
+		models.insert(models.end(), sceneModels.begin(), sceneModels.end());
+		materials = result;
+
+		printf("Loaded scene %s in %.2f ms: %zu meshes from %zu files as %zu models with %zu placements\n", filepath.c_str(), timer.ElapsedMillis(), meshes.size(), sources.size(), sceneModels.size(), placementCount);
+	}
+}
\ No newline at end of file
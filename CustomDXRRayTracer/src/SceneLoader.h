@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Structures.h"
+
+namespace SceneLoader
+{
+	bool IsScene(const std::string& filepath);
+
+	// Loads a text scene file made of these lines:
+	//   mtllib <library>                      materials that meshes can be assigned, read from materials\ like OBJ
+	//   mesh <name> <path> [<material>]       an OBJ, PLY or GLB file, optionally drawn with one scene material
+	//   instance <name> <12 floats>           a placement of a mesh as a row-major 3x4 transform
+	// Every file is loaded once however many meshes name it, and meshes with the same file and material share one
+	// model whose instances hold all of their placements, so they share one set of BLASes in the TLAS.
+	void LoadScene(const std::string& filepath, std::vector<std::shared_ptr<Model>>& models, std::vector<Material>& materials);
+}
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "common.h"
+#include "Common.h"
 
 static bool CompareVector3WithEpsilon(const DirectX::XMFLOAT3& lhs, const DirectX::XMFLOAT3& rhs)
 {
@@ -14,15 +14,51 @@ static bool CompareVector2WithEpsilon(const DirectX::XMFLOAT2& lhs, const Direct
 	return DirectX::XMVector2NearEqual(DirectX::XMLoadFloat2(&lhs), DirectX::XMLoadFloat2(&rhs), DirectX::XMLoadFloat2(&vector3Epsilon));
 }
 
+enum class MipFilter
+{
+	Box,
+	Kaiser,
+	Lanczos
+};
+
+enum class TextureCompression
+{
+	None,
+	BC1,
+	BC7
+};
+
+enum class CompressionQuality
+{
+	Fast,
+	Normal,
+	High
+};
+
+struct TextureOptions
+{
+	MipFilter mipFilter = MipFilter::Box;
+	TextureCompression compression = TextureCompression::None;
+	CompressionQuality quality = CompressionQuality::Normal;
+};
+
+#ifdef _WIN32
 struct ConfigInfo
 {
 	LPWSTR windowName = L"";
 	int width = 640;
 	int height = 360;
 	bool vsync = false;
+	bool compactVertices = false;
+	MipFilter mipFilter = MipFilter::Box;
+	TextureCompression textureCompression = TextureCompression::None;
+	CompressionQuality compressionQuality = CompressionQuality::Normal;
+	UINT tileBudget = 256;
 	std::string model = "";
+	std::string environment = "";
 	HINSTANCE instance = NULL;
 };
+#endif
 
 struct Vertex
 {
@@ -31,7 +67,7 @@ struct Vertex
 
 	bool operator==(const Vertex& v) const
 	{
-		return CompareVector3WithEpsilon(position, v.position);
+		return CompareVector3WithEpsilon(position, v.position) && CompareVector2WithEpsilon(uv, v.uv);
 	}
 
 	Vertex& operator=(const Vertex& v)
@@ -42,17 +78,115 @@ struct Vertex
 	}
 };
 
+struct VertexFrame
+{
+	DirectX::XMFLOAT3 normal = DirectX::XMFLOAT3(0.f, 1.f, 0.f);
+	DirectX::XMFLOAT4 tangent = DirectX::XMFLOAT4(1.f, 0.f, 0.f, 1.f);
+};
+
 struct Material
 {
 	std::string name = "defaultMaterial";
 	std::string texturePath = "";
 	int textureResolution = 512;
+
+	// Encoded image bytes inside a mapped model file, used instead of texturePath when set
+	std::shared_ptr<void> mapping;
+	const UINT8* embeddedTexture = nullptr;
+	size_t embeddedTextureSize = 0;
+
+	// Set when embeddedTexture already holds the texture in its GPU form, as in a baked archive: the full mip chain in
+	// embeddedFormat, every level placed at the upload pitch like a texture cache file
+	int embeddedWidth = 0;
+	int embeddedHeight = 0;
+	int embeddedMipLevels = 0;
+	DXGI_FORMAT embeddedFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+};
+
+struct CompactVertex
+{
+	int16_t position[4];
+	uint16_t uv[2];
+};
+
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 scale = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+	DirectX::XMFLOAT3 bias = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
+	DirectX::XMFLOAT2 uvScale = DirectX::XMFLOAT2(1.f, 1.f);
+	DirectX::XMFLOAT2 uvBias = DirectX::XMFLOAT2(0.f, 0.f);
+};
+
+struct Submesh
+{
+	uint32_t indexOffset = 0;
+	uint32_t indexCount = 0;
+	uint32_t materialIndex = 0;
+};
+
+struct Cluster
+{
+	uint32_t submeshOffset = 0;
+	uint32_t submeshCount = 0;
+	DirectX::XMFLOAT3 boundsMin = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
+	DirectX::XMFLOAT3 boundsMax = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
+
+	// Coarser levels of this cluster, from finest to coarsest, in Model::lods
+	uint32_t lodOffset = 0;
+	uint32_t lodCount = 0;
+};
+
+struct ClusterLod
+{
+	uint32_t submeshOffset = 0;
+	uint32_t submeshCount = 0;
+	float error = 0.f;	// Upper bound on the object space distance to the full-resolution surface
 };
 
 struct Model
 {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	std::vector<VertexFrame> frames;
+	std::vector<Submesh> submeshes;
+	std::vector<Cluster> clusters;
+	std::vector<ClusterLod> lods;
+
+	// World transforms (3x4, row-major) of every placement; empty means a single identity instance
+	std::vector<DirectX::XMFLOAT3X4> instances;
+
+	std::shared_ptr<void> mapping;
+	const Vertex* mappedVertices = nullptr;
+	const uint32_t* mappedIndices = nullptr;
+	const VertexFrame* mappedFrames = nullptr;
+	size_t mappedVertexCount = 0;
+	size_t mappedIndexCount = 0;
+
+	const Vertex* VertexData() const
+	{
+		return mappedVertices ? mappedVertices : vertices.data();
+	}
+
+	size_t VertexCount() const
+	{
+		return mappedVertices ? mappedVertexCount : vertices.size();
+	}
+
+	const uint32_t* IndexData() const
+	{
+		return mappedIndices ? mappedIndices : indices.data();
+	}
+
+	size_t IndexCount() const
+	{
+		return mappedIndices ? mappedIndexCount : indices.size();
+	}
+
+	// Normal and tangent per vertex, parallel to VertexData()
+	const VertexFrame* FrameData() const
+	{
+		return mappedFrames ? mappedFrames : frames.data();
+	}
 };
 
 struct TextureInfo
@@ -62,18 +196,49 @@ struct TextureInfo
 	int height = 0;
 	int stride = 0;
 	int offset = 0;
+	int mipLevels = 1;
+	DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	// Texels read in place from a mapped texture cache file, used instead of pixels when set.
+	// Every level is already placed at the row pitch and offset the upload buffer copy expects.
+	std::shared_ptr<void> mapping;
+	const UINT8* mappedPixels = nullptr;
+	size_t mappedSize = 0;
+};
+
+// One entry of the material buffer, mirrored by MaterialRecord in Common.hlsl
+struct MaterialRecord
+{
+	UINT textureIndex = 0;
+	UINT textureWidth = 1;
+	UINT textureHeight = 1;
+	UINT textureLevels = 1;
+	DirectX::XMUINT4 virtualTexture = DirectX::XMUINT4(0, 0, 0, 0);
 };
 
-struct MaterialCB
+struct GeometryCB
 {
-	DirectX::XMFLOAT4 resolution;
+	DirectX::XMFLOAT3 positionScale = DirectX::XMFLOAT3(1.f, 1.f, 1.f);
+	UINT triangleOffset = 0;
+	DirectX::XMFLOAT3 positionBias = DirectX::XMFLOAT3(0.f, 0.f, 0.f);
+	UINT materialIndex = 0;
+	DirectX::XMFLOAT2 uvScale = DirectX::XMFLOAT2(1.f, 1.f);
+	DirectX::XMFLOAT2 uvBias = DirectX::XMFLOAT2(0.f, 0.f);
 };
 
+// Renderer state, which only the Windows build has
+#ifdef _WIN32
+
 struct ViewCB
 {
 	DirectX::XMMATRIX view = DirectX::XMMatrixIdentity();
 	DirectX::XMFLOAT4 viewOriginAndTanHalfFovY = DirectX::XMFLOAT4(0.f, 0.f, 0.f, 0.f);
 	DirectX::XMFLOAT2 resolution = DirectX::XMFLOAT2(0.f, 0.f);
+	UINT frameNumber = 0;
+	UINT environmentSamples = 0;	// Zero without an environment map
+	UINT environmentWidth = 0;
+	UINT environmentHeight = 0;
+	UINT environmentBlock = 1;
 };
 
 struct D3D12BufferCreateInfo
@@ -133,28 +298,56 @@ struct D3D12ShaderInfo
 		targetProfile(inProfile) {}
 };
 
-struct D3D12Resources
+struct GeometryBuffers
 {
-	ID3D12Resource* DXROutput;
+	std::shared_ptr<Model> model;
 
 	ID3D12Resource* vertexBuffer = nullptr;
-	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+	D3D12_VERTEX_BUFFER_VIEW vertexBufferView = {};
+	ID3D12Resource* vertexTransform = nullptr;
+	VertexQuantization vertexQuantization;
 	ID3D12Resource* indexBuffer = nullptr;
-	D3D12_INDEX_BUFFER_VIEW indexBufferView;
+	D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
+	ID3D12Resource* frameBuffer = nullptr;
+
+	UINT firstBLAS = 0;
+	UINT firstHitGroup = 0;
+
+	// Level of every cluster in every placement, 0 being full resolution
+	std::vector<UINT8> lodSelection;
+};
+
+class TextureStream;
+class UploadManager;
+class VirtualTextures;
+
+struct D3D12Resources
+{
+	ID3D12Resource* DXROutput;
+
+	std::vector<GeometryBuffers> geometry;
 
 	ID3D12Resource* viewCB = nullptr;
 	ViewCB viewCBData;
 	UINT8* viewCBStart = nullptr;
 
-	ID3D12Resource* materialCB = nullptr;
-	MaterialCB materialCBData;
-	UINT8* materialCBStart = nullptr;
+	ID3D12Resource* materialBuffer = nullptr;
+	std::vector<MaterialRecord> materialRecords;
+	UINT8* materialBufferStart = nullptr;
 
 	ID3D12DescriptorHeap* rtvHeap = nullptr;
 	ID3D12DescriptorHeap* descriptorHeap = nullptr;
 
-	ID3D12Resource* texture = nullptr;
-	ID3D12Resource* textureUploadResource = nullptr;
+	std::vector<ID3D12Resource*> textures;		// Null while the texture is loading
+	std::vector<UINT> materialTextures;
+	ID3D12Resource* placeholderTexture = nullptr;
+
+	ID3D12Resource* environment = nullptr;
+	ID3D12Resource* environmentTable = nullptr;
+
+	std::shared_ptr<UploadManager> upload;
+	std::shared_ptr<VirtualTextures> virtualTextures;
+	std::shared_ptr<TextureStream> textureStream;
 
 	UINT rtvDescSize = 0;
 
@@ -184,6 +377,11 @@ struct D3D12Global
 	int width = 640;
 	int height = 360;
 	bool vsync = false;
+	bool compactVertices = false;
+	MipFilter mipFilter = MipFilter::Box;
+	TextureCompression textureCompression = TextureCompression::None;
+	CompressionQuality compressionQuality = CompressionQuality::Normal;
+	UINT tileBudget = 256;
 };
 
 struct AccelerationStructureBuffer
@@ -263,11 +461,14 @@ struct HitProgram
 struct DXRGlobal
 {
 	AccelerationStructureBuffer TLAS;
-	AccelerationStructureBuffer BLAS;
+	std::vector<AccelerationStructureBuffer> BLAS;
+	ID3D12Resource* blasScratch = nullptr;
+	std::vector<ID3D12Resource*> retiredResources;
 	uint64_t tlasSize;
 
 	ID3D12Resource* shaderTable = nullptr;
 	uint32_t shaderTableRecordSize = 0;
+	uint32_t hitGroupRecordCount = 0;
 
 	RtProgram rgs;
 	RtProgram miss;
@@ -275,4 +476,6 @@ struct DXRGlobal
 
 	ID3D12StateObject* rtpso = nullptr;
 	ID3D12StateObjectProperties* rtpsoInfo = nullptr;
-};
\ No newline at end of file
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,378 @@
+#include "TangentSpace.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const UINT TaskShift = 16;
+	const float SameNormalThreshold = 0.99999f;
+	const float SliverThreshold = 1e-12f;
+	const uint32_t ExactValence = 256;
+	const uint32_t DirectionCells = 32;
+
+	struct FaceFrame
+	{
+		XMFLOAT3 normal;	// Unnormalized cross product, so its length carries the area weight
+		XMFLOAT3 tangent;	// Unit direction of increasing u, zero when the uv mapping is degenerate
+		float handedness;
+	};
+
+	XMVECTOR Position(const Vertex* vertices, uint32_t index)
+	{
+		return XMLoadFloat3(&vertices[index].position);
+	}
+
+	float CornerAngle(const Vertex* vertices, const uint32_t* triangle, int corner)
+	{
+		const XMVECTOR p = Position(vertices, triangle[corner]);
+		const XMVECTOR a = XMVector3Normalize(XMVectorSubtract(Position(vertices, triangle[(corner + 1) % 3]), p));
+		const XMVECTOR b = XMVector3Normalize(XMVectorSubtract(Position(vertices, triangle[(corner + 2) % 3]), p));
+		const float cosine = (std::max)(-1.f, (std::min)(1.f, XMVectorGetX(XMVector3Dot(a, b))));
+		return acosf(cosine);
+	}
+
+	void ForEachChunk(size_t count, const std::function<void(size_t, size_t)>& task)
+	{
+		// Fixed chunk boundaries keep every floating point sum independent of the worker count
+		const UINT taskCount = static_cast<UINT>((count + (static_cast<size_t>(1) << TaskShift) - 1) >> TaskShift);
+		Utils::ParallelFor(taskCount, [&](UINT chunk)
+		{
+			const size_t begin = static_cast<size_t>(chunk) << TaskShift;
+			task(begin, (std::min)(begin + (static_cast<size_t>(1) << TaskShift), count));
+		});
+	}
+
+	class VertexSmoother
+	{
+	public:
+		VertexSmoother(const Vertex* vertices, const uint32_t* indices, const std::vector<FaceFrame>& faces, float cosCrease) :
+			m_Vertices(vertices), m_Indices(indices), m_Faces(faces), m_CosCrease(cosCrease) {}
+
+		// Groups the corners of one vertex into distinct frames. groups receives the frame of each corner.
+		uint32_t Smooth(const uint32_t* corners, uint32_t cornerCount, std::vector<uint32_t>& groups, std::vector<XMFLOAT3>& normals, std::vector<float>& handedness)
+		{
+			normals.clear();
+			handedness.clear();
+			groups.resize(cornerCount);
+
+			Cluster(corners, cornerCount);
+			const uint32_t clusterCount = static_cast<uint32_t>(m_Clusters.size());
+
+			XMVECTOR all = XMVectorZero();
+			for (const CornerCluster& cluster : m_Clusters) all = XMVectorAdd(all, XMLoadFloat3(&cluster.weighted));
+
+			for (uint32_t i = 0; i < clusterCount; i++)
+			{
+				CornerCluster& cluster = m_Clusters[i];
+				const XMVECTOR direction = XMLoadFloat3(&cluster.direction);
+
+				// Degenerate faces have no direction of their own; they join the first frame once all others are known
+				cluster.group = UINT32_MAX;
+				if (XMVectorGetX(XMVector3LengthSq(direction)) <= 0.f) continue;
+
+				XMVECTOR sum = XMVectorZero();
+				for (uint32_t j = 0; j < clusterCount; j++)
+				{
+					if (j == i || XMVectorGetX(XMVector3Dot(direction, XMLoadFloat3(&m_Clusters[j].direction))) >= m_CosCrease) sum = XMVectorAdd(sum, XMLoadFloat3(&m_Clusters[j].weighted));
+				}
+
+				XMFLOAT3 normal;
+				XMStoreFloat3(&normal, (XMVectorGetX(XMVector3LengthSq(sum)) > 0.f) ? XMVector3Normalize(sum) : direction);
+
+				uint32_t group = 0;
+				while (group < normals.size())
+				{
+					const float similarity = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), XMLoadFloat3(&normals[group])));
+					if (similarity >= SameNormalThreshold && handedness[group] == cluster.handedness) break;
+					group++;
+				}
+
+				if (group == normals.size())
+				{
+					normals.push_back(normal);
+					handedness.push_back(cluster.handedness);
+				}
+				cluster.group = group;
+			}
+
+			for (CornerCluster& cluster : m_Clusters)
+			{
+				if (cluster.group != UINT32_MAX) continue;
+
+				if (normals.empty())
+				{
+					XMFLOAT3 normal(0.f, 1.f, 0.f);
+					if (XMVectorGetX(XMVector3LengthSq(all)) > 0.f) XMStoreFloat3(&normal, XMVector3Normalize(all));
+					normals.push_back(normal);
+					handedness.push_back(cluster.handedness);
+				}
+				cluster.group = 0;
+			}
+
+			for (uint32_t i = 0; i < cornerCount; i++) groups[i] = m_Clusters[m_CornerClusters[i]].group;
+			return static_cast<uint32_t>(normals.size());
+		}
+
+		// Angle-weighted average of the face tangents in one group, orthogonalized against its normal
+		XMFLOAT4 Tangent(const uint32_t* corners, uint32_t cornerCount, const std::vector<uint32_t>& groups, uint32_t group, const XMFLOAT3& normal, float handedness)
+		{
+			const XMVECTOR n = XMLoadFloat3(&normal);
+
+			XMVECTOR sum = XMVectorZero();
+			for (uint32_t i = 0; i < cornerCount; i++)
+			{
+				if (groups[i] != group) continue;
+
+				const XMVECTOR t = XMLoadFloat3(&m_Faces[corners[i] / 3].tangent);
+				const XMVECTOR projected = XMVectorSubtract(t, XMVectorScale(n, XMVectorGetX(XMVector3Dot(n, t))));
+				if (XMVectorGetX(XMVector3LengthSq(projected)) <= 1e-12f) continue;
+
+				sum = XMVectorAdd(sum, XMVectorScale(XMVector3Normalize(projected), CornerAngle(m_Vertices, m_Indices + (corners[i] / 3) * 3, corners[i] % 3)));
+			}
+
+			sum = XMVectorSubtract(sum, XMVectorScale(n, XMVectorGetX(XMVector3Dot(n, sum))));
+			if (XMVectorGetX(XMVector3LengthSq(sum)) <= 1e-12f)
+			{
+				// No usable uv gradient; pick any direction perpendicular to the normal
+				const XMVECTOR axis = (fabsf(normal.x) < 0.9f) ? XMVectorSet(1.f, 0.f, 0.f, 0.f) : XMVectorSet(0.f, 1.f, 0.f, 0.f);
+				sum = XMVector3Cross(n, XMVector3Cross(axis, n));
+			}
+
+			XMFLOAT4 tangent;
+			XMStoreFloat4(&tangent, XMVector3Normalize(sum));
+			tangent.w = handedness;
+			return tangent;
+		}
+
+	private:
+		struct CornerCluster
+		{
+			XMFLOAT3 weighted;	// Sum of angle-weighted face normals
+			XMFLOAT3 direction;	// Unit face direction, zero for degenerate faces
+			float handedness;
+			uint32_t group;
+		};
+
+		// Low valence vertices compare every corner against every other one. Fans around high valence
+		// vertices would make that quadratic, so their corners are first binned by direction and handedness.
+		void Cluster(const uint32_t* corners, uint32_t cornerCount)
+		{
+			m_Clusters.clear();
+			m_CornerClusters.resize(cornerCount);
+
+			const bool binned = cornerCount > ExactValence;
+			if (binned) m_Cells.assign(DirectionCells * DirectionCells * 2 + 1, UINT32_MAX);
+
+			for (uint32_t i = 0; i < cornerCount; i++)
+			{
+				const FaceFrame& face = m_Faces[corners[i] / 3];
+				const XMVECTOR faceNormal = XMLoadFloat3(&face.normal);
+				const XMVECTOR direction = XMVector3Normalize(faceNormal);
+				const XMVECTOR weighted = XMVectorScale(faceNormal, CornerAngle(m_Vertices, m_Indices + (corners[i] / 3) * 3, corners[i] % 3));
+
+				uint32_t cluster = static_cast<uint32_t>(m_Clusters.size());
+				if (binned)
+				{
+					uint32_t& cell = m_Cells[DirectionCell(direction, face.handedness)];
+					if (cell == UINT32_MAX) cell = cluster;
+					cluster = cell;
+				}
+
+				if (cluster == m_Clusters.size())
+				{
+					CornerCluster created = {};
+					created.handedness = face.handedness;
+					m_Clusters.push_back(created);
+				}
+
+				CornerCluster& target = m_Clusters[cluster];
+				XMStoreFloat3(&target.weighted, XMVectorAdd(XMLoadFloat3(&target.weighted), weighted));
+				XMStoreFloat3(&target.direction, XMVectorAdd(XMLoadFloat3(&target.direction), direction));
+				m_CornerClusters[i] = cluster;
+			}
+
+			if (binned)
+			{
+				for (CornerCluster& cluster : m_Clusters) XMStoreFloat3(&cluster.direction, XMVector3Normalize(XMLoadFloat3(&cluster.direction)));
+			}
+		}
+
+		// Octahedral cell of a unit direction; degenerate faces share the last cell
+		static uint32_t DirectionCell(FXMVECTOR direction, float handedness)
+		{
+			XMFLOAT3 d;
+			XMStoreFloat3(&d, direction);
+			const float length = fabsf(d.x) + fabsf(d.y) + fabsf(d.z);
+			if (length <= 0.f) return DirectionCells * DirectionCells * 2;
+
+			float u = d.x / length, v = d.y / length;
+			if (d.z < 0.f)
+			{
+				const float folded = (1.f - fabsf(v)) * ((u < 0.f) ? -1.f : 1.f);
+				v = (1.f - fabsf(u)) * ((v < 0.f) ? -1.f : 1.f);
+				u = folded;
+			}
+
+			const uint32_t x = (std::min)(static_cast<uint32_t>((u * 0.5f + 0.5f) * DirectionCells), DirectionCells - 1);
+			const uint32_t y = (std::min)(static_cast<uint32_t>((v * 0.5f + 0.5f) * DirectionCells), DirectionCells - 1);
+			return ((handedness < 0.f) ? DirectionCells * DirectionCells : 0) + y * DirectionCells + x;
+		}
+
+		const Vertex* m_Vertices;
+		const uint32_t* m_Indices;
+		const std::vector<FaceFrame>& m_Faces;
+		float m_CosCrease;
+
+		std::vector<CornerCluster> m_Clusters;
+		std::vector<uint32_t> m_CornerClusters;
+		std::vector<uint32_t> m_Cells;
+	};
+}
+
+namespace TangentSpace
+{
+	TangentSpaceStats Generate(Model& model, float creaseAngleDegrees)
+	{
+		Utils::Timer timer;
+		TangentSpaceStats stats;
+
+		const Vertex* vertices = model.VertexData();
+		const uint32_t* indices = model.IndexData();
+		const size_t vertexCount = model.VertexCount();
+		const size_t cornerCount = model.IndexCount() - (model.IndexCount() % 3);
+		const size_t triangleCount = cornerCount / 3;
+		stats.inputVertices = vertexCount;
+
+		std::vector<FaceFrame> faces(triangleCount);
+		ForEachChunk(triangleCount, [&](size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; t++)
+			{
+				const Vertex& v0 = vertices[indices[t * 3 + 0]];
+				const Vertex& v1 = vertices[indices[t * 3 + 1]];
+				const Vertex& v2 = vertices[indices[t * 3 + 2]];
+
+				const XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&v1.position), XMLoadFloat3(&v0.position));
+				const XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&v2.position), XMLoadFloat3(&v0.position));
+				const float du1 = v1.uv.x - v0.uv.x, dv1 = v1.uv.y - v0.uv.y;
+				const float du2 = v2.uv.x - v0.uv.x, dv2 = v2.uv.y - v0.uv.y;
+				const float uvArea = du1 * dv2 - du2 * dv1;
+
+				// Slivers whose area is negligible next to their longest edge have no reliable direction
+				const XMVECTOR cross = XMVector3Cross(e1, e2);
+				const float longestEdge = (std::max)((std::max)(XMVectorGetX(XMVector3LengthSq(e1)), XMVectorGetX(XMVector3LengthSq(e2))), XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(e2, e1))));
+				const bool sliver = XMVectorGetX(XMVector3LengthSq(cross)) <= SliverThreshold * longestEdge * longestEdge;
+
+				FaceFrame& face = faces[t];
+				XMStoreFloat3(&face.normal, sliver ? XMVectorZero() : cross);
+				face.handedness = (uvArea < 0.f) ? -1.f : 1.f;
+
+				const XMVECTOR tangent = XMVectorScale(XMVectorSubtract(XMVectorScale(e1, dv2), XMVectorScale(e2, dv1)), face.handedness);
+				XMStoreFloat3(&face.tangent, (uvArea != 0.f && !sliver) ? XMVector3Normalize(tangent) : XMVectorZero());
+			}
+		});
+
+		// Vertex to corner adjacency; each list is sorted so sums run in a fixed order
+		std::vector<std::atomic<uint32_t>> counts(vertexCount);
+		for (auto& count : counts) count.store(0, std::memory_order_relaxed);
+		ForEachChunk(cornerCount, [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++) counts[indices[c]].fetch_add(1, std::memory_order_relaxed);
+		});
+
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + counts[v].load(std::memory_order_relaxed);
+		for (size_t v = 0; v < vertexCount; v++) counts[v].store(offsets[v], std::memory_order_relaxed);
+
+		std::vector<uint32_t> adjacency(cornerCount);
+		ForEachChunk(cornerCount, [&](size_t begin, size_t end)
+		{
+			for (size_t c = begin; c < end; c++) adjacency[counts[indices[c]].fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(c);
+		});
+		ForEachChunk(vertexCount, [&](size_t begin, size_t end)
+		{
+			for (size_t v = begin; v < end; v++) std::sort(adjacency.begin() + offsets[v], adjacency.begin() + offsets[v + 1]);
+		});
+
+		const float cosCrease = cosf((std::max)(0.f, (std::min)(180.f, creaseAngleDegrees)) * XM_PI / 180.f);
+
+		// First pass counts the frames each vertex needs; unreferenced vertices keep one slot so
+		// that an unsplit mesh maps every vertex onto itself
+		std::vector<uint32_t> cornerGroups(cornerCount);
+		std::vector<uint32_t> frameOffsets(vertexCount + 1, 0);
+		ForEachChunk(vertexCount, [&](size_t begin, size_t end)
+		{
+			VertexSmoother smoother(vertices, indices, faces, cosCrease);
+			std::vector<uint32_t> groups;
+			std::vector<XMFLOAT3> normals;
+			std::vector<float> handedness;
+			for (size_t v = begin; v < end; v++)
+			{
+				const uint32_t first = offsets[v];
+				const uint32_t count = offsets[v + 1] - first;
+				const uint32_t frames = smoother.Smooth(adjacency.data() + first, count, groups, normals, handedness);
+				for (uint32_t i = 0; i < count; i++) cornerGroups[adjacency[first + i]] = groups[i];
+				frameOffsets[v + 1] = (std::max)(frames, 1u);
+			}
+		});
+
+		for (size_t v = 0; v < vertexCount; v++) frameOffsets[v + 1] += frameOffsets[v];
+		const size_t frameCount = frameOffsets[vertexCount];
+
+		std::vector<VertexFrame> frames(frameCount);
+		ForEachChunk(vertexCount, [&](size_t begin, size_t end)
+		{
+			VertexSmoother smoother(vertices, indices, faces, cosCrease);
+			std::vector<uint32_t> groups;
+			std::vector<XMFLOAT3> normals;
+			std::vector<float> handedness;
+			for (size_t v = begin; v < end; v++)
+			{
+				const uint32_t first = offsets[v];
+				const uint32_t count = offsets[v + 1] - first;
+				const uint32_t groupCount = smoother.Smooth(adjacency.data() + first, count, groups, normals, handedness);
+				for (uint32_t g = 0; g < groupCount; g++)
+				{
+					VertexFrame& frame = frames[frameOffsets[v] + g];
+					frame.normal = normals[g];
+					frame.tangent = smoother.Tangent(adjacency.data() + first, count, groups, g, normals[g], handedness[g]);
+				}
+			}
+		});
+
+		if (frameCount != vertexCount)
+		{
+			std::vector<Vertex> splitVertices(frameCount);
+			ForEachChunk(vertexCount, [&](size_t begin, size_t end)
+			{
+				for (size_t v = begin; v < end; v++)
+				{
+					for (uint32_t f = frameOffsets[v]; f < frameOffsets[v + 1]; f++) splitVertices[f] = vertices[v];
+				}
+			});
+
+			std::vector<uint32_t> splitIndices(cornerCount);
+			ForEachChunk(cornerCount, [&](size_t begin, size_t end)
+			{
+				for (size_t c = begin; c < end; c++) splitIndices[c] = frameOffsets[indices[c]] + cornerGroups[c];
+			});
+
+			model.vertices.swap(splitVertices);
+			model.indices.swap(splitIndices);
+			model.mappedVertices = nullptr;
+			model.mappedIndices = nullptr;
+		}
+
+		model.frames.swap(frames);
+		model.mappedFrames = nullptr;
+
+		stats.outputVertices = frameCount;
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Structures.h"
+
+static const float DefaultCreaseAngle = 60.f;
+
+struct TangentSpaceStats
+{
+	size_t inputVertices = 0;
+	size_t outputVertices = 0;
+	float milliseconds = 0.f;
+};
+
+namespace TangentSpace
+{
+	// Fills model.frames with area- and angle-weighted smooth normals and per-vertex tangents.
+	// Faces only smooth across edges whose dihedral angle is below the crease angle, and vertices
+	// whose corners end up with different normals or texture handedness are split. The result
+	// does not depend on the number of worker threads.
+	TangentSpaceStats Generate(Model& model, float creaseAngleDegrees = DefaultCreaseAngle);
+}
\ No newline at end of file
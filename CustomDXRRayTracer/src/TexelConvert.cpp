@@ -0,0 +1,355 @@
+#include "TexelConvert.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang need each kernel marked with the instruction sets it uses
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KERNEL_TARGET(features)
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define KERNEL_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace
+{
+	const size_t BandTexels = (1 << 18);
+	const UINT32 OpaqueAlpha = 0xFF000000;
+	const UINT32 GreyToRgb = 0x00010101;
+
+	typedef void (*ExpandKernel)(const UINT8* source, UINT8* destination, size_t count);
+	typedef void (*HalfKernel)(const UINT8* source, UINT16* destination, size_t count, bool srgb);
+
+	UINT16 FloatToHalf(float value)
+	{
+		UINT32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const UINT32 sign = (bits >> 16) & 0x8000;
+		bits &= 0x7FFFFFFF;
+		if (bits >= 0x47800000) return static_cast<UINT16>(sign | 0x7C00);
+		if (bits < 0x38800000) return static_cast<UINT16>(sign | static_cast<UINT32>(std::nearbyint(fabsf(value) * 16777216.f)));
+
+		// Rebias the exponent and round the mantissa to nearest even, as F16C does
+		UINT32 half = (bits - 0x38000000) >> 13;
+		const UINT32 remainder = bits & 0x1FFF;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+		return static_cast<UINT16>(sign | half);
+	}
+
+	// Value of every byte decoded from sRGB, then of every byte as linear, with the matching halves
+	struct HalfTables
+	{
+		float values[512];
+		UINT16 halves[512];
+
+		HalfTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				const double linear = i / 255.0;
+				const double decoded = (linear <= 0.04045) ? linear / 12.92 : pow((linear + 0.055) / 1.055, 2.4);
+				values[i] = static_cast<float>(decoded);
+				values[i + 256] = static_cast<float>(linear);
+			}
+
+			for (int i = 0; i < 512; i++) halves[i] = FloatToHalf(values[i]);
+		}
+	};
+
+	const HalfTables& GetHalfTables()
+	{
+		static const HalfTables tables;
+		return tables;
+	}
+
+	void ExpandGreyScalar(const UINT8* source, UINT8* destination, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[i * 4 + 0] = destination[i * 4 + 1] = destination[i * 4 + 2] = source[i];
+			destination[i * 4 + 3] = 0xFF;
+		}
+	}
+
+	void ExpandGreyAlphaScalar(const UINT8* source, UINT8* destination, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[i * 4 + 0] = destination[i * 4 + 1] = destination[i * 4 + 2] = source[i * 2];
+			destination[i * 4 + 3] = source[i * 2 + 1];
+		}
+	}
+
+	void ExpandRgbScalar(const UINT8* source, UINT8* destination, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[i * 4 + 0] = source[i * 3 + 0];
+			destination[i * 4 + 1] = source[i * 3 + 1];
+			destination[i * 4 + 2] = source[i * 3 + 2];
+			destination[i * 4 + 3] = 0xFF;
+		}
+	}
+
+	void CopyRgba(const UINT8* source, UINT8* destination, size_t count)
+	{
+		memcpy(destination, source, count * 4);
+	}
+
+	void ToHalfScalar(const UINT8* source, UINT16* destination, size_t count, bool srgb)
+	{
+		const UINT16* halves = GetHalfTables().halves;
+		const UINT16* colour = srgb ? halves : halves + 256;
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[i * 4 + 0] = colour[source[i * 4 + 0]];
+			destination[i * 4 + 1] = colour[source[i * 4 + 1]];
+			destination[i * 4 + 2] = colour[source[i * 4 + 2]];
+			destination[i * 4 + 3] = halves[256 + source[i * 4 + 3]];
+		}
+	}
+
+	KERNEL_TARGET("ssse3") void ExpandGreySsse3(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m128i alpha = _mm_set1_epi32(OpaqueAlpha);
+		const __m128i shuffles[4] =
+		{
+			_mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1),
+			_mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+			_mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1),
+			_mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1)
+		};
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			for (int k = 0; k < 4; k++)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + (i + k * 4) * 4), _mm_or_si128(_mm_shuffle_epi8(grey, shuffles[k]), alpha));
+			}
+		}
+
+		ExpandGreyScalar(source + i, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("ssse3") void ExpandGreyAlphaSsse3(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m128i low = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+		const __m128i high = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_shuffle_epi8(texels, low));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 16), _mm_shuffle_epi8(texels, high));
+		}
+
+		ExpandGreyAlphaScalar(source + i * 2, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("ssse3") void ExpandRgbSsse3(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m128i alpha = _mm_set1_epi32(OpaqueAlpha);
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+		// Four texels use 12 of the 16 bytes loaded, so the loop stops while two more texels remain readable
+		size_t i = 0;
+		for (; i + 6 <= count; i += 4)
+		{
+			const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+		}
+
+		ExpandRgbScalar(source + i * 3, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("avx2,f16c") void ExpandGreyAvx2(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m256i alpha = _mm256_set1_epi32(OpaqueAlpha);
+		const __m256i spread = _mm256_set1_epi32(GreyToRgb);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i grey = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_or_si256(_mm256_mullo_epi32(grey, spread), alpha));
+		}
+
+		ExpandGreyScalar(source + i, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("avx2,f16c") void ExpandGreyAlphaAvx2(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m256i mask = _mm256_set1_epi32(0xFF);
+		const __m256i spread = _mm256_set1_epi32(GreyToRgb);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i texels = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2)));
+			const __m256i grey = _mm256_mullo_epi32(_mm256_and_si256(texels, mask), spread);
+			const __m256i alpha = _mm256_slli_epi32(_mm256_srli_epi32(texels, 8), 24);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_or_si256(grey, alpha));
+		}
+
+		ExpandGreyAlphaScalar(source + i * 2, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("avx2,f16c") void ExpandRgbAvx2(const UINT8* source, UINT8* destination, size_t count)
+	{
+		const __m256i alpha = _mm256_set1_epi32(OpaqueAlpha);
+		const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+		// Each lane loads 16 bytes for four texels, so the second load needs four bytes past the eighth texel
+		size_t i = 0;
+		for (; i + 10 <= count; i += 8)
+		{
+			const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+			const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3 + 12));
+			const __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+		}
+
+		ExpandRgbScalar(source + i * 3, destination + i * 4, count - i);
+	}
+
+	KERNEL_TARGET("avx2,f16c") void ToHalfAvx2(const UINT8* source, UINT16* destination, size_t count, bool srgb)
+	{
+		// Alpha always indexes the linear half of the table, colour only when srgb is off
+		const float* values = GetHalfTables().values;
+		const int colour = srgb ? 0 : 256;
+		const __m256i offsets = _mm256_setr_epi32(colour, colour, colour, 256, colour, colour, colour, 256);
+
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i * 4)));
+			const __m256 texels = _mm256_i32gather_ps(values, _mm256_add_epi32(bytes, offsets), 4);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm256_cvtps_ph(texels, _MM_FROUND_TO_NEAREST_INT));
+		}
+
+		ToHalfScalar(source + i * 4, destination + i * 4, count - i, srgb);
+	}
+
+	void ReadCpuid(int info[4], int leaf)
+	{
+#ifdef _MSC_VER
+		__cpuidex(info, leaf, 0);
+#else
+		__cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+#endif
+	}
+
+	UINT64 ReadXcr0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		UINT32 low, high;
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<UINT64>(high) << 32) | low;
+#endif
+	}
+
+	KernelLevel DetectKernelLevel()
+	{
+		int info[4];
+		ReadCpuid(info, 0);
+		const int maxLeaf = info[0];
+
+		ReadCpuid(info, 1);
+		const bool ssse3 = (info[2] & (1 << 9)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		const bool f16c = (info[2] & (1 << 29)) != 0;
+		if (!ssse3) return KernelLevel::Scalar;
+
+		// AVX2 also needs the OS to save YMM registers
+		if (maxLeaf < 7 || !osxsave || !avx || !f16c || (ReadXcr0() & 0x6) != 0x6) return KernelLevel::Ssse3;
+
+		ReadCpuid(info, 7);
+		return (info[1] & (1 << 5)) ? KernelLevel::Avx2 : KernelLevel::Ssse3;
+	}
+
+	KernelLevel SupportedLevel()
+	{
+		static const KernelLevel level = DetectKernelLevel();
+		return level;
+	}
+
+	KernelLevel& ActiveLevel()
+	{
+		static KernelLevel level = SupportedLevel();
+		return level;
+	}
+
+	ExpandKernel SelectExpandKernel(UINT channels)
+	{
+		static const ExpandKernel kernels[3][4] =
+		{
+			{ ExpandGreyScalar, ExpandGreyAlphaScalar, ExpandRgbScalar, CopyRgba },
+			{ ExpandGreySsse3, ExpandGreyAlphaSsse3, ExpandRgbSsse3, CopyRgba },
+			{ ExpandGreyAvx2, ExpandGreyAlphaAvx2, ExpandRgbAvx2, CopyRgba }
+		};
+
+		return kernels[static_cast<int>(ActiveLevel())][channels - 1];
+	}
+
+	// Rows are split into bands of roughly BandTexels, converted in parallel
+	void ForEachBand(UINT width, UINT height, const std::function<void(size_t, size_t)>& convert)
+	{
+		if (width == 0 || height == 0) return;
+
+		const size_t rowsPerBand = (std::max)(static_cast<size_t>(1), BandTexels / width);
+		const UINT bandCount = static_cast<UINT>((height + rowsPerBand - 1) / rowsPerBand);
+		Utils::ParallelFor(bandCount, [&](UINT band)
+		{
+			const size_t firstRow = band * rowsPerBand;
+			const size_t rows = (std::min)(rowsPerBand, height - firstRow);
+			convert(firstRow * width, rows * width);
+		});
+	}
+}
+
+namespace TexelConvert
+{
+	void ToRgba8(const UINT8* source, UINT channels, UINT8* destination, UINT width, UINT height)
+	{
+		if (channels < 1 || channels > 4)
+		{
+			throw std::runtime_error("Error: unsupported texel channel count " + std::to_string(channels));
+		}
+
+		const ExpandKernel kernel = SelectExpandKernel(channels);
+		ForEachBand(width, height, [&](size_t first, size_t count)
+		{
+			kernel(source + first * channels, destination + first * 4, count);
+		});
+	}
+
+	void ToRgba16F(const UINT8* source, UINT16* destination, UINT width, UINT height, bool srgb)
+	{
+		// The gather and F16C conversion come with AVX2; without them a table lookup per channel is already the fastest
+		const HalfKernel kernel = (ActiveLevel() == KernelLevel::Avx2) ? ToHalfAvx2 : ToHalfScalar;
+		ForEachBand(width, height, [&](size_t first, size_t count)
+		{
+			kernel(source + first * 4, destination + first * 4, count, srgb);
+		});
+	}
+
+	KernelLevel GetKernelLevel()
+	{
+		return ActiveLevel();
+	}
+
+	void SetKernelLevel(KernelLevel level)
+	{
+		ActiveLevel() = (std::min)(level, SupportedLevel());
+	}
+}
\ No newline at end of file
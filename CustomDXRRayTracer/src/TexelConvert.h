@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Structures.h"
+
+enum class KernelLevel
+{
+	Scalar,
+	Ssse3,
+	Avx2
+};
+
+namespace TexelConvert
+{
+	// Expands 8-bit texels with 1 (grey), 2 (grey, alpha), 3 (RGB) or 4 (RGBA) channels to RGBA8
+	void ToRgba8(const UINT8* source, UINT channels, UINT8* destination, UINT width, UINT height);
+
+	// Converts RGBA8 to RGBA16F in [0, 1]. With srgb set the colour channels are decoded to linear; alpha never is.
+	void ToRgba16F(const UINT8* source, UINT16* destination, UINT width, UINT height, bool srgb);
+
+	// Kernels are picked from the CPU features on first use. Setting a level lowers it, e.g. to compare against the
+	// scalar kernels; levels the CPU does not support are clamped to the highest one it does.
+	KernelLevel GetKernelLevel();
+
+	void SetKernelLevel(KernelLevel level);
+}
\ No newline at end of file
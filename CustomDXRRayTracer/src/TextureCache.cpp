@@ -0,0 +1,228 @@
+#include "TextureCache.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "Utils.h"
+
+#include <atomic>
+
+namespace
+{
+	const UINT32 TextureCacheVersion = 2;
+	const size_t HashBlockSize = (16 << 20);
+
+	const UINT32 DdsMagic = 0x20534444;
+	const UINT32 DdsFourCcDx10 = 0x30315844;
+	const UINT32 DdsFlags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;
+	const UINT32 DdsPixelFormatFourCc = 0x4;
+	const UINT32 DdsCaps = 0x8 | 0x1000 | 0x400000;
+	const UINT32 DdsDimensionTexture2D = 3;
+	const UINT32 DdsPitchAlignedTag = 0x50544C41;	// "ALTP", rows padded to the upload pitch
+
+	std::atomic<UINT> hitCount(0);
+	std::atomic<UINT> missCount(0);
+	std::atomic<UINT64> bytesMapped(0);
+	std::atomic<UINT64> bytesWritten(0);
+
+	struct DdsPixelFormat
+	{
+		UINT32 size;
+		UINT32 flags;
+		UINT32 fourCC;
+		UINT32 rgbBitCount;
+		UINT32 masks[4];
+	};
+
+	struct DdsHeader
+	{
+		UINT32 magic;
+		UINT32 size;
+		UINT32 flags;
+		UINT32 height;
+		UINT32 width;
+		UINT32 linearSize;
+		UINT32 depth;
+		UINT32 mipLevels;
+		UINT32 reserved[11];
+		DdsPixelFormat pixelFormat;
+		UINT32 caps[4];
+		UINT32 reserved2;
+		UINT32 dxgiFormat;
+		UINT32 dimension;
+		UINT32 miscFlags;
+		UINT32 arraySize;
+		UINT32 miscFlags2;
+	};
+
+	inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	bool IsSupportedFormat(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC7_UNORM;
+	}
+}
+
+namespace TextureCache
+{
+	UINT64 ComputeKey(const UINT8* data, size_t size, UINT width, UINT height, const TextureOptions& options)
+	{
+		const UINT blockCount = static_cast<UINT>((size + HashBlockSize - 1) / HashBlockSize);
+		std::vector<UINT64> blockHashes(blockCount + 1);
+
+		Utils::ParallelFor(blockCount, [&](UINT i)
+		{
+			const size_t offset = i * HashBlockSize;
+			blockHashes[i] = Utils::Hash(data + offset, (std::min)(HashBlockSize, size - offset), i);
+		});
+
+		// Quality only matters to the block encoder, so uncompressed textures share an entry whatever it is set to
+		const UINT32 quality = (options.compression != TextureCompression::None) ? static_cast<UINT32>(options.quality) : 0;
+		const UINT32 settings[7] = { TextureCacheVersion, static_cast<UINT32>(size), width, height, static_cast<UINT32>(options.mipFilter), static_cast<UINT32>(options.compression), quality };
+		blockHashes[blockCount] = Utils::Hash(settings, sizeof(settings));
+
+		const UINT64 key = Utils::Hash(blockHashes.data(), blockHashes.size() * sizeof(UINT64));
+		return key ? key : 1;
+	}
+
+	std::string GetCachePath(UINT64 key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+		return std::string("cache/") + name + ".dds";
+	}
+
+	UINT64 GetLayout(UINT width, UINT height, UINT levelCount, DXGI_FORMAT format, std::vector<TextureLevelLayout>& levels)
+	{
+		const bool compressed = BlockCompressor::IsCompressed(format);
+		const UINT unit = compressed ? BlockCompressor::BlockSize : 1;
+		const UINT unitBytes = compressed ? BlockCompressor::GetBlockBytes(format) : 4;
+
+		levels.resize(levelCount);
+
+		// Like the runtime, the last row of a level is not padded before the next level is aligned
+		UINT64 size = 0;
+		for (UINT level = 0; level < levelCount; level++)
+		{
+			TextureLevelLayout& layout = levels[level];
+			layout.offset = AlignUp(size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			layout.rowSize = ((MipGenerator::GetMipSize(width, level) + unit - 1) / unit) * unitBytes;
+			layout.rowPitch = static_cast<UINT>(AlignUp(layout.rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT));
+			layout.rowCount = (MipGenerator::GetMipSize(height, level) + unit - 1) / unit;
+			size = layout.offset + static_cast<UINT64>(layout.rowPitch) * (layout.rowCount - 1) + layout.rowSize;
+		}
+
+		return size;
+	}
+
+	bool Load(UINT64 key, TextureInfo& texture)
+	{
+		std::shared_ptr<Utils::MappedFile> file = std::make_shared<Utils::MappedFile>();
+		if (!file->Open(GetCachePath(key)) || file->Size() < sizeof(DdsHeader))
+		{
+			missCount++;
+			return false;
+		}
+
+		DdsHeader header;
+		memcpy(&header, file->Data(), sizeof(header));
+
+		const DXGI_FORMAT format = static_cast<DXGI_FORMAT>(header.dxgiFormat);
+		bool valid = header.magic == DdsMagic && header.size == offsetof(DdsHeader, dxgiFormat) - sizeof(UINT32) && header.reserved[0] == DdsPitchAlignedTag;
+		valid = valid && header.pixelFormat.fourCC == DdsFourCcDx10 && header.dimension == DdsDimensionTexture2D && header.arraySize == 1;
+		valid = valid && header.width > 0 && header.height > 0 && header.mipLevels == MipGenerator::GetMipCount(header.width, header.height);
+		valid = valid && IsSupportedFormat(format);
+
+		std::vector<TextureLevelLayout> levels;
+		const UINT64 size = valid ? GetLayout(header.width, header.height, header.mipLevels, format, levels) : 0;
+		if (!valid || sizeof(DdsHeader) + size > file->Size())
+		{
+			missCount++;
+			return false;
+		}
+
+		texture.pixels.clear();
+		texture.width = static_cast<int>(header.width);
+		texture.height = static_cast<int>(header.height);
+		texture.stride = (format == DXGI_FORMAT_R8G8B8A8_UNORM) ? 4 : 0;
+		texture.mipLevels = static_cast<int>(header.mipLevels);
+		texture.format = format;
+		texture.mappedPixels = reinterpret_cast<const UINT8*>(file->Data()) + sizeof(DdsHeader);
+		texture.mappedSize = static_cast<size_t>(size);
+		texture.mapping = file;
+
+		hitCount++;
+		bytesMapped += size;
+		return true;
+	}
+
+	bool Save(UINT64 key, const TextureInfo& texture)
+	{
+		const UINT width = static_cast<UINT>(texture.width);
+		const UINT height = static_cast<UINT>(texture.height);
+		if (!IsSupportedFormat(texture.format)) return false;
+
+		std::vector<TextureLevelLayout> levels;
+		const UINT64 size = GetLayout(width, height, texture.mipLevels, texture.format, levels);
+
+		size_t packedSize = 0;
+		for (const TextureLevelLayout& layout : levels) packedSize += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+		if (texture.pixels.size() != packedSize) return false;
+
+		Utils::OutputFile file;
+		if (!file.Open(GetCachePath(key))) return false;
+
+		DdsHeader header = {};
+		header.magic = DdsMagic;
+		header.size = offsetof(DdsHeader, dxgiFormat) - sizeof(UINT32);
+		header.flags = DdsFlags;
+		header.height = height;
+		header.width = width;
+		header.linearSize = levels[0].rowPitch * levels[0].rowCount;
+		header.mipLevels = texture.mipLevels;
+		header.reserved[0] = DdsPitchAlignedTag;
+		header.pixelFormat.size = sizeof(DdsPixelFormat);
+		header.pixelFormat.flags = DdsPixelFormatFourCc;
+		header.pixelFormat.fourCC = DdsFourCcDx10;
+		header.caps[0] = DdsCaps;
+		header.dxgiFormat = texture.format;
+		header.dimension = DdsDimensionTexture2D;
+		header.arraySize = 1;
+
+		bool result = file.Write(&header, sizeof(header));
+
+		// Each level is padded in a staging buffer, up to where the next one starts, and written whole
+		std::vector<UINT8> staging;
+		const UINT8* level = texture.pixels.data();
+		for (size_t i = 0; i < levels.size() && result; i++)
+		{
+			const TextureLevelLayout& layout = levels[i];
+			const UINT64 end = (i + 1 < levels.size()) ? levels[i + 1].offset : size;
+
+			staging.assign(static_cast<size_t>(end - layout.offset), 0);
+			for (UINT row = 0; row < layout.rowCount; row++)
+			{
+				memcpy(staging.data() + static_cast<size_t>(row) * layout.rowPitch, level + static_cast<size_t>(row) * layout.rowSize, layout.rowSize);
+			}
+			level += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+
+			result = file.Write(staging.data(), staging.size());
+		}
+
+		if (!result || !file.Commit()) return false;
+
+		bytesWritten += sizeof(header) + size;
+		return true;
+	}
+
+	TextureCacheCounters GetCounters()
+	{
+		TextureCacheCounters counters;
+		counters.hits = hitCount;
+		counters.misses = missCount;
+		counters.bytesMapped = bytesMapped;
+		counters.bytesWritten = bytesWritten;
+		return counters;
+	}
+}
\ No newline at end of file
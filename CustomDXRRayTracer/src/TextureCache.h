@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Structures.h"
+
+struct TextureLevelLayout
+{
+	UINT64 offset = 0;
+	UINT rowPitch = 0;
+	UINT rowSize = 0;
+	UINT rowCount = 0;
+};
+
+struct TextureCacheCounters
+{
+	UINT hits = 0;
+	UINT misses = 0;
+	UINT64 bytesMapped = 0;
+	UINT64 bytesWritten = 0;
+};
+
+namespace TextureCache
+{
+	// Key of a source image, either its encoded file bytes or raw RGBA8 texels of the given size, together with the
+	// settings that shape its GPU form. The key does not depend on where the image came from, only on its contents.
+	UINT64 ComputeKey(const UINT8* data, size_t size, UINT width, UINT height, const TextureOptions& options);
+
+	std::string GetCachePath(UINT64 key);
+
+	// Places every level the way GetCopyableFootprints does in a buffer at offset zero: rows padded to
+	// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and levels starting on D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT. Returns the total size.
+	UINT64 GetLayout(UINT width, UINT height, UINT levelCount, DXGI_FORMAT format, std::vector<TextureLevelLayout>& levels);
+
+	// Cached textures are DDS files with a DX10 header and the full mip chain in the layout above, so the data is copied
+	// to the upload buffer as is. A tag in the reserved header words marks the padded rows, which generic DDS readers do not expect.
+	// A hit leaves the file mapped in the texture rather than copying it.
+	bool Load(UINT64 key, TextureInfo& texture);
+
+	// Writes a texture whose levels are packed tightly in pixels
+	bool Save(UINT64 key, const TextureInfo& texture);
+
+	TextureCacheCounters GetCounters();
+}
\ No newline at end of file
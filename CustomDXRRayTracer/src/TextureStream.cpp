@@ -0,0 +1,69 @@
+#include "TextureStream.h"
+
+void TextureStream::Start(const std::vector<TextureRequest>& requests, const TextureOptions& options, UINT workerCount)
+{
+	Stop();
+
+	m_Requests = requests;
+	m_Options = options;
+	m_Textures.assign(requests.size(), StreamedTexture());
+	m_CacheHits = 0;
+
+	if (workerCount == 0) workerCount = (std::max)(Utils::GetWorkerCount(), 2u) - 1;
+	m_Queue.Start(static_cast<UINT>(requests.size()), workerCount, [this](UINT32 request) { return Load(request); });
+}
+
+UINT64 TextureStream::Load(UINT request)
+{
+	StreamedTexture& streamed = m_Textures[request];
+	streamed.index = m_Requests[request].index;
+	streamed.texture = Utils::LoadTexture(m_Requests[request].source, m_Options, streamed.stats);
+
+	// Only the source material's own data is needed, and the mapping it holds can go now
+	m_Requests[request].source = Material();
+
+	if (streamed.stats.cacheHit) m_CacheHits++;
+	return GetBytes(streamed.texture);
+}
+
+bool TextureStream::Poll(std::vector<StreamedTexture>& textures, UINT64 maxBytes)
+{
+	textures.clear();
+	if (!m_Queue.Poll(m_Finished, maxBytes)) return false;
+
+	for (UINT32 request : m_Finished) textures.push_back(std::move(m_Textures[request]));
+	return true;
+}
+
+bool TextureStream::Wait(StreamedTexture& texture)
+{
+	UINT32 request = 0;
+	if (!m_Queue.Wait(request)) return false;
+
+	texture = std::move(m_Textures[request]);
+	return true;
+}
+
+void TextureStream::Stop()
+{
+	m_Queue.Stop();
+}
+
+bool TextureStream::IsFinished()
+{
+	return m_Queue.IsFinished();
+}
+
+TextureStreamStats TextureStream::GetStats()
+{
+	const LoadQueueStats queueStats = m_Queue.GetStats();
+
+	TextureStreamStats stats;
+	stats.textureCount = queueStats.itemCount;
+	stats.cacheHits = m_CacheHits;
+	stats.workerCount = queueStats.workerCount;
+	stats.bytes = queueStats.bytes;
+	stats.firstMilliseconds = queueStats.firstMilliseconds;
+	stats.milliseconds = queueStats.milliseconds;
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "LoadQueue.h"
+#include "Structures.h"
+#include "Utils.h"
+
+#include <atomic>
+
+// Bytes of loaded textures handed to the render thread per frame; a larger texture still goes on its own
+static const UINT64 TextureSwapBytesPerFrame = (64 << 20);
+
+// A texture to load for the given slot of the bindless range, from the material that first samples it
+struct TextureRequest
+{
+	UINT index = 0;
+	Material source;
+};
+
+// A texture loaded in its GPU form, waiting to replace the placeholder in its slot
+struct StreamedTexture
+{
+	UINT index = 0;
+	TextureInfo texture;
+	TextureLoadStats stats;
+};
+
+struct TextureStreamStats
+{
+	UINT textureCount = 0;
+	UINT cacheHits = 0;
+	UINT workerCount = 0;
+	UINT64 bytes = 0;
+	float firstMilliseconds = 0.f;	// Until the first texture was ready
+	float milliseconds = 0.f;		// Until the last one was
+};
+
+// Loads textures on a pool of background workers through a LoadQueue. The render thread polls for the finished ones at a
+// frame boundary and swaps them in for the placeholder bound meanwhile, so no frame waits on a decode.
+class TextureStream
+{
+public:
+	TextureStream() {}
+
+	~TextureStream()
+	{
+		Stop();
+	}
+
+	TextureStream(const TextureStream&) = delete;
+	TextureStream& operator=(const TextureStream&) = delete;
+
+	// A worker count of zero leaves one hardware thread to the render loop
+	void Start(const std::vector<TextureRequest>& requests, const TextureOptions& options, UINT workerCount = 0);
+
+	// Takes finished textures in the order they were finished, up to maxBytes of them but at least one.
+	// Rethrows a load error on the calling thread.
+	bool Poll(std::vector<StreamedTexture>& textures, UINT64 maxBytes = TextureSwapBytesPerFrame);
+
+	bool Wait(StreamedTexture& texture);
+
+	void Stop();
+
+	// Every request has been loaded and taken
+	bool IsFinished();
+
+	TextureStreamStats GetStats();
+
+	static UINT64 GetBytes(const TextureInfo& texture)
+	{
+		return texture.mappedPixels ? texture.mappedSize : texture.pixels.size();
+	}
+
+private:
+	UINT64 Load(UINT request);
+
+	std::vector<TextureRequest> m_Requests;
+	TextureOptions m_Options;
+
+	// One slot per request, written by the worker that loads it and moved out when it is handed over
+	std::vector<StreamedTexture> m_Textures;
+	std::vector<UINT32> m_Finished;
+	std::atomic<UINT> m_CacheHits{ 0 };
+
+	// Last, so its workers are stopped before the slots they write go
+	LoadQueue m_Queue;
+};
\ No newline at end of file
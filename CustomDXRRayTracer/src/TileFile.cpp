@@ -0,0 +1,253 @@
+#include "TileFile.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+const UINT TileFile::TileBytes;
+
+namespace
+{
+	const UINT32 TileFileMagic = 0x4C495456;	// "VTIL"
+	const UINT32 TileFileVersion = 1;
+
+	struct TileFileHeader
+	{
+		UINT32 magic;
+		UINT32 version;
+		UINT32 width;
+		UINT32 height;
+		UINT32 levelCount;
+		UINT32 format;
+		UINT32 tileWidth;
+		UINT32 tileHeight;
+		UINT64 tileCount;
+	};
+
+	struct TileFileLevel
+	{
+		UINT32 width;
+		UINT32 height;
+		UINT32 tilesX;
+		UINT32 tilesY;
+		UINT64 firstTile;
+	};
+
+	// Bytes per row of a tile and rows per tile, in block rows for compressed formats
+	void GetTileRows(DXGI_FORMAT format, UINT tileWidth, UINT tileHeight, UINT& rowBytes, UINT& rowCount)
+	{
+		const bool compressed = BlockCompressor::IsCompressed(format);
+		const UINT unit = compressed ? BlockCompressor::BlockSize : 1;
+		rowBytes = (tileWidth / unit) * (compressed ? BlockCompressor::GetBlockBytes(format) : 4);
+		rowCount = tileHeight / unit;
+	}
+
+	void GetLevels(UINT width, UINT height, UINT levelCount, UINT tileWidth, UINT tileHeight, std::vector<TileLevel>& levels, UINT64& tileCount)
+	{
+		levels.resize(levelCount);
+
+		tileCount = 0;
+		for (UINT i = 0; i < levelCount; i++)
+		{
+			TileLevel& level = levels[i];
+			level.width = MipGenerator::GetMipSize(width, i);
+			level.height = MipGenerator::GetMipSize(height, i);
+			level.tilesX = (level.width + tileWidth - 1) / tileWidth;
+			level.tilesY = (level.height + tileHeight - 1) / tileHeight;
+			level.firstTile = tileCount;
+			tileCount += static_cast<UINT64>(level.tilesX) * level.tilesY;
+		}
+	}
+}
+
+bool TileFile::GetTileShape(DXGI_FORMAT format, UINT& width, UINT& height)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+		width = 128;
+		height = 128;
+		return true;
+	case DXGI_FORMAT_BC1_UNORM:
+		width = 512;
+		height = 256;
+		return true;
+	case DXGI_FORMAT_BC7_UNORM:
+		width = 256;
+		height = 256;
+		return true;
+	default:
+		return false;
+	}
+}
+
+std::string TileFile::GetCachePath(UINT64 key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return std::string("cache/") + name + ".vtex";
+}
+
+bool TileFile::Write(const std::string& path, const TextureInfo& texture)
+{
+	UINT tileWidth, tileHeight;
+	if (!GetTileShape(texture.format, tileWidth, tileHeight)) return false;
+
+	const UINT width = static_cast<UINT>(texture.width);
+	const UINT height = static_cast<UINT>(texture.height);
+
+	std::vector<TextureLevelLayout> layouts;
+	TextureCache::GetLayout(width, height, texture.mipLevels, texture.format, layouts);
+
+	size_t packedSize = 0;
+	for (const TextureLevelLayout& layout : layouts) packedSize += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+	if (texture.pixels.size() != packedSize) return false;
+
+	std::vector<TileLevel> levels;
+	UINT64 tileCount = 0;
+	GetLevels(width, height, texture.mipLevels, tileWidth, tileHeight, levels, tileCount);
+
+	Utils::OutputFile file;
+	if (!file.Open(path)) return false;
+
+	// The header and level table take the first tile, so every tile after it starts on a 64 KB boundary
+	std::vector<UINT8> staging(TileBytes, 0);
+
+	TileFileHeader header = {};
+	header.magic = TileFileMagic;
+	header.version = TileFileVersion;
+	header.width = width;
+	header.height = height;
+	header.levelCount = texture.mipLevels;
+	header.format = texture.format;
+	header.tileWidth = tileWidth;
+	header.tileHeight = tileHeight;
+	header.tileCount = tileCount;
+	memcpy(staging.data(), &header, sizeof(header));
+
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		const TileFileLevel level = { levels[i].width, levels[i].height, levels[i].tilesX, levels[i].tilesY, levels[i].firstTile };
+		memcpy(staging.data() + sizeof(header) + i * sizeof(level), &level, sizeof(level));
+	}
+
+	bool result = file.Write(staging.data(), staging.size());
+
+	UINT tileRowBytes, tileRowCount;
+	GetTileRows(texture.format, tileWidth, tileHeight, tileRowBytes, tileRowCount);
+
+	// A row of tiles is cut out of the level in a staging buffer and written whole
+	const UINT8* source = texture.pixels.data();
+	for (size_t i = 0; i < levels.size() && result; i++)
+	{
+		const TextureLevelLayout& layout = layouts[i];
+		const TileLevel& level = levels[i];
+
+		for (UINT ty = 0; ty < level.tilesY && result; ty++)
+		{
+			staging.assign(static_cast<size_t>(level.tilesX) * TileBytes, 0);
+
+			const UINT firstRow = ty * tileRowCount;
+			const UINT rowCount = (std::min)(tileRowCount, layout.rowCount - firstRow);
+			Utils::ParallelFor(level.tilesX, [&](UINT tx)
+			{
+				const UINT firstByte = tx * tileRowBytes;
+				const UINT rowBytes = (std::min)(tileRowBytes, layout.rowSize - firstByte);
+				UINT8* tile = staging.data() + static_cast<size_t>(tx) * TileBytes;
+				for (UINT row = 0; row < rowCount; row++)
+				{
+					memcpy(tile + static_cast<size_t>(row) * tileRowBytes, source + static_cast<size_t>(firstRow + row) * layout.rowSize + firstByte, rowBytes);
+				}
+			});
+
+			result = file.Write(staging.data(), staging.size());
+		}
+
+		source += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+	}
+
+	return result && file.Commit();
+}
+
+bool TileFile::Open(const std::string& path)
+{
+	Close();
+
+	if (!m_File.Open(path) || m_File.Size() < TileBytes) return false;
+
+	TileFileHeader header;
+	memcpy(&header, m_File.Data(), sizeof(header));
+
+	const DXGI_FORMAT format = static_cast<DXGI_FORMAT>(header.format);
+	UINT tileWidth = 0, tileHeight = 0;
+	bool valid = header.magic == TileFileMagic && header.version == TileFileVersion && GetTileShape(format, tileWidth, tileHeight);
+	valid = valid && header.tileWidth == tileWidth && header.tileHeight == tileHeight;
+	valid = valid && header.width > 0 && header.height > 0 && header.levelCount == MipGenerator::GetMipCount(header.width, header.height);
+	if (!valid)
+	{
+		m_File.Close();
+		return false;
+	}
+
+	UINT64 tileCount = 0;
+	GetLevels(header.width, header.height, header.levelCount, tileWidth, tileHeight, m_Levels, tileCount);
+
+	// The level table must agree with the one derived from the header, and every tile must be in the file
+	for (UINT i = 0; i < header.levelCount && valid; i++)
+	{
+		TileFileLevel level;
+		memcpy(&level, m_File.Data() + sizeof(header) + i * sizeof(level), sizeof(level));
+		valid = level.width == m_Levels[i].width && level.height == m_Levels[i].height && level.tilesX == m_Levels[i].tilesX && level.tilesY == m_Levels[i].tilesY && level.firstTile == m_Levels[i].firstTile;
+	}
+
+	if (!valid || tileCount != header.tileCount || (tileCount + 1) * TileBytes > m_File.Size())
+	{
+		Close();
+		return false;
+	}
+
+	m_Tiles = reinterpret_cast<const UINT8*>(m_File.Data()) + TileBytes;
+	m_Width = header.width;
+	m_Height = header.height;
+	m_Format = format;
+	m_TileWidth = tileWidth;
+	m_TileHeight = tileHeight;
+	m_TileCount = tileCount;
+	return true;
+}
+
+void TileFile::Close()
+{
+	m_File.Close();
+	m_Tiles = nullptr;
+	m_Width = 0;
+	m_Height = 0;
+	m_Format = DXGI_FORMAT_UNKNOWN;
+	m_TileCount = 0;
+	m_Levels.clear();
+}
+
+const UINT8* TileFile::GetTile(UINT level, UINT x, UINT y) const
+{
+	const TileLevel& tiles = m_Levels[level];
+	return m_Tiles + (tiles.firstTile + static_cast<UINT64>(y) * tiles.tilesX + x) * TileBytes;
+}
+
+void TileFile::ReadRows(UINT level, UINT8* destination, UINT64 pitch) const
+{
+	std::vector<TextureLevelLayout> layouts;
+	TextureCache::GetLayout(m_Width, m_Height, level + 1, m_Format, layouts);
+	const TextureLevelLayout& layout = layouts[level];
+
+	UINT tileRowBytes, tileRowCount;
+	GetTileRows(m_Format, m_TileWidth, m_TileHeight, tileRowBytes, tileRowCount);
+
+	for (UINT row = 0; row < layout.rowCount; row++)
+	{
+		for (UINT tx = 0, firstByte = 0; firstByte < layout.rowSize; tx++, firstByte += tileRowBytes)
+		{
+			const UINT8* tile = GetTile(level, tx, row / tileRowCount);
+			memcpy(destination + row * pitch + firstByte, tile + static_cast<size_t>(row % tileRowCount) * tileRowBytes, (std::min)(tileRowBytes, layout.rowSize - firstByte));
+		}
+	}
+}
\ No newline at end of file
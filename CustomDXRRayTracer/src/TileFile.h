@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Structures.h"
+#include "Utils.h"
+
+struct TileLevel
+{
+	UINT width = 0;
+	UINT height = 0;
+	UINT tilesX = 0;
+	UINT tilesY = 0;
+	UINT64 firstTile = 0;
+};
+
+// A texture's mip chain stored as 64 KB tiles in the standard tile shape of its format, so a tile is copied into a
+// reserved resource as is. Every level is tiled, the ones smaller than a tile padded to a single tile; tiles are stored
+// level after level in row order, each on a 64 KB boundary, and read in place from the mapped file.
+class TileFile
+{
+public:
+	static const UINT TileBytes = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+
+	// Texels covered by one tile: 128x128 for RGBA8, 512x256 for BC1 and 256x256 for BC7
+	static bool GetTileShape(DXGI_FORMAT format, UINT& width, UINT& height);
+
+	static std::string GetCachePath(UINT64 key);
+
+	// Writes a texture whose levels are packed tightly in pixels
+	static bool Write(const std::string& path, const TextureInfo& texture);
+
+	TileFile() {}
+
+	TileFile(const TileFile&) = delete;
+	TileFile& operator=(const TileFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	UINT GetWidth() const
+	{
+		return m_Width;
+	}
+
+	UINT GetHeight() const
+	{
+		return m_Height;
+	}
+
+	UINT GetLevelCount() const
+	{
+		return static_cast<UINT>(m_Levels.size());
+	}
+
+	DXGI_FORMAT GetFormat() const
+	{
+		return m_Format;
+	}
+
+	UINT GetTileWidth() const
+	{
+		return m_TileWidth;
+	}
+
+	UINT GetTileHeight() const
+	{
+		return m_TileHeight;
+	}
+
+	UINT64 GetTileCount() const
+	{
+		return m_TileCount;
+	}
+
+	const TileLevel& GetLevel(UINT level) const
+	{
+		return m_Levels[level];
+	}
+
+	// Texels of one tile, row by row at the tile's row pitch
+	const UINT8* GetTile(UINT level, UINT x, UINT y) const;
+
+	// Gathers a level's rows (block rows for compressed formats) out of its tiles, rowSize bytes each, at the given pitch
+	void ReadRows(UINT level, UINT8* destination, UINT64 pitch) const;
+
+private:
+	Utils::MappedFile m_File;
+	const UINT8* m_Tiles = nullptr;
+	UINT m_Width = 0;
+	UINT m_Height = 0;
+	DXGI_FORMAT m_Format = DXGI_FORMAT_UNKNOWN;
+	UINT m_TileWidth = 0;
+	UINT m_TileHeight = 0;
+	UINT64 m_TileCount = 0;
+	std::vector<TileLevel> m_Levels;
+};
\ No newline at end of file
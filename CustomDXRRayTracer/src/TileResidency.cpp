@@ -0,0 +1,226 @@
+#include "TileResidency.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+const UINT TileResidency::InvalidSlot;
+
+void TileResidency::Reset(UINT slotCount)
+{
+	m_Textures.clear();
+	m_TileSlots.clear();
+	m_TileFrames.clear();
+
+	m_SlotTiles.assign(slotCount, InvalidSlot);
+	m_SlotPrev.assign(slotCount, InvalidSlot);
+	m_SlotNext.assign(slotCount, InvalidSlot);
+
+	// Free slots are handed out from the back, lowest first
+	m_FreeSlots.resize(slotCount);
+	for (UINT i = 0; i < slotCount; i++) m_FreeSlots[i] = slotCount - 1 - i;
+
+	m_Head = InvalidSlot;
+	m_Tail = InvalidSlot;
+	m_Frame = 0;
+}
+
+UINT TileResidency::AddTexture(UINT width, UINT height, UINT tileWidth, UINT tileHeight, UINT levelCount)
+{
+	TextureTiles texture;
+	texture.firstTile = GetTileCount();
+
+	for (UINT level = 0; level < levelCount; level++)
+	{
+		const UINT levelWidth = (std::max)(width >> level, 1u);
+		const UINT levelHeight = (std::max)(height >> level, 1u);
+		texture.levelFirstTiles.push_back(texture.tileCount);
+		texture.tilesX.push_back((levelWidth + tileWidth - 1) / tileWidth);
+		texture.tilesY.push_back((levelHeight + tileHeight - 1) / tileHeight);
+		texture.tileCount += texture.tilesX.back() * texture.tilesY.back();
+	}
+
+	m_TileSlots.resize(m_TileSlots.size() + texture.tileCount, InvalidSlot);
+	m_TileFrames.resize(m_TileFrames.size() + texture.tileCount, 0);
+	m_Textures.push_back(texture);
+
+	return texture.firstTile;
+}
+
+UINT TileResidency::GetTileIndex(UINT texture, UINT level, UINT x, UINT y) const
+{
+	const TextureTiles& tiles = m_Textures[texture];
+	return tiles.firstTile + tiles.levelFirstTiles[level] + y * tiles.tilesX[level] + x;
+}
+
+void TileResidency::GetTileLocation(UINT tile, UINT& texture, UINT& level, UINT& x, UINT& y) const
+{
+	auto textureIt = std::upper_bound(m_Textures.begin(), m_Textures.end(), tile, [](UINT value, const TextureTiles& tiles)
+	{
+		return value < tiles.firstTile;
+	});
+	texture = static_cast<UINT>(textureIt - m_Textures.begin()) - 1;
+
+	const TextureTiles& tiles = m_Textures[texture];
+	const UINT local = tile - tiles.firstTile;
+	level = static_cast<UINT>(std::upper_bound(tiles.levelFirstTiles.begin(), tiles.levelFirstTiles.end(), local) - tiles.levelFirstTiles.begin()) - 1;
+
+	const UINT offset = local - tiles.levelFirstTiles[level];
+	x = offset % tiles.tilesX[level];
+	y = offset / tiles.tilesX[level];
+}
+
+void TileResidency::Unlink(UINT slot)
+{
+	const UINT prev = m_SlotPrev[slot];
+	const UINT next = m_SlotNext[slot];
+	if (prev != InvalidSlot) m_SlotNext[prev] = next;
+	else m_Head = next;
+	if (next != InvalidSlot) m_SlotPrev[next] = prev;
+	else m_Tail = prev;
+
+	m_SlotPrev[slot] = InvalidSlot;
+	m_SlotNext[slot] = InvalidSlot;
+}
+
+void TileResidency::PushFront(UINT slot)
+{
+	m_SlotPrev[slot] = InvalidSlot;
+	m_SlotNext[slot] = m_Head;
+	if (m_Head != InvalidSlot) m_SlotPrev[m_Head] = slot;
+	else m_Tail = slot;
+	m_Head = slot;
+}
+
+ResidencyStats TileResidency::Update(const std::vector<UINT>& requested, UINT maxLoads, std::vector<TileMapping>& loads, std::vector<TileMapping>& evictions, std::vector<UINT>& changedTextures)
+{
+	Utils::Timer timer;
+	ResidencyStats stats;
+
+	loads.clear();
+	evictions.clear();
+	changedTextures.clear();
+
+	m_Frame++;
+
+	// A requested tile brings its coarser ancestors along, so a fallback is always close by while it loads.
+	// Tiles already marked this frame end the walk, their ancestors having been marked with them.
+	std::vector<std::pair<UINT, UINT>> missing;
+	for (UINT request : requested)
+	{
+		if (request >= GetTileCount()) continue;
+
+		UINT texture, level, x, y;
+		GetTileLocation(request, texture, level, x, y);
+		const TextureTiles& tiles = m_Textures[texture];
+
+		for (;;)
+		{
+			const UINT tile = GetTileIndex(texture, level, x, y);
+			if (m_TileFrames[tile] == m_Frame) break;
+
+			m_TileFrames[tile] = m_Frame;
+			stats.requested++;
+
+			const UINT slot = m_TileSlots[tile];
+			if (slot != InvalidSlot)
+			{
+				Unlink(slot);
+				PushFront(slot);
+			}
+			else
+			{
+				missing.push_back(std::make_pair(level, tile));
+			}
+
+			if (++level == tiles.tilesX.size()) break;
+			x = (std::min)(x >> 1, tiles.tilesX[level] - 1);
+			y = (std::min)(y >> 1, tiles.tilesY[level] - 1);
+		}
+	}
+
+	std::sort(missing.begin(), missing.end(), [](const std::pair<UINT, UINT>& a, const std::pair<UINT, UINT>& b)
+	{
+		return (a.first != b.first) ? a.first > b.first : a.second < b.second;
+	});
+
+	std::vector<bool> changed(m_Textures.size(), false);
+	auto markChanged = [&](UINT tile)
+	{
+		UINT texture, level, x, y;
+		GetTileLocation(tile, texture, level, x, y);
+		if (!changed[texture]) changedTextures.push_back(texture);
+		changed[texture] = true;
+	};
+
+	for (size_t i = 0; i < missing.size(); i++)
+	{
+		// Every slot in use holds a tile wanted this frame once the least recently used one was requested too
+		UINT slot = InvalidSlot;
+		if (loads.size() < maxLoads && !m_FreeSlots.empty())
+		{
+			slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else if (loads.size() < maxLoads && m_Tail != InvalidSlot && m_TileFrames[m_SlotTiles[m_Tail]] != m_Frame)
+		{
+			slot = m_Tail;
+			const UINT evicted = m_SlotTiles[slot];
+			Unlink(slot);
+			m_TileSlots[evicted] = InvalidSlot;
+
+			TileMapping eviction;
+			eviction.tile = evicted;
+			eviction.slot = slot;
+			evictions.push_back(eviction);
+			markChanged(evicted);
+		}
+		else
+		{
+			stats.deferred = static_cast<UINT>(missing.size() - i);
+			break;
+		}
+
+		const UINT tile = missing[i].second;
+		m_SlotTiles[slot] = tile;
+		m_TileSlots[tile] = slot;
+		PushFront(slot);
+
+		TileMapping load;
+		load.tile = tile;
+		load.slot = slot;
+		loads.push_back(load);
+		markChanged(tile);
+	}
+
+	stats.resident = GetSlotCount() - static_cast<UINT>(m_FreeSlots.size());
+	stats.loaded = static_cast<UINT>(loads.size());
+	stats.evicted = static_cast<UINT>(evictions.size());
+	stats.milliseconds = timer.ElapsedMillis();
+	return stats;
+}
+
+void TileResidency::GetMinLevelMap(UINT texture, std::vector<UINT>& map) const
+{
+	const TextureTiles& tiles = m_Textures[texture];
+	const UINT levelCount = static_cast<UINT>(tiles.tilesX.size());
+
+	map.resize(tiles.tilesX[0] * tiles.tilesY[0]);
+	for (UINT y = 0; y < tiles.tilesY[0]; y++)
+	{
+		for (UINT x = 0; x < tiles.tilesX[0]; x++)
+		{
+			// Coarse to fine, stopping at the first missing tile, as eviction can leave a finer tile resident after its
+			// ancestor has gone
+			UINT level = levelCount;
+			while (level > 0)
+			{
+				const UINT tileX = (std::min)(x >> (level - 1), tiles.tilesX[level - 1] - 1);
+				const UINT tileY = (std::min)(y >> (level - 1), tiles.tilesY[level - 1] - 1);
+				if (m_TileSlots[GetTileIndex(texture, level - 1, tileX, tileY)] == InvalidSlot) break;
+				level--;
+			}
+
+			map[y * tiles.tilesX[0] + x] = level;
+		}
+	}
+}
\ No newline at end of file
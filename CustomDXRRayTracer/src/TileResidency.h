@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Structures.h"
+
+struct TileMapping
+{
+	UINT tile = 0;
+	UINT slot = 0;
+};
+
+struct ResidencyStats
+{
+	UINT requested = 0;		// Tiles asked for this frame, their coarser ancestors included
+	UINT resident = 0;		// Tiles held once the update is done
+	UINT loaded = 0;
+	UINT evicted = 0;
+	UINT deferred = 0;		// Requested tiles left for a later frame by the load limit or the budget
+	float milliseconds = 0.f;
+};
+
+// Tracks which tiles of a set of virtual textures occupy which of a fixed number of physical slots. A texture's
+// standard levels are cut into tiles numbered across all textures, which is how the GPU reports the tiles it wants.
+// Each frame the requested tiles are marked used and the missing ones are given slots, coarse levels first, taking
+// free slots and then those of the least recently used tiles not wanted this frame. The caller maps and fills the
+// slots it is handed. Nothing here touches the GPU.
+class TileResidency
+{
+public:
+	static const UINT InvalidSlot = 0xFFFFFFFF;
+
+	TileResidency() {}
+
+	explicit TileResidency(UINT slotCount)
+	{
+		Reset(slotCount);
+	}
+
+	// Forgets every texture and tile
+	void Reset(UINT slotCount);
+
+	// Registers the tiled levels of a texture, finest first, and returns the number of its first tile
+	UINT AddTexture(UINT width, UINT height, UINT tileWidth, UINT tileHeight, UINT levelCount);
+
+	UINT GetTextureCount() const
+	{
+		return static_cast<UINT>(m_Textures.size());
+	}
+
+	UINT GetTileCount() const
+	{
+		return static_cast<UINT>(m_TileSlots.size());
+	}
+
+	UINT GetSlotCount() const
+	{
+		return static_cast<UINT>(m_SlotTiles.size());
+	}
+
+	UINT GetTileIndex(UINT texture, UINT level, UINT x, UINT y) const;
+
+	void GetTileLocation(UINT tile, UINT& texture, UINT& level, UINT& x, UINT& y) const;
+
+	// Slot holding a tile, or InvalidSlot
+	UINT GetSlot(UINT tile) const
+	{
+		return m_TileSlots[tile];
+	}
+
+	// Marks a frame's requested tiles used and hands out slots for up to maxLoads missing ones. Slots taken from
+	// evicted tiles are listed in evictions before they are reused in loads, and every texture either touches is
+	// added to changedTextures once.
+	ResidencyStats Update(const std::vector<UINT>& requested, UINT maxLoads, std::vector<TileMapping>& loads, std::vector<TileMapping>& evictions, std::vector<UINT>& changedTextures);
+
+	// Finest level over each tile of a texture's top level, in row order, that is resident along with every coarser
+	// tiled level under it, or the level count where the coarsest tile is missing
+	void GetMinLevelMap(UINT texture, std::vector<UINT>& map) const;
+
+private:
+	struct TextureTiles
+	{
+		UINT firstTile = 0;
+		UINT tileCount = 0;
+		std::vector<UINT> tilesX;
+		std::vector<UINT> tilesY;
+		std::vector<UINT> levelFirstTiles;
+	};
+
+	void Unlink(UINT slot);
+	void PushFront(UINT slot);
+
+	std::vector<TextureTiles> m_Textures;
+
+	// Page table: the slot of every tile and the last frame it was requested in
+	std::vector<UINT> m_TileSlots;
+	std::vector<UINT> m_TileFrames;
+
+	// Tile held by every slot, and the slots in use as a list from most to least recently used
+	std::vector<UINT> m_SlotTiles;
+	std::vector<UINT> m_SlotPrev;
+	std::vector<UINT> m_SlotNext;
+	std::vector<UINT> m_FreeSlots;
+	UINT m_Head = InvalidSlot;
+	UINT m_Tail = InvalidSlot;
+	UINT m_Frame = 0;
+};
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "UploadManager.h"
+#include "BlockCompressor.h"
+#include "Graphics.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+void UploadManager::Init(ID3D12Device5* device, ID3D12CommandQueue* queue, UINT64 capacity)
+{
+	Release();
+
+	m_Device = device;
+	m_Queue = queue;
+	m_Capacity = capacity;
+}
+
+void UploadManager::Create()
+{
+	if (m_Ring) return;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	desc.Width = m_Capacity;
+	desc.Height = 1;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = DXGI_FORMAT_UNKNOWN;
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+	HRESULT hr = m_Device->CreateCommittedResource(&UploadHeapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_Ring));
+	Utils::Validate(hr, L"Error: failed to create upload ring");
+
+#if NAME_D3D_RESOURCES
+	m_Ring->SetName(L"Upload Ring");
+#endif
+
+	// The ring stays mapped for its whole life; the CPU only writes ranges the GPU is done with
+	D3D12_RANGE readRange = {};
+	hr = m_Ring->Map(0, &readRange, reinterpret_cast<void**>(&m_RingData));
+	Utils::Validate(hr, L"Error: failed to map upload ring");
+
+	for (UINT i = 0; i < UploadListCount; i++)
+	{
+		hr = m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_CmdAllocs[i]));
+		Utils::Validate(hr, L"Error: failed to create upload command allocator");
+		m_CmdAllocFences[i] = 0;
+	}
+
+	hr = m_Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_CmdAllocs[0], nullptr, IID_PPV_ARGS(&m_CmdList));
+	Utils::Validate(hr, L"Error: failed to create upload command list");
+
+	hr = m_CmdList->Close();
+	Utils::Validate(hr, L"Error: failed to close upload command list");
+
+	hr = m_Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence));
+	Utils::Validate(hr, L"Error: failed to create upload fence");
+
+	m_FenceEvent = CreateEventEx(nullptr, FALSE, FALSE, EVENT_ALL_ACCESS);
+	if (m_FenceEvent == nullptr)
+	{
+		Utils::Validate(HRESULT_FROM_WIN32(GetLastError()), L"Error: failed to create upload fence event");
+	}
+
+	m_FenceValue = 0;
+	m_CmdAllocIndex = 0;
+	m_Recording = false;
+	m_Allocator.Reset(m_Capacity);
+}
+
+UINT8* UploadManager::Allocate(UINT64 size, UINT64 alignment, UINT64& offset)
+{
+	Create();
+
+	if (m_Allocator.GetOpenBytes() >= UploadChunkBytes) Submit();
+
+	m_Allocator.Retire(m_Fence->GetCompletedValue());
+	while (!m_Allocator.Allocate(size, alignment, offset))
+	{
+		// Copies recorded so far hold space the ring needs back, so they go to the GPU before anything is waited on
+		if (m_Allocator.GetOpenBytes() > 0)
+		{
+			Submit();
+			continue;
+		}
+
+		const UINT64 pendingFence = m_Allocator.GetPendingFence();
+		if (pendingFence == 0)
+		{
+			throw std::runtime_error("Error: upload does not fit in the upload ring");
+		}
+
+		Utils::Timer timer;
+		WaitForFence(pendingFence);
+		m_Allocator.Retire(m_Fence->GetCompletedValue());
+
+		m_Stats.stallCount++;
+		m_Stats.milliseconds += timer.ElapsedMillis();
+	}
+
+	m_Stats.bytes += size;
+	m_Stats.chunkCount++;
+	return m_RingData + offset;
+}
+
+void UploadManager::Begin()
+{
+	if (m_Recording) return;
+
+	// Command allocators are reused in turn, once the copies last recorded with them have finished
+	WaitForFence(m_CmdAllocFences[m_CmdAllocIndex]);
+
+	HRESULT hr = m_CmdAllocs[m_CmdAllocIndex]->Reset();
+	Utils::Validate(hr, L"Error: failed to reset upload command allocator");
+
+	hr = m_CmdList->Reset(m_CmdAllocs[m_CmdAllocIndex], nullptr);
+	Utils::Validate(hr, L"Error: failed to reset upload command list");
+
+	m_Recording = true;
+}
+
+void UploadManager::WaitForFence(UINT64 fenceValue)
+{
+	if (m_Fence->GetCompletedValue() >= fenceValue) return;
+
+	HRESULT hr = m_Fence->SetEventOnCompletion(fenceValue, m_FenceEvent);
+	Utils::Validate(hr, L"Error: failed to set upload fence event");
+
+	WaitForSingleObjectEx(m_FenceEvent, INFINITE, FALSE);
+}
+
+void UploadManager::UploadTexture(ID3D12Resource* destination, const TextureInfo& texture)
+{
+	const D3D12_RESOURCE_DESC desc = destination->GetDesc();
+	const UINT levelCount = desc.MipLevels;
+	const UINT unit = BlockCompressor::IsCompressed(desc.Format) ? BlockCompressor::BlockSize : 1;
+
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(levelCount);
+	std::vector<UINT> rowCounts(levelCount);
+	std::vector<UINT64> rowSizes(levelCount);
+	m_Device->GetCopyableFootprints(&desc, 0, levelCount, 0, footprints.data(), rowCounts.data(), rowSizes.data(), nullptr);
+
+	// Mapped cache files keep each level at the upload pitch; in memory the levels are packed tightly
+	std::vector<TextureLevelLayout> levels;
+	if (texture.mappedPixels) TextureCache::GetLayout(static_cast<UINT>(texture.width), static_cast<UINT>(texture.height), levelCount, desc.Format, levels);
+
+	const UINT8* packed = texture.pixels.data();
+	for (UINT i = 0; i < levelCount; i++)
+	{
+		const D3D12_SUBRESOURCE_FOOTPRINT& footprint = footprints[i].Footprint;
+		const UINT64 sourcePitch = texture.mappedPixels ? levels[i].rowPitch : rowSizes[i];
+		const UINT8* level = texture.mappedPixels ? texture.mappedPixels + levels[i].offset : packed;
+		const UINT bandRows = static_cast<UINT>((std::max)(static_cast<UINT64>(1), (std::min)(static_cast<UINT64>(rowCounts[i]), UploadChunkBytes / footprint.RowPitch)));
+
+		for (UINT row = 0; row < rowCounts[i]; row += bandRows)
+		{
+			const UINT rows = (std::min)(bandRows, rowCounts[i] - row);
+			const UINT8* source = level + row * sourcePitch;
+
+			UINT64 offset = 0;
+			UINT8* data = Allocate(static_cast<UINT64>(footprint.RowPitch) * rows, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, offset);
+			if (sourcePitch == footprint.RowPitch)
+			{
+				memcpy(data, source, static_cast<size_t>(footprint.RowPitch) * (rows - 1) + rowSizes[i]);
+			}
+			else
+			{
+				for (UINT r = 0; r < rows; r++) memcpy(data + static_cast<size_t>(r) * footprint.RowPitch, source + r * sourcePitch, rowSizes[i]);
+			}
+
+			D3D12_TEXTURE_COPY_LOCATION src = {};
+			src.pResource = m_Ring;
+			src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+			src.PlacedFootprint.Offset = offset;
+			src.PlacedFootprint.Footprint = footprint;
+			src.PlacedFootprint.Footprint.Height = (row + rows == rowCounts[i]) ? footprint.Height - row * unit : rows * unit;
+
+			D3D12_TEXTURE_COPY_LOCATION dest = {};
+			dest.pResource = destination;
+			dest.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+			dest.SubresourceIndex = i;
+
+			Begin();
+			m_CmdList->CopyTextureRegion(&dest, 0, row * unit, 0, &src, nullptr);
+		}
+
+		packed += rowCounts[i] * rowSizes[i];
+	}
+
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	barrier.Transition.pResource = destination;
+	barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+	barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+	Begin();
+	m_CmdList->ResourceBarrier(1, &barrier);
+}
+
+void UploadManager::UploadBuffer(ID3D12Resource* destination, size_t elementCount, UINT elementSize, const std::function<void(UINT8*, size_t, size_t)>& write)
+{
+	const size_t chunkElements = static_cast<size_t>((std::max)(static_cast<UINT64>(1), UploadChunkBytes / elementSize));
+	for (size_t first = 0; first < elementCount; first += chunkElements)
+	{
+		const size_t count = (std::min)(chunkElements, elementCount - first);
+		const UINT64 size = static_cast<UINT64>(count) * elementSize;
+
+		UINT64 offset = 0;
+		UINT8* data = Allocate(size, 16, offset);
+		write(data, first, count);
+
+		Begin();
+		m_CmdList->CopyBufferRegion(destination, static_cast<UINT64>(first) * elementSize, m_Ring, offset, size);
+	}
+}
+
+void UploadManager::UploadBuffer(ID3D12Resource* destination, const void* data, UINT64 size)
+{
+	const UINT8* bytes = static_cast<const UINT8*>(data);
+	UploadBuffer(destination, static_cast<size_t>(size), 1, [bytes](UINT8* chunk, size_t first, size_t count)
+	{
+		memcpy(chunk, bytes + first, count);
+	});
+}
+
+void UploadManager::Submit()
+{
+	if (!m_Recording) return;
+
+	HRESULT hr = m_CmdList->Close();
+	Utils::Validate(hr, L"Error: failed to close upload command list");
+
+	ID3D12CommandList* cmdList = m_CmdList;
+	m_Queue->ExecuteCommandLists(1, &cmdList);
+
+	m_FenceValue++;
+	hr = m_Queue->Signal(m_Fence, m_FenceValue);
+	Utils::Validate(hr, L"Error: failed to signal upload fence");
+
+	m_Allocator.Submit(m_FenceValue);
+	m_CmdAllocFences[m_CmdAllocIndex] = m_FenceValue;
+	m_CmdAllocIndex = (m_CmdAllocIndex + 1) % UploadListCount;
+	m_Recording = false;
+
+	m_Stats.submitCount++;
+}
+
+void UploadManager::Release()
+{
+	if (!m_Ring) return;
+
+	Submit();
+	WaitForFence(m_FenceValue);
+
+	m_Ring->Unmap(0, nullptr);
+	m_RingData = nullptr;
+
+	SAFE_RELEASE(m_Ring);
+	SAFE_RELEASE(m_CmdList);
+	for (UINT i = 0; i < UploadListCount; i++) SAFE_RELEASE(m_CmdAllocs[i]);
+	SAFE_RELEASE(m_Fence);
+
+	CloseHandle(m_FenceEvent);
+	m_FenceEvent = NULL;
+
+	m_Allocator.Reset(0);
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Structures.h"
+#include "RingAllocator.h"
+
+#include <functional>
+
+static const UINT64 UploadRingBytes = (32ull << 20);
+// Recorded copies are submitted once they hold this much of the ring, so the GPU drains one piece while the next is filled
+static const UINT64 UploadChunkBytes = (8ull << 20);
+static const UINT UploadListCount = 4;
+
+struct UploadStats
+{
+	UINT64 bytes = 0;
+	UINT chunkCount = 0;
+	UINT submitCount = 0;
+	UINT stallCount = 0;
+	float milliseconds = 0.f;	// Time spent waiting for the GPU to free ring space
+};
+
+// Streams textures and buffers into default heap resources through one fixed-size upload ring. Copies are recorded on
+// command lists of its own and submitted to the main queue, ahead of any work that reads the results, and the ring
+// space of each submission is reclaimed once its fence completes. The ring, command lists and fence are created on
+// first use and freed by Release, so no upload memory stays alive after loading.
+class UploadManager
+{
+public:
+	UploadManager() {}
+
+	~UploadManager()
+	{
+		Release();
+	}
+
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	void Init(ID3D12Device5* device, ID3D12CommandQueue* queue, UINT64 capacity = UploadRingBytes);
+
+	// Copies every level of a texture created in the copy destination state, in row bands that fit the ring,
+	// then makes it readable by shaders
+	void UploadTexture(ID3D12Resource* destination, const TextureInfo& texture);
+
+	// Fills a buffer in pieces of whole elements; write receives ring memory for count elements starting at first
+	void UploadBuffer(ID3D12Resource* destination, size_t elementCount, UINT elementSize, const std::function<void(UINT8*, size_t, size_t)>& write);
+
+	void UploadBuffer(ID3D12Resource* destination, const void* data, UINT64 size);
+
+	// Sends the recorded copies to the queue; later submissions to the queue see their results
+	void Submit();
+
+	// Submits and waits for every copy, then frees the ring and command lists
+	void Release();
+
+	const UploadStats& GetStats() const
+	{
+		return m_Stats;
+	}
+
+	void ResetStats()
+	{
+		m_Stats = UploadStats();
+	}
+
+private:
+	void Create();
+
+	UINT8* Allocate(UINT64 size, UINT64 alignment, UINT64& offset);
+
+	void Begin();
+
+	void WaitForFence(UINT64 fenceValue);
+
+	ID3D12Device5* m_Device = nullptr;
+	ID3D12CommandQueue* m_Queue = nullptr;
+	UINT64 m_Capacity = UploadRingBytes;
+
+	ID3D12Resource* m_Ring = nullptr;
+	UINT8* m_RingData = nullptr;
+	RingAllocator m_Allocator;
+
+	ID3D12GraphicsCommandList* m_CmdList = nullptr;
+	ID3D12CommandAllocator* m_CmdAllocs[UploadListCount] = {};
+	UINT64 m_CmdAllocFences[UploadListCount] = {};
+	UINT m_CmdAllocIndex = 0;
+	bool m_Recording = false;
+
+	ID3D12Fence* m_Fence = nullptr;
+	UINT64 m_FenceValue = 0;
+	HANDLE m_FenceEvent = NULL;
+
+	UploadStats m_Stats;
+};
\ No newline at end of file
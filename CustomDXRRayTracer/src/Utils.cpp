@@ -1,47 +1,176 @@
-#pragma once
-
 #include "Utils.h"
+#include "JpegBands.h"
+#include "MeshCache.h"
+#include "MeshCleaner.h"
+#include "MeshOptimizer.h"
+#include "MeshPartitioner.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include "PlyLoader.h"
+#include "TangentSpace.h"
+#include "TexelConvert.h"
+#include "TextureCache.h"
+#include "TileFile.h"
+#include "VertexWelder.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
-
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
 #include <shellapi.h>
-#include <unordered_map>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-namespace std
+using namespace std;
+
+namespace
 {
-	void hash_combine(size_t& seed, size_t hash)
+	// One ParallelFor call. Its indices are claimed by the calling thread and by every pool thread that picks it up.
+	struct ParallelJob
 	{
-		hash += 0x9e3779b9 + (seed << 6) + (seed >> 2);
-		seed ^= hash;
-	}
+		const function<void(UINT)>* task = nullptr;
+		UINT count = 0;
+		atomic<UINT> next{ 0 };
+		atomic<UINT> finished{ 0 };
+		atomic<bool> failed{ false };
+		exception_ptr error;
+	};
 
-	template<> struct hash<Vertex>
+	class ThreadPool
 	{
-		size_t operator()(Vertex const& vertex) const
+	public:
+		~ThreadPool()
+		{
+			Resize(0);
+		}
+
+		void Resize(UINT threadCount)
+		{
+			{
+				lock_guard<mutex> lock(m_Mutex);
+				m_Stop = true;
+			}
+
+			m_Work.notify_all();
+			for (thread& worker : m_Threads) worker.join();
+			m_Threads.clear();
+
+			m_Stop = false;
+			for (UINT i = 0; i < threadCount; i++) m_Threads.emplace_back(&ThreadPool::Work, this);
+		}
+
+		void Run(const shared_ptr<ParallelJob>& job)
 		{
-			size_t seed = 0;
-			hash<float> hasher;
-			hash_combine(seed, hasher(vertex.position.x));
-			hash_combine(seed, hasher(vertex.position.y));
-			hash_combine(seed, hasher(vertex.position.z));
+			{
+				lock_guard<mutex> lock(m_Mutex);
+				m_Jobs.push_back(job);
+			}
 
-			hash_combine(seed, hasher(vertex.uv.x));
-			hash_combine(seed, hasher(vertex.uv.y));
+			if (job->count - 1 < m_Threads.size())
+			{
+				for (UINT i = 1; i < job->count; i++) m_Work.notify_one();
+			}
+			else
+			{
+				m_Work.notify_all();
+			}
+
+			Execute(*job);
+
+			unique_lock<mutex> lock(m_Mutex);
+			m_Done.wait(lock, [&]() { return job->finished == job->count; });
+		}
+
+	private:
+		void Execute(ParallelJob& job)
+		{
+			for (UINT i = job.next++; i < job.count; i = job.next++)
+			{
+				if (!job.failed)
+				{
+					try
+					{
+						(*job.task)(i);
+					}
+					catch (...)
+					{
+						if (!job.failed.exchange(true)) job.error = current_exception();
+					}
+				}
+
+				if (++job.finished == job.count)
+				{
+					lock_guard<mutex> lock(m_Mutex);
+					m_Done.notify_all();
+				}
+			}
+		}
+
+		void Work()
+		{
+			unique_lock<mutex> lock(m_Mutex);
+			while (true)
+			{
+				m_Work.wait(lock, [this]() { return m_Stop || !m_Jobs.empty(); });
+				if (m_Stop) return;
+
+				// A job every index of which has been claimed is dropped; its callers wait for the rest on their own
+				shared_ptr<ParallelJob> job = m_Jobs.front();
+				if (job->next >= job->count)
+				{
+					m_Jobs.pop_front();
+					continue;
+				}
 
-			return seed;
+				lock.unlock();
+				Execute(*job);
+				lock.lock();
+			}
 		}
+
+		vector<thread> m_Threads;
+		mutex m_Mutex;
+		condition_variable m_Work;
+		condition_variable m_Done;
+		deque<shared_ptr<ParallelJob>> m_Jobs;
+		bool m_Stop = false;
 	};
-}
 
-using namespace std;
+	UINT g_WorkerCount = 0;
+
+	ThreadPool& GetThreadPool()
+	{
+		static ThreadPool pool;
+		static once_flag started;
+		call_once(started, []() { pool.Resize(Utils::GetWorkerCount() - 1); });
+		return pool;
+	}
+
+#ifndef _WIN32
+	string NativePath(string filepath)
+	{
+		replace(filepath.begin(), filepath.end(), '\\', '/');
+		return filepath;
+	}
+#endif
+}
 
 namespace Utils
 {
+#ifdef _WIN32
 	HRESULT ParseCommandLine(LPWSTR lpCmdLine, ConfigInfo& config)
 	{
 		LPWSTR* argv = NULL;
@@ -87,6 +216,54 @@ namespace Utils
 					continue;
 				}
 
+				if (!strcmp(str, "-compactVertices"))
+				{
+					wcstombs(str, argv[i], 256);
+					i++;
+					config.compactVertices = (atoi(str) > 0);
+					continue;
+				}
+
+				// -mipFilter box|kaiser|lanczos picks the filter texture mip chains are built with
+				if (!strcmp(str, "-mipFilter"))
+				{
+					wcstombs(str, argv[i], 256);
+					i++;
+					if (!strcmp(str, "kaiser")) config.mipFilter = MipFilter::Kaiser;
+					else if (!strcmp(str, "lanczos")) config.mipFilter = MipFilter::Lanczos;
+					else config.mipFilter = MipFilter::Box;
+					continue;
+				}
+
+				// -compression none|bc1|bc7 [fast|normal|high] block-compresses textures, caching the result on disk
+				if (!strcmp(str, "-compression"))
+				{
+					wcstombs(str, argv[i], 256);
+					i++;
+					if (!strcmp(str, "bc1")) config.textureCompression = TextureCompression::BC1;
+					else if (!strcmp(str, "bc7")) config.textureCompression = TextureCompression::BC7;
+					else config.textureCompression = TextureCompression::None;
+
+					if (i < argc && argv[i][0] != L'-')
+					{
+						wcstombs(str, argv[i], 256);
+						i++;
+						if (!strcmp(str, "fast")) config.compressionQuality = CompressionQuality::Fast;
+						else if (!strcmp(str, "high")) config.compressionQuality = CompressionQuality::High;
+						else config.compressionQuality = CompressionQuality::Normal;
+					}
+					continue;
+				}
+
+				// -tileBudget <MB> sizes the heap that tiles of streamed textures are mapped from
+				if (!strcmp(str, "-tileBudget"))
+				{
+					wcstombs(str, argv[i], 256);
+					i++;
+					config.tileBudget = static_cast<UINT>((std::max)(atoi(str), 1));
+					continue;
+				}
+
 				if (!strcmp(str, "-model"))
 				{
 					wcstombs(str, argv[i], 256);
@@ -94,6 +271,15 @@ namespace Utils
 					config.model = str;
 					continue;
 				}
+
+				// -environment <file.hdr> lights the scene with a lat-long environment map, importance-sampled
+				if (!strcmp(str, "-environment"))
+				{
+					wcstombs(str, argv[i], 256);
+					i++;
+					config.environment = str;
+					continue;
+				}
 			}
 		}
 		else
@@ -114,87 +300,658 @@ namespace Utils
 			PostQuitMessage(EXIT_FAILURE);
 		}
 	}
+#endif
+
+	UINT GetWorkerCount()
+	{
+		return g_WorkerCount ? g_WorkerCount : (std::max)(1u, std::thread::hardware_concurrency());
+	}
+
+	void SetWorkerCount(UINT workerCount)
+	{
+		g_WorkerCount = workerCount;
+		GetThreadPool().Resize(GetWorkerCount() - 1);
+	}
+
+	void ParallelFor(UINT count, const std::function<void(UINT)>& task)
+	{
+		if (count <= 1 || GetWorkerCount() <= 1)
+		{
+			for (UINT i = 0; i < count; i++) task(i);
+			return;
+		}
+
+		shared_ptr<ParallelJob> job = make_shared<ParallelJob>();
+		job->task = &task;
+		job->count = count;
+
+		GetThreadPool().Run(job);
+		if (job->error) rethrow_exception(job->error);
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const string& filepath)
+	{
+		Close();
+
+		m_File = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_File == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size = {};
+		if (!GetFileSizeEx(m_File, &size))
+		{
+			Close();
+			return false;
+		}
+
+		FILETIME modifiedTime = {};
+		GetFileTime(m_File, NULL, NULL, &modifiedTime);
+
+		m_Size = static_cast<UINT64>(size.QuadPart);
+		m_ModifiedTime = (static_cast<UINT64>(modifiedTime.dwHighDateTime) << 32) | modifiedTime.dwLowDateTime;
+		if (m_Size == 0) return true;
+
+		m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_Mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+
+		m_Data = static_cast<const char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+		if (m_Data == nullptr)
+		{
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_Data) UnmapViewOfFile(m_Data);
+		if (m_Mapping != NULL) CloseHandle(m_Mapping);
+		if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+
+		m_Data = nullptr;
+		m_Mapping = NULL;
+		m_File = INVALID_HANDLE_VALUE;
+		m_Size = 0;
+		m_ModifiedTime = 0;
+	}
+
+	bool OutputFile::Open(const string& filepath)
+	{
+		Discard();
+
+		const size_t separator = filepath.find_last_of("/\\");
+		if (separator != string::npos) CreateDirectoryA(filepath.substr(0, separator).c_str(), NULL);
+
+		m_Path = filepath;
+		m_TempPath = filepath + ".tmp";
+		m_File = CreateFileA(m_TempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		return m_File != INVALID_HANDLE_VALUE;
+	}
+
+	bool OutputFile::Write(const void* data, UINT64 size)
+	{
+		if (m_File == INVALID_HANDLE_VALUE) return false;
+
+		const UINT8* p = static_cast<const UINT8*>(data);
+		while (size > 0)
+		{
+			DWORD written = 0;
+			DWORD count = static_cast<DWORD>((std::min)(size, static_cast<UINT64>(1 << 30)));
+			if (!WriteFile(m_File, p, count, &written, NULL) || written != count) return false;
+
+			p += count;
+			size -= count;
+		}
+
+		return true;
+	}
+
+	bool OutputFile::Commit()
+	{
+		if (m_File == INVALID_HANDLE_VALUE) return false;
+
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+
+		if (!MoveFileExA(m_TempPath.c_str(), m_Path.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			DeleteFileA(m_TempPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
 
-	void LoadModel(string filepath, Model& model, Material& material)
+	void OutputFile::Discard()
+	{
+		if (m_File == INVALID_HANDLE_VALUE) return;
+
+		CloseHandle(m_File);
+		DeleteFileA(m_TempPath.c_str());
+		m_File = INVALID_HANDLE_VALUE;
+	}
+#else
+	bool MappedFile::Open(const string& filepath)
 	{
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string err;
+		Close();
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filepath.c_str(), "materials\\"))
+		const int file = open(NativePath(filepath).c_str(), O_RDONLY);
+		if (file < 0) return false;
+
+		struct stat status;
+		if (fstat(file, &status) != 0)
+		{
+			close(file);
+			return false;
+		}
+
+		m_Size = static_cast<UINT64>(status.st_size);
+		m_ModifiedTime = static_cast<UINT64>(status.st_mtim.tv_sec) * 1000000000ull + static_cast<UINT64>(status.st_mtim.tv_nsec);
+
+		// The mapping keeps the file open on its own
+		if (m_Size > 0)
 		{
-			throw std::runtime_error(err);
+			void* data = mmap(nullptr, static_cast<size_t>(m_Size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED) m_Data = static_cast<const char*>(data);
 		}
 
-		material.name = materials[0].name;
-		material.texturePath = materials[0].diffuse_texname;
+		close(file);
 
-		unordered_map<Vertex, uint32_t> uniqueVertices = {};
-		for (const auto& shape : shapes)
+		if (m_Size > 0 && m_Data == nullptr)
 		{
-			for (const auto& index : shape.mesh.indices)
+			Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_Data) munmap(const_cast<char*>(m_Data), static_cast<size_t>(m_Size));
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_ModifiedTime = 0;
+	}
+
+	bool OutputFile::Open(const string& filepath)
+	{
+		Discard();
+
+		m_Path = NativePath(filepath);
+		m_TempPath = m_Path + ".tmp";
+
+		const size_t separator = m_Path.find_last_of('/');
+		if (separator != string::npos) mkdir(m_Path.substr(0, separator).c_str(), 0755);
+
+		m_File = open(m_TempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		return m_File >= 0;
+	}
+
+	bool OutputFile::Write(const void* data, UINT64 size)
+	{
+		if (m_File < 0) return false;
+
+		const UINT8* p = static_cast<const UINT8*>(data);
+		while (size > 0)
+		{
+			const ssize_t written = write(m_File, p, static_cast<size_t>((std::min)(size, static_cast<UINT64>(1 << 30))));
+			if (written <= 0) return false;
+
+			p += written;
+			size -= static_cast<UINT64>(written);
+		}
+
+		return true;
+	}
+
+	bool OutputFile::Commit()
+	{
+		if (m_File < 0) return false;
+
+		const bool closed = (close(m_File) == 0);
+		m_File = -1;
+
+		if (!closed || rename(m_TempPath.c_str(), m_Path.c_str()) != 0)
+		{
+			unlink(m_TempPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	void OutputFile::Discard()
+	{
+		if (m_File < 0) return;
+
+		close(m_File);
+		unlink(m_TempPath.c_str());
+		m_File = -1;
+	}
+#endif
+
+	UINT64 Hash(const void* data, size_t size, UINT64 seed)
+	{
+		const UINT64 prime0 = 0x9E3779B185EBCA87ull;
+		const UINT64 prime1 = 0xC2B2AE3D27D4EB4Full;
+
+		auto rotate = [](UINT64 value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+		auto round = [&](UINT64 accumulator, UINT64 lane) { return rotate(accumulator + lane * prime1, 31) * prime0; };
+
+		const UINT8* p = static_cast<const UINT8*>(data);
+		const UINT8* end = p + size;
+
+		UINT64 lanes[4] = { seed + prime0 + prime1, seed + prime1, seed, seed - prime0 };
+		while (end - p >= 32)
+		{
+			UINT64 words[4];
+			memcpy(words, p, sizeof(words));
+			for (int i = 0; i < 4; i++) lanes[i] = round(lanes[i], words[i]);
+			p += 32;
+		}
+
+		UINT64 hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) + rotate(lanes[3], 18);
+		hash += static_cast<UINT64>(size);
+
+		while (end - p >= 8)
+		{
+			UINT64 word;
+			memcpy(&word, p, sizeof(word));
+			hash = rotate(hash ^ round(0, word), 27) * prime0 + prime1;
+			p += 8;
+		}
+
+		while (p < end)
+		{
+			hash = rotate(hash ^ (*p * prime0), 11) * prime1;
+			p++;
+		}
+
+		hash ^= hash >> 33;
+		hash *= prime1;
+		hash ^= hash >> 29;
+		hash *= prime0;
+		hash ^= hash >> 32;
+		return hash;
+	}
+
+	vector<string> GetMaterialLibraryPaths(const ObjMesh& mesh)
+	{
+		vector<string> paths;
+		for (const auto& library : mesh.materialLibraries) paths.push_back("materials/" + library);
+		return paths;
+	}
+
+	void LoadMaterials(const ObjMesh& mesh, vector<Material>& materials)
+	{
+		for (const auto& path : GetMaterialLibraryPaths(mesh))
+		{
+			if (ObjParser::ParseMtl(path, materials)) break;
+		}
+
+		// Faces without a usemtl, or naming an unknown material, fall back to the first entry
+		if (materials.empty()) materials.push_back(Material());
+	}
+
+	void LoadModel(string filepath, Model& model, vector<Material>& materials)
+	{
+		Timer timer;
+		materials.clear();
+
+		const UINT64 cacheKey = MeshCache::ComputeKey(filepath);
+		if (cacheKey && MeshCache::Load(cacheKey, model, materials))
+		{
+			printf("Loaded %s from mesh cache in %.2f ms\n", filepath.c_str(), timer.ElapsedMillis());
+			return;
+		}
+
+		vector<string> libraries;
+		if (PlyLoader::IsPly(filepath))
+		{
+			PlyLoader::LoadPly(filepath, model);
+			materials.push_back(Material());
+		}
+		else
+		{
+			ObjMesh mesh;
+			ObjParser::ParseObj(filepath, mesh);
+
+			libraries = GetMaterialLibraryPaths(mesh);
+			LoadMaterials(mesh, materials);
+			BuildModel(mesh, materials, model);
+		}
+
+		if (cacheKey && MeshCache::Save(cacheKey, model, materials, libraries)) MeshCache::SaveKey(filepath, cacheKey);
+
+		printf("Loaded %s in %.2f ms\n", filepath.c_str(), timer.ElapsedMillis());
+	}
+
+	void BuildModel(const ObjMesh& mesh, const vector<Material>& materials, Model& model)
+	{
+		model.mapping.reset();
+		model.mappedVertices = nullptr;
+		model.mappedIndices = nullptr;
+		model.mappedFrames = nullptr;
+
+		vector<Vertex> corners(mesh.indices.size());
+		const UINT taskCount = static_cast<UINT>((corners.size() + 0xFFFF) >> 16);
+		ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = static_cast<size_t>(task) << 16;
+			const size_t end = (std::min)(begin + 0x10000, corners.size());
+			for (size_t i = begin; i < end; i++)
 			{
-				Vertex vertex = {};
+				const ObjIndex& index = mesh.indices[i];
+				Vertex& vertex = corners[i];
 				vertex.position =
 				{
-					attrib.vertices[3 * index.vertex_index + 2],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 0]
+					mesh.positions[3 * index.position + 2],
+					mesh.positions[3 * index.position + 1],
+					mesh.positions[3 * index.position + 0]
 				};
 
-				vertex.uv =
+				vertex.uv = { 0.f, 0.f };
+				if (index.texcoord >= 0)
 				{
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1 - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
+					vertex.uv =
+					{
+						mesh.texcoords[2 * index.texcoord + 0],
+						1 - mesh.texcoords[2 * index.texcoord + 1]
+					};
+				}
+			}
+		});
 
-				if (uniqueVertices.count(vertex) == 0)
+		WeldStats weld = VertexWelder::Weld(corners, model.vertices, model.indices);
+		printf("Welded %zu corners into %zu vertices in %.2f ms\n", weld.inputVertices, weld.uniqueVertices, weld.milliseconds);
+
+		model.submeshes.clear();
+		for (size_t i = 0; i < mesh.groups.size(); i++)
+		{
+			const size_t begin = mesh.groups[i].indexOffset;
+			const size_t end = (i + 1 < mesh.groups.size()) ? mesh.groups[i + 1].indexOffset : mesh.indices.size();
+			if (end <= begin) continue;
+
+			Submesh submesh;
+			submesh.indexOffset = static_cast<uint32_t>(begin);
+			submesh.indexCount = static_cast<uint32_t>(end - begin);
+			submesh.materialIndex = 0;
+			for (size_t m = 0; m < materials.size(); m++)
+			{
+				if (materials[m].name == mesh.groups[i].material)
 				{
-					uniqueVertices[vertex] = static_cast<uint32_t>(model.vertices.size());
-					model.vertices.push_back(vertex);
+					submesh.materialIndex = static_cast<uint32_t>(m);
+					break;
 				}
+			}
 
-				model.indices.push_back(uniqueVertices[vertex]);
+			// Adjacent shapes sharing a material become one geometry, keeping the hit group table small
+			if (!model.submeshes.empty() && model.submeshes.back().materialIndex == submesh.materialIndex)
+			{
+				model.submeshes.back().indexCount += submesh.indexCount;
+				continue;
 			}
+
+			model.submeshes.push_back(submesh);
 		}
+
+		if (model.submeshes.empty() && !model.indices.empty())
+		{
+			Submesh submesh;
+			submesh.indexOffset = 0;
+			submesh.indexCount = static_cast<uint32_t>(model.indices.size());
+			submesh.materialIndex = 0;
+			model.submeshes.push_back(submesh);
+		}
+
+		printf("Split mesh into %zu submeshes using %zu materials\n", model.submeshes.size(), materials.size());
+
+		FinalizeModel(model);
+	}
+
+	void FinalizeModel(Model& model)
+	{
+		CleanupStats cleanup = MeshCleaner::Clean(model);
+		printf("Cleaned mesh in %.2f ms, welded %zu -> %zu vertices, removed %zu degenerate and %zu duplicate of %zu triangles\n", cleanup.milliseconds, cleanup.inputVertices, cleanup.outputVertices, cleanup.degenerateTriangles, cleanup.duplicateTriangles, cleanup.inputTriangles);
+
+		TangentSpaceStats tangents = TangentSpace::Generate(model);
+		printf("Generated normals and tangents in %.2f ms, %zu -> %zu vertices after crease splits\n", tangents.milliseconds, tangents.inputVertices, tangents.outputVertices);
+
+		PartitionStats partition = MeshPartitioner::Partition(model);
+		printf("Partitioned mesh into %zu clusters (largest %zu triangles, AABB overlap %.2fx) in %.2f ms\n", partition.clusterCount, partition.largestCluster, partition.overlapRatio, partition.milliseconds);
+
+		SimplifyStats simplify = MeshSimplifier::BuildLods(model);
+		printf("Built LOD chains of up to %zu levels in %.2f ms, %zu -> %zu triangles at the coarsest level (max error %g)\n", simplify.levelCount, simplify.milliseconds, simplify.baseTriangles, simplify.coarsestTriangles, simplify.maxError);
+
+		OptimizeStats optimize = MeshOptimizer::Optimize(model);
+		printf("Reordered mesh for locality in %.2f ms, average vertex fetch stride %.0f -> %.0f bytes\n", optimize.milliseconds, optimize.fetchStrideBefore, optimize.fetchStrideAfter);
 	}
 
 	void FormatTexture(TextureInfo& info, UINT8* pixels)
 	{
-		const UINT numPixels = (info.width * info.height);
-		const UINT oldStride = info.stride;
-		const UINT oldSize = (numPixels * info.stride);
+		const UINT newStride = 4;
+		info.pixels.resize(static_cast<size_t>(info.width) * info.height * newStride);
+
+		TexelConvert::ToRgba8(pixels, info.stride, info.pixels.data(), info.width, info.height);
+
+		info.stride = newStride;
+	}
+
+	bool DecodeTexture(const UINT8* data, size_t size, TextureInfo& result)
+	{
+		if (JpegBands::Decode(data, size, result)) return true;
 
-		const UINT newStride = DXGI_FORMAT_R32G32B32A32_SINT;
-		const UINT newSize = (numPixels * newStride);
-		info.pixels.resize(newSize);
+		UINT8* pixels = stbi_load_from_memory(data, static_cast<int>(size), &result.width, &result.height, &result.stride, STBI_default);
+		if (!pixels) return false;
+
+		FormatTexture(result, pixels);
+
+		stbi_image_free(pixels);
+
+		return true;
+	}
+
+	TextureInfo LoadTexture(string filepath)
+	{
+		TextureInfo result = {};
 
-		for (UINT i = 0; i < numPixels; i++)
+		MappedFile file;
+		if (!file.Open(filepath) || !DecodeTexture(reinterpret_cast<const UINT8*>(file.Data()), static_cast<size_t>(file.Size()), result))
 		{
-			info.pixels[i * newStride + 0] = pixels[i * oldStride + 0];
-			info.pixels[i * newStride + 1] = pixels[i * oldStride + 1];
-			info.pixels[i * newStride + 2] = pixels[i * oldStride + 2];
-			info.pixels[i * newStride + 3] = 0xFF;
+			throw runtime_error("Error: failed to load image");
 		}
 
-		info.stride = newStride;
+		return result;
 	}
 
-	TextureInfo LoadTexture(string filepath)
+	TextureInfo LoadTexture(const UINT8* data, size_t size)
+	{
+		TextureInfo result = {};
+
+		if (!DecodeTexture(data, size, result))
+		{
+			throw runtime_error("Error: failed to load embedded image");
+		}
+
+		return result;
+	}
+
+	void BuildTexture(TextureInfo& texture, const TextureOptions& options, TextureLoadStats& stats)
 	{
+		const bool compress = (options.compression != TextureCompression::None) && BlockCompressor::CanCompress(texture);
+
+		stats.mips = MipGenerator::Generate(texture, options.mipFilter);
+		if (compress)
+		{
+			stats.compression = BlockCompressor::Compress(texture, options.compression, options.quality);
+		}
+	}
+
+	// Raw texels are given by their size; encoded images pass zero and are decoded on a miss
+	TextureInfo LoadCachedTexture(const UINT8* data, size_t size, int width, int height, const TextureOptions& options, TextureLoadStats& stats)
+	{
+		Timer timer;
 		TextureInfo result = {};
 
-		UINT8* pixels = stbi_load(filepath.c_str(), &result.width, &result.height, &result.stride, STBI_default);
-		if (!pixels)
+		const UINT64 key = TextureCache::ComputeKey(data, size, static_cast<UINT>(width), static_cast<UINT>(height), options);
+		if (TextureCache::Load(key, result))
+		{
+			stats.cacheHit = true;
+			stats.milliseconds = timer.ElapsedMillis();
+			return result;
+		}
+
+		if (width > 0)
+		{
+			result.width = width;
+			result.height = height;
+			result.stride = 4;
+			result.pixels.assign(data, data + size);
+		}
+		else if (!DecodeTexture(data, size, result))
+		{
+			return result;
+		}
+
+		stats.decodeMilliseconds = timer.ElapsedMillis();
+
+		BuildTexture(result, options, stats);
+		TextureCache::Save(key, result);
+
+		stats.milliseconds = timer.ElapsedMillis();
+		return result;
+	}
+
+	TextureInfo LoadTexture(string filepath, const TextureOptions& options, TextureLoadStats& stats)
+	{
+		MappedFile file;
+		if (!file.Open(filepath))
 		{
 			throw runtime_error("Error: failed to load image");
 		}
 
-		FormatTexture(result, pixels);
+		TextureInfo result = LoadCachedTexture(reinterpret_cast<const UINT8*>(file.Data()), static_cast<size_t>(file.Size()), 0, 0, options, stats);
+		if (result.width == 0)
+		{
+			throw runtime_error("Error: failed to load image");
+		}
 
-		stbi_image_free(pixels);
+		return result;
+	}
+
+	TextureInfo LoadTexture(const UINT8* data, size_t size, const TextureOptions& options, TextureLoadStats& stats)
+	{
+		TextureInfo result = LoadCachedTexture(data, size, 0, 0, options, stats);
+		if (result.width == 0)
+		{
+			throw runtime_error("Error: failed to load embedded image");
+		}
 
 		return result;
 	}
+
+	TextureInfo LoadTexture(const Material& material, const TextureOptions& options, TextureLoadStats& stats)
+	{
+		if (material.embeddedTexture && material.embeddedWidth > 0)
+		{
+			TextureInfo texture;
+			texture.width = material.embeddedWidth;
+			texture.height = material.embeddedHeight;
+			texture.stride = (material.embeddedFormat == DXGI_FORMAT_R8G8B8A8_UNORM) ? 4 : 0;
+			texture.mipLevels = material.embeddedMipLevels;
+			texture.format = material.embeddedFormat;
+			texture.mapping = material.mapping;
+			texture.mappedPixels = material.embeddedTexture;
+			texture.mappedSize = material.embeddedTextureSize;
+			stats.cacheHit = true;
+			return texture;
+		}
+
+		if (material.embeddedTexture)
+		{
+			return LoadTexture(material.embeddedTexture, material.embeddedTextureSize, options, stats);
+		}
+
+		if (!material.texturePath.empty())
+		{
+			return LoadTexture(material.texturePath, options, stats);
+		}
+
+		TextureInfo texture;
+		texture.width = 1;
+		texture.height = 1;
+		texture.stride = 4;
+		texture.pixels = { 0xFF, 0xFF, 0xFF, 0xFF };
+		BuildTexture(texture, options, stats);
+		return texture;
+	}
+
+	bool GetTextureSize(string filepath, int& width, int& height)
+	{
+		MappedFile file;
+		int components = 0;
+		return file.Open(filepath) && stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(file.Data()), static_cast<int>(file.Size()), &width, &height, &components) != 0;
+	}
+
+	string LoadTileFile(string filepath, const TextureOptions& options, TextureLoadStats& stats)
+	{
+		Timer timer;
+
+		MappedFile file;
+		if (!file.Open(filepath))
+		{
+			throw runtime_error("Error: failed to load image");
+		}
+
+		const UINT8* data = reinterpret_cast<const UINT8*>(file.Data());
+		const size_t size = static_cast<size_t>(file.Size());
+
+		const string path = TileFile::GetCachePath(TextureCache::ComputeKey(data, size, 0, 0, options));
+		TileFile tiles;
+		if (tiles.Open(path))
+		{
+			stats.cacheHit = true;
+			stats.milliseconds = timer.ElapsedMillis();
+			return path;
+		}
+
+		TextureInfo texture = {};
+		if (!DecodeTexture(data, size, texture))
+		{
+			throw runtime_error("Error: failed to load image");
+		}
+
+		stats.decodeMilliseconds = timer.ElapsedMillis();
+		stats.mips = MipGenerator::Generate(texture, options.mipFilter);
+
+		// Levels above the largest texture the device can create are dropped, the chain then starting one level down
+		while ((std::max)(texture.width, texture.height) > D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+		{
+			texture.pixels.erase(texture.pixels.begin(), texture.pixels.begin() + static_cast<size_t>(texture.width) * texture.height * 4);
+			texture.width = (std::max)(texture.width >> 1, 1);
+			texture.height = (std::max)(texture.height >> 1, 1);
+			texture.mipLevels--;
+		}
+
+		if (options.compression != TextureCompression::None && BlockCompressor::CanCompress(texture))
+		{
+			stats.compression = BlockCompressor::Compress(texture, options.compression, options.quality);
+		}
+
+		if (!TileFile::Write(path, texture))
+		{
+			throw runtime_error("Error: failed to write tile file");
+		}
+
+		stats.milliseconds = timer.ElapsedMillis();
+		return path;
+	}
 }
\ No newline at end of file
@@ -1,19 +1,148 @@
 #pragma once
 
-#include "structures.h"
+#include "Structures.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
 
 #include <chrono>
+#include <functional>
+
+struct ObjMesh;
+
+struct TextureLoadStats
+{
+	bool cacheHit = false;
+	float decodeMilliseconds = 0.f;
+	MipStats mips;
+	CompressStats compression;
+	float milliseconds = 0.f;
+};
 
 namespace Utils
 {
+#ifdef _WIN32
 	HRESULT ParseCommandLine(LPWSTR lpCmdLine, ConfigInfo& config);
 
 	void Validate(HRESULT hr, LPWSTR message);
+#endif
+
+	void LoadModel(std::string filepath, Model& model, std::vector<Material>& materials);
+
+	std::vector<std::string> GetMaterialLibraryPaths(const ObjMesh& mesh);
+
+	void LoadMaterials(const ObjMesh& mesh, std::vector<Material>& materials);
+
+	void BuildModel(const ObjMesh& mesh, const std::vector<Material>& materials, Model& model);
 
-	void LoadModel(std::string filepath, Model& model, Material& material);
+	void FinalizeModel(Model& model);
 
 	TextureInfo LoadTexture(std::string filepath);
 
+	TextureInfo LoadTexture(const UINT8* data, size_t size);
+
+	// These return the texture in the form the GPU samples: a full mip chain, block-compressed when the options ask for it.
+	// The result is stored in the texture cache under a hash of the source bytes, and a later hit maps it instead of decoding.
+	TextureInfo LoadTexture(std::string filepath, const TextureOptions& options, TextureLoadStats& stats);
+
+	TextureInfo LoadTexture(const UINT8* data, size_t size, const TextureOptions& options, TextureLoadStats& stats);
+
+	// The texture a material samples: its baked or embedded image, its texture file, or plain white when it has none.
+	// A baked texture is returned in place as the archive holds it, whatever the options ask for.
+	TextureInfo LoadTexture(const Material& material, const TextureOptions& options, TextureLoadStats& stats);
+
+	// Builds the mip chain of a decoded RGBA8 texture and compresses it when asked, without going through the cache
+	void BuildTexture(TextureInfo& texture, const TextureOptions& options, TextureLoadStats& stats);
+
+	bool GetTextureSize(std::string filepath, int& width, int& height);
+
+	// Builds the tile file of a texture that is streamed rather than loaded whole, unless one is already cached,
+	// and returns its path
+	std::string LoadTileFile(std::string filepath, const TextureOptions& options, TextureLoadStats& stats);
+
+	UINT GetWorkerCount();
+
+	// Sizes the thread pool ParallelFor runs on, the calling thread included; zero goes back to one per hardware thread.
+	// Must not be called while a ParallelFor is running.
+	void SetWorkerCount(UINT workerCount);
+
+	// Runs task(i) for every i below count on the thread pool and the calling thread, and returns once all have run.
+	// Nested calls share the pool rather than starting threads of their own. The first exception a task throws is
+	// rethrown here, after the tasks already started have finished; the rest are skipped.
+	void ParallelFor(UINT count, const std::function<void(UINT)>& task);
+
+	UINT64 Hash(const void* data, size_t size, UINT64 seed = 0);
+
+	class MappedFile
+	{
+	public:
+		MappedFile() {}
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		const char* Data() const
+		{
+			return m_Data;
+		}
+
+		UINT64 Size() const
+		{
+			return m_Size;
+		}
+
+		UINT64 ModifiedTime() const
+		{
+			return m_ModifiedTime;
+		}
+
+	private:
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+		HANDLE m_Mapping = NULL;
+#endif
+		const char* m_Data = nullptr;
+		UINT64 m_Size = 0;
+		UINT64 m_ModifiedTime = 0;
+	};
+
+	// A file written under a temporary name and moved over the given path by Commit, so a reader never maps a partial one.
+	// The directory it goes in is created when missing.
+	class OutputFile
+	{
+	public:
+		OutputFile() {}
+
+		~OutputFile()
+		{
+			Discard();
+		}
+
+		OutputFile(const OutputFile&) = delete;
+		OutputFile& operator=(const OutputFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		bool Write(const void* data, UINT64 size);
+		bool Commit();
+		void Discard();
+
+	private:
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+#else
+		int m_File = -1;
+#endif
+		std::string m_Path;
+		std::string m_TempPath;
+	};
+
 	class Timer
 	{
 	public:
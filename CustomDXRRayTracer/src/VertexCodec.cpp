@@ -0,0 +1,114 @@
+#include "VertexCodec.h"
+#include "Utils.h"
+
+#include <cmath>
+
+namespace
+{
+	const size_t VerticesPerTask = (1 << 16);
+	const float SnormScale = 32767.f;
+	const float UnormScale = 65535.f;
+
+	inline int16_t QuantizeSnorm(float value, float scale, float bias)
+	{
+		const float normalized = (std::min)((std::max)((value - bias) / scale, -1.f), 1.f);
+		return static_cast<int16_t>(std::lround(normalized * SnormScale));
+	}
+
+	inline float DequantizeSnorm(int16_t value, float scale, float bias)
+	{
+		return (std::max)(value / SnormScale, -1.f) * scale + bias;
+	}
+
+	inline uint16_t QuantizeUnorm(float value, float scale, float bias)
+	{
+		const float normalized = (std::min)((std::max)((value - bias) / scale, 0.f), 1.f);
+		return static_cast<uint16_t>(std::lround(normalized * UnormScale));
+	}
+
+	inline float DequantizeUnorm(uint16_t value, float scale, float bias)
+	{
+		return value / UnormScale * scale + bias;
+	}
+}
+
+namespace VertexCodec
+{
+	VertexQuantization ComputeQuantization(const Vertex* vertices, size_t count)
+	{
+		VertexQuantization quantization;
+		if (count == 0) return quantization;
+
+		DirectX::XMFLOAT3 boundsMin = vertices[0].position;
+		DirectX::XMFLOAT3 boundsMax = vertices[0].position;
+		DirectX::XMFLOAT2 uvMin = vertices[0].uv;
+		DirectX::XMFLOAT2 uvMax = vertices[0].uv;
+		for (size_t i = 1; i < count; i++)
+		{
+			const DirectX::XMFLOAT3& position = vertices[i].position;
+			boundsMin.x = (std::min)(boundsMin.x, position.x);
+			boundsMin.y = (std::min)(boundsMin.y, position.y);
+			boundsMin.z = (std::min)(boundsMin.z, position.z);
+			boundsMax.x = (std::max)(boundsMax.x, position.x);
+			boundsMax.y = (std::max)(boundsMax.y, position.y);
+			boundsMax.z = (std::max)(boundsMax.z, position.z);
+
+			const DirectX::XMFLOAT2& uv = vertices[i].uv;
+			uvMin.x = (std::min)(uvMin.x, uv.x);
+			uvMin.y = (std::min)(uvMin.y, uv.y);
+			uvMax.x = (std::max)(uvMax.x, uv.x);
+			uvMax.y = (std::max)(uvMax.y, uv.y);
+		}
+
+		// Positions map to [-1, 1] around the AABB center; flat axes keep a unit scale
+		quantization.bias = DirectX::XMFLOAT3((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+		quantization.scale = DirectX::XMFLOAT3((boundsMax.x - boundsMin.x) * 0.5f, (boundsMax.y - boundsMin.y) * 0.5f, (boundsMax.z - boundsMin.z) * 0.5f);
+
+		if (quantization.scale.x <= 0.f) quantization.scale.x = 1.f;
+		if (quantization.scale.y <= 0.f) quantization.scale.y = 1.f;
+		if (quantization.scale.z <= 0.f) quantization.scale.z = 1.f;
+
+		// UVs map to [0, 1] over their range, so tiling UVs far outside [0, 1] keep the same step as the rest
+		quantization.uvBias = uvMin;
+		quantization.uvScale = DirectX::XMFLOAT2(uvMax.x - uvMin.x, uvMax.y - uvMin.y);
+
+		if (quantization.uvScale.x <= 0.f) quantization.uvScale.x = 1.f;
+		if (quantization.uvScale.y <= 0.f) quantization.uvScale.y = 1.f;
+
+		return quantization;
+	}
+
+	void Encode(const Vertex* vertices, size_t count, const VertexQuantization& quantization, CompactVertex* output)
+	{
+		const UINT taskCount = static_cast<UINT>((count + VerticesPerTask - 1) / VerticesPerTask);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * VerticesPerTask;
+			const size_t end = (std::min)(begin + VerticesPerTask, count);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				const Vertex& vertex = vertices[i];
+				CompactVertex& compact = output[i];
+
+				compact.position[0] = QuantizeSnorm(vertex.position.x, quantization.scale.x, quantization.bias.x);
+				compact.position[1] = QuantizeSnorm(vertex.position.y, quantization.scale.y, quantization.bias.y);
+				compact.position[2] = QuantizeSnorm(vertex.position.z, quantization.scale.z, quantization.bias.z);
+				compact.position[3] = 0;
+				compact.uv[0] = QuantizeUnorm(vertex.uv.x, quantization.uvScale.x, quantization.uvBias.x);
+				compact.uv[1] = QuantizeUnorm(vertex.uv.y, quantization.uvScale.y, quantization.uvBias.y);
+			}
+		});
+	}
+
+	Vertex Decode(const CompactVertex& vertex, const VertexQuantization& quantization)
+	{
+		Vertex result;
+		result.position.x = DequantizeSnorm(vertex.position[0], quantization.scale.x, quantization.bias.x);
+		result.position.y = DequantizeSnorm(vertex.position[1], quantization.scale.y, quantization.bias.y);
+		result.position.z = DequantizeSnorm(vertex.position[2], quantization.scale.z, quantization.bias.z);
+		result.uv.x = DequantizeUnorm(vertex.uv[0], quantization.uvScale.x, quantization.uvBias.x);
+		result.uv.y = DequantizeUnorm(vertex.uv[1], quantization.uvScale.y, quantization.uvBias.y);
+		return result;
+	}
+}
\ No newline at end of file
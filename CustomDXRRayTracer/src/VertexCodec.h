@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Structures.h"
+
+namespace VertexCodec
+{
+	VertexQuantization ComputeQuantization(const Vertex* vertices, size_t count);
+
+	void Encode(const Vertex* vertices, size_t count, const VertexQuantization& quantization, CompactVertex* output);
+
+	Vertex Decode(const CompactVertex& vertex, const VertexQuantization& quantization);
+}
\ No newline at end of file
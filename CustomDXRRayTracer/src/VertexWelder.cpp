@@ -0,0 +1,200 @@
+#include "VertexWelder.h"
+#include "Utils.h"
+
+namespace
+{
+	const UINT32 EmptySlot = 0xFFFFFFFF;
+	const size_t CornersPerTask = (1 << 16);
+
+	static_assert(sizeof(Vertex) == 5 * sizeof(UINT32), "VertexWelder hashes and compares the raw 20 byte Vertex layout");
+
+	struct Slot
+	{
+		UINT32 hash;
+		UINT32 corner;
+	};
+
+	inline UINT32 HashVertex(const Vertex& vertex)
+	{
+		UINT32 words[5];
+		memcpy(words, &vertex, sizeof(words));
+
+		UINT64 hash = ((static_cast<UINT64>(words[1]) << 32) | words[0]) * 0x9E3779B185EBCA87ull;
+		hash ^= (((static_cast<UINT64>(words[3]) << 32) | words[2]) + (hash >> 29)) * 0xC2B2AE3D27D4EB4Full;
+		hash ^= (static_cast<UINT64>(words[4]) + (hash >> 32)) * 0x165667B19E3779F9ull;
+		hash ^= hash >> 29;
+		return static_cast<UINT32>(hash >> 32);
+	}
+
+	inline bool SameBits(const Vertex& lhs, const Vertex& rhs)
+	{
+		return memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+	}
+
+	UINT32 NextPowerOfTwo(size_t value)
+	{
+		UINT32 result = 1;
+		while (result < value) result <<= 1;
+		return result;
+	}
+}
+
+namespace VertexWelder
+{
+	WeldStats Weld(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		Utils::Timer timer;
+
+		WeldStats stats;
+		stats.inputVertices = corners.size();
+
+		const size_t cornerCount = corners.size();
+		const UINT taskCount = static_cast<UINT>((cornerCount + CornersPerTask - 1) / CornersPerTask);
+
+		UINT partitionBits = 0;
+		while ((1u << partitionBits) < Utils::GetWorkerCount() * 4 && partitionBits < 8) partitionBits++;
+		const UINT partitionCount = (1u << partitionBits);
+		const UINT partitionShift = 32 - partitionBits;
+
+		auto partitionOf = [&](UINT32 hash)
+		{
+			return partitionBits ? (hash >> partitionShift) : 0u;
+		};
+
+		// Hash every corner and bucket it by the top bits of its hash
+		std::vector<UINT32> hashes(cornerCount);
+		std::vector<UINT32> taskOffsets(static_cast<size_t>(taskCount) * partitionCount, 0);
+
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * CornersPerTask;
+			const size_t end = (std::min)(begin + CornersPerTask, cornerCount);
+			UINT32* counts = &taskOffsets[static_cast<size_t>(task) * partitionCount];
+
+			for (size_t i = begin; i < end; i++)
+			{
+				hashes[i] = HashVertex(corners[i]);
+				counts[partitionOf(hashes[i])]++;
+			}
+		});
+
+		std::vector<UINT32> partitionOffsets(partitionCount + 1, 0);
+		for (UINT partition = 0; partition < partitionCount; partition++)
+		{
+			UINT32 offset = partitionOffsets[partition];
+			for (UINT task = 0; task < taskCount; task++)
+			{
+				UINT32& count = taskOffsets[static_cast<size_t>(task) * partitionCount + partition];
+				const UINT32 partitionCountInTask = count;
+				count = offset;
+				offset += partitionCountInTask;
+			}
+			partitionOffsets[partition + 1] = offset;
+		}
+
+		// Scatter corner ids so every partition lists its corners in ascending order
+		std::vector<UINT32> order(cornerCount);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * CornersPerTask;
+			const size_t end = (std::min)(begin + CornersPerTask, cornerCount);
+			UINT32* offsets = &taskOffsets[static_cast<size_t>(task) * partitionCount];
+
+			for (size_t i = begin; i < end; i++)
+			{
+				order[offsets[partitionOf(hashes[i])]++] = static_cast<UINT32>(i);
+			}
+		});
+
+		// Weld each partition independently; the representative is always the first corner seen
+		std::vector<UINT32> representatives(cornerCount);
+		Utils::ParallelFor(partitionCount, [&](UINT partition)
+		{
+			const UINT32 begin = partitionOffsets[partition];
+			const UINT32 end = partitionOffsets[partition + 1];
+			if (begin == end) return;
+
+			const UINT32 mask = NextPowerOfTwo(static_cast<size_t>(end - begin) * 2) - 1;
+			std::vector<Slot> table(static_cast<size_t>(mask) + 1, Slot{ 0, EmptySlot });
+
+			for (UINT32 i = begin; i < end; i++)
+			{
+				const UINT32 corner = order[i];
+				const UINT32 hash = hashes[corner];
+
+				UINT32 slot = hash & mask;
+				while (true)
+				{
+					Slot& entry = table[slot];
+					if (entry.corner == EmptySlot)
+					{
+						entry.hash = hash;
+						entry.corner = corner;
+						representatives[corner] = corner;
+						break;
+					}
+
+					if (entry.hash == hash && SameBits(corners[entry.corner], corners[corner]))
+					{
+						representatives[corner] = entry.corner;
+						break;
+					}
+
+					slot = (slot + 1) & mask;
+				}
+			}
+		});
+
+		// Number unique vertices in first-use order, matching the order the old map produced
+		std::vector<UINT32> uniqueOffsets(taskCount + 1, 0);
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * CornersPerTask;
+			const size_t end = (std::min)(begin + CornersPerTask, cornerCount);
+
+			UINT32 count = 0;
+			for (size_t i = begin; i < end; i++)
+			{
+				if (representatives[i] == i) count++;
+			}
+			uniqueOffsets[task + 1] = count;
+		});
+
+		for (UINT task = 0; task < taskCount; task++) uniqueOffsets[task + 1] += uniqueOffsets[task];
+
+		std::vector<UINT32> remap(cornerCount);
+		vertices.resize(uniqueOffsets[taskCount]);
+		indices.resize(cornerCount);
+
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * CornersPerTask;
+			const size_t end = (std::min)(begin + CornersPerTask, cornerCount);
+
+			UINT32 next = uniqueOffsets[task];
+			for (size_t i = begin; i < end; i++)
+			{
+				if (representatives[i] != i) continue;
+
+				remap[i] = next;
+				vertices[next] = corners[i];
+				next++;
+			}
+		});
+
+		Utils::ParallelFor(taskCount, [&](UINT task)
+		{
+			const size_t begin = task * CornersPerTask;
+			const size_t end = (std::min)(begin + CornersPerTask, cornerCount);
+
+			for (size_t i = begin; i < end; i++)
+			{
+				indices[i] = remap[representatives[i]];
+			}
+		});
+
+		stats.uniqueVertices = vertices.size();
+		stats.milliseconds = timer.ElapsedMillis();
+		return stats;
+	}
+}
\ No newline at end of file
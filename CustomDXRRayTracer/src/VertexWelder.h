@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Structures.h"
+
+struct WeldStats
+{
+	size_t inputVertices = 0;
+	size_t uniqueVertices = 0;
+	float milliseconds = 0.f;
+};
+
+namespace VertexWelder
+{
+	WeldStats Weld(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+}
\ No newline at end of file
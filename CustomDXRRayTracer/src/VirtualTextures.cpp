@@ -0,0 +1,390 @@
+#include "VirtualTextures.h"
+#include "Graphics.h"
+#include "Utils.h"
+
+namespace
+{
+	const D3D12_RESOURCE_STATES ShaderResourceState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+
+	inline UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	ID3D12Resource* CreateBuffer(ID3D12Device5* device, UINT64 size, const D3D12_HEAP_PROPERTIES& heapProperties, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES state)
+	{
+		D3D12_RESOURCE_DESC desc = {};
+		desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		desc.Width = size;
+		desc.Height = 1;
+		desc.DepthOrArraySize = 1;
+		desc.MipLevels = 1;
+		desc.Format = DXGI_FORMAT_UNKNOWN;
+		desc.SampleDesc.Count = 1;
+		desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		desc.Flags = flags;
+
+		ID3D12Resource* buffer = nullptr;
+		HRESULT hr = device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc, state, nullptr, IID_PPV_ARGS(&buffer));
+		Utils::Validate(hr, L"Error: failed to create virtual texture buffer");
+		return buffer;
+	}
+}
+
+void VirtualTextures::Init(ID3D12Device5* device, ID3D12CommandQueue* queue, UINT64 budget)
+{
+	Release();
+
+	m_Device = device;
+	m_Queue = queue;
+	m_Budget = budget;
+
+	// Free slots are handed out lowest first, so however large the budget, the slots in use stay below the tile count
+	m_Residency.Reset(static_cast<UINT>(budget / TileFile::TileBytes));
+}
+
+ID3D12Resource* VirtualTextures::AddTexture(const std::string& path, UINT textureIndex)
+{
+	VirtualTexture texture;
+	texture.file = std::make_shared<TileFile>();
+	texture.textureIndex = textureIndex;
+	if (!texture.file->Open(path))
+	{
+		throw std::runtime_error("Error: failed to open tile file " + path);
+	}
+
+	const TileFile& file = *texture.file;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = file.GetWidth();
+	desc.Height = file.GetHeight();
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = static_cast<UINT16>(file.GetLevelCount());
+	desc.Format = file.GetFormat();
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+
+	HRESULT hr = m_Device->CreateReservedResource(&desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture.resource));
+	Utils::Validate(hr, L"Error: failed to create reserved texture");
+
+#if NAME_D3D_RESOURCES
+	texture.resource->SetName(L"Virtual Texture");
+#endif
+
+	UINT tileCount = 0;
+	UINT subresourceCount = file.GetLevelCount();
+	D3D12_PACKED_MIP_INFO packedInfo = {};
+	D3D12_TILE_SHAPE shape = {};
+	std::vector<D3D12_SUBRESOURCE_TILING> tilings(subresourceCount);
+	m_Device->GetResourceTiling(texture.resource, &tileCount, &packedInfo, &shape, &subresourceCount, 0, tilings.data());
+
+	// The tile file is laid out in the standard shapes, which the runtime reports for this layout
+	bool valid = shape.WidthInTexels == file.GetTileWidth() && shape.HeightInTexels == file.GetTileHeight() && packedInfo.NumStandardMips > 0;
+	for (UINT level = 0; level < packedInfo.NumStandardMips && valid; level++)
+	{
+		valid = tilings[level].WidthInTiles == file.GetLevel(level).tilesX && tilings[level].HeightInTiles == file.GetLevel(level).tilesY;
+	}
+
+	if (!valid)
+	{
+		SAFE_RELEASE(texture.resource);
+		throw std::runtime_error("Error: tile file does not match the tiling of its reserved texture " + path);
+	}
+
+	// The last level always stays resident, so a texture without packed levels keeps its 1x1 tile out of the budget
+	texture.standardLevels = packedInfo.NumStandardMips;
+	texture.streamedLevels = (std::min)(texture.standardLevels, file.GetLevelCount() - 1);
+	texture.packedTiles = packedInfo.NumTilesForPackedMips;
+	texture.firstTile = m_Residency.AddTexture(file.GetWidth(), file.GetHeight(), file.GetTileWidth(), file.GetTileHeight(), texture.streamedLevels);
+	texture.residencyOffset = m_ResidencyCount;
+	m_ResidencyCount += file.GetLevel(0).tilesX * file.GetLevel(0).tilesY;
+
+	m_Textures.push_back(texture);
+	return texture.resource;
+}
+
+void VirtualTextures::Create(ID3D12GraphicsCommandList4* cmdList)
+{
+	const UINT streamedTiles = (std::min)(m_Residency.GetSlotCount(), m_Residency.GetTileCount());
+
+	// Levels past the streamed ones are copied through the staging buffer once, then it holds a frame's tiles
+	UINT pinnedTiles = 0;
+	UINT64 tailBytes = 0;
+	std::vector<UINT64> tailOffsets(m_Textures.size());
+	for (size_t i = 0; i < m_Textures.size(); i++)
+	{
+		const VirtualTexture& texture = m_Textures[i];
+		const D3D12_RESOURCE_DESC desc = texture.resource->GetDesc();
+
+		UINT64 size = 0;
+		m_Device->GetCopyableFootprints(&desc, texture.streamedLevels, desc.MipLevels - texture.streamedLevels, 0, nullptr, nullptr, nullptr, &size);
+
+		tailOffsets[i] = tailBytes;
+		tailBytes = AlignUp(tailBytes + size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		pinnedTiles += texture.packedTiles + (texture.standardLevels - texture.streamedLevels);
+	}
+
+	const UINT64 residencyBytes = static_cast<UINT64>(GetResidencyCount()) * sizeof(UINT);
+	const UINT64 tileBytes = static_cast<UINT64>(MaxTileLoadsPerFrame) * TileFile::TileBytes;
+	const UINT64 stagingBytes = (std::max)(tileBytes, tailBytes) + AlignUp(residencyBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+	if (streamedTiles + pinnedTiles > 0)
+	{
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = static_cast<UINT64>(streamedTiles + pinnedTiles) * TileFile::TileBytes;
+		heapDesc.Properties = DefaultHeapProperties;
+		heapDesc.Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+
+		HRESULT hr = m_Device->CreateHeap(&heapDesc, IID_PPV_ARGS(&m_Heap));
+		Utils::Validate(hr, L"Error: failed to create virtual texture tile heap");
+
+#if NAME_D3D_RESOURCES
+		m_Heap->SetName(L"Virtual Texture Tile Heap");
+#endif
+	}
+
+	m_FeedbackBuffer = CreateBuffer(m_Device, GetFeedbackCount() * sizeof(UINT), DefaultHeapProperties, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	m_ReadbackBuffer = CreateBuffer(m_Device, GetFeedbackCount() * sizeof(UINT), ReadbackHeapProperties, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+	m_ResidencyBuffer = CreateBuffer(m_Device, residencyBytes, DefaultHeapProperties, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+	m_Staging = CreateBuffer(m_Device, stagingBytes, UploadHeapProperties, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+#if NAME_D3D_RESOURCES
+	m_FeedbackBuffer->SetName(L"Tile Feedback");
+	m_ReadbackBuffer->SetName(L"Tile Feedback Readback");
+	m_ResidencyBuffer->SetName(L"Tile Residency");
+	m_Staging->SetName(L"Tile Staging");
+#endif
+
+	// Both stay mapped; the feedback is only read once the frame that copied it has finished
+	HRESULT hr = m_ReadbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_Feedback));
+	Utils::Validate(hr, L"Error: failed to map tile feedback readback buffer");
+
+	D3D12_RANGE readRange = {};
+	hr = m_Staging->Map(0, &readRange, reinterpret_cast<void**>(&m_StagingData));
+	Utils::Validate(hr, L"Error: failed to map tile staging buffer");
+
+	UINT heapTile = streamedTiles;
+	for (size_t i = 0; i < m_Textures.size(); i++)
+	{
+		const VirtualTexture& texture = m_Textures[i];
+		const D3D12_RESOURCE_DESC desc = texture.resource->GetDesc();
+
+		// Levels that stay resident are mapped to tiles past the budget: a standard 1x1 level kept out of streaming,
+		// then the packed levels, which are mapped as a whole
+		for (UINT level = texture.streamedLevels; level <= texture.standardLevels && level < desc.MipLevels; level++)
+		{
+			D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+			coordinate.Subresource = level;
+
+			D3D12_TILE_REGION_SIZE regionSize = {};
+			regionSize.NumTiles = (level < texture.standardLevels) ? 1 : texture.packedTiles;
+			if (regionSize.NumTiles == 0) continue;
+
+			const D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NONE;
+			m_Queue->UpdateTileMappings(texture.resource, 1, &coordinate, &regionSize, m_Heap, 1, &flags, &heapTile, &regionSize.NumTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+			heapTile += regionSize.NumTiles;
+		}
+
+		const UINT levelCount = desc.MipLevels - texture.streamedLevels;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(levelCount);
+		m_Device->GetCopyableFootprints(&desc, texture.streamedLevels, levelCount, tailOffsets[i], footprints.data(), nullptr, nullptr, nullptr);
+
+		for (UINT j = 0; j < levelCount; j++)
+		{
+			texture.file->ReadRows(texture.streamedLevels + j, m_StagingData + footprints[j].Offset, footprints[j].Footprint.RowPitch);
+
+			D3D12_TEXTURE_COPY_LOCATION src = {};
+			src.pResource = m_Staging;
+			src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+			src.PlacedFootprint = footprints[j];
+
+			D3D12_TEXTURE_COPY_LOCATION dest = {};
+			dest.pResource = texture.resource;
+			dest.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+			dest.SubresourceIndex = texture.streamedLevels + j;
+
+			cmdList->CopyTextureRegion(&dest, 0, 0, 0, &src, nullptr);
+		}
+
+		Transition(cmdList, texture.resource, D3D12_RESOURCE_STATE_COPY_DEST, ShaderResourceState);
+	}
+
+	// Nothing is streamed in yet, so every tile starts out reading the first resident level
+	const UINT64 residencyOffset = (std::max)(tileBytes, tailBytes);
+	UINT* residency = reinterpret_cast<UINT*>(m_StagingData + residencyOffset);
+	for (const VirtualTexture& texture : m_Textures)
+	{
+		const TileLevel& top = texture.file->GetLevel(0);
+		std::fill(residency + texture.residencyOffset, residency + texture.residencyOffset + top.tilesX * top.tilesY, texture.streamedLevels);
+	}
+
+	cmdList->CopyBufferRegion(m_ResidencyBuffer, 0, m_Staging, residencyOffset, residencyBytes);
+	Transition(cmdList, m_ResidencyBuffer, D3D12_RESOURCE_STATE_COPY_DEST, ShaderResourceState);
+}
+
+void VirtualTextures::Update(ID3D12GraphicsCommandList4* cmdList)
+{
+	if (m_Textures.empty()) return;
+
+	Utils::Timer timer;
+
+	m_Requests.clear();
+	if (m_FeedbackFrame != 0)
+	{
+		for (UINT tile = 0; tile < m_Residency.GetTileCount(); tile++)
+		{
+			if (m_Feedback[tile] == m_FeedbackFrame) m_Requests.push_back(tile);
+		}
+	}
+
+	const ResidencyStats stats = m_Residency.Update(m_Requests, MaxTileLoadsPerFrame, m_Loads, m_Evictions, m_ChangedTextures);
+
+	m_Stats.tilesLoaded += stats.loaded;
+	m_Stats.tilesEvicted += stats.evicted;
+	m_Stats.tilesDeferred += stats.deferred;
+	m_Stats.peakResident = (std::max)(m_Stats.peakResident, stats.resident);
+	m_Stats.frameCount++;
+
+	if (m_ChangedTextures.empty())
+	{
+		m_Stats.milliseconds += timer.ElapsedMillis();
+		return;
+	}
+
+	// Tiles are copied out of the mapped files in parallel, so reads of tiles not yet in memory overlap
+	Utils::ParallelFor(static_cast<UINT>(m_Loads.size()), [&](UINT i)
+	{
+		UINT index, level, x, y;
+		m_Residency.GetTileLocation(m_Loads[i].tile, index, level, x, y);
+		memcpy(m_StagingData + static_cast<size_t>(i) * TileFile::TileBytes, m_Textures[index].file->GetTile(level, x, y), TileFile::TileBytes);
+	});
+
+	for (UINT index : m_ChangedTextures)
+	{
+		UpdateMappings(index);
+		Transition(cmdList, m_Textures[index].resource, ShaderResourceState, D3D12_RESOURCE_STATE_COPY_DEST);
+	}
+
+	for (size_t i = 0; i < m_Loads.size(); i++)
+	{
+		UINT index, level, x, y;
+		m_Residency.GetTileLocation(m_Loads[i].tile, index, level, x, y);
+
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+		coordinate.X = x;
+		coordinate.Y = y;
+		coordinate.Subresource = level;
+
+		D3D12_TILE_REGION_SIZE regionSize = {};
+		regionSize.NumTiles = 1;
+
+		cmdList->CopyTiles(m_Textures[index].resource, &coordinate, &regionSize, m_Staging, static_cast<UINT64>(i) * TileFile::TileBytes, D3D12_TILE_COPY_FLAG_LINEAR_BUFFER_TO_SWIZZLED_TILED_RESOURCE);
+	}
+
+	// The residency maps of the textures that changed are rewritten whole; they are a few KB each
+	const UINT64 residencyOffset = static_cast<UINT64>(MaxTileLoadsPerFrame) * TileFile::TileBytes;
+	Transition(cmdList, m_ResidencyBuffer, ShaderResourceState, D3D12_RESOURCE_STATE_COPY_DEST);
+
+	for (UINT index : m_ChangedTextures)
+	{
+		const VirtualTexture& texture = m_Textures[index];
+		Transition(cmdList, texture.resource, D3D12_RESOURCE_STATE_COPY_DEST, ShaderResourceState);
+
+		m_Residency.GetMinLevelMap(index, m_MinLevels);
+
+		const UINT64 offset = residencyOffset + static_cast<UINT64>(texture.residencyOffset) * sizeof(UINT);
+		memcpy(m_StagingData + offset, m_MinLevels.data(), m_MinLevels.size() * sizeof(UINT));
+		cmdList->CopyBufferRegion(m_ResidencyBuffer, static_cast<UINT64>(texture.residencyOffset) * sizeof(UINT), m_Staging, offset, m_MinLevels.size() * sizeof(UINT));
+	}
+
+	Transition(cmdList, m_ResidencyBuffer, D3D12_RESOURCE_STATE_COPY_DEST, ShaderResourceState);
+
+	m_Stats.milliseconds += timer.ElapsedMillis();
+}
+
+void VirtualTextures::UpdateMappings(UINT index)
+{
+	// One single-tile region per tile of the texture; evicted tiles are unmapped before their slots are mapped again
+	std::vector<D3D12_TILED_RESOURCE_COORDINATE> coordinates;
+	std::vector<D3D12_TILE_RANGE_FLAGS> flags;
+	std::vector<UINT> heapOffsets;
+	for (size_t i = 0; i < m_Evictions.size() + m_Loads.size(); i++)
+	{
+		const bool eviction = (i < m_Evictions.size());
+		const TileMapping& mapping = eviction ? m_Evictions[i] : m_Loads[i - m_Evictions.size()];
+
+		UINT texture, level, x, y;
+		m_Residency.GetTileLocation(mapping.tile, texture, level, x, y);
+		if (texture != index) continue;
+
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+		coordinate.X = x;
+		coordinate.Y = y;
+		coordinate.Subresource = level;
+
+		coordinates.push_back(coordinate);
+		flags.push_back(eviction ? D3D12_TILE_RANGE_FLAG_NULL : D3D12_TILE_RANGE_FLAG_NONE);
+		heapOffsets.push_back(eviction ? 0 : mapping.slot);
+	}
+
+	if (coordinates.empty()) return;
+
+	const std::vector<UINT> tileCounts(coordinates.size(), 1);
+	m_Queue->UpdateTileMappings(m_Textures[index].resource, static_cast<UINT>(coordinates.size()), coordinates.data(), nullptr, m_Heap, static_cast<UINT>(coordinates.size()),
+		flags.data(), heapOffsets.data(), tileCounts.data(), D3D12_TILE_MAPPING_FLAG_NONE);
+}
+
+void VirtualTextures::CopyFeedback(ID3D12GraphicsCommandList4* cmdList, UINT frameNumber)
+{
+	if (m_Textures.empty()) return;
+
+	Transition(cmdList, m_FeedbackBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	cmdList->CopyBufferRegion(m_ReadbackBuffer, 0, m_FeedbackBuffer, 0, static_cast<UINT64>(GetFeedbackCount()) * sizeof(UINT));
+	Transition(cmdList, m_FeedbackBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	m_FeedbackFrame = frameNumber;
+}
+
+void VirtualTextures::SetTextureRecords(std::vector<MaterialRecord>& textures) const
+{
+	for (const VirtualTexture& texture : m_Textures)
+	{
+		if (texture.textureIndex >= textures.size()) continue;
+
+		textures[texture.textureIndex].virtualTexture = DirectX::XMUINT4(texture.firstTile + 1, texture.residencyOffset,
+			texture.file->GetTileWidth() | (texture.file->GetTileHeight() << 16), texture.streamedLevels);
+	}
+}
+
+void VirtualTextures::Transition(ID3D12GraphicsCommandList4* cmdList, ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+{
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	barrier.Transition.pResource = resource;
+	barrier.Transition.StateBefore = before;
+	barrier.Transition.StateAfter = after;
+	barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+	cmdList->ResourceBarrier(1, &barrier);
+}
+
+void VirtualTextures::Release()
+{
+	if (m_ReadbackBuffer && m_Feedback) m_ReadbackBuffer->Unmap(0, nullptr);
+	if (m_Staging && m_StagingData) m_Staging->Unmap(0, nullptr);
+	m_Feedback = nullptr;
+	m_StagingData = nullptr;
+	m_FeedbackFrame = 0;
+
+	SAFE_RELEASE(m_Heap);
+	SAFE_RELEASE(m_FeedbackBuffer);
+	SAFE_RELEASE(m_ReadbackBuffer);
+	SAFE_RELEASE(m_ResidencyBuffer);
+	SAFE_RELEASE(m_Staging);
+
+	// The reserved resources themselves are released by their owner
+	m_Textures.clear();
+	m_Residency.Reset(static_cast<UINT>(m_Budget / TileFile::TileBytes));
+	m_ResidencyCount = 0;
+}
\ No newline at end of file
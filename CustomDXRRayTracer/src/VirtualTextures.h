@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Structures.h"
+#include "TileFile.h"
+#include "TileResidency.h"
+
+// Textures whose larger side is above this are streamed as tiles rather than loaded whole
+static const UINT VirtualTextureMinSize = 8192;
+// Tiles copied in per frame, which also sizes the staging buffer they go through
+static const UINT MaxTileLoadsPerFrame = 64;
+
+struct VirtualTextureStats
+{
+	UINT64 tilesLoaded = 0;
+	UINT64 tilesEvicted = 0;
+	UINT64 tilesDeferred = 0;
+	UINT frameCount = 0;
+	UINT peakResident = 0;
+	float milliseconds = 0.f;	// Time spent reading feedback, updating residency and recording the copies
+};
+
+// Streams the standard levels of large textures into reserved resources one 64 KB tile at a time, backed by a single
+// heap whose size is the tile budget. The closest hit shader stamps the tiles it would like to read into a feedback
+// buffer with the frame number; that buffer is read back after the frame, the requested tiles are handed heap slots
+// by TileResidency, mapped with UpdateTileMappings and filled from the texture's tile file with CopyTiles. A residency
+// map per texture gives the shader the finest level resident over each of its top level tiles, which it clamps to.
+// The packed levels at the end of every chain are mapped and uploaded once, outside the budget.
+class VirtualTextures
+{
+public:
+	VirtualTextures() {}
+
+	~VirtualTextures()
+	{
+		Release();
+	}
+
+	VirtualTextures(const VirtualTextures&) = delete;
+	VirtualTextures& operator=(const VirtualTextures&) = delete;
+
+	void Init(ID3D12Device5* device, ID3D12CommandQueue* queue, UINT64 budget);
+
+	// Creates the reserved resource of a tile file for the given texture index. The resource belongs to the caller,
+	// which must keep it alive until Release.
+	ID3D12Resource* AddTexture(const std::string& path, UINT textureIndex);
+
+	// Creates the tile heap, the feedback and residency buffers, and maps and uploads the packed levels of every
+	// texture added so far. The copies are recorded on the given list, which must run before the first Update.
+	void Create(ID3D12GraphicsCommandList4* cmdList);
+
+	// Reads the previous frame's feedback and records the tile copies and residency map updates it leads to.
+	// The previous frame must have finished on the GPU.
+	void Update(ID3D12GraphicsCommandList4* cmdList);
+
+	// Records the copy of this frame's feedback, written with the given frame number, to the readback buffer
+	void CopyFeedback(ID3D12GraphicsCommandList4* cmdList, UINT frameNumber);
+
+	// Virtual texture constants of the streamed textures' records: first feedback tile plus one (zero for regular
+	// textures), residency map offset, tile width and height, and the number of streamed levels
+	void SetTextureRecords(std::vector<MaterialRecord>& textures) const;
+
+	void Release();
+
+	ID3D12Resource* GetFeedbackBuffer() const
+	{
+		return m_FeedbackBuffer;
+	}
+
+	ID3D12Resource* GetResidencyBuffer() const
+	{
+		return m_ResidencyBuffer;
+	}
+
+	// Elements in the feedback and residency buffers, at least one so their views are never empty
+	UINT GetFeedbackCount() const
+	{
+		return (std::max)(m_Residency.GetTileCount(), 1u);
+	}
+
+	UINT GetResidencyCount() const
+	{
+		return (std::max)(m_ResidencyCount, 1u);
+	}
+
+	UINT GetTextureCount() const
+	{
+		return static_cast<UINT>(m_Textures.size());
+	}
+
+	UINT GetSlotCount() const
+	{
+		return m_Residency.GetSlotCount();
+	}
+
+	const VirtualTextureStats& GetStats() const
+	{
+		return m_Stats;
+	}
+
+private:
+	struct VirtualTexture
+	{
+		std::shared_ptr<TileFile> file;
+		ID3D12Resource* resource = nullptr;
+		UINT textureIndex = 0;
+		UINT firstTile = 0;
+		UINT residencyOffset = 0;
+		UINT streamedLevels = 0;
+		UINT standardLevels = 0;
+		UINT packedTiles = 0;
+	};
+
+	void UpdateMappings(UINT index);
+
+	void Transition(ID3D12GraphicsCommandList4* cmdList, ID3D12Resource* resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+
+	ID3D12Device5* m_Device = nullptr;
+	ID3D12CommandQueue* m_Queue = nullptr;
+	UINT64 m_Budget = 0;
+
+	std::vector<VirtualTexture> m_Textures;
+	TileResidency m_Residency;
+	UINT m_ResidencyCount = 0;
+
+	ID3D12Heap* m_Heap = nullptr;
+	ID3D12Resource* m_FeedbackBuffer = nullptr;
+	ID3D12Resource* m_ReadbackBuffer = nullptr;
+	UINT* m_Feedback = nullptr;
+	UINT m_FeedbackFrame = 0;
+	ID3D12Resource* m_ResidencyBuffer = nullptr;
+	ID3D12Resource* m_Staging = nullptr;
+	UINT8* m_StagingData = nullptr;
+
+	std::vector<UINT> m_Requests;
+	std::vector<TileMapping> m_Loads;
+	std::vector<TileMapping> m_Evictions;
+	std::vector<UINT> m_ChangedTextures;
+	std::vector<UINT> m_MinLevels;
+
+	VirtualTextureStats m_Stats;
+};
\ No newline at end of file
@@ -1,6 +1,7 @@
-#include "window.h"
-#include "graphics.h"
-#include "utils.h"
+#include "Window.h"
+#include "Graphics.h"
+#include "ModelStream.h"
+#include "Utils.h"
 
 #include <sstream>
 
@@ -21,8 +22,13 @@ public:
 		d3d.width = config.width;
 		d3d.height = config.height;
 		d3d.vsync = config.vsync;
+		d3d.compactVertices = config.compactVertices;
+		d3d.mipFilter = config.mipFilter;
+		d3d.textureCompression = config.textureCompression;
+		d3d.compressionQuality = config.compressionQuality;
+		d3d.tileBudget = config.tileBudget;
 
-		Utils::LoadModel(config.model, model, material);
+		stream.Start(config.model, materials);
 
 		D3DShaders::Init_Shader_Compiler(shaderCompiler);
 
@@ -36,21 +42,23 @@ public:
 
 		D3DResources::Create_Descriptor_Heaps(d3d, resources);
 		D3DResources::Create_BackBuffer_RTV(d3d, resources);
-		D3DResources::Create_Vertex_Buffer(d3d, resources, model);
-		D3DResources::Create_Index_Buffer(d3d, resources, model);
-		D3DResources::Create_Texture(d3d, resources, material);
+		D3DResources::Create_Upload_Manager(d3d, resources);
+		D3DResources::Create_Virtual_Textures(d3d, resources);
+		D3DResources::Create_Textures(d3d, resources, materials);
+		D3DResources::Create_Environment(d3d, resources, config.environment);
 		D3DResources::Create_View_CB(d3d, resources);
-		D3DResources::Create_Material_CB(d3d, resources, material);
+		D3DResources::Create_Material_Buffer(d3d, resources);
 
-		DXR::Create_Bottom_Level_AS(d3d, dxr, resources, model);
-		DXR::Create_Top_Level_AS(d3d, dxr, resources);
 		DXR::Create_DXR_Output(d3d, resources);
-		DXR::Create_Descriptor_Heaps(d3d, dxr, resources, model);
+		DXR::Create_Descriptor_Heaps(d3d, dxr, resources);
 		DXR::Create_RayGen_Program(d3d, dxr, shaderCompiler);
 		DXR::Create_Miss_Program(d3d, dxr, shaderCompiler);
 		DXR::Create_Closest_Hit_Program(d3d, dxr, shaderCompiler);
 		DXR::Create_Pipeline_State_Object(d3d, dxr);
-		DXR::Create_Shader_Table(d3d, dxr, resources);
+
+		std::vector<std::shared_ptr<Model>> batches;
+		stream.Poll(batches);
+		Append_Batches(batches);
 
 		d3d.cmdList->Close();
 		ID3D12CommandList* pGraphicsList = { d3d.cmdList };
@@ -58,11 +66,30 @@ public:
 
 		D3D12::WaitForGPU(d3d);
 		D3D12::Reset_CommandList(d3d);
+
+		// Batches still streaming in bring the upload ring back until the model is complete
+		D3DResources::Release_Uploads(resources);
 	}
 
 	void Update()
 	{
+		// The previous frame has finished on the GPU, so replaced buffers can go and new batches can be built
+		DXR::Release_Retired_Resources(dxr);
+
 		D3DResources::Update_View_CB(d3d, resources);
+
+		// Tiles asked for by the previous frame are mapped and copied in ahead of this one
+		D3DResources::Update_Virtual_Textures(d3d, resources);
+
+		// Textures finished in the background replace their placeholders
+		D3DResources::Update_Textures(d3d, resources);
+
+		// Cluster levels follow the camera; the TLAS is only rebuilt when one of them changes
+		std::vector<std::shared_ptr<Model>> batches;
+		if (stream.Poll(batches)) Append_Batches(batches);
+		else if (DXR::Select_Lods(d3d, resources)) DXR::Create_Top_Level_AS(d3d, dxr, resources);
+
+		if (stream.IsFinished()) D3DResources::Release_Uploads(resources);
 	}
 
 	void Render()
@@ -75,6 +102,8 @@ public:
 
 	void Cleanup()
 	{
+		stream.Stop();
+
 		D3D12::WaitForGPU(d3d);
 		CloseHandle(d3d.fenceEvent);
 
@@ -88,8 +117,17 @@ public:
 
 	HWND window;
 private:
-	Model model;
-	Material material;
+	void Append_Batches(const std::vector<std::shared_ptr<Model>>& batches)
+	{
+		for (const std::shared_ptr<Model>& batch : batches) DXR::Append_Geometry(d3d, dxr, resources, batch);
+
+		DXR::Select_Lods(d3d, resources);
+		DXR::Create_Top_Level_AS(d3d, dxr, resources);
+		DXR::Create_Shader_Table(d3d, dxr, resources);
+	}
+
+	ModelStream stream;
+	std::vector<Material> materials;
 
 	DXRGlobal dxr = {};
 	D3D12Global d3d = {};
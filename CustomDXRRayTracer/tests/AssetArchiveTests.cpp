@@ -0,0 +1,207 @@
+#include "AssetArchive.h"
+#include "MipGenerator.h"
+#include "Test.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+namespace
+{
+	const int TextureWidth = 64;
+	const int TextureHeight = 48;
+
+	void WriteBytes(const std::string& path, const std::string& bytes)
+	{
+		Utils::OutputFile file;
+		CHECK(file.Open(path) && file.Write(bytes.data(), bytes.size()) && file.Commit(), "writing %s failed", path.c_str());
+	}
+
+	// An uncompressed 32-bit TGA, stored top row first
+	std::string MakeTga()
+	{
+		std::string bytes(18, '\0');
+		bytes[2] = 2;
+		bytes[12] = static_cast<char>(TextureWidth & 0xFF);
+		bytes[13] = static_cast<char>(TextureWidth >> 8);
+		bytes[14] = static_cast<char>(TextureHeight & 0xFF);
+		bytes[15] = static_cast<char>(TextureHeight >> 8);
+		bytes[16] = 32;
+		bytes[17] = 0x28;
+		for (int y = 0; y < TextureHeight; y++)
+		{
+			for (int x = 0; x < TextureWidth; x++)
+			{
+				const char texel[4] = { static_cast<char>(x * 4), static_cast<char>(y * 5), static_cast<char>((x ^ y) * 3), static_cast<char>(255) };
+				bytes.append(texel, 4);
+			}
+		}
+		return bytes;
+	}
+
+	// A textured quad and an untextured triangle in two materials
+	void WriteSources()
+	{
+		WriteBytes("archive_test/texture.tga", MakeTga());
+		WriteBytes("materials/archive_test.mtl", "newmtl textured\nmap_Kd archive_test/texture.tga\nnewmtl plain\nKd 1 0 0\n");
+		WriteBytes("archive_test/model.obj",
+			"mtllib archive_test.mtl\n"
+			"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0 0\nv 3 0 0\nv 2 1 0\n"
+			"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+			"usemtl textured\nf 1/1 2/2 3/3\nf 1/1 3/3 4/4\n"
+			"usemtl plain\nf 5/1 6/2 7/3\n");
+	}
+
+	bool Rejects(const std::string& path)
+	{
+		try
+		{
+			std::vector<std::shared_ptr<Model>> models;
+			std::vector<Material> materials;
+			AssetArchive::Load(path, models, materials);
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	UINT64 ReadUInt64(const std::string& bytes, size_t offset)
+	{
+		UINT64 value = 0;
+		memcpy(&value, bytes.data() + offset, sizeof(value));
+		return value;
+	}
+
+	void TestRoundTrip(TextureCompression compression)
+	{
+		TextureOptions options;
+		options.compression = compression;
+
+		// Bake from a texture cache miss, so the archive pads freshly built levels itself
+		Utils::MappedFile source;
+		CHECK(source.Open("archive_test/texture.tga"), "the texture was not written");
+		remove(TextureCache::GetCachePath(TextureCache::ComputeKey(reinterpret_cast<const UINT8*>(source.Data()), static_cast<size_t>(source.Size()), 0, 0, options)).c_str());
+
+		const BakeStats stats = AssetArchive::Bake("archive_test/scene.dxra", { "archive_test/model.obj" }, options);
+		CHECK(stats.modelCount == 1 && stats.materialCount == 2 && stats.textureCount == 1, "baked %zu models, %zu materials and %zu textures", stats.modelCount, stats.materialCount, stats.textureCount);
+
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<Material> materials;
+		AssetArchive::Load("archive_test/scene.dxra", models, materials);
+		CHECK(models.size() == 1 && materials.size() == 2, "loaded %zu models and %zu materials", models.size(), materials.size());
+		if (models.size() != 1 || materials.size() != 2) return;
+
+		Model expected;
+		std::vector<Material> expectedMaterials;
+		Utils::LoadModel("archive_test/model.obj", expected, expectedMaterials);
+		const Model& model = *models[0];
+		CHECK(model.VertexCount() == expected.VertexCount() && memcmp(model.VertexData(), expected.VertexData(), expected.VertexCount() * sizeof(Vertex)) == 0, "vertices differ from the loader's");
+		CHECK(model.IndexCount() == expected.IndexCount() && memcmp(model.IndexData(), expected.IndexData(), expected.IndexCount() * sizeof(uint32_t)) == 0, "indices differ from the loader's");
+
+		// The textured material carries its GPU form, which comes back in place and matches the texture cache's
+		const Material& textured = materials[0].embeddedTexture ? materials[0] : materials[1];
+		const DXGI_FORMAT format = (compression == TextureCompression::BC1) ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+		CHECK(textured.embeddedFormat == format && textured.embeddedWidth == TextureWidth && textured.embeddedHeight == TextureHeight, "the texture was baked as format %d, %dx%d", static_cast<int>(textured.embeddedFormat), textured.embeddedWidth, textured.embeddedHeight);
+		CHECK(textured.embeddedMipLevels == static_cast<int>(MipGenerator::GetMipCount(TextureWidth, TextureHeight)), "the texture has %d levels", textured.embeddedMipLevels);
+
+		TextureLoadStats loadStats;
+		const TextureInfo baked = Utils::LoadTexture(textured, options, loadStats);
+		CHECK(baked.mappedPixels == textured.embeddedTexture && baked.format == format && baked.mipLevels == textured.embeddedMipLevels, "the baked texture was not returned in place");
+
+		const TextureInfo cached = Utils::LoadTexture("archive_test/texture.tga", options, loadStats);
+		CHECK(loadStats.cacheHit && cached.mappedSize == baked.mappedSize && memcmp(cached.mappedPixels, baked.mappedPixels, cached.mappedSize) == 0, "the baked texels differ from the texture cache's");
+
+		// A version from before the texture layout changed is rejected
+		Utils::MappedFile archive;
+		CHECK(archive.Open("archive_test/scene.dxra"), "the archive was not written");
+		std::string bytes(archive.Data(), static_cast<size_t>(archive.Size()));
+		bytes[4] = 1;
+		WriteBytes("archive_test/old.dxra", bytes);
+
+		bool rejected = false;
+		try
+		{
+			AssetArchive::Load("archive_test/old.dxra", models, materials);
+		}
+		catch (const std::runtime_error&)
+		{
+			rejected = true;
+		}
+		CHECK(rejected, "a version 1 archive was accepted");
+	}
+
+	void TestDamaged()
+	{
+		// A flat grid, which simplifies into LOD levels
+		std::string grid = "mtllib archive_test.mtl\nusemtl plain\n";
+		const int size = 64;
+		for (int y = 0; y <= size; y++)
+		{
+			for (int x = 0; x <= size; x++) grid += "v " + std::to_string(x) + " 0 " + std::to_string(y) + "\n";
+		}
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				const int a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+				grid += "f " + std::to_string(a) + " " + std::to_string(b) + " " + std::to_string(d) + " " + std::to_string(c) + "\n";
+			}
+		}
+		WriteBytes("archive_test/grid.obj", grid);
+
+		AssetArchive::Bake("archive_test/damaged.dxra", { "archive_test/grid.obj" }, TextureOptions());
+		Utils::MappedFile archive;
+		CHECK(archive.Open("archive_test/damaged.dxra"), "the archive was not written");
+		const std::string bytes(archive.Data(), static_cast<size_t>(archive.Size()));
+		archive.Close();
+
+		// The first model's entry follows the 32-byte header as thirteen 64-bit offsets and counts
+		const size_t entry = 32;
+		const UINT64 vertexCount = ReadUInt64(bytes, entry + 8);
+		const UINT64 indexOffset = ReadUInt64(bytes, entry + 16);
+		const UINT64 submeshOffset = ReadUInt64(bytes, entry + 40);
+		const UINT64 clusterOffset = ReadUInt64(bytes, entry + 56);
+		const UINT64 lodOffset = ReadUInt64(bytes, entry + 72);
+		const UINT64 lodCount = ReadUInt64(bytes, entry + 80);
+		CHECK(lodCount > 0 && !Rejects("archive_test/damaged.dxra"), "the intact archive has %llu LOD levels or was rejected", static_cast<unsigned long long>(lodCount));
+
+		// Each value the renderer indexes with, pointed one past what it refers to
+		struct Damage
+		{
+			UINT64 offset;
+			UINT32 value;
+			const char* what;
+		};
+
+		const Damage damages[] =
+		{
+			{ indexOffset + 4, static_cast<UINT32>(vertexCount), "an index past the vertices" },
+			{ submeshOffset + offsetof(Submesh, materialIndex), 2, "a material index past the materials" },
+			{ submeshOffset + offsetof(Submesh, indexCount), 0x7FFFFFFF, "a submesh past the indices" },
+			{ clusterOffset + offsetof(Cluster, submeshCount), 100, "a cluster past the submeshes" },
+			{ clusterOffset + offsetof(Cluster, lodCount), static_cast<UINT32>(lodCount + 1), "a cluster past the LOD levels" },
+			{ lodOffset + offsetof(ClusterLod, submeshCount), 100000, "a LOD level past the submeshes" },
+		};
+
+		for (const Damage& damage : damages)
+		{
+			std::string damaged = bytes;
+			memcpy(&damaged[static_cast<size_t>(damage.offset)], &damage.value, sizeof(damage.value));
+			WriteBytes("archive_test/damaged_copy.dxra", damaged);
+			CHECK(Rejects("archive_test/damaged_copy.dxra"), "%s was accepted", damage.what);
+		}
+
+		remove("archive_test/damaged_copy.dxra");
+		remove("archive_test/damaged.dxra");
+	}
+}
+
+int main()
+{
+	WriteSources();
+	TestRoundTrip(TextureCompression::None);
+	TestRoundTrip(TextureCompression::BC1);
+	TestDamaged();
+
+	return Test::Finish("AssetArchiveTests");
+}
\ No newline at end of file
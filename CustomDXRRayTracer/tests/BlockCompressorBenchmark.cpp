@@ -0,0 +1,59 @@
+#include "BlockCompressor.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// Compresses a 2048 x 2048 photo-like texture to BC1 and to BC7 at every quality and reports the throughput of each.
+// Usage: BlockCompressorBenchmark [size]
+int main(int argc, char** argv)
+{
+	const int size = (argc > 1) ? (atoi(argv[1]) & ~3) : 2048;
+
+	// Overlapping waves of different colours with grain
+	std::mt19937 random(17);
+	TextureInfo source;
+	source.width = source.height = size;
+	source.stride = 4;
+	source.pixels.resize(static_cast<size_t>(size) * size * 4);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			UINT8* texel = &source.pixels[(static_cast<size_t>(y) * size + x) * 4];
+			for (int c = 0; c < 3; c++)
+			{
+				const float value = 128.f + 60.f * sinf(x * (0.011f + c * 0.005f)) * cosf(y * 0.007f) + 40.f * sinf((x + y * (c + 1)) * 0.023f);
+				texel[c] = static_cast<UINT8>((std::min)(255.f, (std::max)(0.f, value + static_cast<int>(random() % 25) - 12.f)));
+			}
+			texel[3] = 255;
+		}
+	}
+
+	struct Run
+	{
+		const char* name;
+		TextureCompression compression;
+		CompressionQuality quality;
+	};
+
+	const Run runs[] =
+	{
+		{ "BC1", TextureCompression::BC1, CompressionQuality::Normal },
+		{ "BC7 fast", TextureCompression::BC7, CompressionQuality::Fast },
+		{ "BC7 normal", TextureCompression::BC7, CompressionQuality::Normal },
+		{ "BC7 high", TextureCompression::BC7, CompressionQuality::High },
+	};
+
+	printf("%dx%d texels, %u workers\n", size, size, Utils::GetWorkerCount());
+	for (const Run& run : runs)
+	{
+		TextureInfo texture = source;
+		const CompressStats stats = BlockCompressor::Compress(texture, run.compression, run.quality);
+		const double texels = static_cast<double>(size) * size;
+		printf("  %-12s %9.1f ms  %7.2f M texels/s  %7.1f MB/s in\n", run.name, stats.milliseconds, texels / (stats.milliseconds * 1000.0), stats.inputBytes / (1024.0 * 1024.0) / (stats.milliseconds * 0.001));
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "BlockCompressor.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const int ImageSize = 256;
+
+	const UINT16 Partitions2[64] =
+	{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	const UINT8 Anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+	};
+
+	const int Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Reads a BC7 block's bits from the least significant end
+	class BitReader
+	{
+	public:
+		explicit BitReader(const UINT8* block) : m_Block(block) {}
+
+		int Read(int count)
+		{
+			int value = 0;
+			for (int i = 0; i < count; i++, m_Position++) value |= ((m_Block[m_Position >> 3] >> (m_Position & 7)) & 1) << i;
+			return value;
+		}
+
+	private:
+		const UINT8* m_Block;
+		int m_Position = 0;
+	};
+
+	// Decodes the two BC7 modes the encoder writes, following the format specification rather than the encoder.
+	// Returns false for any other mode.
+	bool DecodeBc7(const UINT8* block, UINT8 (&texels)[16][4])
+	{
+		BitReader reader(block);
+		if (reader.Read(2) == 2)
+		{
+			const int partition = reader.Read(6);
+			int endpoints[2][2][3];
+			for (int c = 0; c < 3; c++)
+			{
+				for (int s = 0; s < 2; s++)
+				{
+					endpoints[s][0][c] = reader.Read(6);
+					endpoints[s][1][c] = reader.Read(6);
+				}
+			}
+			for (int s = 0; s < 2; s++)
+			{
+				const int pBit = reader.Read(1);
+				for (int e = 0; e < 2; e++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						const int value = (endpoints[s][e][c] << 1) | pBit;
+						endpoints[s][e][c] = (value << 1) | (value >> 6);
+					}
+				}
+			}
+			for (int i = 0; i < 16; i++)
+			{
+				const int s = (Partitions2[partition] >> i) & 1;
+				const int index = reader.Read((i == 0 || i == Anchors2[partition]) ? 2 : 3);
+				for (int c = 0; c < 3; c++) texels[i][c] = static_cast<UINT8>(((64 - Weights3[index]) * endpoints[s][0][c] + Weights3[index] * endpoints[s][1][c] + 32) >> 6);
+				texels[i][3] = 255;
+			}
+			return true;
+		}
+
+		reader = BitReader(block);
+		if (reader.Read(7) != (1 << 6)) return false;
+
+		int endpoints[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			endpoints[0][c] = reader.Read(7);
+			endpoints[1][c] = reader.Read(7);
+		}
+		for (int e = 0; e < 2; e++)
+		{
+			const int pBit = reader.Read(1);
+			for (int c = 0; c < 4; c++) endpoints[e][c] = (endpoints[e][c] << 1) | pBit;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			const int index = reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++) texels[i][c] = static_cast<UINT8>(((64 - Weights4[index]) * endpoints[0][c] + Weights4[index] * endpoints[1][c] + 32) >> 6);
+		}
+		return true;
+	}
+
+	void DecodeBc1(const UINT8* block, UINT8 (&texels)[16][4])
+	{
+		UINT16 colors[2];
+		memcpy(colors, block, sizeof(colors));
+
+		int palette[4][4];
+		for (int e = 0; e < 2; e++)
+		{
+			const int r = (colors[e] >> 11) & 31, g = (colors[e] >> 5) & 63, b = colors[e] & 31;
+			palette[e][0] = (r << 3) | (r >> 2);
+			palette[e][1] = (g << 2) | (g >> 4);
+			palette[e][2] = (b << 3) | (b >> 2);
+			palette[e][3] = 255;
+		}
+		for (int c = 0; c < 4; c++)
+		{
+			if (colors[0] > colors[1])
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+
+		UINT32 indices;
+		memcpy(&indices, block + 4, sizeof(indices));
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++) texels[i][c] = static_cast<UINT8>(palette[(indices >> (i * 2)) & 3][c]);
+		}
+	}
+
+	typedef UINT8 (*Generator)(int x, int y, int channel, std::mt19937& random);
+
+	// Smooth gradients with a little noise, like skies and soft lighting
+	UINT8 Gradient(int x, int y, int channel, std::mt19937& random)
+	{
+		const float value = (channel == 0) ? x : (channel == 1) ? y : (x + y) * 0.5f;
+		return static_cast<UINT8>((std::min)(255.f, (std::max)(0.f, value + static_cast<int>(random() % 7) - 3.f)));
+	}
+
+	// Overlapping waves of different colours with grain, like a photographed surface
+	UINT8 Detail(int x, int y, int channel, std::mt19937& random)
+	{
+		const float value = 128.f + 60.f * sinf(x * (0.11f + channel * 0.05f)) * cosf(y * 0.07f) + 40.f * sinf((x + y * (channel + 1)) * 0.23f);
+		return static_cast<UINT8>((std::min)(255.f, (std::max)(0.f, value + static_cast<int>(random() % 25) - 12.f)));
+	}
+
+	// Two flat colours meeting along diagonal edges, like decals and lettering
+	UINT8 Edges(int x, int y, int channel, std::mt19937&)
+	{
+		const UINT8 colors[2][3] = { { 200, 40, 30 }, { 20, 90, 220 } };
+		return colors[((x * 3 + y * 5) / 11) & 1][channel];
+	}
+
+	TextureInfo MakeImage(Generator generator, bool cutout)
+	{
+		std::mt19937 random(17);
+		TextureInfo texture;
+		texture.width = texture.height = ImageSize;
+		texture.stride = 4;
+		texture.pixels.resize(ImageSize * ImageSize * 4);
+		for (int y = 0; y < ImageSize; y++)
+		{
+			for (int x = 0; x < ImageSize; x++)
+			{
+				UINT8* texel = &texture.pixels[(y * ImageSize + x) * 4];
+				for (int c = 0; c < 3; c++) texel[c] = generator(x, y, c, random);
+				texel[3] = cutout ? static_cast<UINT8>((x / 3 + y / 5) % 7 < 3 ? 20 : 230) : 255;
+			}
+		}
+		return texture;
+	}
+
+	// Compresses one level and decodes it again; false if a block uses a mode the decoder does not know
+	bool RoundTrip(const TextureInfo& source, TextureCompression compression, CompressionQuality quality, std::vector<UINT8>& decoded)
+	{
+		TextureInfo texture = source;
+		BlockCompressor::Compress(texture, compression, quality);
+
+		const int blocksWide = ImageSize / 4;
+		const UINT blockBytes = BlockCompressor::GetBlockBytes(texture.format);
+		decoded.assign(source.pixels.size(), 0);
+		for (int block = 0; block < blocksWide * blocksWide; block++)
+		{
+			UINT8 texels[16][4];
+			if (compression == TextureCompression::BC1) DecodeBc1(&texture.pixels[block * blockBytes], texels);
+			else if (!DecodeBc7(&texture.pixels[block * blockBytes], texels)) return false;
+
+			for (int i = 0; i < 16; i++)
+			{
+				const int x = (block % blocksWide) * 4 + (i & 3), y = (block / blocksWide) * 4 + (i >> 2);
+				memcpy(&decoded[(y * ImageSize + x) * 4], texels[i], 4);
+			}
+		}
+		return true;
+	}
+
+	double Psnr(const std::vector<UINT8>& lhs, const std::vector<UINT8>& rhs, int channels)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < lhs.size(); i += 4)
+		{
+			for (int c = 0; c < channels; c++) sum += (lhs[i + c] - rhs[i + c]) * (lhs[i + c] - rhs[i + c]);
+		}
+		const double mse = sum / (lhs.size() / 4 * channels);
+		return (mse == 0.0) ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+	}
+
+	struct Case
+	{
+		const char* name;
+		Generator generator;
+		double bc1;
+		double bc7[3];
+	};
+
+	void TestQuality()
+	{
+		// PSNR floors in dB for BC1 (RGB) and for BC7 (RGBA) at each quality, about 1 dB under what the encoder reaches
+		// today: 41.7, 45.4, 47.5 and 47.6 on the gradient, 28.7, 31.1, 34.5 and 34.5 on the detail, and 40.6 then 54.2
+		// for every BC7 quality on the edges
+		const Case cases[] =
+		{
+			{ "gradient", Gradient, 40.5, { 44.0, 46.5, 46.5 } },
+			{ "detail", Detail, 27.5, { 30.0, 33.5, 33.5 } },
+			{ "edges", Edges, 39.5, { 53.0, 53.0, 53.0 } },
+		};
+
+		const char* qualityNames[] = { "fast", "normal", "high" };
+		for (const Case& test : cases)
+		{
+			const TextureInfo source = MakeImage(test.generator, false);
+
+			std::vector<UINT8> decoded;
+			RoundTrip(source, TextureCompression::BC1, CompressionQuality::Normal, decoded);
+			const double bc1 = Psnr(source.pixels, decoded, 3);
+			CHECK(bc1 >= test.bc1, "BC1 reaches %.2f dB on %s, under %.2f", bc1, test.name, test.bc1);
+
+			double previous = 0.0;
+			for (int quality = 0; quality < 3; quality++)
+			{
+				CHECK(RoundTrip(source, TextureCompression::BC7, static_cast<CompressionQuality>(quality), decoded), "BC7 %s wrote a mode other than 1 and 6 on %s", qualityNames[quality], test.name);
+				const double bc7 = Psnr(source.pixels, decoded, 4);
+				CHECK(bc7 >= test.bc7[quality], "BC7 %s reaches %.2f dB on %s, under %.2f", qualityNames[quality], bc7, test.name, test.bc7[quality]);
+				CHECK(bc7 >= previous - 0.05, "BC7 %s is worse than the quality below it on %s", qualityNames[quality], test.name);
+				CHECK(bc7 > bc1, "BC7 %s is no better than BC1 on %s", qualityNames[quality], test.name);
+				previous = bc7;
+			}
+		}
+	}
+
+	void TestCutout()
+	{
+		// BC1 keeps alpha as one bit: texels under half alpha must come back transparent black, the rest opaque
+		const TextureInfo source = MakeImage(Detail, true);
+		std::vector<UINT8> decoded;
+		RoundTrip(source, TextureCompression::BC1, CompressionQuality::Normal, decoded);
+
+		size_t wrong = 0;
+		for (size_t i = 0; i < decoded.size(); i += 4)
+		{
+			const bool transparent = source.pixels[i + 3] < 128;
+			wrong += transparent ? (decoded[i + 3] != 0) : (decoded[i + 3] != 255);
+		}
+		CHECK(wrong == 0, "%zu texels lost their 1-bit alpha", wrong);
+
+		// BC7 mode 6 fits alpha on the same line as colour, which a hard cutout strains; it reaches 27.7 dB
+		std::vector<UINT8> bc7;
+		CHECK(RoundTrip(source, TextureCompression::BC7, CompressionQuality::Normal, bc7), "BC7 wrote a mode other than 1 and 6 on the cutout");
+		const double psnr = Psnr(source.pixels, bc7, 4);
+		CHECK(psnr >= 26.5, "BC7 reaches %.2f dB on the cutout, under 26.50", psnr);
+	}
+}
+
+int main()
+{
+	TestQuality();
+	TestCutout();
+
+	return Test::Finish("BlockCompressorTests");
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "EnvironmentMap.h"
+#include "Utils.h"
+
+// Builds the texels and sampling table of an 8K lat-long map and times the steps on their own.
+// Usage: EnvironmentMapBenchmark [width]; the map is half as tall as it is wide.
+int main(int argc, char** argv)
+{
+	const UINT width = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 8192;
+	const UINT height = width / 2;
+
+	std::vector<float> texels(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < texels.size(); i++) texels[i] = (i % 97) * 0.37f + 0.01f;
+
+	printf("%u x %u, %u workers\n", width, height, Utils::GetWorkerCount());
+
+	// Best of three, so the first run's page faults do not count
+	EnvironmentStats best;
+	UINT tableWidth = 0, tableHeight = 0;
+	for (int run = 0; run < 3; run++)
+	{
+		EnvironmentInfo environment;
+		EnvironmentStats stats;
+		EnvironmentMap::Build(texels.data(), width, height, environment, stats);
+		if (run == 0 || stats.tableMilliseconds < best.tableMilliseconds) best = stats;
+		tableWidth = environment.tableWidth;
+		tableHeight = environment.tableHeight;
+	}
+	printf("  texels and table %8.1f ms, %6.1f M texels/s (%u x %u cells)\n", best.tableMilliseconds, texels.size() / 4 / (best.tableMilliseconds * 1000.0), tableWidth, tableHeight);
+
+	// The scalar encoder the SSE2 path in Build replaces
+	std::vector<UINT32> encoded(static_cast<size_t>(width) * height);
+	Utils::Timer timer;
+	for (size_t i = 0; i < encoded.size(); i++) encoded[i] = EnvironmentMap::EncodeRgb9e5(texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2]);
+	const float encodeMilliseconds = timer.ElapsedMillis();
+	printf("  scalar encode    %8.1f ms, %6.1f M texels/s\n", encodeMilliseconds, encoded.size() / (encodeMilliseconds * 1000.0));
+
+	// Alias tables alone, one row at a time on this thread
+	const UINT rowWidth = EnvironmentTableMaxWidth, rowCount = EnvironmentTableMaxWidth / 2;
+	std::vector<float> weights(static_cast<size_t>(rowWidth) * rowCount);
+	for (size_t i = 0; i < weights.size(); i++) weights[i] = (i * 7919 % 1000) * 0.1f;
+	std::vector<AliasEntry> table(weights.size());
+	timer.Reset();
+	for (UINT row = 0; row < rowCount; row++) EnvironmentMap::BuildAliasTable(weights.data() + static_cast<size_t>(row) * rowWidth, rowWidth, table.data() + static_cast<size_t>(row) * rowWidth);
+	const float aliasMilliseconds = timer.ElapsedMillis();
+	printf("  alias tables     %8.1f ms, %u rows of %u, %6.1f M entries/s\n", aliasMilliseconds, rowCount, rowWidth, weights.size() / (aliasMilliseconds * 1000.0));
+
+	return 0;
+}
\ No newline at end of file
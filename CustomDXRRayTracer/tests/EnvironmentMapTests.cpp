@@ -0,0 +1,267 @@
+#include "EnvironmentMap.h"
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const double Pi = 3.14159265358979323846;
+
+	float GetLuminance(const float* texel)
+	{
+		return (std::max)(0.f, 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2]);
+	}
+
+	// A sky brightening across the upper half over a dim ground, with a small sun thousands of times brighter
+	void MakeSky(UINT width, UINT height, std::vector<float>& texels)
+	{
+		texels.assign(static_cast<size_t>(width) * height * 4, 0.f);
+		for (UINT y = 0; y < height; y++)
+		{
+			for (UINT x = 0; x < width; x++)
+			{
+				const float sky = (y < height / 2) ? 0.5f + 0.5f * x / width : 0.05f;
+				const float dx = x - width * 0.3f, dy = y - height * 0.25f;
+				const float sun = (dx * dx + dy * dy < (width / 100.f) * (width / 100.f) + 1.f) ? 5000.f : 0.f;
+
+				float* texel = &texels[(static_cast<size_t>(y) * width + x) * 4];
+				texel[0] = sky + sun;
+				texel[1] = sky * 0.8f + sun;
+				texel[2] = sky * 1.2f + sun * 0.9f;
+				texel[3] = 1.f;
+			}
+		}
+	}
+
+	void TestAliasTable()
+	{
+		// The probability every index ends up with, over all slots, must be its share of the weights
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		for (UINT count : { 1u, 2u, 7u, 1000u, 4096u })
+		{
+			std::vector<float> weights(count);
+			for (float& weight : weights)
+			{
+				const float value = unit(random);
+				weight = (value < 0.3f) ? 0.f : value * value * value * 100.f;
+			}
+
+			std::vector<AliasEntry> table(count);
+			EnvironmentMap::BuildAliasTable(weights.data(), count, table.data());
+
+			double sum = 0.0;
+			for (float weight : weights) sum += weight;
+
+			std::vector<double> probabilities(count, 0.0);
+			for (UINT i = 0; i < count; i++)
+			{
+				probabilities[i] += table[i].probability / count;
+				probabilities[table[i].alias] += (1.0 - table[i].probability) / count;
+			}
+
+			double worstProbability = 0.0, worstPdf = 0.0;
+			for (UINT i = 0; i < count; i++)
+			{
+				const double expected = (sum > 0.0) ? weights[i] / sum : 1.0 / count;
+				worstProbability = (std::max)(worstProbability, std::fabs(probabilities[i] - expected));
+				worstPdf = (std::max)(worstPdf, std::fabs(table[i].pdf - expected));
+			}
+
+			CHECK(worstProbability < 1e-6 && worstPdf < 1e-6, "%u weights: probabilities off by %g, pdfs by %g", count, worstProbability, worstPdf);
+		}
+
+		std::vector<float> zeros(5, 0.f);
+		std::vector<AliasEntry> table(5);
+		EnvironmentMap::BuildAliasTable(zeros.data(), 5, table.data());
+		for (const AliasEntry& entry : table) CHECK(std::fabs(entry.pdf - 0.2f) < 1e-7f && entry.probability == 1.f, "zero weights give pdf %f, probability %f", entry.pdf, entry.probability);
+	}
+
+	void TestRgb9e5()
+	{
+		// A shared 5-bit exponent and 9-bit mantissas keep every channel within 1/512 of the largest
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> exponent(-20.f, 16.f), unit(0.f, 1.f);
+		double worst = 0.0;
+		for (int i = 0; i < 1000000; i++)
+		{
+			float color[3];
+			for (float& channel : color) channel = std::pow(2.f, exponent(random)) * unit(random);
+
+			const DirectX::XMFLOAT3 decoded = EnvironmentMap::DecodeRgb9e5(EnvironmentMap::EncodeRgb9e5(color[0], color[1], color[2]));
+			const float largest = (std::max)(color[0], (std::max)(color[1], color[2]));
+			const float error = (std::max)(std::fabs(decoded.x - color[0]), (std::max)(std::fabs(decoded.y - color[1]), std::fabs(decoded.z - color[2])));
+			if (largest > 1e-4f) worst = (std::max)(worst, static_cast<double>(error) / largest);
+		}
+		CHECK(worst <= 1.0 / 512 + 1e-6, "worst error %g of the largest channel", worst);
+
+		const DirectX::XMFLOAT3 clamped = EnvironmentMap::DecodeRgb9e5(EnvironmentMap::EncodeRgb9e5(1e9f, -1.f, NAN));
+		CHECK(clamped.x == 65408.f && clamped.y == 0.f && clamped.z == 0.f, "clamped to %f %f %f", clamped.x, clamped.y, clamped.z);
+
+		const DirectX::XMFLOAT3 exact = EnvironmentMap::DecodeRgb9e5(EnvironmentMap::EncodeRgb9e5(1.f, 0.5f, 0.25f));
+		CHECK(exact.x == 1.f && exact.y == 0.5f && exact.z == 0.25f, "1, 0.5, 0.25 decodes to %f %f %f", exact.x, exact.y, exact.z);
+
+		// Rounding the mantissa up to 512 must move to the next exponent
+		const DirectX::XMFLOAT3 rounded = EnvironmentMap::DecodeRgb9e5(EnvironmentMap::EncodeRgb9e5(1.999f, 0.f, 0.f));
+		CHECK(std::fabs(rounded.x - 2.f) < 1e-6f, "1.999 decodes to %f", rounded.x);
+	}
+
+	void TestBuildEncoding()
+	{
+		// Build encodes with SSE2 and must agree with the scalar encoder, special values included
+		const UINT width = 1023, height = 61;
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> exponent(-26.f, 18.f), unit(-0.2f, 1.f);
+		std::vector<float> texels(static_cast<size_t>(width) * height * 4);
+		for (size_t i = 0; i < texels.size(); i++)
+		{
+			texels[i] = std::pow(2.f, exponent(random)) * unit(random);
+			if (i % 997 == 0) texels[i] = NAN;
+			if (i % 991 == 0) texels[i] = INFINITY;
+			if (i % 983 == 0) texels[i] = 0.f;
+			if (i % 977 == 0) texels[i] = 1.9990234f * std::pow(2.f, static_cast<float>(static_cast<int>(exponent(random))));
+		}
+
+		EnvironmentInfo environment;
+		EnvironmentStats stats;
+		EnvironmentMap::Build(texels.data(), width, height, environment, stats);
+
+		const UINT32* encoded = reinterpret_cast<const UINT32*>(environment.texture.pixels.data());
+		size_t mismatches = 0;
+		for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+		{
+			if (encoded[i] != EnvironmentMap::EncodeRgb9e5(texels[i * 4], texels[i * 4 + 1], texels[i * 4 + 2])) mismatches++;
+		}
+		CHECK(mismatches == 0, "%zu of %u texels encoded differently", mismatches, width * height);
+	}
+
+	void TestLoad()
+	{
+		// A flat, not run-length encoded, Radiance file of 6x3 texels
+		const std::string path = "environment_test.hdr";
+		const UINT width = 6, height = 3;
+		FILE* file = fopen(path.c_str(), "wb");
+		CHECK(file != nullptr, "failed to create %s", path.c_str());
+		if (!file) return;
+
+		fprintf(file, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %u +X %u\n", height, width);
+		for (UINT i = 0; i < width * height; i++)
+		{
+			const unsigned char rgbe[4] = { 128, 64, 32, static_cast<unsigned char>(129 + (i % 3)) };
+			fwrite(rgbe, 1, 4, file);
+		}
+		fclose(file);
+
+		EnvironmentInfo environment;
+		EnvironmentStats stats;
+		const bool loaded = EnvironmentMap::Load(path, environment, stats);
+		CHECK(loaded && environment.texture.width == 6 && environment.texture.height == 3, "loading %s failed", path.c_str());
+		CHECK(environment.table.size() == 3 + 18, "table of %zu entries", environment.table.size());
+		if (loaded)
+		{
+			const DirectX::XMFLOAT3 texel = EnvironmentMap::DecodeRgb9e5(reinterpret_cast<const UINT32*>(environment.texture.pixels.data())[2]);
+			CHECK(std::fabs(texel.x - 4.f) < 0.05f && std::fabs(texel.y - 2.f) < 0.05f && std::fabs(texel.z - 1.f) < 0.05f, "texel 2 is %f %f %f, expected 4 2 1", texel.x, texel.y, texel.z);
+		}
+
+		remove(path.c_str());
+		CHECK(!EnvironmentMap::Load(path, environment, stats), "loaded a missing file");
+	}
+
+	void TestSampling(UINT width, UINT height, int sampleCount)
+	{
+		std::vector<float> texels;
+		MakeSky(width, height, texels);
+
+		EnvironmentInfo environment;
+		EnvironmentStats stats;
+		EnvironmentMap::Build(texels.data(), width, height, environment, stats);
+
+		const UINT tableWidth = environment.tableWidth, tableHeight = environment.tableHeight;
+		std::vector<double> cellProbabilities(static_cast<size_t>(tableWidth) * tableHeight);
+		for (UINT row = 0; row < tableHeight; row++)
+		{
+			for (UINT column = 0; column < tableWidth; column++)
+			{
+				cellProbabilities[row * tableWidth + column] = static_cast<double>(environment.table[row].pdf) * environment.table[tableHeight + row * tableWidth + column].pdf;
+			}
+		}
+
+		// Directions are binned into the cells they came from, and the estimate of the map's integral uses their pdfs
+		std::vector<double> histogram(cellProbabilities.size(), 0.0);
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		double estimate = 0.0;
+		int badPdfs = 0;
+		for (int i = 0; i < sampleCount; i++)
+		{
+			const float u0 = unit(random), u1 = unit(random);
+			float pdf = 0.f;
+			const DirectX::XMFLOAT3 direction = EnvironmentMap::Sample(environment, u0, u1, pdf);
+
+			double u = std::atan2(direction.x, -direction.z) / (2.0 * Pi);
+			if (u < 0.0) u += 1.0;
+			const double v = std::acos((std::max)(-1.f, (std::min)(1.f, direction.y))) / Pi;
+			const UINT x = (std::min)(static_cast<UINT>(u * width), width - 1);
+			const UINT y = (std::min)(static_cast<UINT>(v * height), height - 1);
+			histogram[(y / environment.block) * tableWidth + x / environment.block] += 1.0;
+
+			if (!(pdf > 0.f))
+			{
+				badPdfs++;
+				continue;
+			}
+			estimate += GetLuminance(&texels[(static_cast<size_t>(y) * width + x) * 4]) / pdf;
+		}
+		estimate /= sampleCount;
+
+		double exact = 0.0;
+		for (UINT y = 0; y < height; y++)
+		{
+			const double solidAngle = 2.0 * Pi / width * (std::cos(Pi * y / height) - std::cos(Pi * (y + 1) / height));
+			for (UINT x = 0; x < width; x++) exact += GetLuminance(&texels[(static_cast<size_t>(y) * width + x) * 4]) * solidAngle;
+		}
+
+		// Chi-square over the cells expecting at least five samples, the rest pooled into one
+		double chiSquare = 0.0, pooledExpected = 0.0, pooledObserved = 0.0;
+		int degrees = 0;
+		for (size_t cell = 0; cell < histogram.size(); cell++)
+		{
+			const double expected = cellProbabilities[cell] * sampleCount;
+			if (expected < 5.0)
+			{
+				pooledExpected += expected;
+				pooledObserved += histogram[cell];
+				continue;
+			}
+			chiSquare += (histogram[cell] - expected) * (histogram[cell] - expected) / expected;
+			degrees++;
+		}
+		if (pooledExpected > 0.0)
+		{
+			chiSquare += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+			degrees++;
+		}
+		degrees--;
+
+		// For this many degrees of freedom the statistic is close to normal
+		const double deviations = (chiSquare - degrees) / std::sqrt(2.0 * degrees);
+		CHECK(std::fabs(deviations) < 4.0, "%ux%u: chi-square %.0f over %d degrees of freedom is %.2f deviations out", width, height, chiSquare, degrees, deviations);
+		CHECK(std::fabs(estimate - exact) / exact < 0.01, "%ux%u: E[L/pdf] %.5f, integral %.5f", width, height, estimate, exact);
+		CHECK(badPdfs == 0, "%ux%u: %d samples with no pdf", width, height, badPdfs);
+	}
+}
+
+int main()
+{
+	TestAliasTable();
+	TestRgb9e5();
+	TestBuildEncoding();
+	TestLoad();
+
+	// One cell per texel, a map wider than the table so cells cover blocks, and odd sizes
+	TestSampling(512, 256, 4000000);
+	TestSampling(5000, 2500, 4000000);
+	TestSampling(33, 17, 1000000);
+	return Test::Finish("EnvironmentMapTests");
+}
\ No newline at end of file
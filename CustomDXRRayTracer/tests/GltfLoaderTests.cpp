@@ -0,0 +1,273 @@
+#include "GltfLoader.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <cmath>
+
+namespace
+{
+	// Assembles a GLB from a JSON string and a binary chunk
+	struct GlbBuilder
+	{
+		std::vector<UINT8> bin;
+
+		// Appends data on a 4-byte boundary and returns its offset in the binary chunk
+		size_t Add(const void* data, size_t size)
+		{
+			bin.resize((bin.size() + 3) & ~static_cast<size_t>(3));
+			const size_t offset = bin.size();
+			bin.insert(bin.end(), static_cast<const UINT8*>(data), static_cast<const UINT8*>(data) + size);
+			return offset;
+		}
+
+		void Write(const std::string& path, std::string json, size_t truncatedSize = 0)
+		{
+			json.resize((json.size() + 3) & ~static_cast<size_t>(3), ' ');
+			bin.resize((bin.size() + 3) & ~static_cast<size_t>(3));
+
+			std::vector<UINT8> file;
+			const UINT32 header[] = { 0x46546C67, 2, static_cast<UINT32>(12 + 8 + json.size() + 8 + bin.size()) };
+			const UINT32 jsonChunk[] = { static_cast<UINT32>(json.size()), 0x4E4F534A };
+			const UINT32 binChunk[] = { static_cast<UINT32>(bin.size()), 0x004E4942 };
+			file.insert(file.end(), reinterpret_cast<const UINT8*>(header), reinterpret_cast<const UINT8*>(header) + sizeof(header));
+			file.insert(file.end(), reinterpret_cast<const UINT8*>(jsonChunk), reinterpret_cast<const UINT8*>(jsonChunk) + sizeof(jsonChunk));
+			file.insert(file.end(), json.begin(), json.end());
+			file.insert(file.end(), reinterpret_cast<const UINT8*>(binChunk), reinterpret_cast<const UINT8*>(binChunk) + sizeof(binChunk));
+			file.insert(file.end(), bin.begin(), bin.end());
+			if (truncatedSize) file.resize(truncatedSize);
+
+			Utils::OutputFile output;
+			CHECK(output.Open(path) && output.Write(file.data(), file.size()) && output.Commit(), "writing %s failed", path.c_str());
+		}
+	};
+
+	// A unit quad in the xz plane
+	const float QuadPositions[] = { 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 0.f, 1.f, 0.f, 0.f, 1.f };
+	const float QuadUvs[] = { 0.f, 0.f, 1.f, 0.f, 1.f, 1.f, 0.f, 1.f };
+	const uint32_t QuadIndices[] = { 0, 2, 1, 0, 3, 2 };
+
+	std::string ToString(size_t value)
+	{
+		return std::to_string(value);
+	}
+
+	std::string BufferView(size_t offset, size_t length, size_t stride = 0)
+	{
+		return "{\"buffer\":0,\"byteOffset\":" + ToString(offset) + ",\"byteLength\":" + ToString(length) + (stride ? ",\"byteStride\":" + ToString(stride) : "") + "}";
+	}
+
+	std::string Accessor(int view, size_t offset, int componentType, size_t count, const char* type)
+	{
+		return "{\"bufferView\":" + std::to_string(view) + ",\"byteOffset\":" + ToString(offset) + ",\"componentType\":" + std::to_string(componentType) + ",\"count\":" + ToString(count) + ",\"type\":\"" + type + "\"}";
+	}
+
+	const char* const QuadMesh = "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1},\"indices\":2}]}],\"nodes\":[{\"mesh\":0}],";
+
+	std::vector<std::shared_ptr<Model>> Load(const std::string& path, std::vector<Material>& materials)
+	{
+		std::vector<std::shared_ptr<Model>> models;
+		GltfLoader::LoadGlb(path, models, materials);
+		return models;
+	}
+
+	bool Throws(const std::string& path)
+	{
+		try
+		{
+			std::vector<Material> materials;
+			Load(path, materials);
+		}
+		catch (const std::exception&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	bool MatchesQuad(const Model& model)
+	{
+		if (model.VertexCount() != 4 || model.IndexCount() != 6) return false;
+		for (size_t i = 0; i < 4; i++)
+		{
+			const Vertex& vertex = model.VertexData()[i];
+			if (vertex.position.x != QuadPositions[i * 3] || vertex.position.z != QuadPositions[i * 3 + 2] || vertex.uv.x != QuadUvs[i * 2] || vertex.uv.y != QuadUvs[i * 2 + 1]) return false;
+		}
+		return std::equal(QuadIndices, QuadIndices + 6, model.IndexData());
+	}
+
+	void TestInterleaved()
+	{
+		// Float position and uv interleaved with the Vertex stride, and uint32 indices, are used from the file in place
+		GlbBuilder glb;
+		float interleaved[20];
+		for (int i = 0; i < 4; i++)
+		{
+			memcpy(&interleaved[i * 5], &QuadPositions[i * 3], 3 * sizeof(float));
+			memcpy(&interleaved[i * 5 + 3], &QuadUvs[i * 2], 2 * sizeof(float));
+		}
+		const size_t vertexOffset = glb.Add(interleaved, sizeof(interleaved));
+		const size_t indexOffset = glb.Add(QuadIndices, sizeof(QuadIndices));
+
+		const std::string path = "gltf_interleaved.glb";
+		glb.Write(path, std::string("{\"asset\":{\"version\":\"2.0\"},") + QuadMesh +
+			"\"bufferViews\":[" + BufferView(vertexOffset, sizeof(interleaved), sizeof(Vertex)) + "," + BufferView(indexOffset, sizeof(QuadIndices)) + "]," +
+			"\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "," + Accessor(0, 12, 5126, 4, "VEC2") + "," + Accessor(1, 0, 5125, 6, "SCALAR") + "]}");
+
+		std::vector<Material> materials;
+		const std::vector<std::shared_ptr<Model>> models = Load(path, materials);
+		CHECK(models.size() == 1 && materials.size() == 1, "%zu models and %zu materials", models.size(), materials.size());
+		if (models.size() == 1)
+		{
+			const Model& model = *models[0];
+			CHECK(model.mappedVertices && model.mappedIndices && model.vertices.empty() && model.indices.empty(), "interleaved data was copied");
+			CHECK(MatchesQuad(model), "interleaved quad reads back wrong");
+			CHECK(model.instances.size() == 1 && model.submeshes.size() == 1 && model.submeshes[0].materialIndex == 0, "%zu instances, %zu submeshes", model.instances.size(), model.submeshes.size());
+		}
+
+		remove(path.c_str());
+	}
+
+	void TestSeparate()
+	{
+		// Positions and uvs in views of their own, with uint16 indices, are copied into the Vertex layout
+		GlbBuilder glb;
+		const uint16_t indices16[] = { 0, 2, 1, 0, 3, 2 };
+		const size_t positionOffset = glb.Add(QuadPositions, sizeof(QuadPositions));
+		const size_t uvOffset = glb.Add(QuadUvs, sizeof(QuadUvs));
+		const size_t indexOffset = glb.Add(indices16, sizeof(indices16));
+
+		const std::string path = "gltf_separate.glb";
+		glb.Write(path, std::string("{\"asset\":{\"version\":\"2.0\"},") + QuadMesh +
+			"\"bufferViews\":[" + BufferView(positionOffset, sizeof(QuadPositions)) + "," + BufferView(uvOffset, sizeof(QuadUvs)) + "," + BufferView(indexOffset, sizeof(indices16)) + "]," +
+			"\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "," + Accessor(1, 0, 5126, 4, "VEC2") + "," + Accessor(2, 0, 5123, 6, "SCALAR") + "]}");
+
+		std::vector<Material> materials;
+		const std::vector<std::shared_ptr<Model>> models = Load(path, materials);
+		CHECK(models.size() == 1, "%zu models", models.size());
+		if (models.size() == 1)
+		{
+			CHECK(!models[0]->mappedVertices && !models[0]->mappedIndices, "separate attributes or uint16 indices were used in place");
+			CHECK(MatchesQuad(*models[0]), "separate quad reads back wrong");
+		}
+
+		remove(path.c_str());
+	}
+
+	void TestNodes()
+	{
+		// One mesh under a translated parent, its scaled child and a rotated root becomes one model with three instances.
+		// Instance rows are in the renderer's frame, with x and z swapped.
+		GlbBuilder glb;
+		const size_t positionOffset = glb.Add(QuadPositions, sizeof(QuadPositions));
+		const size_t indexOffset = glb.Add(QuadIndices, sizeof(QuadIndices));
+
+		const std::string path = "gltf_nodes.glb";
+		glb.Write(path, std::string("{\"asset\":{\"version\":\"2.0\"},\"scene\":0,\"scenes\":[{\"nodes\":[0,2]}],") +
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}]," +
+			"\"nodes\":[{\"mesh\":0,\"translation\":[1,0,0],\"children\":[1]},{\"mesh\":0,\"scale\":[2,2,2]},{\"mesh\":0,\"rotation\":[0,0.70710678,0,0.70710678]}]," +
+			"\"bufferViews\":[" + BufferView(positionOffset, sizeof(QuadPositions)) + "," + BufferView(indexOffset, sizeof(QuadIndices)) + "]," +
+			"\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "," + Accessor(1, 0, 5125, 6, "SCALAR") + "]}");
+
+		std::vector<Material> materials;
+		const std::vector<std::shared_ptr<Model>> models = Load(path, materials);
+		CHECK(models.size() == 1 && models[0]->instances.size() == 3, "%zu models, %zu instances", models.size(), models.empty() ? 0 : models[0]->instances.size());
+
+		int parents = 0, children = 0, rotated = 0;
+		for (size_t i = 0; models.size() == 1 && i < models[0]->instances.size(); i++)
+		{
+			const DirectX::XMFLOAT3X4& m = models[0]->instances[i];
+			if (m.m[2][3] == 1.f && m.m[1][1] == 1.f && m.m[0][2] == 1.f) parents++;
+			else if (m.m[2][3] == 1.f && m.m[1][1] == 2.f && m.m[0][2] == 2.f && m.m[2][0] == 2.f) children++;
+			else if (m.m[2][3] == 0.f && fabsf(m.m[0][0] + 1.f) < 1e-5f && fabsf(m.m[2][2] - 1.f) < 1e-5f) rotated++;
+		}
+		CHECK(parents == 1 && children == 1 && rotated == 1, "%d parent, %d child and %d rotated instances", parents, children, rotated);
+
+		// A primitive without a material gets the default entry, and without uvs reads them as zero
+		CHECK(materials.size() == 1 && models.size() == 1 && models[0]->submeshes[0].materialIndex == 0, "%zu materials", materials.size());
+		CHECK(models.size() == 1 && models[0]->VertexData()[2].uv.x == 0.f, "missing uvs are not zero");
+
+		remove(path.c_str());
+	}
+
+	void TestEmbeddedImage()
+	{
+		// A base color image in a buffer view points into the mapped file rather than at a path
+		GlbBuilder glb;
+		const UINT8 image[] = { 0x89, 'P', 'N', 'G', 1, 2, 3, 4, 5 };
+		const size_t positionOffset = glb.Add(QuadPositions, sizeof(QuadPositions));
+		const size_t indexOffset = glb.Add(QuadIndices, sizeof(QuadIndices));
+		const size_t imageOffset = glb.Add(image, sizeof(image));
+
+		const std::string path = "gltf_image.glb";
+		glb.Write(path, std::string("{\"asset\":{\"version\":\"2.0\"},") +
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1,\"material\":1}]}],\"nodes\":[{\"mesh\":0}]," +
+			"\"materials\":[{\"name\":\"linked\",\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":1}}},{\"name\":\"embedded\",\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":0}}}]," +
+			"\"textures\":[{\"source\":0},{\"source\":1}],\"images\":[{\"bufferView\":2,\"mimeType\":\"image/png\"},{\"uri\":\"albedo.png\"}]," +
+			"\"bufferViews\":[" + BufferView(positionOffset, sizeof(QuadPositions)) + "," + BufferView(indexOffset, sizeof(QuadIndices)) + "," + BufferView(imageOffset, sizeof(image)) + "]," +
+			"\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "," + Accessor(1, 0, 5125, 6, "SCALAR") + "]}");
+
+		std::vector<Material> materials;
+		const std::vector<std::shared_ptr<Model>> models = Load(path, materials);
+		CHECK(materials.size() == 2 && models.size() == 1 && models[0]->submeshes[0].materialIndex == 1, "%zu materials", materials.size());
+		if (materials.size() == 2)
+		{
+			CHECK(materials[0].name == "linked" && materials[0].texturePath == "albedo.png" && !materials[0].embeddedTexture, "linked image resolved to \"%s\"", materials[0].texturePath.c_str());
+			CHECK(materials[1].name == "embedded" && materials[1].embeddedTextureSize == sizeof(image) && materials[1].mapping &&
+				materials[1].embeddedTexture && memcmp(materials[1].embeddedTexture, image, sizeof(image)) == 0, "embedded image is %zu bytes", materials[1].embeddedTextureSize);
+		}
+
+		remove(path.c_str());
+	}
+
+	void TestErrors()
+	{
+		// An index past the vertices is rejected whether the indices are used in place or copied
+		const uint32_t badIndices[] = { 0, 1, 4 };
+		const UINT8 badIndices8[] = { 0, 1, 4 };
+		const std::string path = "gltf_bad.glb";
+		for (int componentType : { 5125, 5121 })
+		{
+			GlbBuilder glb;
+			const size_t positionOffset = glb.Add(QuadPositions, sizeof(QuadPositions));
+			const size_t indexOffset = (componentType == 5125) ? glb.Add(badIndices, sizeof(badIndices)) : glb.Add(badIndices8, sizeof(badIndices8));
+			glb.Write(path, std::string("{\"asset\":{\"version\":\"2.0\"},") +
+				"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}],\"nodes\":[{\"mesh\":0}]," +
+				"\"bufferViews\":[" + BufferView(positionOffset, sizeof(QuadPositions)) + "," + BufferView(indexOffset, glb.bin.size() - indexOffset) + "]," +
+				"\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "," + Accessor(1, 0, componentType, 3, "SCALAR") + "]}");
+			CHECK(Throws(path), "an out-of-range index of type %d loaded", componentType);
+		}
+
+		// A chunk longer than the file, a file cut inside the header, and one that is not a GLB
+		GlbBuilder glb;
+		const size_t positionOffset = glb.Add(QuadPositions, sizeof(QuadPositions));
+		const std::string json = std::string("{\"asset\":{\"version\":\"2.0\"},\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0}}]}],\"nodes\":[{\"mesh\":0}],") +
+			"\"bufferViews\":[" + BufferView(positionOffset, sizeof(QuadPositions)) + "],\"accessors\":[" + Accessor(0, 0, 5126, 4, "VEC3") + "]}";
+
+		glb.Write(path, json);
+		std::vector<Material> materials;
+		CHECK(!Throws(path) && Load(path, materials).size() == 1, "the intact file did not load");
+
+		glb.Write(path, json, 12 + 8 + 40);
+		CHECK(Throws(path), "a truncated JSON chunk loaded");
+		glb.Write(path, json, 12 + 8 + json.size() + 8 + 16);
+		CHECK(Throws(path), "a truncated binary chunk loaded");
+		glb.Write(path, json, 8);
+		CHECK(Throws(path), "a truncated header loaded");
+
+		Utils::OutputFile text;
+		CHECK(text.Open(path) && text.Write("{\"asset\":{}}", 13) && text.Commit(), "writing %s failed", path.c_str());
+		CHECK(Throws(path), "a JSON file loaded as a GLB");
+
+		remove(path.c_str());
+	}
+}
+
+int main()
+{
+	TestInterleaved();
+	TestSeparate();
+	TestNodes();
+	TestEmbeddedImage();
+	TestErrors();
+	return Test::Finish("GltfLoaderTests");
+}
\ No newline at end of file
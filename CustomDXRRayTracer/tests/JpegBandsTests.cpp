@@ -0,0 +1,393 @@
+#include "JpegBands.h"
+#include "TexelConvert.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <cmath>
+#include <stb_image.h>
+
+namespace
+{
+	const double Pi = 3.14159265358979323846;
+
+	// Sampling of the first component; the others are always 1x1
+	struct JpegOptions
+	{
+		int components = 3;
+		int samplingH = 2;
+		int samplingV = 2;
+		UINT restartInterval = 0;	// In MCUs; 0 writes no DRI
+	};
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<UINT8>& bytes) : m_Bytes(bytes) {}
+
+		void Write(UINT32 bits, int count)
+		{
+			for (int i = count - 1; i >= 0; i--)
+			{
+				m_Byte = static_cast<UINT8>((m_Byte << 1) | ((bits >> i) & 1));
+				if (++m_Count == 8) Emit();
+			}
+		}
+
+		// Pads the last byte with ones, as a restart marker or the end of the scan requires
+		void Flush()
+		{
+			while (m_Count != 0) Write(1, 1);
+		}
+
+	private:
+		void Emit()
+		{
+			m_Bytes.push_back(m_Byte);
+			if (m_Byte == 0xFF) m_Bytes.push_back(0x00);
+			m_Byte = 0;
+			m_Count = 0;
+		}
+
+		std::vector<UINT8>& m_Bytes;
+		UINT8 m_Byte = 0;
+		int m_Count = 0;
+	};
+
+	// One Huffman table for DC and one for AC, shared by every component. DC has its 12 categories at 4 bits; AC gives
+	// every byte value a code, 255 of them at 8 bits and the last at 9 so no code is all ones.
+	struct HuffmanCode
+	{
+		UINT32 bits;
+		int length;
+	};
+
+	HuffmanCode DcCode(int category)
+	{
+		return HuffmanCode{ static_cast<UINT32>(category), 4 };
+	}
+
+	HuffmanCode AcCode(int symbol)
+	{
+		return (symbol < 255) ? HuffmanCode{ static_cast<UINT32>(symbol), 8 } : HuffmanCode{ 0x1FE, 9 };
+	}
+
+	int Category(int value)
+	{
+		int magnitude = (value < 0) ? -value : value;
+		int category = 0;
+		while (magnitude) { category++; magnitude >>= 1; }
+		return category;
+	}
+
+	void WriteValue(BitWriter& writer, int value, int category)
+	{
+		if (category == 0) return;
+		writer.Write(static_cast<UINT32>((value < 0) ? value + (1 << category) - 1 : value), category);
+	}
+
+	void Marker(std::vector<UINT8>& bytes, UINT8 marker, const std::vector<UINT8>& payload)
+	{
+		bytes.push_back(0xFF);
+		bytes.push_back(marker);
+		bytes.push_back(static_cast<UINT8>((payload.size() + 2) >> 8));
+		bytes.push_back(static_cast<UINT8>((payload.size() + 2) & 0xFF));
+		bytes.insert(bytes.end(), payload.begin(), payload.end());
+	}
+
+	// A small baseline encoder: a direct floating point DCT, one flat quantization table and the tables above
+	std::vector<UINT8> EncodeJpeg(const std::vector<UINT8>& rgb, int width, int height, const JpegOptions& options)
+	{
+		const int quantizer = 4;
+		const int maxH = (options.components == 1) ? 1 : options.samplingH;
+		const int maxV = (options.components == 1) ? 1 : options.samplingV;
+		const int mcuWidth = 8 * maxH, mcuHeight = 8 * maxV;
+		const int mcusPerRow = (width + mcuWidth - 1) / mcuWidth, mcuRows = (height + mcuHeight - 1) / mcuHeight;
+
+		// Full-resolution planes, edges repeated out to whole MCUs
+		const int planeWidth = mcusPerRow * mcuWidth, planeHeight = mcuRows * mcuHeight;
+		std::vector<std::vector<double>> planes(options.components, std::vector<double>(static_cast<size_t>(planeWidth) * planeHeight));
+		for (int y = 0; y < planeHeight; y++)
+		{
+			for (int x = 0; x < planeWidth; x++)
+			{
+				const UINT8* p = &rgb[(static_cast<size_t>((std::min)(y, height - 1)) * width + (std::min)(x, width - 1)) * 3];
+				const size_t i = static_cast<size_t>(y) * planeWidth + x;
+				planes[0][i] = 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+				if (options.components == 3)
+				{
+					planes[1][i] = -0.168736 * p[0] - 0.331264 * p[1] + 0.5 * p[2] + 128.0;
+					planes[2][i] = 0.5 * p[0] - 0.418688 * p[1] - 0.081312 * p[2] + 128.0;
+				}
+			}
+		}
+
+		std::vector<UINT8> bytes = { 0xFF, 0xD8 };
+
+		std::vector<UINT8> dqt = { 0 };
+		dqt.resize(65, static_cast<UINT8>(quantizer));
+		Marker(bytes, 0xDB, dqt);
+
+		std::vector<UINT8> sof = { 8, static_cast<UINT8>(height >> 8), static_cast<UINT8>(height & 0xFF), static_cast<UINT8>(width >> 8), static_cast<UINT8>(width & 0xFF), static_cast<UINT8>(options.components) };
+		for (int c = 0; c < options.components; c++)
+		{
+			const UINT8 sampling = (c == 0) ? static_cast<UINT8>((maxH << 4) | maxV) : 0x11;
+			sof.insert(sof.end(), { static_cast<UINT8>(c + 1), sampling, 0 });
+		}
+		Marker(bytes, 0xC0, sof);
+
+		std::vector<UINT8> dht = { 0x00, 0, 0, 0, 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+		for (int i = 0; i < 12; i++) dht.push_back(static_cast<UINT8>(i));
+		dht.insert(dht.end(), { 0x10, 0, 0, 0, 0, 0, 0, 0, 255, 1, 0, 0, 0, 0, 0, 0, 0 });
+		for (int i = 0; i < 256; i++) dht.push_back(static_cast<UINT8>(i));
+		Marker(bytes, 0xC4, dht);
+
+		if (options.restartInterval) Marker(bytes, 0xDD, { static_cast<UINT8>(options.restartInterval >> 8), static_cast<UINT8>(options.restartInterval & 0xFF) });
+
+		std::vector<UINT8> sos = { static_cast<UINT8>(options.components) };
+		for (int c = 0; c < options.components; c++) sos.insert(sos.end(), { static_cast<UINT8>(c + 1), 0x00 });
+		sos.insert(sos.end(), { 0, 63, 0 });
+		Marker(bytes, 0xDA, sos);
+
+		int zigzag[64];
+		for (int i = 0, d = 0; d < 15; d++)
+		{
+			for (int k = 0; k <= d; k++)
+			{
+				const int row = (d % 2) ? k : d - k, column = d - row;
+				if (row < 8 && column < 8) zigzag[i++] = row * 8 + column;
+			}
+		}
+
+		BitWriter writer(bytes);
+		std::vector<int> predictors(options.components, 0);
+		const int mcuCount = mcusPerRow * mcuRows;
+		for (int mcu = 0; mcu < mcuCount; mcu++)
+		{
+			if (options.restartInterval && mcu > 0 && mcu % options.restartInterval == 0)
+			{
+				writer.Flush();
+				bytes.push_back(0xFF);
+				bytes.push_back(static_cast<UINT8>(0xD0 + (mcu / options.restartInterval - 1) % 8));
+				std::fill(predictors.begin(), predictors.end(), 0);
+			}
+
+			const int mcuX = (mcu % mcusPerRow) * mcuWidth, mcuY = (mcu / mcusPerRow) * mcuHeight;
+			for (int c = 0; c < options.components; c++)
+			{
+				const int blocksH = (c == 0) ? maxH : 1, blocksV = (c == 0) ? maxV : 1;
+				const int scaleX = maxH / blocksH, scaleY = maxV / blocksV;
+				for (int by = 0; by < blocksV; by++)
+				{
+					for (int bx = 0; bx < blocksH; bx++)
+					{
+						// Subsampled components average the full-resolution texels they cover
+						double block[64];
+						for (int y = 0; y < 8; y++)
+						{
+							for (int x = 0; x < 8; x++)
+							{
+								double sum = 0.0;
+								for (int sy = 0; sy < scaleY; sy++)
+								{
+									for (int sx = 0; sx < scaleX; sx++)
+									{
+										const int px = mcuX + (bx * 8 + x) * scaleX + sx, py = mcuY + (by * 8 + y) * scaleY + sy;
+										sum += planes[c][static_cast<size_t>(py) * planeWidth + px];
+									}
+								}
+								block[y * 8 + x] = sum / (scaleX * scaleY) - 128.0;
+							}
+						}
+
+						int coefficients[64];
+						for (int v = 0; v < 8; v++)
+						{
+							for (int u = 0; u < 8; u++)
+							{
+								double sum = 0.0;
+								for (int y = 0; y < 8; y++)
+								{
+									for (int x = 0; x < 8; x++) sum += block[y * 8 + x] * cos((2 * x + 1) * u * Pi / 16.0) * cos((2 * y + 1) * v * Pi / 16.0);
+								}
+								const double scale = 0.25 * ((u == 0) ? sqrt(0.5) : 1.0) * ((v == 0) ? sqrt(0.5) : 1.0);
+								coefficients[v * 8 + u] = static_cast<int>(floor(sum * scale / quantizer + 0.5));
+							}
+						}
+
+						const int dc = coefficients[0] - predictors[c];
+						predictors[c] = coefficients[0];
+						const HuffmanCode dcCode = DcCode(Category(dc));
+						writer.Write(dcCode.bits, dcCode.length);
+						WriteValue(writer, dc, Category(dc));
+
+						int run = 0;
+						for (int i = 1; i < 64; i++)
+						{
+							const int value = coefficients[zigzag[i]];
+							if (value == 0)
+							{
+								run++;
+								continue;
+							}
+
+							for (; run > 15; run -= 16)
+							{
+								const HuffmanCode zrl = AcCode(0xF0);
+								writer.Write(zrl.bits, zrl.length);
+							}
+
+							const HuffmanCode code = AcCode((run << 4) | Category(value));
+							writer.Write(code.bits, code.length);
+							WriteValue(writer, value, Category(value));
+							run = 0;
+						}
+
+						if (run > 0)
+						{
+							const HuffmanCode eob = AcCode(0x00);
+							writer.Write(eob.bits, eob.length);
+						}
+					}
+				}
+			}
+		}
+
+		writer.Flush();
+		bytes.push_back(0xFF);
+		bytes.push_back(0xD9);
+		return bytes;
+	}
+
+	// Gradients with a fine pattern and hard color edges, so seams and chroma upsampling show in any difference
+	std::vector<UINT8> MakeImage(int width, int height)
+	{
+		std::vector<UINT8> rgb(static_cast<size_t>(width) * height * 3);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				UINT8* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+				p[0] = static_cast<UINT8>((x * 3 + y) & 0xFF);
+				p[1] = static_cast<UINT8>(128 + 100 * sin(x * 0.3 + y * 0.05));
+				p[2] = static_cast<UINT8>(((x / 5 + y / 7) % 2) ? 230 : 20);
+			}
+		}
+		return rgb;
+	}
+
+	// What a whole-image decode gives, in the RGBA8 layout the loaders return
+	bool DecodeWhole(const std::vector<UINT8>& jpeg, TextureInfo& result)
+	{
+		int channels = 0;
+		UINT8* pixels = stbi_load_from_memory(jpeg.data(), static_cast<int>(jpeg.size()), &result.width, &result.height, &channels, STBI_default);
+		if (!pixels) return false;
+
+		result.stride = 4;
+		result.pixels.resize(static_cast<size_t>(result.width) * result.height * 4);
+		TexelConvert::ToRgba8(pixels, channels, result.pixels.data(), result.width, result.height);
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	void TestIdentical(const char* name, int width, int height, const JpegOptions& options)
+	{
+		const std::vector<UINT8> jpeg = EncodeJpeg(MakeImage(width, height), width, height, options);
+
+		TextureInfo whole;
+		CHECK(DecodeWhole(jpeg, whole) && whole.width == width && whole.height == height, "%s: stb could not decode the test image", name);
+
+		for (UINT workerCount : { 1u, 3u, 4u })
+		{
+			Utils::SetWorkerCount(workerCount);
+
+			// One worker leaves nothing to split, so the file goes back to the whole-image decode
+			TextureInfo bands;
+			const bool split = JpegBands::Decode(jpeg.data(), jpeg.size(), bands);
+			CHECK(split == (workerCount > 1), "%s: %s with %u workers", name, split ? "split" : "not split", workerCount);
+			if (split)
+			{
+				CHECK(bands.width == width && bands.height == height && bands.stride == 4 && bands.pixels == whole.pixels, "%s: bands differ from the whole image with %u workers", name, workerCount);
+			}
+
+			const TextureInfo loaded = Utils::LoadTexture(jpeg.data(), jpeg.size());
+			CHECK(loaded.width == width && loaded.height == height && loaded.pixels == whole.pixels, "%s: LoadTexture differs from the whole image with %u workers", name, workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestFallback()
+	{
+		// Each of these is a valid JPEG that cannot be cut into bands; Decode declines and LoadTexture decodes it whole
+		Utils::SetWorkerCount(4);
+
+		struct Case
+		{
+			const char* name;
+			int width;
+			int height;
+			JpegOptions options;
+		};
+
+		JpegOptions noRestarts;
+		JpegOptions offRow;
+		offRow.restartInterval = 3;
+		JpegOptions fewRows;
+		fewRows.restartInterval = 5;
+		const Case cases[] =
+		{
+			{ "no restart markers", 72, 795, noRestarts },
+			{ "restarts off the MCU rows", 72, 795, offRow },
+			{ "too few MCU rows", 72, 490, fewRows },
+		};
+
+		for (const Case& test : cases)
+		{
+			const std::vector<UINT8> jpeg = EncodeJpeg(MakeImage(test.width, test.height), test.width, test.height, test.options);
+
+			TextureInfo bands;
+			CHECK(!JpegBands::Decode(jpeg.data(), jpeg.size(), bands), "%s: split", test.name);
+
+			TextureInfo whole;
+			const TextureInfo loaded = Utils::LoadTexture(jpeg.data(), jpeg.size());
+			CHECK(DecodeWhole(jpeg, whole) && loaded.width == whole.width && loaded.pixels == whole.pixels, "%s: LoadTexture differs from the whole image", test.name);
+		}
+
+		// A scan cut short has fewer segments than MCU rows, and a file that is not a JPEG has no headers at all
+		JpegOptions options;
+		options.restartInterval = 5;
+		std::vector<UINT8> jpeg = EncodeJpeg(MakeImage(72, 795), 72, 795, options);
+		jpeg.resize(jpeg.size() / 2);
+		jpeg.insert(jpeg.end(), { 0xFF, 0xD9 });
+		TextureInfo bands;
+		CHECK(!JpegBands::Decode(jpeg.data(), jpeg.size(), bands), "a truncated scan was split");
+
+		const UINT8 png[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+		CHECK(!JpegBands::Decode(png, sizeof(png), bands), "a PNG signature was split");
+
+		Utils::SetWorkerCount(0);
+	}
+}
+
+int main()
+{
+	// 4:2:0 with a restart per MCU row and a partial last row, 4:4:4 with several restarts per row, and greyscale with
+	// a restart after every block
+	JpegOptions subsampled;
+	subsampled.restartInterval = 5;
+	TestIdentical("4:2:0", 72, 795, subsampled);
+
+	JpegOptions full;
+	full.samplingH = 1;
+	full.samplingV = 1;
+	full.restartInterval = 3;
+	TestIdentical("4:4:4", 48, 403, full);
+
+	JpegOptions grey;
+	grey.components = 1;
+	grey.restartInterval = 1;
+	TestIdentical("greyscale", 40, 420, grey);
+
+	TestFallback();
+	return Test::Finish("JpegBandsTests");
+}
\ No newline at end of file
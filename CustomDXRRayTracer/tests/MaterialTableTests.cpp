@@ -0,0 +1,92 @@
+#include "MaterialTable.h"
+#include "Test.h"
+
+namespace
+{
+	Material MakeMaterial(const std::string& texturePath, const UINT8* embeddedTexture = nullptr)
+	{
+		Material material;
+		material.texturePath = texturePath;
+		material.embeddedTexture = embeddedTexture;
+		material.embeddedTextureSize = embeddedTexture ? 4 : 0;
+		return material;
+	}
+
+	void TestAssign()
+	{
+		// Two paths named more than once, two embedded images and two untextured materials, which share the white
+		// texture. An embedded image wins over a path, so the last material shares the first embedded texture.
+		const UINT8 images[8] = {};
+		const std::vector<Material> materials =
+		{
+			MakeMaterial("textures/brick.png"),
+			MakeMaterial(""),
+			MakeMaterial("textures/wood.png"),
+			MakeMaterial("textures/brick.png"),
+			MakeMaterial("", images),
+			MakeMaterial(""),
+			MakeMaterial("", images + 4),
+			MakeMaterial("textures/wood.png"),
+			MakeMaterial("textures/brick.png", images),
+		};
+
+		std::vector<UINT> textureIndices = { 99 };
+		std::vector<UINT> sources = { 99, 99 };
+		MaterialTable::AssignTextures(materials, textureIndices, sources);
+
+		const std::vector<UINT> expectedIndices = { 0, 1, 2, 0, 3, 1, 4, 2, 3 };
+		const std::vector<UINT> expectedSources = { 0, 1, 2, 4, 6 };
+		CHECK(textureIndices == expectedIndices, "%zu texture indices assigned, material 8 samples %u", textureIndices.size(), textureIndices.empty() ? 0 : textureIndices.back());
+		CHECK(sources == expectedSources, "%zu textures, expected 5", sources.size());
+
+		// Each texture is loaded from a material that really samples it
+		for (size_t t = 0; t < sources.size() && textureIndices.size() == materials.size(); t++)
+		{
+			CHECK(sources[t] < materials.size() && textureIndices[sources[t]] == t, "texture %zu is loaded from material %u", t, sources[t]);
+		}
+
+		MaterialTable::AssignTextures(std::vector<Material>(), textureIndices, sources);
+		CHECK(textureIndices.empty() && sources.empty(), "no materials gave %zu indices and %zu textures", textureIndices.size(), sources.size());
+	}
+
+	void TestPack()
+	{
+		// Each record is its texture's, with the texture's index filled in
+		std::vector<MaterialRecord> textures(3);
+		for (UINT t = 0; t < 3; t++)
+		{
+			textures[t].textureIndex = 77;
+			textures[t].textureWidth = 64 << t;
+			textures[t].textureHeight = 32 << t;
+			textures[t].textureLevels = 7 + t;
+			textures[t].virtualTexture = DirectX::XMUINT4(t, t + 1, t + 2, t + 3);
+		}
+
+		std::vector<MaterialRecord> records;
+		const std::vector<UINT> textureIndices = { 2, 0, 2, 1 };
+		MaterialTable::Pack(textureIndices, textures, records);
+		CHECK(records.size() == 4, "%zu records for 4 materials", records.size());
+		for (size_t i = 0; i < records.size() && i < textureIndices.size(); i++)
+		{
+			const MaterialRecord& record = records[i];
+			const MaterialRecord& texture = textures[textureIndices[i]];
+			CHECK(record.textureIndex == textureIndices[i] && record.textureWidth == texture.textureWidth && record.textureHeight == texture.textureHeight && record.textureLevels == texture.textureLevels && record.virtualTexture.x == texture.virtualTexture.x && record.virtualTexture.w == texture.virtualTexture.w,
+				"record %zu samples texture %u at %ux%u", i, record.textureIndex, record.textureWidth, record.textureHeight);
+		}
+
+		// An empty table still packs one default record, so the buffer and its view are never empty
+		records = textures;
+		MaterialTable::Pack(std::vector<UINT>(), std::vector<MaterialRecord>(), records);
+		const MaterialRecord empty;
+		CHECK(records.size() == 1, "%zu records for no materials", records.size());
+		CHECK(records.empty() || (records[0].textureIndex == empty.textureIndex && records[0].textureWidth == empty.textureWidth && records[0].textureHeight == empty.textureHeight && records[0].textureLevels == empty.textureLevels && records[0].virtualTexture.x == 0 && records[0].virtualTexture.w == 0),
+			"the record of an empty table samples texture %u", records.empty() ? 0 : records[0].textureIndex);
+	}
+}
+
+int main()
+{
+	TestAssign();
+	TestPack();
+	return Test::Finish("MaterialTableTests");
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "MeshCache.h"
+#include "Utils.h"
+
+#include <cmath>
+
+// Loads a generated OBJ through LoadModel with the mesh cache entry removed, then again from the cache, and reports both.
+// Usage: MeshCacheBenchmark [grid size]; the model is a rolling terrain of twice the grid size squared triangles.
+namespace
+{
+	void WriteTerrain(const std::string& path, UINT size)
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file) throw std::runtime_error("Error: failed to create " + path);
+
+		for (UINT y = 0; y <= size; y++)
+		{
+			for (UINT x = 0; x <= size; x++)
+			{
+				const float height = sinf(x * 0.05f) * cosf(y * 0.07f) * 4.f;
+				fprintf(file, "v %.5f %.5f %.5f\nvt %.5f %.5f\n", static_cast<float>(x), height, static_cast<float>(y), static_cast<float>(x) / size, static_cast<float>(y) / size);
+			}
+		}
+
+		for (UINT y = 0; y < size; y++)
+		{
+			for (UINT x = 0; x < size; x++)
+			{
+				const UINT a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+				fprintf(file, "f %u/%u %u/%u %u/%u %u/%u\n", a, a, b, b, d, d, c, c);
+			}
+		}
+
+		fclose(file);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const UINT size = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 1000;
+	const std::string path = "mesh_cache_benchmark.obj";
+	WriteTerrain(path, size);
+
+	const UINT64 key = MeshCache::ComputeKey(path);
+	remove(MeshCache::GetCachePath(key).c_str());
+
+	Model model;
+	std::vector<Material> materials;
+	Utils::Timer timer;
+	Utils::LoadModel(path, model, materials);
+	const float coldMilliseconds = timer.ElapsedMillis();
+	const size_t triangleCount = model.IndexCount() / 3;
+
+	// Best of three warm loads; the first cold run has already brought the cache file into memory
+	float warmMilliseconds = 0.f;
+	for (int run = 0; run < 3; run++)
+	{
+		Model cached;
+		timer.Reset();
+		Utils::LoadModel(path, cached, materials);
+		const float milliseconds = timer.ElapsedMillis();
+		if (run == 0 || milliseconds < warmMilliseconds) warmMilliseconds = milliseconds;
+		if (!cached.mapping) printf("Warm load did not come from the mesh cache\n");
+	}
+
+	printf("\n%zu triangles, %u workers\n", triangleCount, Utils::GetWorkerCount());
+	printf("  cold OBJ    %9.1f ms\n", coldMilliseconds);
+	printf("  warm cache  %9.1f ms  (%.0fx)\n", warmMilliseconds, coldMilliseconds / warmMilliseconds);
+
+	remove(MeshCache::GetCachePath(key).c_str());
+	remove(path.c_str());
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "MeshCache.h"
+#include "Test.h"
+#include "Utils.h"
+
+namespace
+{
+	void WriteText(const std::string& path, const std::string& text)
+	{
+		Utils::OutputFile file;
+		CHECK(file.Open(path) && file.Write(text.data(), text.size()) && file.Commit(), "writing %s failed", path.c_str());
+	}
+
+	// Two triangles in one cluster with one LOD level
+	Model MakeModel()
+	{
+		Model model;
+		model.vertices.resize(4);
+		model.frames.resize(4);
+		model.indices = { 0, 1, 2, 0, 2, 3 };
+
+		Submesh submesh;
+		submesh.indexCount = 6;
+		model.submeshes = { submesh, submesh };
+
+		Cluster cluster;
+		cluster.submeshCount = 1;
+		cluster.lodCount = 1;
+		model.clusters = { cluster };
+
+		ClusterLod lod;
+		lod.submeshOffset = 1;
+		lod.submeshCount = 1;
+		model.lods = { lod };
+		return model;
+	}
+
+	bool Loads(UINT64 key)
+	{
+		Model model;
+		std::vector<Material> materials;
+		return MeshCache::Load(key, model, materials);
+	}
+
+	void TestRoundTrip()
+	{
+		const UINT64 key = 0x1001;
+		const Model model = MakeModel();
+		CHECK(MeshCache::Save(key, model, { Material() }, {}), "save failed");
+
+		Model loaded;
+		std::vector<Material> materials;
+		CHECK(MeshCache::Load(key, loaded, materials), "load failed");
+		CHECK(loaded.IndexCount() == 6 && loaded.VertexCount() == 4, "loaded %zu indices and %zu vertices", loaded.IndexCount(), loaded.VertexCount());
+		CHECK(loaded.submeshes.size() == 2 && loaded.clusters.size() == 1 && loaded.lods.size() == 1, "ranges were not loaded");
+		CHECK(materials.size() == 1, "loaded %zu materials", materials.size());
+	}
+
+	void TestMaterialLibraries()
+	{
+		const UINT64 key = 0x1002;
+		const std::string library = "materials/mesh_cache_test.mtl";
+		WriteText(library, "newmtl red1\n");
+		CHECK(MeshCache::Save(key, MakeModel(), { Material() }, { library }), "save failed");
+		CHECK(Loads(key), "an entry with unchanged libraries was rejected");
+
+		// Same size and possibly the same timestamp: only the bytes tell the edit apart
+		WriteText(library, "newmtl red2\n");
+		CHECK(!Loads(key), "an entry whose library was edited was accepted");
+
+		CHECK(MeshCache::Save(key, MakeModel(), { Material() }, { library }), "save failed");
+		remove(library.c_str());
+		CHECK(!Loads(key), "an entry whose library was deleted was accepted");
+
+		// A library missing at save time that appears later also makes the entry stale
+		CHECK(MeshCache::Save(key, MakeModel(), { Material() }, { library }), "save failed");
+		CHECK(Loads(key), "an entry with a library that is still missing was rejected");
+		WriteText(library, "newmtl red1\n");
+		CHECK(!Loads(key), "an entry whose library appeared was accepted");
+	}
+
+	void TestRanges()
+	{
+		const UINT64 key = 0x1003;
+
+		Model model = MakeModel();
+		model.submeshes[1].indexOffset = 3;
+		model.submeshes[1].indexCount = 4;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "a submesh past the indices was accepted");
+
+		model = MakeModel();
+		model.clusters[0].submeshOffset = 2;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "a cluster past the submeshes was accepted");
+
+		model = MakeModel();
+		model.clusters[0].lodCount = 2;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "a cluster past the LOD levels was accepted");
+
+		model = MakeModel();
+		model.lods[0].submeshCount = 2;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "a LOD level past the submeshes was accepted");
+
+		model = MakeModel();
+		model.submeshes[0].indexOffset = 0xFFFFFFFF;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "an overflowing submesh range was accepted");
+
+		model = MakeModel();
+		model.indices[4] = 4;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "an index past the vertices was accepted");
+
+		model = MakeModel();
+		model.submeshes[1].materialIndex = 1;
+		CHECK(MeshCache::Save(key, model, { Material() }, {}) && !Loads(key), "a material index past the materials was accepted");
+		CHECK(MeshCache::Save(key, model, { Material(), Material() }, {}) && Loads(key), "a second material was not found");
+	}
+
+	void TestKeys()
+	{
+		const std::string source = "mesh_cache_test/model.obj";
+		WriteText(source, "v 0 0 0\n");
+		CHECK(MeshCache::FindKey(source) == 0, "a key was found before any was saved");
+
+		CHECK(MeshCache::SaveKey(source, 0x1234), "saving a key failed");
+		CHECK(MeshCache::FindKey(source) == 0x1234, "the saved key was not found");
+
+		// A different size misses, so the full key is computed again
+		WriteText(source, "v 0 0 0\nv 1 0 0\n");
+		CHECK(MeshCache::FindKey(source) == 0, "a key was found for a changed file");
+		CHECK(MeshCache::FindKey("mesh_cache_test/missing.obj") == 0, "a key was found for a missing file");
+	}
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestMaterialLibraries();
+	TestRanges();
+	TestKeys();
+
+	return Test::Finish("MeshCacheTests");
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "MeshCleaner.h"
+#include "Utils.h"
+
+#include <random>
+
+// Cleans jittered grids of growing size to show the time per vertex stays flat, with and without a tolerance.
+// Usage: MeshCleanerBenchmark [largest grid size]; each grid has three copies of its points, so about 3 x size^2 vertices.
+namespace
+{
+	Model MakeJitteredGrid(UINT size)
+	{
+		std::mt19937 random(13);
+		std::uniform_real_distribution<float> jitter(-MeshCleaner::WeldPositionTolerance / 5.f, MeshCleaner::WeldPositionTolerance / 5.f);
+
+		Model model;
+		const UINT copies = 3;
+		model.vertices.resize(static_cast<size_t>(copies) * (size + 1) * (size + 1));
+		for (size_t i = 0; i < model.vertices.size(); i++)
+		{
+			const UINT point = static_cast<UINT>(i % ((size + 1) * (size + 1)));
+			const UINT x = point % (size + 1), y = point / (size + 1);
+			model.vertices[i].position = DirectX::XMFLOAT3(x * 0.01f + jitter(random), jitter(random), y * 0.01f + jitter(random));
+			model.vertices[i].uv = DirectX::XMFLOAT2(static_cast<float>(x) / size, static_cast<float>(y) / size);
+		}
+
+		const UINT pointCount = (size + 1) * (size + 1);
+		model.indices.reserve(static_cast<size_t>(size) * size * 6);
+		for (UINT y = 0; y < size; y++)
+		{
+			for (UINT x = 0; x < size; x++)
+			{
+				const uint32_t a = (random() % copies) * pointCount + y * (size + 1) + x;
+				const uint32_t b = (random() % copies) * pointCount + y * (size + 1) + x + 1;
+				const uint32_t c = (random() % copies) * pointCount + (y + 1) * (size + 1) + x;
+				const uint32_t d = (random() % copies) * pointCount + (y + 1) * (size + 1) + x + 1;
+				const uint32_t quad[] = { a, b, d, a, d, c };
+				model.indices.insert(model.indices.end(), quad, quad + 6);
+			}
+		}
+
+		Submesh submesh;
+		submesh.indexCount = static_cast<uint32_t>(model.indices.size());
+		model.submeshes.push_back(submesh);
+		return model;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const UINT largest = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 1600;
+
+	printf("%u workers\n", Utils::GetWorkerCount());
+	printf("  %10s %10s %12s %12s %12s\n", "vertices", "welded", "tolerance", "ms", "ns/vertex");
+
+	for (UINT size = largest / 8; size <= largest; size *= 2)
+	{
+		const Model grid = MakeJitteredGrid(size);
+		for (float tolerance : { MeshCleaner::WeldPositionTolerance, 0.f })
+		{
+			// Best of three
+			CleanupStats best;
+			for (int run = 0; run < 3; run++)
+			{
+				Model model = grid;
+				const CleanupStats stats = MeshCleaner::Clean(model, tolerance);
+				if (run == 0 || stats.milliseconds < best.milliseconds) best = stats;
+			}
+
+			printf("  %10zu %10zu %12g %12.1f %12.1f\n", best.inputVertices, best.outputVertices, tolerance, best.milliseconds, best.milliseconds * 1e6 / best.inputVertices);
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "MeshCleaner.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <random>
+
+namespace
+{
+	const float Tolerance = 0.001f;
+
+	Vertex MakeVertex(float x, float y, float z, float u = 0.f, float v = 0.f)
+	{
+		Vertex vertex;
+		vertex.position = DirectX::XMFLOAT3(x, y, z);
+		vertex.uv = DirectX::XMFLOAT2(u, v);
+		return vertex;
+	}
+
+	Submesh MakeSubmesh(uint32_t indexOffset, uint32_t indexCount, uint32_t materialIndex)
+	{
+		Submesh submesh;
+		submesh.indexOffset = indexOffset;
+		submesh.indexCount = indexCount;
+		submesh.materialIndex = materialIndex;
+		return submesh;
+	}
+
+	// A grid with every point written three times, each copy moved by up to a fifth of the tolerance, and quads that
+	// pick a copy at random for each corner, as exporters that split vertices per face leave them
+	Model MakeJitteredGrid(UINT size, unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> jitter(-Tolerance / 5.f, Tolerance / 5.f);
+
+		Model model;
+		const UINT copies = 3;
+		for (UINT copy = 0; copy < copies; copy++)
+		{
+			for (UINT y = 0; y <= size; y++)
+			{
+				for (UINT x = 0; x <= size; x++)
+				{
+					model.vertices.push_back(MakeVertex(x * 0.01f + jitter(random), jitter(random), y * 0.01f + jitter(random), x * 0.1f, y * 0.1f));
+				}
+			}
+		}
+
+		const UINT pointCount = (size + 1) * (size + 1);
+		auto corner = [&](UINT x, UINT y) { return static_cast<uint32_t>((random() % copies) * pointCount + y * (size + 1) + x); };
+		for (UINT y = 0; y < size; y++)
+		{
+			for (UINT x = 0; x < size; x++)
+			{
+				const uint32_t a = corner(x, y), b = corner(x + 1, y), c = corner(x, y + 1), d = corner(x + 1, y + 1);
+				const uint32_t quad[] = { a, b, d, a, d, c };
+				model.indices.insert(model.indices.end(), quad, quad + 6);
+			}
+		}
+
+		model.submeshes.push_back(MakeSubmesh(0, static_cast<uint32_t>(model.indices.size()), 0));
+		return model;
+	}
+
+	void TestWeld()
+	{
+		const UINT size = 100;
+		Model model = MakeJitteredGrid(size, 13);
+		const Model original = model;
+		const CleanupStats stats = MeshCleaner::Clean(model, Tolerance, Tolerance);
+
+		// Every point welds to its first copy, and no triangle is lost
+		CHECK(stats.inputVertices == 3 * (size + 1) * (size + 1) && stats.outputVertices == (size + 1) * (size + 1) && model.vertices.size() == stats.outputVertices, "welded %zu vertices into %zu", stats.inputVertices, stats.outputVertices);
+		CHECK(stats.degenerateTriangles == 0 && stats.duplicateTriangles == 0 && stats.outputTriangles == 2 * size * size, "%zu degenerate, %zu duplicate, %zu kept", stats.degenerateTriangles, stats.duplicateTriangles, stats.outputTriangles);
+		CHECK(memcmp(model.vertices.data(), original.vertices.data(), model.vertices.size() * sizeof(Vertex)) == 0, "the first copy of each point is not the one kept");
+
+		size_t moved = 0;
+		for (size_t i = 0; i < model.indices.size() && i < original.indices.size(); i++)
+		{
+			const DirectX::XMFLOAT3& before = original.vertices[original.indices[i]].position;
+			const DirectX::XMFLOAT3& after = model.vertices[model.indices[i]].position;
+			if (fabsf(before.x - after.x) > Tolerance || fabsf(before.y - after.y) > Tolerance || fabsf(before.z - after.z) > Tolerance) moved++;
+		}
+		CHECK(moved == 0, "%zu corners moved further than the tolerance", moved);
+
+		// Points closer than the tolerance but with different uvs stay apart
+		Model seam;
+		seam.vertices = { MakeVertex(0.f, 0.f, 0.f, 0.f, 0.f), MakeVertex(1.f, 0.f, 0.f), MakeVertex(0.f, 0.f, 1.f), MakeVertex(0.0002f, 0.f, 0.f, 1.f, 0.f) };
+		seam.indices = { 0, 1, 2, 3, 2, 1 };
+		seam.submeshes = { MakeSubmesh(0, 6, 0) };
+		CHECK(MeshCleaner::Clean(seam, Tolerance, Tolerance).outputVertices == 4, "a uv seam was welded");
+	}
+
+	void TestTriangles()
+	{
+		// Six triangles in the first submesh: one kept, one with a repeated corner, one with three points in a line, one
+		// repeating the first in another cyclic order, one with the opposite winding and one repeating the first through
+		// a welded copy of its vertices. The second submesh repeats the first triangle under another material.
+		Model model;
+		model.vertices =
+		{
+			MakeVertex(0.f, 0.f, 0.f), MakeVertex(1.f, 0.f, 0.f), MakeVertex(0.f, 0.f, 1.f),
+			MakeVertex(2.f, 0.f, 0.f), MakeVertex(0.0001f, 0.f, 0.f), MakeVertex(1.f, 0.0001f, 0.f), MakeVertex(0.f, 0.f, 1.0001f)
+		};
+		model.indices =
+		{
+			0, 1, 2,
+			0, 1, 1,
+			0, 1, 3,
+			1, 2, 0,
+			0, 2, 1,
+			4, 5, 6,
+			0, 1, 2,
+		};
+		model.submeshes = { MakeSubmesh(0, 18, 0), MakeSubmesh(18, 3, 1) };
+
+		const CleanupStats stats = MeshCleaner::Clean(model, Tolerance, Tolerance);
+		CHECK(stats.degenerateTriangles == 2 && stats.duplicateTriangles == 2 && stats.outputTriangles == 3, "%zu degenerate, %zu duplicate, %zu kept", stats.degenerateTriangles, stats.duplicateTriangles, stats.outputTriangles);
+		CHECK(model.submeshes.size() == 2 && model.submeshes[0].indexCount == 6 && model.submeshes[1].indexOffset == 6 && model.submeshes[1].indexCount == 3 && model.submeshes[1].materialIndex == 1, "submeshes were not kept apart");
+		CHECK(model.indices == std::vector<uint32_t>({ 0, 1, 2, 0, 2, 1, 0, 1, 2 }), "kept the wrong triangles");
+
+		// A submesh left with nothing is dropped
+		Model flat;
+		flat.vertices = { MakeVertex(0.f, 0.f, 0.f), MakeVertex(1.f, 0.f, 0.f), MakeVertex(2.f, 0.f, 0.f), MakeVertex(0.f, 0.f, 1.f) };
+		flat.indices = { 0, 1, 2, 0, 1, 3 };
+		flat.submeshes = { MakeSubmesh(0, 3, 0), MakeSubmesh(3, 3, 1) };
+		MeshCleaner::Clean(flat, Tolerance, Tolerance);
+		CHECK(flat.submeshes.size() == 1 && flat.submeshes[0].materialIndex == 1 && flat.submeshes[0].indexOffset == 0, "%zu submeshes after an empty one", flat.submeshes.size());
+	}
+
+	void TestWorkerCounts()
+	{
+		Model reference = MakeJitteredGrid(300, 17);
+		Utils::SetWorkerCount(1);
+		MeshCleaner::Clean(reference, Tolerance, Tolerance);
+
+		for (UINT workerCount : { 3u, 8u })
+		{
+			Utils::SetWorkerCount(workerCount);
+			Model model = MakeJitteredGrid(300, 17);
+			MeshCleaner::Clean(model, Tolerance, Tolerance);
+
+			CHECK(model.vertices.size() == reference.vertices.size() && memcmp(model.vertices.data(), reference.vertices.data(), model.vertices.size() * sizeof(Vertex)) == 0, "vertices differ with %u workers", workerCount);
+			CHECK(model.indices == reference.indices, "indices differ with %u workers", workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestZeroTolerance()
+	{
+		// Only equal positions weld, and both zeros are equal
+		Model model;
+		model.vertices = { MakeVertex(0.f, 0.f, 0.f), MakeVertex(-0.f, 0.f, -0.f), MakeVertex(1.f, 0.f, 0.f), MakeVertex(1.0000001f, 0.f, 0.f), MakeVertex(0.f, 0.f, 1.f), MakeVertex(1.f, 0.f, 0.f) };
+		model.indices = { 0, 2, 4, 1, 3, 4, 1, 5, 4 };
+		model.submeshes = { MakeSubmesh(0, 9, 0) };
+		const CleanupStats stats = MeshCleaner::Clean(model, 0.f, 0.f);
+		CHECK(stats.outputVertices == 4 && stats.duplicateTriangles == 1 && stats.outputTriangles == 2, "%zu vertices, %zu duplicate triangles", stats.outputVertices, stats.duplicateTriangles);
+
+		// A grid of distinct points at zero tolerance takes one cell each; a single shared cell would take minutes
+		Model grid = MakeJitteredGrid(300, 19);
+		const CleanupStats gridStats = MeshCleaner::Clean(grid, 0.f, 0.f);
+		CHECK(gridStats.outputVertices == gridStats.inputVertices, "welded %zu distinct points into %zu", gridStats.inputVertices, gridStats.outputVertices);
+
+		// A negative tolerance is taken as zero
+		Model negative = MakeJitteredGrid(20, 19);
+		const CleanupStats negativeStats = MeshCleaner::Clean(negative, -1.f, 0.f);
+		CHECK(negativeStats.outputVertices == negativeStats.inputVertices && negativeStats.outputTriangles == 800, "a negative tolerance left %zu vertices and %zu triangles", negativeStats.outputVertices, negativeStats.outputTriangles);
+	}
+}
+
+int main()
+{
+	TestWeld();
+	TestTriangles();
+	TestWorkerCounts();
+	TestZeroTolerance();
+	return Test::Finish("MeshCleanerTests");
+}
\ No newline at end of file
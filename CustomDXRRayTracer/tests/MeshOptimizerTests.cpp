@@ -0,0 +1,149 @@
+#include "MeshOptimizer.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	// A grid of quads with its vertices and triangles shuffled, split into three submeshes
+	Model MakeShuffledGrid(UINT size)
+	{
+		std::mt19937 random(5);
+
+		Model model;
+		std::vector<uint32_t> order((size + 1) * (size + 1));
+		for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+		std::shuffle(order.begin(), order.end(), random);
+
+		model.vertices.resize(order.size());
+		model.frames.resize(order.size());
+		for (UINT y = 0; y <= size; y++)
+		{
+			for (UINT x = 0; x <= size; x++)
+			{
+				const uint32_t vertex = order[y * (size + 1) + x];
+				model.vertices[vertex].position = DirectX::XMFLOAT3(static_cast<float>(x), 0.f, static_cast<float>(y));
+				model.vertices[vertex].uv = DirectX::XMFLOAT2(static_cast<float>(x) / size, static_cast<float>(y) / size);
+
+				// Tag each frame with its vertex so the two streams can be checked against each other
+				model.frames[vertex].normal = DirectX::XMFLOAT3(static_cast<float>(x), 1.f, static_cast<float>(y));
+			}
+		}
+
+		std::vector<uint32_t> quads(size * size);
+		for (uint32_t i = 0; i < quads.size(); i++) quads[i] = i;
+		std::shuffle(quads.begin(), quads.end(), random);
+		for (uint32_t quad : quads)
+		{
+			const uint32_t x = quad % size, y = quad / size;
+			const uint32_t a = order[y * (size + 1) + x], b = order[y * (size + 1) + x + 1];
+			const uint32_t c = order[(y + 1) * (size + 1) + x], d = order[(y + 1) * (size + 1) + x + 1];
+			const uint32_t corners[] = { a, b, d, a, d, c };
+			model.indices.insert(model.indices.end(), corners, corners + 6);
+		}
+
+		const uint32_t third = static_cast<uint32_t>(model.indices.size() / 9) * 3;
+		const uint32_t offsets[] = { 0, third, third * 2, static_cast<uint32_t>(model.indices.size()) };
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			Submesh submesh;
+			submesh.indexOffset = offsets[i];
+			submesh.indexCount = offsets[i + 1] - offsets[i];
+			submesh.materialIndex = i;
+			model.submeshes.push_back(submesh);
+		}
+
+		return model;
+	}
+
+	// The triangles of a submesh by corner position, corner order kept, sorted so the order of triangles does not count
+	std::vector<std::vector<float>> GetTriangles(const Model& model, const Submesh& submesh)
+	{
+		std::vector<std::vector<float>> triangles;
+		for (uint32_t i = submesh.indexOffset; i < submesh.indexOffset + submesh.indexCount; i += 3)
+		{
+			std::vector<float> triangle;
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const Vertex& vertex = model.vertices[model.indices[i + corner]];
+				triangle.insert(triangle.end(), { vertex.position.x, vertex.position.y, vertex.position.z, vertex.uv.x, vertex.uv.y });
+			}
+			triangles.push_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	void TestPreserved()
+	{
+		const Model original = MakeShuffledGrid(120);
+		Model model = original;
+		const OptimizeStats stats = MeshOptimizer::Optimize(model);
+
+		CHECK(model.vertices.size() == original.vertices.size() && model.frames.size() == original.frames.size(), "%zu vertices and %zu frames after, %zu before", model.vertices.size(), model.frames.size(), original.vertices.size());
+		CHECK(model.indices.size() == original.indices.size(), "%zu indices after, %zu before", model.indices.size(), original.indices.size());
+
+		// Each submesh keeps its range, its material and its triangles, and frames stay with their vertices
+		CHECK(model.submeshes.size() == original.submeshes.size(), "%zu submeshes", model.submeshes.size());
+		for (size_t i = 0; i < original.submeshes.size() && i < model.submeshes.size(); i++)
+		{
+			const Submesh& before = original.submeshes[i];
+			const Submesh& after = model.submeshes[i];
+			CHECK(after.indexOffset == before.indexOffset && after.indexCount == before.indexCount && after.materialIndex == before.materialIndex, "submesh %zu moved", i);
+			CHECK(GetTriangles(model, after) == GetTriangles(original, before), "submesh %zu has different triangles", i);
+		}
+
+		size_t strayFrames = 0;
+		for (size_t i = 0; i < model.vertices.size() && i < model.frames.size(); i++)
+		{
+			if (model.frames[i].normal.x != model.vertices[i].position.x || model.frames[i].normal.z != model.vertices[i].position.z) strayFrames++;
+		}
+		CHECK(strayFrames == 0, "%zu frames no longer match their vertex", strayFrames);
+
+		// Vertices are numbered in first use, and the fetch stride at least halves on a shuffled grid
+		uint32_t next = 0;
+		bool firstUse = true;
+		for (uint32_t index : model.indices)
+		{
+			if (index > next) firstUse = false;
+			if (index == next) next++;
+		}
+		CHECK(firstUse, "vertices are not numbered in the order the triangles first use them");
+		CHECK(stats.fetchStrideBefore == MeshOptimizer::AverageFetchStride(original.indices) && stats.fetchStrideAfter == MeshOptimizer::AverageFetchStride(model.indices), "the stats do not match the indices");
+		CHECK(stats.fetchStrideAfter * 2.f < stats.fetchStrideBefore, "fetch stride went from %.0f to %.0f bytes", stats.fetchStrideBefore, stats.fetchStrideAfter);
+	}
+
+	void TestWorkerCounts()
+	{
+		// The order comes from the triangles alone, not from how the work is split
+		const UINT workerCount = Utils::GetWorkerCount();
+		Utils::SetWorkerCount(1);
+		Model single = MakeShuffledGrid(200);
+		MeshOptimizer::Optimize(single);
+
+		Utils::SetWorkerCount(4);
+		Model several = MakeShuffledGrid(200);
+		MeshOptimizer::Optimize(several);
+		Utils::SetWorkerCount(workerCount);
+
+		CHECK(single.indices == several.indices && memcmp(single.vertices.data(), several.vertices.data(), single.vertices.size() * sizeof(Vertex)) == 0, "1 and 4 workers give different orders");
+	}
+
+	void TestEmpty()
+	{
+		Model model;
+		const OptimizeStats stats = MeshOptimizer::Optimize(model);
+		CHECK(model.indices.empty() && model.vertices.empty() && stats.fetchStrideAfter == 0.f, "an empty model came back with data");
+	}
+}
+
+int main()
+{
+	TestPreserved();
+	TestWorkerCounts();
+	TestEmpty();
+	return Test::Finish("MeshOptimizerTests");
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+#include "MeshPartitioner.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <map>
+#include <random>
+
+namespace
+{
+	// Small triangles scattered through a box, in two materials
+	Model MakeSoup(uint32_t triangleCount, float size)
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> coordinate(0.f, 100.f);
+		std::uniform_real_distribution<float> offset(-size, size);
+
+		Model model;
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			const DirectX::XMFLOAT3 center(coordinate(random), coordinate(random), coordinate(random));
+			for (int corner = 0; corner < 3; corner++)
+			{
+				Vertex vertex;
+				vertex.position = DirectX::XMFLOAT3(center.x + offset(random), center.y + offset(random), center.z + offset(random));
+				vertex.uv = DirectX::XMFLOAT2(0.f, 0.f);
+				model.vertices.push_back(vertex);
+				model.indices.push_back(t * 3 + corner);
+			}
+		}
+
+		Submesh first, second;
+		first.indexCount = (triangleCount / 3) * 3;
+		second.indexOffset = first.indexCount;
+		second.indexCount = triangleCount * 3 - first.indexCount;
+		second.materialIndex = 1;
+		model.submeshes = { first, second };
+		return model;
+	}
+
+	typedef std::array<uint32_t, 4> TriangleKey;
+
+	// Corner order is kept by the partitioner, so a triangle and its material identify it
+	std::map<TriangleKey, int> CountTriangles(const Model& model)
+	{
+		std::map<TriangleKey, int> triangles;
+		for (const Submesh& submesh : model.submeshes)
+		{
+			for (uint32_t i = submesh.indexOffset; i < submesh.indexOffset + submesh.indexCount; i += 3)
+			{
+				triangles[TriangleKey{ { model.indices[i], model.indices[i + 1], model.indices[i + 2], submesh.materialIndex } }]++;
+			}
+		}
+		return triangles;
+	}
+
+	void TestCoverage()
+	{
+		for (uint32_t maxClusterTriangles : { 1u, 100u, 1000u, 4096u, 100000u })
+		{
+			Model model = MakeSoup(20000, 0.5f);
+			const std::map<TriangleKey, int> before = CountTriangles(model);
+
+			const PartitionStats stats = MeshPartitioner::Partition(model, maxClusterTriangles);
+			CHECK(stats.clusterCount == model.clusters.size() && !model.clusters.empty(), "%zu clusters reported, %zu made", stats.clusterCount, model.clusters.size());
+			CHECK(stats.largestCluster <= maxClusterTriangles, "a cluster of %zu triangles over the limit of %u", stats.largestCluster, maxClusterTriangles);
+
+			// Every triangle is in exactly one cluster, with its material
+			std::map<TriangleKey, int> after;
+			uint32_t nextIndex = 0;
+			size_t badClusters = 0, outside = 0;
+			for (const Cluster& cluster : model.clusters)
+			{
+				uint32_t triangles = 0;
+				for (uint32_t s = cluster.submeshOffset; s < cluster.submeshOffset + cluster.submeshCount; s++)
+				{
+					const Submesh& submesh = model.submeshes[s];
+					badClusters += (submesh.indexOffset != nextIndex);
+					nextIndex = submesh.indexOffset + submesh.indexCount;
+					triangles += submesh.indexCount / 3;
+
+					for (uint32_t i = submesh.indexOffset; i < submesh.indexOffset + submesh.indexCount; i += 3)
+					{
+						after[TriangleKey{ { model.indices[i], model.indices[i + 1], model.indices[i + 2], submesh.materialIndex } }]++;
+
+						for (uint32_t c = i; c < i + 3; c++)
+						{
+							const DirectX::XMFLOAT3& p = model.vertices[model.indices[c]].position;
+							outside += (p.x < cluster.boundsMin.x || p.y < cluster.boundsMin.y || p.z < cluster.boundsMin.z || p.x > cluster.boundsMax.x || p.y > cluster.boundsMax.y || p.z > cluster.boundsMax.z);
+						}
+					}
+				}
+
+				badClusters += (triangles == 0 || triangles > maxClusterTriangles);
+			}
+
+			CHECK(after == before, "triangles were lost, duplicated or changed material with a limit of %u", maxClusterTriangles);
+			CHECK(nextIndex == model.indices.size() && badClusters == 0, "%zu clusters are empty, too large or not contiguous with a limit of %u", badClusters, maxClusterTriangles);
+			CHECK(outside == 0, "%zu corners lie outside their cluster's bounds with a limit of %u", outside, maxClusterTriangles);
+		}
+	}
+
+	float BoundsVolume(const Model& model, uint32_t begin, uint32_t end, DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const DirectX::XMFLOAT3& p = model.vertices[model.indices[i]].position;
+			boundsMin = DirectX::XMFLOAT3((std::min)(boundsMin.x, p.x), (std::min)(boundsMin.y, p.y), (std::min)(boundsMin.z, p.z));
+			boundsMax = DirectX::XMFLOAT3((std::max)(boundsMax.x, p.x), (std::max)(boundsMax.y, p.y), (std::max)(boundsMax.z, p.z));
+		}
+		return (boundsMax.x - boundsMin.x) * (boundsMax.y - boundsMin.y) * (boundsMax.z - boundsMin.z);
+	}
+
+	void TestOverlap()
+	{
+		const uint32_t triangleCount = 200000, maxClusterTriangles = 4096;
+		Model model = MakeSoup(triangleCount, 0.5f);
+
+		// The same cluster sizes cut from the triangles in file order, which here is random, as a baseline
+		double unsortedVolume = 0.0;
+		for (uint32_t begin = 0; begin < triangleCount; begin += maxClusterTriangles)
+		{
+			DirectX::XMFLOAT3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			unsortedVolume += BoundsVolume(model, begin * 3, (std::min)(begin + maxClusterTriangles, triangleCount) * 3, boundsMin, boundsMax);
+		}
+
+		const PartitionStats stats = MeshPartitioner::Partition(model, maxClusterTriangles);
+
+		// The reported ratio is the clusters' summed volume over the model's
+		double clusterVolume = 0.0;
+		DirectX::XMFLOAT3 modelMin(FLT_MAX, FLT_MAX, FLT_MAX), modelMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const Cluster& cluster : model.clusters)
+		{
+			clusterVolume += (cluster.boundsMax.x - cluster.boundsMin.x) * (cluster.boundsMax.y - cluster.boundsMin.y) * (cluster.boundsMax.z - cluster.boundsMin.z);
+		}
+		const float modelVolume = BoundsVolume(model, 0, triangleCount * 3, modelMin, modelMax);
+		const double ratio = clusterVolume / modelVolume;
+		const double unsortedRatio = unsortedVolume / modelVolume;
+
+		printf("%zu clusters of up to %zu triangles, AABB overlap %.2fx (%.2fx recomputed), %.2fx for clusters in file order\n", stats.clusterCount, stats.largestCluster, stats.overlapRatio, ratio, unsortedRatio);
+		CHECK(fabs(stats.overlapRatio - ratio) < 0.01 * ratio, "reported overlap %.3f, recomputed %.3f", stats.overlapRatio, ratio);
+		CHECK(ratio < 1.5, "median split clusters overlap %.2fx", ratio);
+		CHECK(ratio * 10.0 < unsortedRatio, "median split overlap %.2fx is not far below the %.2fx of clusters in file order", ratio, unsortedRatio);
+	}
+
+	void TestSmallModel()
+	{
+		// A model under the limit stays one cluster, with its triangles grouped by material
+		Model model = MakeSoup(10, 0.5f);
+		const PartitionStats stats = MeshPartitioner::Partition(model);
+		CHECK(stats.clusterCount == 1 && model.clusters[0].submeshCount == 2, "%zu clusters, %u submeshes", stats.clusterCount, model.clusters.empty() ? 0u : model.clusters[0].submeshCount);
+
+		Model empty;
+		CHECK(MeshPartitioner::Partition(empty).clusterCount == 0 && empty.clusters.empty(), "an empty model got clusters");
+	}
+}
+
+int main()
+{
+	Utils::SetWorkerCount(4);
+	TestCoverage();
+	TestOverlap();
+	TestSmallModel();
+
+	return Test::Finish("MeshPartitionerTests");
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "MeshPartitioner.h"
+#include "MeshSimplifier.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const uint32_t GridSize = 257;
+
+	float Height(uint32_t x, uint32_t z)
+	{
+		return 4.f * sinf(x * 0.05f) * cosf(z * 0.07f) + 0.2f * sinf(x * 0.9f + z * 0.4f);
+	}
+
+	// Rolling hills with fine ripples over a 256 x 256 grid, cut into clusters
+	Model MakeTerrain()
+	{
+		Model model;
+		for (uint32_t z = 0; z < GridSize; z++)
+		{
+			for (uint32_t x = 0; x < GridSize; x++)
+			{
+				Vertex vertex;
+				vertex.position = DirectX::XMFLOAT3(static_cast<float>(x), Height(x, z), static_cast<float>(z));
+				vertex.uv = DirectX::XMFLOAT2(0.f, 0.f);
+				model.vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t z = 0; z + 1 < GridSize; z++)
+		{
+			for (uint32_t x = 0; x + 1 < GridSize; x++)
+			{
+				const uint32_t i = z * GridSize + x;
+				model.indices.insert(model.indices.end(), { i, i + GridSize, i + 1, i + 1, i + GridSize, i + GridSize + 1 });
+			}
+		}
+
+		Submesh submesh;
+		submesh.indexCount = static_cast<uint32_t>(model.indices.size());
+		model.submeshes = { submesh };
+		MeshPartitioner::Partition(model, 16384);
+		return model;
+	}
+
+	// Height of the full-resolution surface straight above or below a point. The vertical gap is never shorter than
+	// the distance to the surface, so it can be checked against the recorded bound.
+	float SurfaceHeight(const Model& model, float x, float z)
+	{
+		const uint32_t cellX = (std::min)(static_cast<uint32_t>(x), GridSize - 2);
+		const uint32_t cellZ = (std::min)(static_cast<uint32_t>(z), GridSize - 2);
+		const float fx = x - cellX, fz = z - cellZ;
+		const size_t i = static_cast<size_t>(cellZ) * GridSize + cellX;
+		const float h00 = model.vertices[i].position.y, h10 = model.vertices[i + 1].position.y;
+		const float h01 = model.vertices[i + GridSize].position.y, h11 = model.vertices[i + GridSize + 1].position.y;
+		if (fx + fz <= 1.f) return h00 + fx * (h10 - h00) + fz * (h01 - h00);
+		return h11 + (1.f - fx) * (h01 - h11) + (1.f - fz) * (h10 - h11);
+	}
+
+	size_t CountTriangles(const Model& model, uint32_t submeshOffset, uint32_t submeshCount)
+	{
+		size_t triangles = 0;
+		for (uint32_t s = submeshOffset; s < submeshOffset + submeshCount; s++) triangles += model.submeshes[s].indexCount / 3;
+		return triangles;
+	}
+
+	void TestLevels()
+	{
+		Model model = MakeTerrain();
+		const size_t baseSubmeshes = model.submeshes.size();
+		const SimplifyStats stats = MeshSimplifier::BuildLods(model);
+		CHECK(stats.levelCount >= 3, "only %zu levels were built", stats.levelCount);
+		CHECK(stats.coarsestTriangles < stats.baseTriangles / 8, "the coarsest levels keep %zu of %zu triangles", stats.coarsestTriangles, stats.baseTriangles);
+
+		const float barycentrics[][2] = { { 1.f / 3, 1.f / 3 }, { 0.5f, 0.f }, { 0.f, 0.5f }, { 0.5f, 0.5f }, { 0.1f, 0.2f }, { 0.7f, 0.1f }, { 0.2f, 0.7f } };
+		for (const Cluster& cluster : model.clusters)
+		{
+			const float diagonal = sqrtf(powf(cluster.boundsMax.x - cluster.boundsMin.x, 2.f) + powf(cluster.boundsMax.y - cluster.boundsMin.y, 2.f) + powf(cluster.boundsMax.z - cluster.boundsMin.z, 2.f));
+			CHECK(cluster.lodCount > 0 && cluster.lodCount <= MeshSimplifier::MaxLodLevels, "a cluster has %u levels", cluster.lodCount);
+
+			size_t previous = CountTriangles(model, cluster.submeshOffset, cluster.submeshCount);
+			float previousError = 0.f;
+			for (uint32_t level = 0; level < cluster.lodCount; level++)
+			{
+				const ClusterLod& lod = model.lods[cluster.lodOffset + level];
+				CHECK(lod.submeshOffset >= baseSubmeshes, "level %u reuses the full-resolution submeshes", level);
+
+				// Each level aims at half the triangles of the one before. Once locked cluster borders make up much of a
+				// small level it may fall short, but a level that shrinks by less than 15% is never kept.
+				const size_t triangles = CountTriangles(model, lod.submeshOffset, lod.submeshCount);
+				CHECK(triangles <= previous * 0.85, "level %u has %zu triangles after %zu", level, triangles, previous);
+				CHECK(previous < 4096 || (triangles <= previous * 0.55 && triangles >= previous * 0.4), "level %u has %zu triangles after %zu, not about half", level, triangles, previous);
+				CHECK(lod.error >= previousError && lod.error <= 0.05f * diagonal, "level %u records an error of %f with a diagonal of %f", level, lod.error, diagonal);
+
+				float worst = 0.f;
+				for (uint32_t s = lod.submeshOffset; s < lod.submeshOffset + lod.submeshCount; s++)
+				{
+					const Submesh& submesh = model.submeshes[s];
+					for (uint32_t i = submesh.indexOffset; i < submesh.indexOffset + submesh.indexCount; i += 3)
+					{
+						const DirectX::XMFLOAT3& a = model.vertices[model.indices[i]].position;
+						const DirectX::XMFLOAT3& b = model.vertices[model.indices[i + 1]].position;
+						const DirectX::XMFLOAT3& c = model.vertices[model.indices[i + 2]].position;
+						for (const auto& w : barycentrics)
+						{
+							const float x = a.x + w[0] * (b.x - a.x) + w[1] * (c.x - a.x);
+							const float y = a.y + w[0] * (b.y - a.y) + w[1] * (c.y - a.y);
+							const float z = a.z + w[0] * (b.z - a.z) + w[1] * (c.z - a.z);
+							worst = (std::max)(worst, fabsf(y - SurfaceHeight(model, x, z)));
+						}
+					}
+				}
+				CHECK(worst <= lod.error, "level %u strays %f from the surface with a bound of %f", level, worst, lod.error);
+
+				previous = triangles;
+				previousError = lod.error;
+			}
+		}
+	}
+
+	void TestWorkerCounts()
+	{
+		// Submeshes are simplified in parallel on the pool, and the levels must not depend on how many workers it has
+		Model reference = MakeTerrain();
+		Utils::SetWorkerCount(1);
+		MeshSimplifier::BuildLods(reference);
+
+		for (UINT workerCount : { 2u, 5u })
+		{
+			Utils::SetWorkerCount(workerCount);
+			Model model = MakeTerrain();
+			MeshSimplifier::BuildLods(model);
+			CHECK(model.indices == reference.indices && model.lods.size() == reference.lods.size(), "levels differ with %u workers", workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+}
+
+int main()
+{
+	TestLevels();
+	TestWorkerCounts();
+
+	return Test::Finish("MeshSimplifierTests");
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "MipGenerator.h"
+#include "Utils.h"
+
+#include <random>
+
+// Builds the full mip chain of an 8192 x 8192 RGBA8 texture with every filter, in sRGB and in linear space.
+// Usage: MipGeneratorBenchmark [size]
+int main(int argc, char** argv)
+{
+	const UINT size = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 8192;
+	const char* filterNames[] = { "box", "Kaiser", "Lanczos" };
+
+	TextureInfo source;
+	source.width = static_cast<int>(size);
+	source.height = static_cast<int>(size);
+	source.stride = 4;
+	source.pixels.resize(static_cast<size_t>(size) * size * 4);
+	std::mt19937 random(18);
+	for (UINT8& byte : source.pixels) byte = static_cast<UINT8>(random());
+
+	printf("%ux%u texels, %u levels, %u workers\n", size, size, MipGenerator::GetMipCount(size, size), Utils::GetWorkerCount());
+	printf("  %-10s%-8s%12s%16s\n", "filter", "space", "ms", "M texels/s");
+
+	TextureInfo texture;
+	for (int f = 0; f < 3; f++)
+	{
+		for (bool srgb : { true, false })
+		{
+			// Best of three, so page faults on the first pass do not count; the copy back is outside the timing
+			float best = 0.f;
+			for (int run = 0; run < 3; run++)
+			{
+				texture.pixels.assign(source.pixels.begin(), source.pixels.end());
+				texture.width = source.width;
+				texture.height = source.height;
+				texture.stride = source.stride;
+
+				const MipStats stats = MipGenerator::Generate(texture, static_cast<MipFilter>(f), srgb);
+				if (run == 0 || stats.milliseconds < best) best = stats.milliseconds;
+			}
+
+			printf("  %-10s%-8s%12.1f%16.0f\n", filterNames[f], srgb ? "sRGB" : "linear", best, static_cast<double>(size) * size / (best * 1000.0));
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
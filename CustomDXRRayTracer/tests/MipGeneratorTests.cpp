@@ -0,0 +1,211 @@
+#include "MipGenerator.h"
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const double Pi = 3.14159265358979323846;
+	const char* FilterNames[] = { "box", "Kaiser", "Lanczos" };
+
+	double ToLinear(UINT8 byte, bool srgb)
+	{
+		const double value = byte / 255.0;
+		if (!srgb) return value;
+		return (value <= 0.04045) ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+	}
+
+	int ToByte(double value, bool srgb)
+	{
+		value = (std::min)((std::max)(value, 0.0), 1.0);
+		if (srgb) value = (value <= 0.0031308) ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+		return static_cast<int>(floor(value * 255.0 + 0.5));
+	}
+
+	double Sinc(double x)
+	{
+		return (fabs(x) < 1e-12) ? 1.0 : sin(Pi * x) / (Pi * x);
+	}
+
+	double BesselI0(double x)
+	{
+		double sum = 1.0, term = 1.0;
+		for (int k = 1; k < 64; k++)
+		{
+			term *= (x * x) / (4.0 * k * k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	// The filters MipGenerator documents: a box over the span each destination texel replaces, a Kaiser window of
+	// width 3 and alpha 4, and Lanczos 3, all stretched by the size ratio and clamped at the edges
+	std::vector<std::vector<double>> ReferenceWeights(UINT sourceSize, UINT destinationSize, MipFilter filter)
+	{
+		const double scale = static_cast<double>(sourceSize) / destinationSize;
+		const double radius = ((filter == MipFilter::Box) ? 0.5 : 3.0) * scale;
+
+		std::vector<std::vector<double>> weights(destinationSize, std::vector<double>(sourceSize, 0.0));
+		for (UINT i = 0; i < destinationSize; i++)
+		{
+			const double center = (i + 0.5) * scale;
+			double sum = 0.0;
+			for (int j = static_cast<int>(floor(center - radius)); j < ceil(center + radius); j++)
+			{
+				const double x = (j + 0.5 - center) / scale;
+				double weight = 0.0;
+				if (filter == MipFilter::Box) weight = (std::max)(0.0, (std::min)(j + 1.0, center + radius) - (std::max)(static_cast<double>(j), center - radius));
+				else if (filter == MipFilter::Kaiser) weight = (fabs(x) < 3.0) ? Sinc(x) * BesselI0(4.0 * sqrt(1.0 - x * x / 9.0)) / BesselI0(4.0) : 0.0;
+				else weight = (fabs(x) < 3.0) ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+
+				weights[i][(std::min)((std::max)(j, 0), static_cast<int>(sourceSize) - 1)] += weight;
+				sum += weight;
+			}
+			for (double& weight : weights[i]) weight /= sum;
+		}
+		return weights;
+	}
+
+	// Resamples one level from the bytes of the level above, entirely in double precision
+	std::vector<int> ReferenceLevel(const UINT8* source, UINT sourceWidth, UINT sourceHeight, UINT width, UINT height, MipFilter filter, bool srgb)
+	{
+		const std::vector<std::vector<double>> horizontal = ReferenceWeights(sourceWidth, width, filter);
+		const std::vector<std::vector<double>> vertical = ReferenceWeights(sourceHeight, height, filter);
+
+		std::vector<double> rows(static_cast<size_t>(sourceHeight) * width * 4, 0.0);
+		for (UINT y = 0; y < sourceHeight; y++)
+		{
+			for (UINT x = 0; x < width; x++)
+			{
+				for (UINT s = 0; s < sourceWidth; s++)
+				{
+					if (horizontal[x][s] == 0.0) continue;
+					for (int c = 0; c < 4; c++) rows[(static_cast<size_t>(y) * width + x) * 4 + c] += horizontal[x][s] * ToLinear(source[(static_cast<size_t>(y) * sourceWidth + s) * 4 + c], srgb && c < 3);
+				}
+			}
+		}
+
+		std::vector<int> result(static_cast<size_t>(width) * height * 4);
+		for (UINT y = 0; y < height; y++)
+		{
+			for (UINT x = 0; x < width; x++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					double value = 0.0;
+					for (UINT s = 0; s < sourceHeight; s++) value += vertical[y][s] * rows[(static_cast<size_t>(s) * width + x) * 4 + c];
+					result[(static_cast<size_t>(y) * width + x) * 4 + c] = ToByte(value, srgb && c < 3);
+				}
+			}
+		}
+		return result;
+	}
+
+	TextureInfo MakeTexture(UINT width, UINT height)
+	{
+		TextureInfo texture;
+		texture.width = static_cast<int>(width);
+		texture.height = static_cast<int>(height);
+		texture.stride = 4;
+		texture.pixels.resize(static_cast<size_t>(width) * height * 4);
+		return texture;
+	}
+
+	void TestReference()
+	{
+		// Odd sizes take the general path at every level, 1x17 filters one axis only, and 256x129 reaches the halving
+		// fast path after its first level
+		const UINT sizes[][2] = { { 5, 3 }, { 1, 17 }, { 256, 129 } };
+		const UINT levelCounts[] = { 3, 5, 9 };
+		std::mt19937 random(18);
+
+		for (int s = 0; s < 3; s++)
+		{
+			const UINT width = sizes[s][0], height = sizes[s][1];
+			CHECK(MipGenerator::GetMipCount(width, height) == levelCounts[s], "%ux%u has %u levels", width, height, MipGenerator::GetMipCount(width, height));
+
+			TextureInfo source = MakeTexture(width, height);
+			for (UINT8& byte : source.pixels) byte = static_cast<UINT8>(random());
+
+			for (int f = 0; f < 3; f++)
+			{
+				for (bool srgb : { true, false })
+				{
+					TextureInfo texture = source;
+					const MipStats stats = MipGenerator::Generate(texture, static_cast<MipFilter>(f), srgb);
+					CHECK(stats.levelCount == levelCounts[s] && texture.mipLevels == static_cast<int>(levelCounts[s]), "%ux%u %s made %u levels", width, height, FilterNames[f], stats.levelCount);
+					CHECK(texture.pixels.size() == MipGenerator::GetMipOffset(width, height, levelCounts[s]) && stats.bytes == texture.pixels.size(), "%ux%u %s chain is %zu bytes", width, height, FilterNames[f], texture.pixels.size());
+					if (texture.pixels.size() != MipGenerator::GetMipOffset(width, height, levelCounts[s])) continue;
+
+					int worst = 0;
+					UINT worstLevel = 0;
+					for (UINT level = 1; level < levelCounts[s]; level++)
+					{
+						const UINT levelWidth = MipGenerator::GetMipSize(width, level), levelHeight = MipGenerator::GetMipSize(height, level);
+						const UINT8* above = &texture.pixels[MipGenerator::GetMipOffset(width, height, level - 1)];
+						const UINT8* generated = &texture.pixels[MipGenerator::GetMipOffset(width, height, level)];
+						const std::vector<int> expected = ReferenceLevel(above, MipGenerator::GetMipSize(width, level - 1), MipGenerator::GetMipSize(height, level - 1), levelWidth, levelHeight, static_cast<MipFilter>(f), srgb);
+
+						for (size_t i = 0; i < expected.size(); i++)
+						{
+							const int difference = abs(generated[i] - expected[i]);
+							if (difference > worst)
+							{
+								worst = difference;
+								worstLevel = level;
+							}
+						}
+					}
+					CHECK(worst <= 1, "%ux%u %s %s is %d off the reference at level %u", width, height, FilterNames[f], srgb ? "sRGB" : "linear", worst, worstLevel);
+				}
+			}
+		}
+	}
+
+	void TestConstant()
+	{
+		// Normalised weights keep a flat image flat, through the sRGB round trip and despite negative lobes
+		const UINT8 colors[][4] = { { 37, 200, 129, 77 }, { 0, 255, 1, 254 }, { 255, 255, 255, 255 } };
+		for (const UINT8* color : colors)
+		{
+			for (int f = 0; f < 3; f++)
+			{
+				for (bool srgb : { true, false })
+				{
+					TextureInfo texture = MakeTexture(77, 40);
+					for (size_t i = 0; i < texture.pixels.size(); i++) texture.pixels[i] = color[i % 4];
+					MipGenerator::Generate(texture, static_cast<MipFilter>(f), srgb);
+
+					size_t changed = 0;
+					for (size_t i = 0; i < texture.pixels.size(); i++) changed += (texture.pixels[i] != color[i % 4]);
+					CHECK(changed == 0, "%zu bytes of a flat %u %u %u %u image changed with %s %s", changed, color[0], color[1], color[2], color[3], FilterNames[f], srgb ? "sRGB" : "linear");
+				}
+			}
+		}
+	}
+
+	void TestErrors()
+	{
+		TextureInfo texture = MakeTexture(4, 4);
+		texture.stride = 8;
+		bool threw = false;
+		try
+		{
+			MipGenerator::Generate(texture);
+		}
+		catch (const std::exception&)
+		{
+			threw = true;
+		}
+		CHECK(threw, "generated mips for an RGBA16F texture");
+	}
+}
+
+int main()
+{
+	TestReference();
+	TestConstant();
+	TestErrors();
+	return Test::Finish("MipGeneratorTests");
+}
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include "MeshCache.h"
+#include "ModelStream.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+namespace
+{
+	void WriteText(const std::string& path, const std::string& text)
+	{
+		Utils::OutputFile file;
+		CHECK(file.Open(path) && file.Write(text.data(), text.size()) && file.Commit(), "writing %s failed", path.c_str());
+	}
+
+	// A flat grid written a row of quads at a time, switching material every ten rows
+	std::string MakeGrid(UINT size, const std::string& badFace = "")
+	{
+		std::string text = "mtllib model_stream_test.mtl\n";
+		char line[128];
+		for (UINT y = 0; y <= size; y++)
+		{
+			for (UINT x = 0; x <= size; x++)
+			{
+				snprintf(line, sizeof(line), "v %u 0 %u\n", x, y);
+				text += line;
+			}
+		}
+
+		for (UINT y = 0; y < size; y++)
+		{
+			if (y % 10 == 0) text += (y % 20 == 0) ? "usemtl red\n" : "usemtl blue\n";
+			for (UINT x = 0; x < size; x++)
+			{
+				const UINT a = y * (size + 1) + x + 1, b = a + 1, c = a + size + 1, d = c + 1;
+				snprintf(line, sizeof(line), "f %u %u %u %u\n", a, b, d, c);
+				text += line;
+			}
+		}
+
+		return text + badFace;
+	}
+
+	void RemoveCacheEntry(const std::string& path)
+	{
+		remove(MeshCache::GetCachePath(MeshCache::ComputeKey(path)).c_str());
+	}
+
+	float GetMinZ(const Model& model)
+	{
+		float minZ = model.vertices.empty() ? 0.f : model.vertices[0].position.z;
+		for (const Vertex& vertex : model.vertices) minZ = (std::min)(minZ, vertex.position.z);
+		return minZ;
+	}
+
+	void TestBatches()
+	{
+		const std::string path = "model_stream_test.obj";
+		const UINT size = 40;
+		WriteText("materials/model_stream_test.mtl", "newmtl red\nnewmtl blue\n");
+		WriteText(path, MakeGrid(size));
+		RemoveCacheEntry(path);
+
+		// Batches arrive in file order, which for this grid is by row, and together hold every triangle; the first batch
+		// takes the vertices and the first rows of faces
+		ModelStream stream;
+		std::vector<Material> materials;
+		stream.Start(path, materials, 20000, 4096);
+		CHECK(materials.size() == 2 && materials[0].name == "red" && materials[1].name == "blue", "%zu materials known after the first batch", materials.size());
+
+		std::shared_ptr<Model> batch;
+		size_t batchCount = 0, triangleCount = 0;
+		float lastMinZ = -1.f;
+		while (stream.Wait(batch))
+		{
+			const float minZ = GetMinZ(*batch);
+			CHECK(minZ >= lastMinZ, "batch %zu starts at row %g after one starting at row %g", batchCount, minZ, lastMinZ);
+			lastMinZ = minZ;
+			batchCount++;
+			triangleCount += batch->indices.size() / 3;
+		}
+		CHECK(batchCount > 5 && triangleCount == 2 * size * size, "%zu batches of %zu triangles", batchCount, triangleCount);
+		CHECK(stream.IsFinished() && !stream.Wait(batch), "Wait handed over a batch after the last");
+
+		// The cache entry saved from the streamed faces is the model LoadModel builds from the whole file
+		ObjMesh mesh;
+		ObjParser::ParseObj(path, mesh);
+		std::vector<Material> wholeMaterials;
+		Utils::LoadMaterials(mesh, wholeMaterials);
+		Model whole;
+		Utils::BuildModel(mesh, wholeMaterials, whole);
+
+		Model cached;
+		std::vector<Material> cachedMaterials;
+		CHECK(MeshCache::Load(MeshCache::ComputeKey(path), cached, cachedMaterials), "streaming saved no cache entry");
+		CHECK(cached.VertexCount() == whole.vertices.size() && cached.IndexCount() == whole.indices.size(), "cached %zu vertices and %zu indices, the whole file builds %zu and %zu", cached.VertexCount(), cached.IndexCount(), whole.vertices.size(), whole.indices.size());
+		if (cached.VertexCount() == whole.vertices.size() && cached.IndexCount() == whole.indices.size())
+		{
+			CHECK(memcmp(cached.VertexData(), whole.vertices.data(), whole.vertices.size() * sizeof(Vertex)) == 0 && std::equal(whole.indices.begin(), whole.indices.end(), cached.IndexData()), "cached geometry differs from the whole file's");
+		}
+		CHECK(cached.submeshes.size() == whole.submeshes.size() && cachedMaterials.size() == wholeMaterials.size(), "cached %zu submeshes and %zu materials, expected %zu and %zu", cached.submeshes.size(), cachedMaterials.size(), whole.submeshes.size(), wholeMaterials.size());
+
+		// The next start finds the entry and hands over the whole model at once
+		stream.Start(path, materials);
+		size_t cachedBatches = 0;
+		while (stream.Wait(batch)) cachedBatches++;
+		CHECK(cachedBatches == 1 && batch->mapping, "a cached model came in %zu batches", cachedBatches);
+
+		RemoveCacheEntry(path);
+		remove(path.c_str());
+	}
+
+	void TestStop()
+	{
+		// Stop after the first batch returns without reading the rest or saving a cache entry
+		const std::string path = "model_stream_stop.obj";
+		const UINT size = 200;
+		WriteText(path, MakeGrid(size));
+		RemoveCacheEntry(path);
+
+		ModelStream stream;
+		std::vector<Material> materials;
+		stream.Start(path, materials, 16384, 16384);
+
+		std::shared_ptr<Model> batch;
+		CHECK(stream.Wait(batch), "no first batch");
+		stream.Stop();
+
+		size_t triangleCount = batch ? batch->indices.size() / 3 : 0;
+		std::vector<std::shared_ptr<Model>> batches;
+		stream.Poll(batches);
+		for (const std::shared_ptr<Model>& rest : batches) triangleCount += rest->indices.size() / 3;
+		CHECK(triangleCount < 2 * size * size && stream.IsFinished(), "%zu triangles after Stop", triangleCount);
+
+		Model cached;
+		CHECK(!MeshCache::Load(MeshCache::ComputeKey(path), cached, materials), "a stopped stream saved a cache entry");
+
+		remove(path.c_str());
+	}
+
+	void TestErrors()
+	{
+		// A bad face in a later batch is rethrown by Wait once the batches before it are taken
+		const std::string path = "model_stream_error.obj";
+		WriteText(path, MakeGrid(40, "f 1 2 99999\n"));
+		RemoveCacheEntry(path);
+
+		ModelStream stream;
+		std::vector<Material> materials;
+		stream.Start(path, materials, 4096, 4096);
+
+		int errors = 0;
+		size_t batchCount = 0;
+		std::shared_ptr<Model> batch;
+		for (int i = 0; i < 1000; i++)
+		{
+			try
+			{
+				if (!stream.Wait(batch)) break;
+				batchCount++;
+			}
+			catch (const std::exception&)
+			{
+				errors++;
+			}
+		}
+		CHECK(errors == 1 && batchCount > 0 && stream.IsFinished(), "%d errors after %zu batches", errors, batchCount);
+
+		Model cached;
+		CHECK(!MeshCache::Load(MeshCache::ComputeKey(path), cached, materials), "a failed stream saved a cache entry");
+
+		// A missing file fails on the calling thread
+		bool threw = false;
+		try
+		{
+			stream.Start("model_stream_missing.obj", materials);
+		}
+		catch (const std::exception&)
+		{
+			threw = true;
+		}
+		CHECK(threw, "a missing file started streaming");
+
+		remove(path.c_str());
+		remove("materials/model_stream_test.mtl");
+	}
+}
+
+int main()
+{
+	TestBatches();
+	TestStop();
+	TestErrors();
+	return Test::Finish("ModelStreamTests");
+}
\ No newline at end of file
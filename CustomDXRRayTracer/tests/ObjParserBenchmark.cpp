@@ -0,0 +1,97 @@
+#include "ObjParser.h"
+#include "Utils.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include <random>
+
+// Parses an OBJ with ObjParser and with tinyobj, which LoadModel used before, checks they read the same corners and
+// reports both speeds. Usage: ObjParserBenchmark [model.obj]; without a model a 2.4M-triangle one is generated.
+namespace
+{
+	void WriteModel(const std::string& path, UINT quadCount)
+	{
+		FILE* file = fopen(path.c_str(), "w");
+		if (!file) throw std::runtime_error("Error: failed to create " + path);
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> coordinate(-10.f, 10.f);
+
+		fprintf(file, "# Generated by ObjParserBenchmark\no grid\n");
+		for (UINT quad = 0; quad < quadCount; quad++)
+		{
+			for (int i = 0; i < 4; i++) fprintf(file, "v %.6f %.6f %.6f\n", coordinate(random), coordinate(random), coordinate(random));
+			for (int i = 0; i < 4; i++) fprintf(file, "vt %.6f %.6f\n", coordinate(random) * 0.05f + 0.5f, coordinate(random) * 0.05f + 0.5f);
+
+			// Relative and absolute indices, quads and triangles, as exporters write them
+			const UINT last = quad * 4 + 4;
+			if (quad % 2) fprintf(file, "f -4/-4 -3/-3 -2/-2 -1/-1\n");
+			else fprintf(file, "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n", last - 3, last - 3, last - 2, last - 2, last - 1, last - 1, last - 3, last - 3, last - 1, last - 1, last, last);
+		}
+
+		fclose(file);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string path = (argc > 1) ? argv[1] : "benchmark.obj";
+	if (argc <= 1) WriteModel(path, 1200000);
+
+	Utils::MappedFile file;
+	if (!file.Open(path))
+	{
+		printf("Cannot open %s\n", path.c_str());
+		return 1;
+	}
+
+	const double megabytes = file.Size() / (1024.0 * 1024.0);
+	file.Close();
+
+	Utils::Timer timer;
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string error;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &error, path.c_str(), "materials/"))
+	{
+		printf("tinyobj failed: %s\n", error.c_str());
+		return 1;
+	}
+
+	const float tinyobjMilliseconds = timer.ElapsedMillis();
+
+	timer.Reset();
+	ObjMesh mesh;
+	ObjParser::ParseObj(path, mesh);
+	const float parserMilliseconds = timer.ElapsedMillis();
+
+	// Same corners in the same order, bit for bit
+	size_t tinyobjCorners = 0, corner = 0, mismatches = 0;
+	for (const tinyobj::shape_t& shape : shapes)
+	{
+		tinyobjCorners += shape.mesh.indices.size();
+		for (const tinyobj::index_t& index : shape.mesh.indices)
+		{
+			if (corner >= mesh.indices.size()) break;
+
+			const ObjIndex& parsed = mesh.indices[corner++];
+			if (memcmp(&attrib.vertices[3 * index.vertex_index], &mesh.positions[3 * parsed.position], 3 * sizeof(float)) != 0) mismatches++;
+			else if (index.texcoord_index >= 0 && memcmp(&attrib.texcoords[2 * index.texcoord_index], &mesh.texcoords[2 * parsed.texcoord], 2 * sizeof(float)) != 0) mismatches++;
+		}
+	}
+
+	const double triangles = mesh.indices.size() / 3.0;
+	printf("%s: %.1f MB, %.0f triangles, %u workers\n", path.c_str(), megabytes, triangles, Utils::GetWorkerCount());
+	printf("  tinyobj    %8.1f ms  %7.1f MB/s  %6.2f M triangles/s\n", tinyobjMilliseconds, megabytes / (tinyobjMilliseconds * 0.001), triangles / (tinyobjMilliseconds * 1000.0));
+	printf("  ObjParser  %8.1f ms  %7.1f MB/s  %6.2f M triangles/s  (%.1fx)\n", parserMilliseconds, megabytes / (parserMilliseconds * 0.001), triangles / (parserMilliseconds * 1000.0), tinyobjMilliseconds / parserMilliseconds);
+
+	if (tinyobjCorners != mesh.indices.size() || corner != mesh.indices.size() || mismatches > 0)
+	{
+		printf("Parsers disagree: %zu corners from tinyobj, %zu from ObjParser, %zu compared, %zu differ\n", tinyobjCorners, mesh.indices.size(), corner, mismatches);
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
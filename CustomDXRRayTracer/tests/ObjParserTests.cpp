@@ -0,0 +1,172 @@
+#include "ObjParser.h"
+#include "Test.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+namespace
+{
+	// Relative and absolute indices, a quad and a pentagon, faces with and without texcoords, groups, comments, CRLF
+	// line ends and values in the notations exporters write
+	const char* const TestObj =
+		"# ObjParserTests\n"
+		"mtllib parser_test.mtl\n"
+		"o first\n"
+		"v 0 0 0\n"
+		"v 1.5 0 -0.25\n"
+		"v 1.5 2e1 0\r\n"
+		"v -0.5 1E-3 +3\n"
+		"vt 0 0\n"
+		"vt 1 0\n"
+		"vt 1 1\n"
+		"vt 0.125 0.875\n"
+		"usemtl red\n"
+		"f 1/1 2/2 3/3 4/4\n"
+		"f -4/-4 -2/-2 -1/-1\n"
+		"g second\n"
+		"v 5 5 5\n"
+		"v 6 5 5\n"
+		"v 6 6 5\n"
+		"usemtl blue\n"
+		"f 5 6 7\n"
+		"f -3 -2 -1 1 2\n"
+		"  f 2//1 3//1 4//1\r\n"
+		"usemtl red\n"
+		"f 1/4/1 -1/3/2 -2/2/3\n";
+
+	void WriteText(const std::string& path, const char* text)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) throw std::runtime_error("Error: failed to create " + path);
+		fputs(text, file);
+		fclose(file);
+	}
+
+	void TestParity()
+	{
+		const std::string path = "parser_test.obj";
+		WriteText(path, TestObj);
+
+		ObjMesh mesh;
+		ObjParser::ParseObj(path, mesh);
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string error;
+		CHECK(tinyobj::LoadObj(&attrib, &shapes, &materials, &error, path.c_str(), ""), "tinyobj failed: %s", error.c_str());
+
+		// The quad and pentagon are fanned from their first corner, so 2 + 1 + 1 + 3 + 1 + 1 triangles
+		CHECK(mesh.indices.size() == 27, "%zu corners, expected 27", mesh.indices.size());
+		CHECK(mesh.positions.size() == 7 * 3 && mesh.texcoords.size() == 4 * 2, "%zu positions and %zu texcoords", mesh.positions.size() / 3, mesh.texcoords.size() / 2);
+		CHECK(mesh.materialLibraries.size() == 1 && mesh.materialLibraries[0] == "parser_test.mtl", "%zu material libraries", mesh.materialLibraries.size());
+
+		// Same corners in the same order, bit for bit, including the ones without texcoords
+		size_t tinyobjCorners = 0, corner = 0, mismatches = 0;
+		for (const tinyobj::shape_t& shape : shapes)
+		{
+			tinyobjCorners += shape.mesh.indices.size();
+			for (const tinyobj::index_t& index : shape.mesh.indices)
+			{
+				if (corner >= mesh.indices.size()) break;
+
+				const ObjIndex& parsed = mesh.indices[corner++];
+				if (memcmp(&attrib.vertices[3 * index.vertex_index], &mesh.positions[3 * parsed.position], 3 * sizeof(float)) != 0) mismatches++;
+				else if ((index.texcoord_index < 0) != (parsed.texcoord < 0)) mismatches++;
+				else if (index.texcoord_index >= 0 && memcmp(&attrib.texcoords[2 * index.texcoord_index], &mesh.texcoords[2 * parsed.texcoord], 2 * sizeof(float)) != 0) mismatches++;
+			}
+		}
+		CHECK(tinyobjCorners == mesh.indices.size() && mismatches == 0, "tinyobj read %zu corners, ObjParser %zu, %zu of them differ", tinyobjCorners, mesh.indices.size(), mismatches);
+
+		// A few corners by hand: the quad's fan, a relative face and the pentagon's last triangle
+		const int expected[][2] = { { 0, 0 }, { 1, 1 }, { 2, 2 }, { 0, 0 }, { 2, 2 }, { 3, 3 }, { 0, 0 }, { 2, 2 }, { 3, 3 } };
+		for (int i = 0; i < 9 && i < static_cast<int>(mesh.indices.size()); i++)
+		{
+			CHECK(mesh.indices[i].position == expected[i][0] && mesh.indices[i].texcoord == expected[i][1], "corner %d is %d/%d", i, mesh.indices[i].position, mesh.indices[i].texcoord);
+		}
+		if (mesh.indices.size() == 27)
+		{
+			CHECK(mesh.indices[18].position == 4 && mesh.indices[19].position == 0 && mesh.indices[20].position == 1, "the pentagon ends %d %d %d", mesh.indices[18].position, mesh.indices[19].position, mesh.indices[20].position);
+			CHECK(mesh.indices[9].texcoord == -1 && mesh.indices[21].texcoord == -1, "faces without texcoords have %d %d", mesh.indices[9].texcoord, mesh.indices[21].texcoord);
+			CHECK(mesh.indices[24].position == 0 && mesh.indices[25].position == 6 && mesh.indices[26].position == 5 && mesh.indices[25].texcoord == 2, "the last face is %d %d %d", mesh.indices[24].position, mesh.indices[25].position, mesh.indices[26].position);
+		}
+
+		CHECK(mesh.positions.size() >= 12 && mesh.positions[7] == 20.f && mesh.positions[9] == -0.5f && mesh.positions[10] == 0.001f && mesh.positions[11] == 3.f, "exponents and signs read wrong");
+
+		// Material switches start groups where they happen
+		const size_t groupOffsets[] = { 0, 9, 24 };
+		const char* groupMaterials[] = { "red", "blue", "red" };
+		CHECK(mesh.groups.size() == 3, "%zu groups", mesh.groups.size());
+		for (size_t i = 0; i < 3 && i < mesh.groups.size(); i++)
+		{
+			CHECK(mesh.groups[i].indexOffset == groupOffsets[i] && mesh.groups[i].material == groupMaterials[i], "group %zu starts at %zu with %s", i, mesh.groups[i].indexOffset, mesh.groups[i].material.c_str());
+		}
+
+		remove(path.c_str());
+	}
+
+	void TestParseFloat()
+	{
+		// tinyobj reads a leading decimal point after a sign as zero; ObjParser does not
+		const char* const tokens[] = { "-.5", ".25", "+7", "1e-2", "-3.5E+2", "12" };
+		const float values[] = { -0.5f, 0.25f, 7.f, 0.01f, -350.f, 12.f };
+		for (int i = 0; i < 6; i++)
+		{
+			const char* p = tokens[i];
+			const float value = ObjParser::ParseFloat(p, tokens[i] + strlen(tokens[i]));
+			CHECK(value == values[i], "%s parsed as %g", tokens[i], value);
+
+			float strict = 0.f;
+			p = tokens[i];
+			CHECK(ObjParser::ParseFloat(p, tokens[i] + strlen(tokens[i]), strict) && strict == values[i] && *p == '\0', "%s parsed strictly as %g", tokens[i], strict);
+		}
+
+		// The checked form reads whole tokens only
+		const char* const bad[] = { "x", "1x", "1e", "-", ".", "1.5.2" };
+		for (const char* token : bad)
+		{
+			float value = 0.f;
+			const char* p = token;
+			CHECK(!ObjParser::ParseFloat(p, token + strlen(token), value) && p == token, "%s parsed as %g", token, value);
+		}
+	}
+
+	void TestErrors()
+	{
+		// References past the vertices read so far are errors, not wild reads
+		const char* const bad[] =
+		{
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n",
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nf -1 -2 -4\n",
+			"v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1/1 2/2 3/2\n",
+		};
+
+		const std::string path = "parser_bad.obj";
+		for (const char* text : bad)
+		{
+			WriteText(path, text);
+
+			bool threw = false;
+			try
+			{
+				ObjMesh mesh;
+				ObjParser::ParseObj(path, mesh);
+			}
+			catch (const std::exception&)
+			{
+				threw = true;
+			}
+			CHECK(threw, "parsed \"%s\"", text);
+		}
+
+		remove(path.c_str());
+	}
+}
+
+int main()
+{
+	TestParity();
+	TestParseFloat();
+	TestErrors();
+	return Test::Finish("ObjParserTests");
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "PlyLoader.h"
+#include "Utils.h"
+
+#include <random>
+
+// Converts generated PLY files in the vertex layouts scanners and exporters write and reports the throughput of each.
+// Usage: PlyLoaderBenchmark [vertex count]; every file has twice as many triangles as vertices.
+namespace
+{
+	struct Layout
+	{
+		const char* name;
+		const char* properties;
+		size_t stride;
+		const char* faceList;
+	};
+
+	template<typename T>
+	void Put(std::vector<UINT8>& buffer, T value)
+	{
+		buffer.insert(buffer.end(), reinterpret_cast<const UINT8*>(&value), reinterpret_cast<const UINT8*>(&value) + sizeof(T));
+	}
+
+	void WriteLayout(const std::string& path, const Layout& layout, size_t vertexCount)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) throw std::runtime_error("Error: failed to create " + path);
+
+		const size_t triangleCount = vertexCount * 2;
+		fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %zu\n%selement face %zu\nproperty list %s vertex_indices\nend_header\n", vertexCount, layout.properties, triangleCount, layout.faceList);
+
+		std::mt19937 random(10);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		std::vector<UINT8> buffer;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			const float x = unit(random) * 10.f, y = unit(random) * 10.f, z = unit(random) * 10.f, u = unit(random), v = unit(random);
+			if (layout.stride == 12)
+			{
+				Put(buffer, x); Put(buffer, y); Put(buffer, z);
+			}
+			else if (layout.stride == 36)
+			{
+				Put(buffer, x); Put(buffer, y); Put(buffer, z);
+				Put(buffer, 0.f); Put(buffer, 1.f); Put(buffer, 0.f);
+				Put(buffer, u); Put(buffer, v);
+				Put(buffer, static_cast<UINT8>(i)); Put(buffer, static_cast<UINT8>(i >> 8)); Put(buffer, static_cast<UINT8>(i >> 16)); Put(buffer, static_cast<UINT8>(255));
+			}
+			else
+			{
+				Put(buffer, static_cast<double>(x)); Put(buffer, static_cast<double>(y)); Put(buffer, static_cast<double>(z));
+				Put(buffer, static_cast<UINT16>(u * 65535.f)); Put(buffer, static_cast<UINT16>(v * 65535.f));
+			}
+
+			if (buffer.size() > (1 << 20))
+			{
+				fwrite(buffer.data(), 1, buffer.size(), file);
+				buffer.clear();
+			}
+		}
+
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			Put(buffer, static_cast<UINT8>(3));
+			for (int k = 0; k < 3; k++) Put(buffer, static_cast<UINT32>(random() % vertexCount));
+
+			if (buffer.size() > (1 << 20))
+			{
+				fwrite(buffer.data(), 1, buffer.size(), file);
+				buffer.clear();
+			}
+		}
+
+		fwrite(buffer.data(), 1, buffer.size(), file);
+		fclose(file);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t vertexCount = (argc > 1) ? static_cast<size_t>(atoll(argv[1])) : 4000000;
+
+	const Layout layouts[] =
+	{
+		{ "float xyz", "property float x\nproperty float y\nproperty float z\n", 12, "uchar int" },
+		{ "float xyz, normal, uv, uchar rgba", "property float x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\nproperty float u\nproperty float v\nproperty uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n", 36, "uchar uint" },
+		{ "double xyz, ushort uv", "property double x\nproperty double y\nproperty double z\nproperty ushort u\nproperty ushort v\n", 28, "uchar uint" },
+	};
+
+	printf("%zu vertices and %zu triangles per file, %u workers\n", vertexCount, vertexCount * 2, Utils::GetWorkerCount());
+	for (const Layout& layout : layouts)
+	{
+		const std::string path = "benchmark.ply";
+		WriteLayout(path, layout, vertexCount);
+
+		// Best of three, so the first run's page faults do not count
+		Model model;
+		PlyStats best;
+		for (int run = 0; run < 3; run++)
+		{
+			const PlyStats stats = PlyLoader::ReadPly(path, model);
+			if (run == 0 || stats.milliseconds < best.milliseconds) best = stats;
+		}
+
+		const double megabytes = best.bytes / (1024.0 * 1024.0);
+		printf("  %-34s %7.1f MB  %8.1f ms  %7.1f MB/s  %6.1f M vertices/s\n", layout.name, megabytes, best.milliseconds, megabytes / (best.milliseconds * 0.001), best.vertexCount / (best.milliseconds * 1000.0));
+		remove(path.c_str());
+	}
+
+	return 0;
+}
\ No newline at end of file
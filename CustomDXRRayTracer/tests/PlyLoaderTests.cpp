@@ -0,0 +1,192 @@
+#include "PlyLoader.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <cmath>
+
+namespace
+{
+	const char* TypeNames[] = { "char", "uchar", "short", "ushort", "int", "uint", "float", "double" };
+
+	template<typename T>
+	void Put(std::string& buffer, T value)
+	{
+		buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void PutTyped(std::string& buffer, int type, double value)
+	{
+		switch (type)
+		{
+		case 0: Put(buffer, static_cast<INT8>(value)); break;
+		case 1: Put(buffer, static_cast<UINT8>(value)); break;
+		case 2: Put(buffer, static_cast<INT16>(value)); break;
+		case 3: Put(buffer, static_cast<UINT16>(value)); break;
+		case 4: Put(buffer, static_cast<INT32>(value)); break;
+		case 5: Put(buffer, static_cast<UINT32>(value)); break;
+		case 6: Put(buffer, static_cast<float>(value)); break;
+		default: Put(buffer, value); break;
+		}
+	}
+
+	void WriteFile(const std::string& path, const std::string& bytes)
+	{
+		Utils::OutputFile file;
+		CHECK(file.Open(path) && file.Write(bytes.data(), bytes.size()) && file.Commit(), "writing %s failed", path.c_str());
+	}
+
+	// A value every type holds exactly, different for each vertex and property
+	double Value(size_t vertex, int property, int type)
+	{
+		const double value = static_cast<double>((vertex * 7 + property * 13) % 120);
+		return (type == 0 || type == 2 || type == 4) && (vertex & 1) ? -value : value;
+	}
+
+	// Writes vertexCount vertices with x, y, z, u, v of the given types, separated by a uchar the loader ignores, and
+	// one triangle per vertex
+	std::string MakePly(const int (&types)[5], size_t vertexCount)
+	{
+		const char* names[] = { "x", "y", "z", "u", "v" };
+		std::string header = "ply\nformat binary_little_endian 1.0\nelement vertex " + std::to_string(vertexCount) + "\n";
+		for (int property = 0; property < 5; property++)
+		{
+			header += std::string("property ") + TypeNames[types[property]] + " " + names[property] + "\nproperty uchar pad" + names[property] + "\n";
+		}
+		header += "element face " + std::to_string(vertexCount) + "\nproperty list uchar int vertex_indices\nend_header\n";
+
+		std::string bytes = header;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			for (int property = 0; property < 5; property++)
+			{
+				PutTyped(bytes, types[property], Value(i, property, types[property]));
+				Put(bytes, static_cast<UINT8>(0xCD));
+			}
+		}
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			Put(bytes, static_cast<UINT8>(3));
+			for (int k = 0; k < 3; k++) Put(bytes, static_cast<INT32>((i + k) % vertexCount));
+		}
+		return bytes;
+	}
+
+	void TestPropertyTypes()
+	{
+		// Every type in every slot, with float-only layouts taking the copy path and the rest the SSE2 one. 70001
+		// vertices span two tasks, several blocks and a tail of one that is not a multiple of four.
+		const size_t vertexCount = 70001;
+		for (int type = 0; type < 8; type++)
+		{
+			const int layouts[][5] =
+			{
+				{ type, type, type, type, type },
+				{ type, (type + 1) % 8, (type + 2) % 8, (type + 3) % 8, (type + 5) % 8 },
+			};
+
+			for (const auto& types : layouts)
+			{
+				const std::string path = "ply_loader_test.ply";
+				WriteFile(path, MakePly(types, vertexCount));
+
+				Model model;
+				PlyLoader::ReadPly(path, model);
+				remove(path.c_str());
+				CHECK(model.vertices.size() == vertexCount, "read %zu vertices with %s x", model.vertices.size(), TypeNames[types[0]]);
+				if (model.vertices.size() != vertexCount) continue;
+
+				size_t wrong = 0;
+				for (size_t i = 0; i < vertexCount; i++)
+				{
+					const Vertex& vertex = model.vertices[i];
+					wrong += vertex.position.x != static_cast<float>(Value(i, 2, types[2]));
+					wrong += vertex.position.y != static_cast<float>(Value(i, 1, types[1]));
+					wrong += vertex.position.z != static_cast<float>(Value(i, 0, types[0]));
+					wrong += vertex.uv.x != static_cast<float>(Value(i, 3, types[3]));
+					wrong += vertex.uv.y != 1 - static_cast<float>(Value(i, 4, types[4]));
+				}
+				CHECK(wrong == 0, "%zu values differ with types %s %s %s %s %s", wrong, TypeNames[types[0]], TypeNames[types[1]], TypeNames[types[2]], TypeNames[types[3]], TypeNames[types[4]]);
+				CHECK(model.indices.size() == vertexCount * 3 && model.indices[3] == 1 && model.indices.back() == 1, "read %zu indices", model.indices.size());
+			}
+		}
+	}
+
+	void TestLargeUnsigned()
+	{
+		// Unsigned 32-bit values past INT32_MAX must not wrap negative
+		std::string bytes = "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty uint x\nproperty uint y\nproperty uint z\nend_header\n";
+		const UINT32 values[] = { 0xFFFFFFFFu, 0x80000000u, 0x80000001u, 65537u };
+		for (UINT32 value : values)
+		{
+			Put(bytes, value); Put(bytes, value); Put(bytes, value);
+		}
+		WriteFile("ply_loader_test.ply", bytes);
+
+		Model model;
+		PlyLoader::ReadPly("ply_loader_test.ply", model);
+		remove("ply_loader_test.ply");
+		for (size_t i = 0; i < 4 && i < model.vertices.size(); i++)
+		{
+			CHECK(model.vertices[i].position.x == static_cast<float>(values[i]), "%u read as %f", values[i], model.vertices[i].position.x);
+		}
+		CHECK(model.vertices.size() == 4 && model.vertices[0].uv.x == 0.f && model.vertices[0].uv.y == 1.f, "a missing texcoord was not zero");
+	}
+
+	// Three vertices followed by the given face records
+	bool ReadFaces(const char* faceList, const std::string& faces, Model& model)
+	{
+		std::string bytes = std::string("ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\nproperty float z\nelement face 3\nproperty list ") + faceList + " vertex_indices\nend_header\n";
+		for (int i = 0; i < 12; i++) Put(bytes, static_cast<float>(i));
+		bytes += faces;
+		WriteFile("ply_loader_test.ply", bytes);
+
+		bool loaded = true;
+		try
+		{
+			PlyLoader::ReadPly("ply_loader_test.ply", model);
+		}
+		catch (const std::runtime_error&)
+		{
+			loaded = false;
+		}
+		remove("ply_loader_test.ply");
+		return loaded;
+	}
+
+	template<typename CountType, typename IndexType>
+	std::string Face(std::initializer_list<int> indices)
+	{
+		std::string bytes;
+		Put(bytes, static_cast<CountType>(indices.size()));
+		for (int index : indices) Put(bytes, static_cast<IndexType>(index));
+		return bytes;
+	}
+
+	void TestFaces()
+	{
+		Model model;
+		CHECK(ReadFaces("uchar int", Face<UINT8, INT32>({ 0, 1, 2 }) + Face<UINT8, INT32>({ 1, 2, 3 }) + Face<UINT8, INT32>({ 3, 2, 0 }), model), "triangles failed to load");
+		CHECK(model.indices == std::vector<uint32_t>({ 0, 1, 2, 1, 2, 3, 3, 2, 0 }), "triangles read wrong");
+
+		// A quad makes the whole element fall back to the serial walk, which fans it into two triangles
+		CHECK(ReadFaces("uchar uint", Face<UINT8, UINT32>({ 0, 1, 2 }) + Face<UINT8, UINT32>({ 0, 1, 2, 3 }) + Face<UINT8, UINT32>({ 3, 2, 1 }), model), "a quad failed to load");
+		CHECK(model.indices == std::vector<uint32_t>({ 0, 1, 2, 0, 1, 2, 0, 2, 3, 3, 2, 1 }), "the quad was not fanned");
+
+		CHECK(ReadFaces("ushort short", Face<UINT16, INT16>({ 0, 1, 2 }) + Face<UINT16, INT16>({ 1, 2, 3 }) + Face<UINT16, INT16>({ 3, 2, 0 }), model), "short triangles failed to load");
+		CHECK(model.indices == std::vector<uint32_t>({ 0, 1, 2, 1, 2, 3, 3, 2, 0 }), "short triangles read wrong");
+
+		CHECK(!ReadFaces("uchar int", Face<UINT8, INT32>({ 0, 1, 2 }) + Face<UINT8, INT32>({ 0, -1, 2 }) + Face<UINT8, INT32>({ 3, 2, 0 }), model), "a negative index was accepted");
+		CHECK(!ReadFaces("uchar uint", Face<UINT8, UINT32>({ 0, 1, 2 }) + Face<UINT8, UINT32>({ 0, 4, 2 }) + Face<UINT8, UINT32>({ 3, 2, 0 }), model), "an index past the vertices was accepted");
+		CHECK(!ReadFaces("uchar short", Face<UINT8, INT16>({ 0, 1, 2 }) + Face<UINT8, INT16>({ 0, -3, 2 }) + Face<UINT8, INT16>({ 3, 2, 0 }), model), "a negative short index was accepted");
+		CHECK(!ReadFaces("uchar int", Face<UINT8, INT32>({ 0, 1, 2 }) + Face<UINT8, INT32>({ 0, 1, 2, -1 }) + Face<UINT8, INT32>({ 3, 2, 0 }), model), "a negative index in a quad was accepted");
+	}
+}
+
+int main()
+{
+	TestPropertyTypes();
+	TestLargeUnsigned();
+	TestFaces();
+
+	return Test::Finish("PlyLoaderTests");
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "RingAllocator.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Range
+	{
+		uint64_t begin;
+		uint64_t end;
+		uint64_t fenceValue;
+	};
+
+	bool Overlaps(const std::vector<Range>& ranges, uint64_t begin, uint64_t end)
+	{
+		for (const Range& range : ranges)
+		{
+			if (begin < range.end && range.begin < end) return true;
+		}
+		return false;
+	}
+
+	uint64_t CountBytes(const std::vector<Range>& ranges)
+	{
+		uint64_t bytes = 0;
+		for (const Range& range : ranges) bytes += range.end - range.begin;
+		return bytes;
+	}
+
+	void TestWholeRing()
+	{
+		// An empty ring takes its whole capacity, and not a byte more
+		RingAllocator ring(4096);
+		uint64_t offset = 1;
+		CHECK(ring.Allocate(4096, 256, offset) && offset == 0, "offset %llu", static_cast<unsigned long long>(offset));
+		CHECK(!ring.Allocate(1, 1, offset), "a full ring handed out another byte");
+		CHECK(ring.GetPendingFence() == 0, "nothing submitted yet, but fence %llu is pending", static_cast<unsigned long long>(ring.GetPendingFence()));
+
+		ring.Submit(1);
+		CHECK(ring.GetPendingFence() == 1, "pending fence %llu", static_cast<unsigned long long>(ring.GetPendingFence()));
+		ring.Retire(1);
+		CHECK(ring.GetUsed() == 0, "%llu bytes still used", static_cast<unsigned long long>(ring.GetUsed()));
+		CHECK(!ring.Allocate(4097, 1, offset), "allocated more than the capacity");
+		CHECK(ring.Allocate(4096, 1, offset) && offset == 0, "offset %llu", static_cast<unsigned long long>(offset));
+
+		// Bad alignments and empty ranges are refused
+		RingAllocator other(4096);
+		CHECK(!other.Allocate(16, 0, offset), "alignment 0 accepted");
+		CHECK(!other.Allocate(16, 48, offset), "alignment 48 accepted");
+		CHECK(!other.Allocate(0, 16, offset), "empty range accepted");
+	}
+
+	void TestWrap()
+	{
+		// The range that does not fit before the end starts again at zero once the front has retired, and the skipped
+		// tail is counted as used until its submission retires
+		RingAllocator ring(1000);
+		uint64_t offset = 0;
+		CHECK(ring.Allocate(400, 1, offset) && offset == 0, "offset %llu", static_cast<unsigned long long>(offset));
+		ring.Submit(1);
+		CHECK(ring.Allocate(500, 1, offset) && offset == 400, "offset %llu", static_cast<unsigned long long>(offset));
+		ring.Submit(2);
+		CHECK(!ring.Allocate(200, 1, offset), "allocated over live bytes");
+
+		ring.Retire(1);
+		CHECK(ring.Allocate(200, 64, offset) && offset == 0, "offset %llu", static_cast<unsigned long long>(offset));
+		CHECK(ring.GetUsed() == 500 + 100 + 200, "used %llu", static_cast<unsigned long long>(ring.GetUsed()));
+		CHECK(ring.GetOpenBytes() == 300, "open %llu", static_cast<unsigned long long>(ring.GetOpenBytes()));
+		CHECK(!ring.Allocate(300, 1, offset), "allocated over the submission waiting for fence 2");
+	}
+
+	void TestRandomized()
+	{
+		// Random sizes, alignments, submissions and out of step retirement, checked against a model of the live ranges
+		const uint64_t capacity = 1 << 20;
+		RingAllocator ring(capacity);
+		std::mt19937_64 random(7);
+		std::vector<Range> open;
+		std::vector<Range> live;
+		uint64_t fenceValue = 0;
+		uint64_t completed = 0;
+		uint64_t previousOffset = 0;
+		size_t wraps = 0;
+		size_t failures = 0;
+
+		for (int step = 0; step < 200000; step++)
+		{
+			const int action = static_cast<int>(random() % 10);
+			if (action < 6)
+			{
+				const uint64_t size = 1 + random() % ((random() % 8 == 0) ? capacity / 2 : 20000);
+				const uint64_t alignment = 1ull << (random() % 10);
+				uint64_t offset = 0;
+				if (ring.Allocate(size, alignment, offset))
+				{
+					CHECK(offset % alignment == 0, "offset %llu is not aligned to %llu", static_cast<unsigned long long>(offset), static_cast<unsigned long long>(alignment));
+					CHECK(offset + size <= capacity, "range %llu + %llu runs past the end", static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size));
+					CHECK(!Overlaps(live, offset, offset + size) && !Overlaps(open, offset, offset + size), "range %llu + %llu overlaps a live range", static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size));
+
+					if (offset < previousOffset) wraps++;
+					previousOffset = offset;
+					open.push_back(Range{ offset, offset + size, 0 });
+				}
+				else
+				{
+					failures++;
+					CHECK(!live.empty() || !open.empty(), "an empty ring refused %llu bytes", static_cast<unsigned long long>(size));
+				}
+			}
+			else if (action < 8)
+			{
+				fenceValue++;
+				ring.Submit(fenceValue);
+				for (Range& range : open)
+				{
+					range.fenceValue = fenceValue;
+					live.push_back(range);
+				}
+				open.clear();
+			}
+			else
+			{
+				if (completed < fenceValue) completed += 1 + random() % (fenceValue - completed);
+				ring.Retire(completed);
+				live.erase(std::remove_if(live.begin(), live.end(), [&](const Range& range) { return range.fenceValue <= completed; }), live.end());
+				if (live.empty() && open.empty()) CHECK(ring.GetUsed() == 0, "%llu bytes used with nothing live", static_cast<unsigned long long>(ring.GetUsed()));
+			}
+
+			const uint64_t liveBytes = CountBytes(live) + CountBytes(open);
+			CHECK(ring.GetUsed() >= liveBytes && ring.GetUsed() <= capacity, "used %llu with %llu live bytes", static_cast<unsigned long long>(ring.GetUsed()), static_cast<unsigned long long>(liveBytes));
+		}
+
+		CHECK(wraps > 100 && failures > 100, "only %zu wraps and %zu failures, the trace does not cover the ring", wraps, failures);
+	}
+}
+
+int main()
+{
+	TestWholeRing();
+	TestWrap();
+	TestRandomized();
+	return Test::Finish("RingAllocatorTests");
+}
\ No newline at end of file
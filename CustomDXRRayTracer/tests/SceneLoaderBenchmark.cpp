@@ -0,0 +1,66 @@
+#include "SceneLoader.h"
+#include "Utils.h"
+
+#include <cmath>
+
+// Loads a generated scene of a million placements spread over a few meshes of one small OBJ, so nearly all of the time
+// is spent reading instance lines. Usage: SceneLoaderBenchmark [placement count]
+int main(int argc, char** argv)
+{
+	const size_t placementCount = (argc > 1) ? static_cast<size_t>(atoll(argv[1])) : 1000000;
+	const int meshCount = 16;
+
+	Utils::OutputFile obj;
+	const std::string triangle = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+	if (!obj.Open("scene_benchmark/triangle.obj") || !obj.Write(triangle.data(), triangle.size()) || !obj.Commit())
+	{
+		printf("Failed to write the mesh\n");
+		return 1;
+	}
+
+	std::string scene;
+	scene.reserve(placementCount * 80);
+	char line[256];
+	for (int mesh = 0; mesh < meshCount; mesh++)
+	{
+		snprintf(line, sizeof(line), "mesh m%d scene_benchmark/triangle.obj\n", mesh);
+		scene += line;
+	}
+	for (size_t i = 0; i < placementCount; i++)
+	{
+		const float angle = i * 0.001f;
+		snprintf(line, sizeof(line), "instance m%d %.6f 0 %.6f %.3f 0 1 0 %.3f %.6f 0 %.6f %.3f\n", static_cast<int>(i % meshCount), cosf(angle), sinf(angle), (i % 1000) * 2.5f, (i / 1000) * 0.01f, -sinf(angle), cosf(angle), (i / 1000) * 2.5f);
+		scene += line;
+	}
+
+	Utils::OutputFile file;
+	if (!file.Open("scene_benchmark/benchmark.scene") || !file.Write(scene.data(), scene.size()) || !file.Commit())
+	{
+		printf("Failed to write the scene\n");
+		return 1;
+	}
+
+	printf("%zu placements of %d meshes, %.1f MB, %u workers\n", placementCount, meshCount, scene.size() / 1048576.0, Utils::GetWorkerCount());
+
+	// Best of three; the first run also builds the mesh cache entry for the OBJ
+	float best = 0.f;
+	size_t instanceCount = 0;
+	for (int run = 0; run < 3; run++)
+	{
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<Material> materials;
+		Utils::Timer timer;
+		SceneLoader::LoadScene("scene_benchmark/benchmark.scene", models, materials);
+		const float milliseconds = timer.ElapsedMillis();
+		if (run == 0 || milliseconds < best) best = milliseconds;
+
+		instanceCount = 0;
+		for (const std::shared_ptr<Model>& model : models) instanceCount += model->instances.size();
+	}
+
+	printf("  LoadScene  %8.1f ms, %6.1f M placements/s, %6.1f MB/s\n", best, placementCount / (best * 1000.0), scene.size() / 1048576.0 / (best / 1000.0));
+	if (instanceCount != placementCount) printf("Loaded %zu instances\n", instanceCount);
+
+	remove("scene_benchmark/benchmark.scene");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "SceneLoader.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <cmath>
+
+namespace
+{
+	const char* const Identity = "1 0 0 0 0 1 0 0 0 0 1 0";
+
+	void WriteBytes(const std::string& path, const std::string& bytes)
+	{
+		Utils::OutputFile file;
+		CHECK(file.Open(path) && file.Write(bytes.data(), bytes.size()) && file.Commit(), "writing %s failed", path.c_str());
+	}
+
+	// One triangle placed by two nodes, translated along x and along y
+	void WriteGlb(const std::string& path)
+	{
+		const float positions[] = { 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+		const uint32_t indices[] = { 0, 2, 1 };
+		std::string json =
+			"{\"asset\":{\"version\":\"2.0\"},\"scenes\":[{\"nodes\":[0,1]}],"
+			"\"nodes\":[{\"mesh\":0,\"translation\":[1,0,0]},{\"mesh\":0,\"translation\":[0,2,0]}],"
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1}]}],"
+			"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":12}],"
+			"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},{\"bufferView\":1,\"componentType\":5125,\"count\":3,\"type\":\"SCALAR\"}]}";
+		json.resize((json.size() + 3) & ~static_cast<size_t>(3), ' ');
+
+		std::string bin(reinterpret_cast<const char*>(positions), sizeof(positions));
+		bin.append(reinterpret_cast<const char*>(indices), sizeof(indices));
+
+		const UINT32 header[] = { 0x46546C67, 2, static_cast<UINT32>(12 + 8 + json.size() + 8 + bin.size()) };
+		const UINT32 jsonChunk[] = { static_cast<UINT32>(json.size()), 0x4E4F534A };
+		const UINT32 binChunk[] = { static_cast<UINT32>(bin.size()), 0x004E4942 };
+		std::string file(reinterpret_cast<const char*>(header), sizeof(header));
+		file.append(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+		file += json;
+		file.append(reinterpret_cast<const char*>(binChunk), sizeof(binChunk));
+		file += bin;
+		WriteBytes(path, file);
+	}
+
+	void WriteSources()
+	{
+		WriteBytes("materials/scene_test.mtl", "newmtl red\nKd 1 0 0\nnewmtl blue\nKd 0 0 1\n");
+		WriteBytes("scene_test/triangle.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+		WriteGlb("scene_test/nodes.glb");
+	}
+
+	std::string Translation(float x, float y, float z)
+	{
+		char text[128];
+		snprintf(text, sizeof(text), "1 0 0 %g 0 1 0 %g 0 0 1 %g", x, y, z);
+		return text;
+	}
+
+	bool HasTranslation(const std::vector<DirectX::XMFLOAT3X4>& instances, float x, float y, float z)
+	{
+		for (const DirectX::XMFLOAT3X4& m : instances)
+		{
+			if (fabsf(m.m[0][3] - x) < 1e-5f && fabsf(m.m[1][3] - y) < 1e-5f && fabsf(m.m[2][3] - z) < 1e-5f) return true;
+		}
+		return false;
+	}
+
+	void TestScene()
+	{
+		// Meshes a and b name one file, b through a path that only matches once normalized, so it must not be opened
+		// on its own. Meshes c and d draw the same file with a scene material, and g is a GLB with two nodes.
+		WriteBytes("scene_test/test.scene",
+			"mtllib scene_test.mtl\n"
+			"mesh a scene_test/triangle.obj\n"
+			"mesh b Scene_Test\\Triangle.OBJ\n"
+			"mesh c scene_test/triangle.obj blue\r\n"
+			"mesh d scene_test/triangle.obj blue\n"
+			"mesh g scene_test/nodes.glb\n"
+			"mesh unused scene_test/missing.obj\n"
+			"# placements\n"
+			"instance a " + Translation(1.f, 0.f, 0.f) + "\n"
+			"  instance b " + Translation(2.f, 0.f, 0.f) + "\n"
+			"instance c " + Translation(3.f, 0.f, 0.f) + "\r\n"
+			"instance d 1e0 0 0 4 0 1 0 0 0 0 1 -0.5\n"
+			"instance g " + Translation(0.f, 0.f, 5.f) + "\n"
+			"instance g " + Translation(0.f, 0.f, 10.f) + "\n");
+
+		std::vector<std::shared_ptr<Model>> models;
+		std::vector<Material> materials;
+		SceneLoader::LoadScene("scene_test/test.scene", models, materials);
+
+		// The scene's two materials come first, then the OBJ's default, then the GLB's
+		CHECK(models.size() == 3, "%zu models", models.size());
+		CHECK(materials.size() == 4 && materials[0].name == "red" && materials[1].name == "blue", "%zu materials", materials.size());
+		if (models.size() != 3 || materials.size() != 4) return;
+
+		const Model* shared = nullptr;
+		const Model* blue = nullptr;
+		const Model* nodes = nullptr;
+		for (const std::shared_ptr<Model>& model : models)
+		{
+			if (model->submeshes.empty()) continue;
+			if (model->submeshes[0].materialIndex == 1) blue = model.get();
+			else if (model->instances.size() == 4) nodes = model.get();
+			else shared = model.get();
+		}
+		CHECK(shared && blue && nodes, "the models are not one per file and material");
+		if (!shared || !blue || !nodes) return;
+
+		CHECK(shared->instances.size() == 2 && HasTranslation(shared->instances, 1.f, 0.f, 0.f) && HasTranslation(shared->instances, 2.f, 0.f, 0.f), "a and b have %zu placements", shared->instances.size());
+		CHECK(shared->submeshes[0].materialIndex == 2, "the file's own material is %u", shared->submeshes[0].materialIndex);
+		CHECK(blue->instances.size() == 2 && HasTranslation(blue->instances, 3.f, 0.f, 0.f) && HasTranslation(blue->instances, 4.f, 0.f, -0.5f), "c and d have %zu placements", blue->instances.size());
+		CHECK(blue->IndexCount() == shared->IndexCount() && memcmp(blue->VertexData(), shared->VertexData(), shared->VertexCount() * sizeof(Vertex)) == 0, "the material override changed the geometry");
+
+		// Each placement repeats both nodes; glTF x lands in the renderer's z
+		CHECK(HasTranslation(nodes->instances, 0.f, 0.f, 6.f) && HasTranslation(nodes->instances, 0.f, 2.f, 5.f) && HasTranslation(nodes->instances, 0.f, 0.f, 11.f) && HasTranslation(nodes->instances, 0.f, 2.f, 10.f), "GLB nodes were not composed with the placements");
+		CHECK(nodes->submeshes[0].materialIndex == 3, "the GLB's material is %u", nodes->submeshes[0].materialIndex);
+	}
+
+	void TestErrors()
+	{
+		const std::string header = "mtllib scene_test.mtl\nmesh a scene_test/triangle.obj\n";
+		const std::string bad[] =
+		{
+			header + "instance a 1 0 0 0 0 1 0 0 0 0 1 x\n",
+			header + "instance a 1 0 0 0 0 1 0 0 0 0 1 0x\n",
+			header + "instance a 1 0 0 0 0 1 0 0 0 0 1\n",
+			header + "instance a " + Identity + " 7\n",
+			header + "instance a 1 0 0 0 0 1 0 0 0 0 1 1e\n",
+			header + "instance " + Identity + "\n",
+			header + "instance z " + Identity + "\n",
+			header + "mesh a scene_test/triangle.obj\n",
+			header + "mesh b\n",
+			header + "mesh b scene_test/triangle.obj red extra\n",
+			header + "mesh b scene_test/triangle.obj purple\n",
+			header + "mtllib scene_missing.mtl\n",
+			header + "mesh b scene_test/missing.obj\ninstance b " + Identity + "\n",
+		};
+
+		for (const std::string& text : bad)
+		{
+			WriteBytes("scene_test/bad.scene", text);
+
+			bool threw = false;
+			try
+			{
+				std::vector<std::shared_ptr<Model>> models;
+				std::vector<Material> materials;
+				SceneLoader::LoadScene("scene_test/bad.scene", models, materials);
+			}
+			catch (const std::exception&)
+			{
+				threw = true;
+			}
+			CHECK(threw, "loaded \"%s\"", text.substr(header.size(), text.size() - header.size() - 1).c_str());
+		}
+
+		remove("scene_test/bad.scene");
+	}
+}
+
+int main()
+{
+	WriteSources();
+	TestScene();
+	TestErrors();
+	return Test::Finish("SceneLoaderTests");
+}
\ No newline at end of file
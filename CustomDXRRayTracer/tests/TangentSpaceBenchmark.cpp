@@ -0,0 +1,69 @@
+#include "TangentSpace.h"
+#include "Utils.h"
+
+#include <cmath>
+#include <random>
+
+// Generates normals and tangents for a 10M-triangle heightfield with one worker and with the default pool, and checks
+// both give the same bits. Usage: TangentSpaceBenchmark [triangle count]
+namespace
+{
+	Model MakeTerrain(uint32_t size)
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> bump(0.f, 0.3f);
+
+		Model model;
+		model.vertices.resize(static_cast<size_t>(size) * size);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				// Ridges every 64 columns crease, and the texcoords mirror every 256 columns
+				Vertex& vertex = model.vertices[static_cast<size_t>(y) * size + x];
+				vertex.position = DirectX::XMFLOAT3(static_cast<float>(x), bump(random) + ((x % 64) == 0 ? 3.f : 0.f), static_cast<float>(y));
+				vertex.uv = DirectX::XMFLOAT2(((x / 256) & 1) ? 1.f - (x % 256) / 256.f : (x % 256) / 256.f, static_cast<float>(y) / size);
+			}
+		}
+
+		model.indices.reserve(static_cast<size_t>(size - 1) * (size - 1) * 6);
+		for (uint32_t y = 0; y + 1 < size; y++)
+		{
+			for (uint32_t x = 0; x + 1 < size; x++)
+			{
+				const uint32_t i = y * size + x;
+				model.indices.insert(model.indices.end(), { i, i + size, i + 1, i + 1, i + size, i + size + 1 });
+			}
+		}
+		return model;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t triangleCount = (argc > 1) ? static_cast<size_t>(atoll(argv[1])) : 10000000;
+	const Model source = MakeTerrain(static_cast<uint32_t>(sqrt(triangleCount / 2.0)) + 1);
+
+	Model single = source;
+	Utils::SetWorkerCount(1);
+	const TangentSpaceStats singleStats = TangentSpace::Generate(single);
+
+	Model pooled = source;
+	Utils::SetWorkerCount(0);
+	const TangentSpaceStats pooledStats = TangentSpace::Generate(pooled);
+
+	const double triangles = source.IndexCount() / 3.0;
+	printf("%.0f triangles, %zu -> %zu vertices\n", triangles, pooledStats.inputVertices, pooledStats.outputVertices);
+	printf("  1 worker    %8.1f ms  %6.1f M triangles/s\n", singleStats.milliseconds, triangles / (singleStats.milliseconds * 1000.0));
+	printf("  %u workers  %8.1f ms  %6.1f M triangles/s  (%.1fx)\n", Utils::GetWorkerCount(), pooledStats.milliseconds, triangles / (pooledStats.milliseconds * 1000.0), singleStats.milliseconds / pooledStats.milliseconds);
+
+	const bool same = single.indices == pooled.indices && single.frames.size() == pooled.frames.size() &&
+		memcmp(single.frames.data(), pooled.frames.data(), single.frames.size() * sizeof(VertexFrame)) == 0;
+	if (!same)
+	{
+		printf("The worker counts disagree\n");
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "TangentSpace.h"
+#include "Test.h"
+#include "Utils.h"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+	// A bumpy heightfield with a ridge sharper than the crease angle and mirrored texcoords on its right half, so
+	// vertices split on both creases and handedness, plus a fan around one vertex with more corners than the exact
+	// smoothing handles
+	Model MakeTerrain(uint32_t size)
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> bump(0.f, 0.3f);
+
+		Model model;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				const float ridge = (x == size / 3) ? 3.f : 0.f;
+				const float u = static_cast<float>(x) / size;
+				Vertex vertex;
+				vertex.position = DirectX::XMFLOAT3(static_cast<float>(x), bump(random) + ridge, static_cast<float>(y));
+				vertex.uv = DirectX::XMFLOAT2((x < size / 2) ? u : 1.f - u, static_cast<float>(y) / size);
+				model.vertices.push_back(vertex);
+			}
+		}
+
+		for (uint32_t y = 0; y + 1 < size; y++)
+		{
+			for (uint32_t x = 0; x + 1 < size; x++)
+			{
+				const uint32_t i = y * size + x;
+				model.indices.insert(model.indices.end(), { i, i + size, i + 1, i + 1, i + size, i + size + 1 });
+			}
+		}
+
+		const uint32_t center = static_cast<uint32_t>(model.vertices.size());
+		Vertex tip;
+		tip.position = DirectX::XMFLOAT3(0.f, 10.f, -10.f);
+		tip.uv = DirectX::XMFLOAT2(0.5f, 0.5f);
+		model.vertices.push_back(tip);
+
+		const uint32_t fanCount = 600;
+		for (uint32_t i = 0; i < fanCount; i++)
+		{
+			const float angle = 2.f * DirectX::XM_PI * i / fanCount;
+			Vertex rim;
+			rim.position = DirectX::XMFLOAT3(cosf(angle) * 5.f, 10.f + sinf(angle * 7.f), -10.f + sinf(angle) * 5.f);
+			rim.uv = DirectX::XMFLOAT2(0.5f + cosf(angle) * 0.5f, 0.5f + sinf(angle) * 0.5f);
+			model.vertices.push_back(rim);
+		}
+		for (uint32_t i = 0; i < fanCount; i++)
+		{
+			model.indices.insert(model.indices.end(), { center, center + 1 + (i + 1) % fanCount, center + 1 + i });
+		}
+		return model;
+	}
+
+	template<typename T>
+	bool SameBytes(const std::vector<T>& lhs, const std::vector<T>& rhs)
+	{
+		return lhs.size() == rhs.size() && (lhs.empty() || memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(T)) == 0);
+	}
+
+	void TestDeterminism()
+	{
+		// About 400K triangles, several chunks of work; every worker count must give the same bits
+		const Model source = MakeTerrain(450);
+
+		Model reference;
+		for (UINT workerCount : { 1u, 2u, 3u, 8u })
+		{
+			Utils::SetWorkerCount(workerCount);
+
+			Model model = source;
+			const TangentSpaceStats stats = TangentSpace::Generate(model);
+			CHECK(stats.outputVertices > stats.inputVertices, "nothing was split with %u workers", workerCount);
+
+			if (workerCount == 1)
+			{
+				reference = model;
+				continue;
+			}
+
+			CHECK(SameBytes(model.vertices, reference.vertices), "vertices differ with %u workers", workerCount);
+			CHECK(model.indices == reference.indices, "indices differ with %u workers", workerCount);
+			CHECK(SameBytes(model.frames, reference.frames), "frames differ with %u workers", workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestFlatQuad()
+	{
+		// A quad facing +y with u along +x: one frame per vertex, no split
+		Model model;
+		const float corners[4][2] = { { 0.f, 0.f }, { 1.f, 0.f }, { 0.f, 1.f }, { 1.f, 1.f } };
+		for (const auto& corner : corners)
+		{
+			Vertex vertex;
+			vertex.position = DirectX::XMFLOAT3(corner[0], 0.f, corner[1]);
+			vertex.uv = DirectX::XMFLOAT2(corner[0], corner[1]);
+			model.vertices.push_back(vertex);
+		}
+		model.indices = { 0, 2, 1, 1, 2, 3 };
+
+		const TangentSpaceStats stats = TangentSpace::Generate(model);
+		CHECK(stats.outputVertices == 4 && model.frames.size() == 4, "the quad was split into %zu vertices", stats.outputVertices);
+		for (const VertexFrame& frame : model.frames)
+		{
+			CHECK(fabsf(frame.normal.y - 1.f) < 1e-5f && fabsf(frame.tangent.x - 1.f) < 1e-5f, "frame normal (%f %f %f) tangent (%f %f %f)", frame.normal.x, frame.normal.y, frame.normal.z, frame.tangent.x, frame.tangent.y, frame.tangent.z);
+		}
+	}
+}
+
+int main()
+{
+	TestDeterminism();
+	TestFlatQuad();
+
+	return Test::Finish("TangentSpaceTests");
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+
+// A failed CHECK prints where it failed and why, and the test goes on to its next check. Finish reports the outcome and
+// gives the exit code ctest reads.
+#define CHECK(condition, ...) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			Test::Failures()++; \
+			printf("%s(%d): check failed: %s: ", __FILE__, __LINE__, #condition); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+namespace Test
+{
+	inline int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline int Finish(const char* name)
+	{
+		if (Failures() > 0)
+		{
+			printf("%s: %d checks failed\n", name, Failures());
+			return 1;
+		}
+
+		printf("%s: all checks passed\n", name);
+		return 0;
+	}
+}
\ No newline at end of file
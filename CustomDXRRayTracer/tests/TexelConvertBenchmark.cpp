@@ -0,0 +1,74 @@
+#include "TexelConvert.h"
+#include "Utils.h"
+
+#include <random>
+
+// Converts a 4096 x 4096 texture from every channel count to RGBA8, and RGBA8 to RGBA16F, with each kernel level the CPU
+// supports. Usage: TexelConvertBenchmark [width] [height]
+namespace
+{
+	const char* LevelNames[] = { "scalar", "SSSE3", "AVX2" };
+
+	// Best of three, so page faults on the first pass do not count
+	template<typename Convert>
+	float Time(const Convert& convert)
+	{
+		float best = 0.f;
+		for (int run = 0; run < 3; run++)
+		{
+			Utils::Timer timer;
+			convert();
+			const float milliseconds = timer.ElapsedMillis();
+			if (run == 0 || milliseconds < best) best = milliseconds;
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const UINT width = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 4096;
+	const UINT height = (argc > 2) ? static_cast<UINT>(atoi(argv[2])) : 4096;
+	const size_t texelCount = static_cast<size_t>(width) * height;
+
+	std::mt19937 random(5);
+	std::vector<UINT8> source(texelCount * 4);
+	for (UINT8& byte : source) byte = static_cast<UINT8>(random());
+	std::vector<UINT8> rgba(texelCount * 4);
+	std::vector<UINT16> halves(texelCount * 4);
+
+	printf("%ux%u texels, %u workers, M texels/s per level\n", width, height, Utils::GetWorkerCount());
+	printf("  %-16s", "");
+	for (const char* name : LevelNames) printf("%10s%6s", name, "");
+	printf("\n");
+
+	const char* rows[] = { "grey", "grey + alpha", "RGB", "RGBA copy", "RGBA16F", "RGBA16F sRGB" };
+	for (int row = 0; row < 6; row++)
+	{
+		printf("  %-16s", rows[row]);
+		float scalar = 0.f;
+		for (KernelLevel level : { KernelLevel::Scalar, KernelLevel::Ssse3, KernelLevel::Avx2 })
+		{
+			TexelConvert::SetKernelLevel(level);
+			if (TexelConvert::GetKernelLevel() != level)
+			{
+				printf("%10s%6s", "-", "");
+				continue;
+			}
+
+			const float milliseconds = Time([&]()
+			{
+				if (row < 4) TexelConvert::ToRgba8(source.data(), row + 1, rgba.data(), width, height);
+				else TexelConvert::ToRgba16F(source.data(), halves.data(), width, height, row == 5);
+			});
+
+			if (level == KernelLevel::Scalar) scalar = milliseconds;
+			printf("%10.0f", texelCount / (milliseconds * 1000.0));
+			if (level == KernelLevel::Scalar) printf("%6s", "");
+			else printf(" %4.1fx", scalar / milliseconds);
+		}
+		printf("\n");
+	}
+
+	return 0;
+}
\ No newline at end of file
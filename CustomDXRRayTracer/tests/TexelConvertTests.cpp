@@ -0,0 +1,119 @@
+#include "TexelConvert.h"
+#include "Test.h"
+
+#include <random>
+
+namespace
+{
+	const size_t GuardBytes = 64;
+	const UINT8 Guard = 0xAB;
+
+	const char* LevelNames[] = { "scalar", "SSSE3", "AVX2" };
+
+	struct Size
+	{
+		UINT width;
+		UINT height;
+	};
+
+	// Widths around every vector width leave tails of each length; the last size spans several bands
+	const Size Sizes[] = { { 1, 1 }, { 3, 1 }, { 7, 2 }, { 15, 3 }, { 16, 1 }, { 17, 5 }, { 31, 2 }, { 33, 3 }, { 63, 1 }, { 1021, 300 } };
+
+	std::vector<UINT8> RandomBytes(size_t count, UINT seed)
+	{
+		std::mt19937 random(seed);
+		std::vector<UINT8> bytes(count);
+		for (UINT8& byte : bytes) byte = static_cast<UINT8>(random());
+		return bytes;
+	}
+
+	bool GuardIntact(const UINT8* end)
+	{
+		for (size_t i = 0; i < GuardBytes; i++)
+		{
+			if (end[i] != Guard) return false;
+		}
+		return true;
+	}
+
+	std::vector<UINT8> Expand(const std::vector<UINT8>& source, UINT channels, const Size& size)
+	{
+		const size_t bytes = static_cast<size_t>(size.width) * size.height * 4;
+		std::vector<UINT8> destination(bytes + GuardBytes, Guard);
+		TexelConvert::ToRgba8(source.data(), channels, destination.data(), size.width, size.height);
+		CHECK(GuardIntact(destination.data() + bytes), "%s wrote past %ux%u texels of %u channels", LevelNames[static_cast<int>(TexelConvert::GetKernelLevel())], size.width, size.height, channels);
+		destination.resize(bytes);
+		return destination;
+	}
+
+	std::vector<UINT16> ToHalves(const std::vector<UINT8>& source, const Size& size, bool srgb)
+	{
+		const size_t count = static_cast<size_t>(size.width) * size.height * 4;
+		std::vector<UINT16> destination(count + GuardBytes / 2, (Guard << 8) | Guard);
+		TexelConvert::ToRgba16F(source.data(), destination.data(), size.width, size.height, srgb);
+		CHECK(GuardIntact(reinterpret_cast<const UINT8*>(destination.data() + count)), "%s wrote past %ux%u halves", LevelNames[static_cast<int>(TexelConvert::GetKernelLevel())], size.width, size.height);
+		destination.resize(count);
+		return destination;
+	}
+
+	void TestScalarExpand()
+	{
+		TexelConvert::SetKernelLevel(KernelLevel::Scalar);
+		const std::vector<UINT8> source = { 10, 20, 30, 40, 50, 60, 70, 80 };
+		const Size size = { 2, 1 };
+		CHECK(Expand(source, 1, size) == std::vector<UINT8>({ 10, 10, 10, 255, 20, 20, 20, 255 }), "grey expanded wrong");
+		CHECK(Expand(source, 2, size) == std::vector<UINT8>({ 10, 10, 10, 20, 30, 30, 30, 40 }), "grey and alpha expanded wrong");
+		CHECK(Expand(source, 3, size) == std::vector<UINT8>({ 10, 20, 30, 255, 40, 50, 60, 255 }), "RGB expanded wrong");
+		CHECK(Expand(source, 4, size) == source, "RGBA copied wrong");
+
+		// 0.2 in linear and 1.0 decode exactly; sRGB only applies to colour, never to alpha
+		const std::vector<UINT8> texel = { 51, 255, 0, 51 };
+		CHECK(ToHalves(texel, { 1, 1 }, false) == std::vector<UINT16>({ 0x3266, 0x3C00, 0x0000, 0x3266 }), "linear halves wrong");
+		const std::vector<UINT16> decoded = ToHalves(texel, { 1, 1 }, true);
+		CHECK(decoded[0] < 0x3266 && decoded[1] == 0x3C00 && decoded[2] == 0 && decoded[3] == 0x3266, "sRGB halves wrong: %04x %04x %04x %04x", decoded[0], decoded[1], decoded[2], decoded[3]);
+	}
+
+	void TestLevelsMatchScalar()
+	{
+		// Every level the CPU has must give exactly the scalar kernels' bytes
+		for (KernelLevel level : { KernelLevel::Ssse3, KernelLevel::Avx2 })
+		{
+			TexelConvert::SetKernelLevel(level);
+			if (TexelConvert::GetKernelLevel() != level)
+			{
+				printf("Skipping %s, which this CPU does not support\n", LevelNames[static_cast<int>(level)]);
+				continue;
+			}
+
+			UINT seed = 1;
+			for (const Size& size : Sizes)
+			{
+				for (UINT channels = 1; channels <= 4; channels++)
+				{
+					const std::vector<UINT8> source = RandomBytes(static_cast<size_t>(size.width) * size.height * channels, seed++);
+					TexelConvert::SetKernelLevel(KernelLevel::Scalar);
+					const std::vector<UINT8> expected = Expand(source, channels, size);
+					TexelConvert::SetKernelLevel(level);
+					CHECK(Expand(source, channels, size) == expected, "%s differs from scalar for %ux%u texels of %u channels", LevelNames[static_cast<int>(level)], size.width, size.height, channels);
+				}
+
+				for (bool srgb : { false, true })
+				{
+					const std::vector<UINT8> source = RandomBytes(static_cast<size_t>(size.width) * size.height * 4, seed++);
+					TexelConvert::SetKernelLevel(KernelLevel::Scalar);
+					const std::vector<UINT16> expected = ToHalves(source, size, srgb);
+					TexelConvert::SetKernelLevel(level);
+					CHECK(ToHalves(source, size, srgb) == expected, "%s halves differ from scalar for %ux%u texels%s", LevelNames[static_cast<int>(level)], size.width, size.height, srgb ? " in sRGB" : "");
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestScalarExpand();
+	TestLevelsMatchScalar();
+
+	return Test::Finish("TexelConvertTests");
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "TextureCache.h"
+#include "Utils.h"
+
+#include <random>
+
+// Loads a generated image through LoadTexture with its texture cache entry removed, then again from the cache, for an
+// uncompressed and a BC1 chain. Usage: TextureCacheBenchmark [size]; the image is a size x size 32-bit TGA.
+namespace
+{
+	std::string MakeTga(UINT size)
+	{
+		std::string bytes(18, '\0');
+		bytes[2] = 2;
+		bytes[12] = static_cast<char>(size & 0xFF);
+		bytes[13] = static_cast<char>(size >> 8);
+		bytes[14] = static_cast<char>(size & 0xFF);
+		bytes[15] = static_cast<char>(size >> 8);
+		bytes[16] = 32;
+		bytes[17] = 0x28;
+
+		// Smooth gradients with a little noise, so the block encoder has real work to do
+		std::mt19937 random(20);
+		bytes.reserve(bytes.size() + static_cast<size_t>(size) * size * 4);
+		for (UINT y = 0; y < size; y++)
+		{
+			for (UINT x = 0; x < size; x++)
+			{
+				const char texel[4] = { static_cast<char>((x >> 3) + random() % 8), static_cast<char>((y >> 3) + random() % 8), static_cast<char>(((x + y) >> 4) + random() % 8), static_cast<char>(255) };
+				bytes.append(texel, 4);
+			}
+		}
+		return bytes;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const UINT size = (argc > 1) ? static_cast<UINT>(atoi(argv[1])) : 2048;
+	const std::string tga = MakeTga(size);
+	const UINT8* data = reinterpret_cast<const UINT8*>(tga.data());
+
+	printf("%ux%u texels, %u workers\n", size, size, Utils::GetWorkerCount());
+	printf("  %-8s%12s%12s%12s%12s%12s\n", "format", "cold ms", "decode", "mips", "compress", "warm ms");
+
+	for (TextureCompression compression : { TextureCompression::None, TextureCompression::BC1 })
+	{
+		TextureOptions options;
+		options.compression = compression;
+		options.quality = CompressionQuality::Fast;
+		const UINT64 key = TextureCache::ComputeKey(data, tga.size(), 0, 0, options);
+
+		// Best of three for both, so page faults on the first pass do not count; each cold load starts without the entry
+		TextureLoadStats cold, warm;
+		for (int run = 0; run < 3; run++)
+		{
+			remove(TextureCache::GetCachePath(key).c_str());
+			TextureLoadStats stats;
+			Utils::LoadTexture(data, tga.size(), options, stats);
+			if (stats.cacheHit) printf("Cold load came from the texture cache\n");
+			if (run == 0 || stats.milliseconds < cold.milliseconds) cold = stats;
+		}
+
+		for (int run = 0; run < 3; run++)
+		{
+			TextureLoadStats stats;
+			Utils::LoadTexture(data, tga.size(), options, stats);
+			if (!stats.cacheHit) printf("Warm load did not come from the texture cache\n");
+			if (run == 0 || stats.milliseconds < warm.milliseconds) warm = stats;
+		}
+
+		printf("  %-8s%12.1f%12.1f%12.1f%12.1f%12.2f  (%.0fx)\n", (compression == TextureCompression::None) ? "RGBA8" : "BC1",
+			cold.milliseconds, cold.decodeMilliseconds, cold.mips.milliseconds, cold.compression.milliseconds, warm.milliseconds, cold.milliseconds / warm.milliseconds);
+
+		remove(TextureCache::GetCachePath(key).c_str());
+	}
+
+	const TextureCacheCounters counters = TextureCache::GetCounters();
+	printf("  %u hits, %u misses, %.1f MB mapped, %.1f MB written\n", counters.hits, counters.misses, counters.bytesMapped / 1048576.0, counters.bytesWritten / 1048576.0);
+	return 0;
+}
\ No newline at end of file
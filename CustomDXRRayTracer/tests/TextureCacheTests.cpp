@@ -0,0 +1,165 @@
+#include "MipGenerator.h"
+#include "Test.h"
+#include "TextureCache.h"
+#include "Utils.h"
+
+namespace
+{
+	// An uncompressed 32-bit TGA, stored top row first
+	std::string MakeTga(int width, int height)
+	{
+		std::string bytes(18, '\0');
+		bytes[2] = 2;
+		bytes[12] = static_cast<char>(width & 0xFF);
+		bytes[13] = static_cast<char>(width >> 8);
+		bytes[14] = static_cast<char>(height & 0xFF);
+		bytes[15] = static_cast<char>(height >> 8);
+		bytes[16] = 32;
+		bytes[17] = 0x28;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const char texel[4] = { static_cast<char>(x * 3), static_cast<char>(y * 5), static_cast<char>((x ^ y) * 7), static_cast<char>(255 - x) };
+				bytes.append(texel, 4);
+			}
+		}
+		return bytes;
+	}
+
+	const UINT8* Bytes(const std::string& bytes)
+	{
+		return reinterpret_cast<const UINT8*>(bytes.data());
+	}
+
+	void TestMissThenHit(TextureCompression compression)
+	{
+		const char* name = (compression == TextureCompression::None) ? "RGBA8" : "BC1";
+		const int width = 75, height = 41;
+		const std::string tga = MakeTga(width, height);
+
+		TextureOptions options;
+		options.compression = compression;
+		const UINT64 key = TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, options);
+		remove(TextureCache::GetCachePath(key).c_str());
+
+		// A miss decodes, builds the chain and writes the whole file
+		const TextureCacheCounters before = TextureCache::GetCounters();
+		TextureLoadStats stats;
+		const TextureInfo built = Utils::LoadTexture(Bytes(tga), tga.size(), options, stats);
+		const TextureCacheCounters missed = TextureCache::GetCounters();
+
+		Utils::MappedFile file;
+		CHECK(file.Open(TextureCache::GetCachePath(key)), "%s: the miss wrote no cache file", name);
+		const UINT64 fileSize = file.Size();
+		file.Close();
+
+		std::vector<TextureLevelLayout> levels;
+		const UINT levelCount = MipGenerator::GetMipCount(width, height);
+		const UINT64 size = TextureCache::GetLayout(width, height, levelCount, built.format, levels);
+
+		CHECK(!stats.cacheHit && built.mipLevels == static_cast<int>(levelCount) && !built.mappedPixels, "%s: the first load was not a miss", name);
+		CHECK(missed.misses == before.misses + 1 && missed.hits == before.hits && missed.bytesMapped == before.bytesMapped, "%s: a miss counted %u misses and %u hits", name, missed.misses - before.misses, missed.hits - before.hits);
+		CHECK(missed.bytesWritten - before.bytesWritten == fileSize && fileSize > size, "%s: a miss counted %llu bytes written for a %llu byte file", name, static_cast<unsigned long long>(missed.bytesWritten - before.bytesWritten), static_cast<unsigned long long>(fileSize));
+
+		// A hit maps the file, with every level where GetLayout places it and the padding left as zeros
+		const TextureInfo mapped = Utils::LoadTexture(Bytes(tga), tga.size(), options, stats);
+		const TextureCacheCounters hit = TextureCache::GetCounters();
+		CHECK(stats.cacheHit && mapped.mappedPixels && mapped.pixels.empty() && mapped.mappedSize == size, "%s: the second load mapped %zu bytes, expected %llu", name, mapped.mappedSize, static_cast<unsigned long long>(size));
+		CHECK(hit.hits == missed.hits + 1 && hit.misses == missed.misses && hit.bytesWritten == missed.bytesWritten, "%s: a hit counted %u hits, %u misses", name, hit.hits - missed.hits, hit.misses - missed.misses);
+		CHECK(hit.bytesMapped - missed.bytesMapped == size, "%s: a hit counted %llu bytes mapped, expected %llu", name, static_cast<unsigned long long>(hit.bytesMapped - missed.bytesMapped), static_cast<unsigned long long>(size));
+		CHECK(mapped.width == width && mapped.height == height && mapped.format == built.format && mapped.mipLevels == built.mipLevels && mapped.stride == built.stride, "%s: the hit is %dx%d with %d levels", name, mapped.width, mapped.height, mapped.mipLevels);
+		if (!mapped.mappedPixels || mapped.mappedSize != size) return;
+
+		size_t packed = 0, rowsDiffering = 0, paddingBytes = 0;
+		for (UINT level = 0; level < levelCount; level++)
+		{
+			const TextureLevelLayout& layout = levels[level];
+			CHECK(layout.offset % D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT == 0 && layout.rowPitch % D3D12_TEXTURE_DATA_PITCH_ALIGNMENT == 0 && layout.rowSize <= layout.rowPitch, "%s: level %u is placed at %llu with pitch %u", name, level, static_cast<unsigned long long>(layout.offset), layout.rowPitch);
+
+			for (UINT row = 0; row < layout.rowCount && packed + layout.rowSize <= built.pixels.size(); row++, packed += layout.rowSize)
+			{
+				const UINT8* texels = mapped.mappedPixels + layout.offset + static_cast<size_t>(row) * layout.rowPitch;
+				rowsDiffering += (memcmp(texels, &built.pixels[packed], layout.rowSize) != 0);
+				if (row + 1 < layout.rowCount)
+				{
+					for (UINT i = layout.rowSize; i < layout.rowPitch; i++) paddingBytes += (texels[i] != 0);
+				}
+			}
+		}
+		CHECK(packed == built.pixels.size(), "%s: the layout holds %zu packed bytes of %zu", name, packed, built.pixels.size());
+		CHECK(rowsDiffering == 0 && paddingBytes == 0, "%s: %zu rows differ from the built texture and %zu padding bytes are set", name, rowsDiffering, paddingBytes);
+	}
+
+	void TestKeys()
+	{
+		// Settings that change the GPU form change the key; quality does not matter without compression
+		const std::string tga = MakeTga(8, 8);
+		TextureOptions options;
+		const UINT64 key = TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, options);
+
+		TextureOptions other = options;
+		other.quality = CompressionQuality::High;
+		CHECK(TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, other) == key, "quality changed the key of an uncompressed texture");
+
+		other = options;
+		other.mipFilter = MipFilter::Kaiser;
+		CHECK(TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, other) != key, "the mip filter did not change the key");
+
+		other = options;
+		other.compression = TextureCompression::BC7;
+		const UINT64 compressed = TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, other);
+		other.quality = CompressionQuality::High;
+		CHECK(compressed != key && TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, other) != compressed, "compression settings did not change the key");
+
+		CHECK(TextureCache::ComputeKey(Bytes(tga), tga.size(), 8, 8, options) != key, "raw texels share a key with the encoded file");
+	}
+
+	void TestRejects()
+	{
+		// A missing file is a miss, and so is a cache file cut short, with a foreign FourCC or with the wrong level count
+		const std::string tga = MakeTga(33, 17);
+		TextureOptions options;
+		const UINT64 key = TextureCache::ComputeKey(Bytes(tga), tga.size(), 0, 0, options);
+		const std::string path = TextureCache::GetCachePath(key);
+		remove(path.c_str());
+
+		TextureInfo texture;
+		TextureCacheCounters before = TextureCache::GetCounters();
+		CHECK(!TextureCache::Load(key, texture) && TextureCache::GetCounters().misses == before.misses + 1, "a missing file was not a miss");
+
+		TextureLoadStats stats;
+		Utils::LoadTexture(Bytes(tga), tga.size(), options, stats);
+
+		Utils::MappedFile file;
+		CHECK(file.Open(path), "no cache file was written");
+		const std::string bytes(file.Data(), static_cast<size_t>(file.Size()));
+		file.Close();
+
+		const size_t damage[][2] = { { bytes.size() - 1, 0 }, { 84, 1 }, { 28, 2 } };
+		for (const size_t* d : damage)
+		{
+			std::string damaged = bytes;
+			if (d[1] == 0) damaged.resize(d[0]);
+			else if (d[1] == 1) damaged[d[0]] ^= 0x55;
+			else damaged[d[0]]++;
+
+			Utils::OutputFile output;
+			CHECK(output.Open(path) && output.Write(damaged.data(), damaged.size()) && output.Commit(), "rewriting %s failed", path.c_str());
+
+			before = TextureCache::GetCounters();
+			CHECK(!TextureCache::Load(key, texture) && TextureCache::GetCounters().misses == before.misses + 1, "a cache file damaged at byte %zu was mapped", d[0]);
+		}
+
+		remove(path.c_str());
+	}
+}
+
+int main()
+{
+	TestMissThenHit(TextureCompression::None);
+	TestMissThenHit(TextureCompression::BC1);
+	TestKeys();
+	TestRejects();
+	return Test::Finish("TextureCacheTests");
+}
\ No newline at end of file
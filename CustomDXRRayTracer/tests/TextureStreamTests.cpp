@@ -0,0 +1,208 @@
+#include "LoadQueue.h"
+#include "Test.h"
+#include "TextureStream.h"
+
+#include <random>
+#include <set>
+
+namespace
+{
+	void Sleep(int milliseconds)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+	}
+
+	void TestHandOff()
+	{
+		// Loads of uneven length and size, taken a frame at a time under a byte budget as the render loop does
+		const uint32_t itemCount = 60;
+		const uint64_t budget = 32ull << 20;
+		std::vector<uint32_t> slots(itemCount, 0);
+		std::vector<uint64_t> sizes(itemCount);
+		std::mt19937 random(25);
+		for (uint64_t& size : sizes) size = (random() % 20) << 20;
+
+		LoadQueue queue;
+		queue.Start(itemCount, 3, [&](uint32_t item)
+		{
+			Sleep(static_cast<int>(item % 4));
+			slots[item] = item * 7 + 1;
+			return sizes[item];
+		});
+
+		std::vector<int> taken(itemCount, 0);
+		std::vector<uint32_t> items;
+		int frames = 0;
+		while (!queue.IsFinished() && frames < 10000)
+		{
+			if (queue.Poll(items, budget))
+			{
+				uint64_t bytes = 0;
+				for (uint32_t item : items)
+				{
+					CHECK(item < itemCount, "item %u handed over", item);
+					if (item >= itemCount) continue;
+
+					CHECK(slots[item] == item * 7 + 1, "item %u handed over before its slot was written", item);
+					taken[item]++;
+					bytes += sizes[item];
+				}
+				CHECK(items.size() == 1 || bytes <= budget, "%zu items of %llu bytes in one frame", items.size(), static_cast<unsigned long long>(bytes));
+			}
+
+			frames++;
+			Sleep(1);
+		}
+
+		for (uint32_t item = 0; item < itemCount; item++) CHECK(taken[item] == 1, "item %u handed over %d times", item, taken[item]);
+
+		uint64_t totalBytes = 0;
+		for (uint64_t size : sizes) totalBytes += size;
+		const LoadQueueStats stats = queue.GetStats();
+		CHECK(stats.itemCount == itemCount && stats.bytes == totalBytes && stats.workerCount == 3, "%u items of %llu bytes on %u workers", stats.itemCount, static_cast<unsigned long long>(stats.bytes), stats.workerCount);
+		CHECK(stats.firstMilliseconds <= stats.milliseconds, "first item at %.1f ms, last at %.1f ms", stats.firstMilliseconds, stats.milliseconds);
+
+		// One worker finishes the items in order, and an item over the budget still goes on its own
+		queue.Start(5, 1, [](uint32_t item) { return (item == 2) ? (100ull << 20) : (1ull << 20); });
+		std::vector<uint32_t> order;
+		while (!queue.IsFinished())
+		{
+			if (queue.Poll(items, 4ull << 20))
+			{
+				for (uint32_t item : items) CHECK(items.size() == 1 || item != 2, "the item over budget shares a frame");
+				order.insert(order.end(), items.begin(), items.end());
+			}
+			Sleep(1);
+		}
+		CHECK(order == std::vector<uint32_t>({ 0, 1, 2, 3, 4 }), "%zu items out of order", order.size());
+	}
+
+	void TestErrors()
+	{
+		// A failed load is rethrown once on the polling thread, and the rest still arrive
+		LoadQueue queue;
+		queue.Start(6, 2, [](uint32_t item) -> uint64_t
+		{
+			if (item == 3) throw std::runtime_error("Error: item 3 failed");
+			return 1;
+		});
+
+		int errors = 0;
+		std::set<uint32_t> taken;
+		std::vector<uint32_t> items;
+		for (int frame = 0; frame < 10000 && !queue.IsFinished(); frame++)
+		{
+			try
+			{
+				queue.Poll(items, 16);
+				taken.insert(items.begin(), items.end());
+			}
+			catch (const std::exception& e)
+			{
+				errors++;
+				CHECK(std::string(e.what()) == "Error: item 3 failed", "rethrew \"%s\"", e.what());
+			}
+			Sleep(1);
+		}
+
+		CHECK(errors == 1 && taken.size() == 5 && taken.count(3) == 0, "%d errors rethrown, %zu items taken", errors, taken.size());
+		CHECK(queue.IsFinished(), "not finished once every item is in");
+	}
+
+	void TestWait()
+	{
+		// Wait hands items over one at a time and returns false once all are taken
+		LoadQueue queue;
+		queue.Start(8, 3, [](uint32_t item) -> uint64_t
+		{
+			Sleep(static_cast<int>(item % 3));
+			return item;
+		});
+
+		std::set<uint32_t> taken;
+		uint32_t item = 0;
+		while (queue.Wait(item)) taken.insert(item);
+		CHECK(taken.size() == 8 && queue.IsFinished(), "Wait took %zu items", taken.size());
+		CHECK(!queue.Wait(item), "Wait returned an item after all were taken");
+
+		// An empty queue is finished at once
+		queue.Start(0, 4, [](uint32_t) -> uint64_t { return 0; });
+		CHECK(queue.IsFinished() && !queue.Wait(item) && queue.GetStats().workerCount == 0, "empty queue is not finished");
+	}
+
+	void TestStop()
+	{
+		// Stop with work queued returns once the loads in progress are done and drops the rest
+		std::atomic<uint32_t> started{ 0 }, finished{ 0 };
+		LoadQueue queue;
+		queue.Start(50, 2, [&](uint32_t) -> uint64_t
+		{
+			started++;
+			Sleep(20);
+			finished++;
+			return 1;
+		});
+
+		Sleep(5);
+		queue.Stop();
+		CHECK(started == finished, "Stop returned with %u loads started and %u finished", started.load(), finished.load());
+		CHECK(finished < 50 && queue.GetStats().itemCount == finished, "%u loads ran after Stop", finished.load());
+		CHECK(!queue.IsFinished(), "a stopped queue with dropped items says it is finished");
+
+		// The queue starts again after a Stop
+		std::vector<uint32_t> items;
+		queue.Start(4, 2, [](uint32_t) -> uint64_t { return 1; });
+		size_t taken = 0;
+		while (!queue.IsFinished())
+		{
+			if (queue.Poll(items, 100)) taken += items.size();
+			Sleep(1);
+		}
+		CHECK(taken == 4, "%zu items after a restart", taken);
+	}
+
+	void TestTextureStream()
+	{
+		// Materials without a texture load as plain white; one naming a missing file fails and is rethrown
+		std::vector<TextureRequest> requests(6);
+		for (UINT i = 0; i < requests.size(); i++) requests[i].index = i * 3 + 1;
+		requests[4].source.texturePath = "texture_stream_test/missing.png";
+
+		TextureStream stream;
+		stream.Start(requests, TextureOptions(), 2);
+
+		std::vector<int> slots(requests.size() * 3, 0);
+		int errors = 0;
+		std::vector<StreamedTexture> textures;
+		for (int frame = 0; frame < 10000 && !stream.IsFinished(); frame++)
+		{
+			try
+			{
+				stream.Poll(textures);
+				for (const StreamedTexture& texture : textures)
+				{
+					CHECK(texture.index < slots.size() && texture.texture.width > 0 && TextureStream::GetBytes(texture.texture) > 0, "texture for slot %u is empty", texture.index);
+					if (texture.index < slots.size()) slots[texture.index]++;
+				}
+			}
+			catch (const std::exception&)
+			{
+				errors++;
+			}
+			Sleep(1);
+		}
+
+		for (UINT i = 0; i < requests.size(); i++) CHECK(slots[requests[i].index] == ((i == 4) ? 0 : 1), "slot %u swapped %d times", requests[i].index, slots[requests[i].index]);
+		CHECK(errors == 1 && stream.GetStats().textureCount == 5, "%d errors, %u textures", errors, stream.GetStats().textureCount);
+	}
+}
+
+int main()
+{
+	TestHandOff();
+	TestErrors();
+	TestWait();
+	TestStop();
+	TestTextureStream();
+	return Test::Finish("TextureStreamTests");
+}
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "Test.h"
+#include "TextureCache.h"
+#include "TileFile.h"
+#include "TileResidency.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	struct TextureShape
+	{
+		UINT width;
+		UINT height;
+		UINT tileWidth;
+		UINT tileHeight;
+		UINT levelCount;
+	};
+
+	UINT GetTilesX(const TextureShape& shape, UINT level)
+	{
+		return ((std::max)(shape.width >> level, 1u) + shape.tileWidth - 1) / shape.tileWidth;
+	}
+
+	UINT GetTilesY(const TextureShape& shape, UINT level)
+	{
+		return ((std::max)(shape.height >> level, 1u) + shape.tileHeight - 1) / shape.tileHeight;
+	}
+
+	bool IsResident(const TileResidency& residency, UINT tile)
+	{
+		return residency.GetSlot(tile) != TileResidency::InvalidSlot;
+	}
+
+	// The map by its definition: the finest level whose tile and every coarser one over it are resident
+	void CheckMinLevelMap(const TileResidency& residency, UINT texture, const TextureShape& shape)
+	{
+		std::vector<UINT> map;
+		residency.GetMinLevelMap(texture, map);
+		CHECK(map.size() == GetTilesX(shape, 0) * GetTilesY(shape, 0), "map of texture %u has %zu entries", texture, map.size());
+		if (map.size() != GetTilesX(shape, 0) * GetTilesY(shape, 0)) return;
+
+		for (UINT y = 0; y < GetTilesY(shape, 0); y++)
+		{
+			for (UINT x = 0; x < GetTilesX(shape, 0); x++)
+			{
+				UINT expected = shape.levelCount;
+				for (UINT level = 0; level < shape.levelCount; level++)
+				{
+					bool complete = true;
+					for (UINT coarser = level; coarser < shape.levelCount; coarser++)
+					{
+						const UINT tileX = (std::min)(x >> coarser, GetTilesX(shape, coarser) - 1);
+						const UINT tileY = (std::min)(y >> coarser, GetTilesY(shape, coarser) - 1);
+						complete = complete && IsResident(residency, residency.GetTileIndex(texture, coarser, tileX, tileY));
+					}
+
+					if (complete)
+					{
+						expected = level;
+						break;
+					}
+				}
+
+				const UINT actual = map[y * GetTilesX(shape, 0) + x];
+				CHECK(actual == expected, "texture %u tile %u,%u maps to level %u, expected %u", texture, x, y, actual, expected);
+			}
+		}
+	}
+
+	void TestPageTable()
+	{
+		const TextureShape shapes[] =
+		{
+			{ 1000, 600, 128, 128, 3 },
+			{ 4096, 4096, 512, 256, 4 },
+			{ 130, 2, 128, 128, 1 },
+		};
+
+		TileResidency residency(16);
+		UINT expectedFirst = 0;
+		for (const TextureShape& shape : shapes)
+		{
+			const UINT first = residency.AddTexture(shape.width, shape.height, shape.tileWidth, shape.tileHeight, shape.levelCount);
+			CHECK(first == expectedFirst, "texture starts at tile %u, expected %u", first, expectedFirst);
+			for (UINT level = 0; level < shape.levelCount; level++) expectedFirst += GetTilesX(shape, level) * GetTilesY(shape, level);
+		}
+
+		CHECK(residency.GetTileCount() == expectedFirst, "%u tiles, expected %u", residency.GetTileCount(), expectedFirst);
+
+		// Every tile number maps back to the location it was made from
+		UINT tile = 0;
+		for (UINT texture = 0; texture < residency.GetTextureCount(); texture++)
+		{
+			const TextureShape& shape = shapes[texture];
+			for (UINT level = 0; level < shape.levelCount; level++)
+			{
+				for (UINT y = 0; y < GetTilesY(shape, level); y++)
+				{
+					for (UINT x = 0; x < GetTilesX(shape, level); x++, tile++)
+					{
+						CHECK(residency.GetTileIndex(texture, level, x, y) == tile, "texture %u level %u tile %u,%u is numbered %u, expected %u", texture, level, x, y, residency.GetTileIndex(texture, level, x, y), tile);
+
+						UINT foundTexture, foundLevel, foundX, foundY;
+						residency.GetTileLocation(tile, foundTexture, foundLevel, foundX, foundY);
+						CHECK(foundTexture == texture && foundLevel == level && foundX == x && foundY == y, "tile %u is found at texture %u level %u tile %u,%u", tile, foundTexture, foundLevel, foundX, foundY);
+						CHECK(!IsResident(residency, tile), "tile %u is resident before any update", tile);
+					}
+				}
+			}
+		}
+	}
+
+	void TestMinLevelGap()
+	{
+		// Both top level tiles load after the level 1 tile they share, which leaves it least recently used and first
+		// to go when a tile of another texture is wanted
+		const TextureShape wide = { 256, 128, 128, 128, 2 };
+		const TextureShape single = { 128, 128, 128, 128, 1 };
+
+		TileResidency residency(3);
+		residency.AddTexture(wide.width, wide.height, wide.tileWidth, wide.tileHeight, wide.levelCount);
+		residency.AddTexture(single.width, single.height, single.tileWidth, single.tileHeight, single.levelCount);
+
+		std::vector<TileMapping> loads, evictions;
+		std::vector<UINT> changed;
+		residency.Update({ residency.GetTileIndex(0, 0, 0, 0), residency.GetTileIndex(0, 0, 1, 0) }, 8, loads, evictions, changed);
+		CHECK(loads.size() == 3 && loads[0].tile == residency.GetTileIndex(0, 1, 0, 0), "%zu loads, the coarse tile is not first", loads.size());
+
+		std::vector<UINT> map;
+		residency.GetMinLevelMap(0, map);
+		CHECK(map.size() == 2 && map[0] == 0 && map[1] == 0, "fully resident texture maps to levels %u and %u", map[0], map[1]);
+
+		residency.Update({ residency.GetTileIndex(1, 0, 0, 0) }, 8, loads, evictions, changed);
+		CHECK(evictions.size() == 1 && evictions[0].tile == residency.GetTileIndex(0, 1, 0, 0), "the shared level 1 tile was not evicted");
+		CHECK(IsResident(residency, residency.GetTileIndex(0, 0, 0, 0)) && IsResident(residency, residency.GetTileIndex(0, 0, 1, 0)), "a top level tile went");
+
+		// The top level tiles are still resident, but their ancestor is not, so neither level can be sampled
+		residency.GetMinLevelMap(0, map);
+		CHECK(map[0] == 2 && map[1] == 2, "texture with a missing ancestor maps to levels %u and %u, expected 2", map[0], map[1]);
+		CheckMinLevelMap(residency, 0, wide);
+		CheckMinLevelMap(residency, 1, single);
+	}
+
+	void TestTrace()
+	{
+		// A view sliding over three textures, asking for a window of tiles at a level that drifts with distance, with a
+		// budget of slots and loads too small for all of it
+		const TextureShape shapes[] =
+		{
+			{ 8192, 8192, 128, 128, 6 },
+			{ 4000, 3000, 512, 256, 4 },
+			{ 1024, 1024, 128, 128, 3 },
+		};
+		const UINT slotCount = 300;
+		const UINT maxLoads = 40;
+
+		TileResidency residency(slotCount);
+		for (const TextureShape& shape : shapes) residency.AddTexture(shape.width, shape.height, shape.tileWidth, shape.tileHeight, shape.levelCount);
+
+		std::mt19937 random(22);
+		std::vector<UINT> lastUsed(residency.GetTileCount(), 0);
+		std::vector<UINT> requestedFrame(residency.GetTileCount(), 0);
+		std::vector<TileMapping> loads, evictions;
+		std::vector<UINT> changed;
+		size_t totalEvictions = 0, totalDeferred = 0;
+
+		for (UINT frame = 1; frame <= 400; frame++)
+		{
+			std::vector<UINT> requested;
+			for (UINT texture = 0; texture < residency.GetTextureCount(); texture++)
+			{
+				const TextureShape& shape = shapes[texture];
+				const UINT level = (frame / 37 + texture + random() % 2) % shape.levelCount;
+				const UINT tilesX = GetTilesX(shape, level), tilesY = GetTilesY(shape, level);
+				const UINT centerX = (frame * (texture + 1) / 3) % tilesX, centerY = (frame / 5 + texture * 7) % tilesY;
+				for (UINT y = centerY; y < (std::min)(centerY + 4, tilesY); y++)
+				{
+					for (UINT x = centerX; x < (std::min)(centerX + 5, tilesX); x++) requested.push_back(residency.GetTileIndex(texture, level, x, y));
+				}
+			}
+			requested.push_back(residency.GetTileCount() + 10);
+
+			// The tiles this frame wants, ancestors included
+			std::vector<UINT> wanted;
+			for (UINT request : requested)
+			{
+				if (request >= residency.GetTileCount()) continue;
+
+				UINT texture, level, x, y;
+				residency.GetTileLocation(request, texture, level, x, y);
+				for (; level < shapes[texture].levelCount; level++, x >>= 1, y >>= 1)
+				{
+					x = (std::min)(x, GetTilesX(shapes[texture], level) - 1);
+					y = (std::min)(y, GetTilesY(shapes[texture], level) - 1);
+					const UINT tile = residency.GetTileIndex(texture, level, x, y);
+					if (requestedFrame[tile] != frame) wanted.push_back(tile);
+					requestedFrame[tile] = frame;
+				}
+			}
+
+			const ResidencyStats stats = residency.Update(requested, maxLoads, loads, evictions, changed);
+			CHECK(stats.requested == wanted.size(), "frame %u counts %u requested tiles, expected %zu", frame, stats.requested, wanted.size());
+			CHECK(loads.size() <= maxLoads, "frame %u loads %zu tiles", frame, loads.size());
+
+			// Evicted tiles were not wanted this frame and were used no later than any tile left resident and unwanted
+			UINT newestEvicted = 0;
+			for (const TileMapping& eviction : evictions)
+			{
+				CHECK(requestedFrame[eviction.tile] != frame, "frame %u evicts tile %u, which it wants", frame, eviction.tile);
+				CHECK(!IsResident(residency, eviction.tile), "frame %u evicts tile %u but keeps it", frame, eviction.tile);
+				newestEvicted = (std::max)(newestEvicted, lastUsed[eviction.tile]);
+			}
+
+			// Page table and slots agree: every slot holds one tile, and the count matches the stats
+			std::vector<bool> slotUsed(slotCount, false);
+			UINT resident = 0;
+			for (UINT tile = 0; tile < residency.GetTileCount(); tile++)
+			{
+				const UINT slot = residency.GetSlot(tile);
+				if (slot == TileResidency::InvalidSlot) continue;
+
+				CHECK(slot < slotCount && !slotUsed[slot], "frame %u gives slot %u to tile %u twice or out of range", frame, slot, tile);
+				if (slot < slotCount) slotUsed[slot] = true;
+				resident++;
+
+				if (!evictions.empty() && requestedFrame[tile] != frame) CHECK(lastUsed[tile] >= newestEvicted, "frame %u keeps tile %u last used in frame %u but evicts one used in frame %u", frame, tile, lastUsed[tile], newestEvicted);
+			}
+			CHECK(resident == stats.resident, "frame %u holds %u tiles, stats say %u", frame, resident, stats.resident);
+
+			UINT missing = 0;
+			for (UINT tile : wanted)
+			{
+				if (IsResident(residency, tile)) lastUsed[tile] = frame;
+				else missing++;
+			}
+			CHECK(missing == stats.deferred, "frame %u leaves %u wanted tiles out, stats say %u deferred", frame, missing, stats.deferred);
+
+			for (UINT texture = 0; texture < residency.GetTextureCount(); texture++) CheckMinLevelMap(residency, texture, shapes[texture]);
+
+			totalEvictions += evictions.size();
+			totalDeferred += stats.deferred;
+		}
+
+		CHECK(totalEvictions > 1000 && totalDeferred > 0, "only %zu evictions and %zu deferred tiles, the trace does not stress the budget", totalEvictions, totalDeferred);
+	}
+
+	void WriteBytes(const std::string& path, const std::vector<UINT8>& bytes, size_t size)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file) throw std::runtime_error("Error: failed to create " + path);
+		fwrite(bytes.data(), 1, size, file);
+		fclose(file);
+	}
+
+	TextureInfo MakeTexture(int width, int height, UINT seed)
+	{
+		TextureInfo texture;
+		texture.width = width;
+		texture.height = height;
+		texture.stride = 4;
+		texture.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+		std::mt19937 random(seed);
+		for (UINT8& value : texture.pixels) value = static_cast<UINT8>(random());
+
+		MipGenerator::Generate(texture, MipFilter::Box);
+		return texture;
+	}
+
+	void TestTileFile(const char* name, TextureInfo texture)
+	{
+		const std::string path = "tile_test.vtex";
+		CHECK(TileFile::Write(path, texture), "%s: writing failed", name);
+
+		TileFile file;
+		CHECK(file.Open(path), "%s: opening failed", name);
+		if (file.GetLevelCount() == 0) return;
+
+		CHECK(file.GetWidth() == static_cast<UINT>(texture.width) && file.GetHeight() == static_cast<UINT>(texture.height), "%s: %u x %u", name, file.GetWidth(), file.GetHeight());
+		CHECK(file.GetFormat() == texture.format && file.GetLevelCount() == static_cast<UINT>(texture.mipLevels), "%s: format %d with %u levels", name, file.GetFormat(), file.GetLevelCount());
+
+		std::vector<TextureLevelLayout> layouts;
+		TextureCache::GetLayout(texture.width, texture.height, texture.mipLevels, texture.format, layouts);
+
+		// Every level gathered out of its tiles matches the packed source, at a pitch wider than a row
+		const UINT8* source = texture.pixels.data();
+		for (UINT level = 0; level < file.GetLevelCount(); level++)
+		{
+			const TextureLevelLayout& layout = layouts[level];
+			const UINT64 pitch = layout.rowSize + 24;
+			std::vector<UINT8> rows(static_cast<size_t>(pitch) * layout.rowCount, 0xCD);
+			file.ReadRows(level, rows.data(), pitch);
+
+			UINT wrongRows = 0;
+			for (UINT row = 0; row < layout.rowCount; row++)
+			{
+				if (memcmp(rows.data() + row * pitch, source + static_cast<size_t>(row) * layout.rowSize, layout.rowSize) != 0) wrongRows++;
+			}
+			CHECK(wrongRows == 0, "%s: level %u has %u of %u rows wrong", name, level, wrongRows, layout.rowCount);
+			source += static_cast<size_t>(layout.rowSize) * layout.rowCount;
+		}
+
+		// The bottom right tile of the top level is padded with zeros past the texture's edge
+		const TileLevel& top = file.GetLevel(0);
+		const UINT8* tile = file.GetTile(0, top.tilesX - 1, top.tilesY - 1);
+		const UINT8* tileEnd = tile + TileFile::TileBytes;
+		CHECK(tileEnd[-1] == 0 && tileEnd[-2] == 0, "%s: the last tile is not padded with zeros", name);
+		CHECK(top.firstTile == 0 && file.GetLevel(file.GetLevelCount() - 1).firstTile + 1 == file.GetTileCount(), "%s: %llu tiles", name, static_cast<unsigned long long>(file.GetTileCount()));
+
+		file.Close();
+
+		// A file cut short or of another version is refused
+		std::vector<UINT8> bytes;
+		{
+			Utils::MappedFile mapped;
+			CHECK(mapped.Open(path), "%s: mapping failed", name);
+			const UINT8* data = reinterpret_cast<const UINT8*>(mapped.Data());
+			bytes.assign(data, data + mapped.Size());
+		}
+
+		std::vector<UINT8> damaged = bytes;
+		damaged[4] = 7;
+		WriteBytes(path, damaged, damaged.size());
+		CHECK(!file.Open(path), "%s: opened a file of another version", name);
+
+		WriteBytes(path, bytes, bytes.size() - TileFile::TileBytes);
+		CHECK(!file.Open(path), "%s: opened a file missing its last tile", name);
+
+		remove(path.c_str());
+	}
+
+	void TestTileFiles()
+	{
+		TestTileFile("RGBA8 300x200", MakeTexture(300, 200, 1));
+
+		TextureInfo bc1 = MakeTexture(1200, 520, 2);
+		BlockCompressor::Compress(bc1, TextureCompression::BC1, CompressionQuality::Fast);
+		TestTileFile("BC1 1200x520", bc1);
+
+		TextureInfo bc7 = MakeTexture(600, 264, 3);
+		BlockCompressor::Compress(bc7, TextureCompression::BC7, CompressionQuality::Fast);
+		TestTileFile("BC7 600x264", bc7);
+	}
+}
+
+int main()
+{
+	TestPageTable();
+	TestMinLevelGap();
+	TestTrace();
+	TestTileFiles();
+	return Test::Finish("TileResidencyTests");
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "Test.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	void TestParallelForCoverage()
+	{
+		for (UINT count : { 0u, 1u, 2u, 7u, 1000u, 100000u })
+		{
+			std::vector<std::atomic<UINT>> hits(count);
+			for (auto& hit : hits) hit = 0;
+
+			Utils::ParallelFor(count, [&](UINT i) { hits[i]++; });
+
+			UINT wrong = 0;
+			for (auto& hit : hits) wrong += (hit != 1);
+			CHECK(wrong == 0, "%u of %u indices did not run exactly once", wrong, count);
+		}
+	}
+
+	void TestNestedParallelFor()
+	{
+		// Nested calls run on the same pool: the number of threads seen stays within the pool, however deep the nesting
+		Utils::SetWorkerCount(4);
+
+		const UINT outer = 64, inner = 256;
+		std::vector<std::atomic<UINT>> hits(outer * inner);
+		for (auto& hit : hits) hit = 0;
+
+		std::mutex mutex;
+		std::vector<std::thread::id> threads;
+
+		Utils::ParallelFor(outer, [&](UINT i)
+		{
+			Utils::ParallelFor(inner, [&](UINT j)
+			{
+				hits[i * inner + j]++;
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (std::find(threads.begin(), threads.end(), std::this_thread::get_id()) == threads.end()) threads.push_back(std::this_thread::get_id());
+			});
+		});
+
+		UINT wrong = 0;
+		for (auto& hit : hits) wrong += (hit != 1);
+		CHECK(wrong == 0, "%u nested indices did not run exactly once", wrong);
+		CHECK(threads.size() <= Utils::GetWorkerCount(), "nested calls ran on %zu threads with %u workers", threads.size(), Utils::GetWorkerCount());
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestParallelForException()
+	{
+		for (UINT workerCount : { 1u, 4u })
+		{
+			Utils::SetWorkerCount(workerCount);
+
+			std::atomic<UINT> ran(0);
+			bool caught = false;
+			try
+			{
+				Utils::ParallelFor(10000, [&](UINT i)
+				{
+					ran++;
+					if (i == 10) throw std::runtime_error("task 10 failed");
+				});
+			}
+			catch (const std::runtime_error& e)
+			{
+				caught = (std::string(e.what()) == "task 10 failed");
+			}
+
+			CHECK(caught, "the exception of a task was not rethrown with %u workers", workerCount);
+			CHECK(ran < 10000, "tasks after the failing one were not skipped with %u workers", workerCount);
+
+			// The pool is still usable afterwards
+			std::atomic<UINT> sum(0);
+			Utils::ParallelFor(100, [&](UINT i) { sum += i; });
+			CHECK(sum == 4950, "sum %u after a failed call with %u workers", sum.load(), workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestFiles()
+	{
+		const std::string path = "utils_test/file.bin";
+
+		std::vector<UINT8> data(3 << 20);
+		for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<UINT8>(i * 7);
+
+		{
+			Utils::OutputFile file;
+			CHECK(file.Open(path) && file.Write(data.data(), 100) && file.Write(data.data() + 100, data.size() - 100) && file.Commit(), "write failed");
+		}
+
+		Utils::MappedFile mapped;
+		CHECK(mapped.Open(path), "mapping the written file failed");
+		CHECK(mapped.Size() == data.size() && memcmp(mapped.Data(), data.data(), data.size()) == 0, "mapped bytes differ from the written ones");
+		CHECK(mapped.ModifiedTime() != 0, "no modified time");
+		mapped.Close();
+
+		// A file discarded before its commit leaves the previous one in place
+		{
+			Utils::OutputFile file;
+			CHECK(file.Open(path) && file.Write(data.data(), 10), "second write failed");
+		}
+
+		CHECK(mapped.Open("utils_test\\file.bin") && mapped.Size() == data.size(), "a discarded write replaced the file");
+		CHECK(!mapped.Open("utils_test/missing.bin"), "opened a missing file");
+	}
+}
+
+int main()
+{
+	TestParallelForCoverage();
+	TestNestedParallelFor();
+	TestParallelForException();
+	TestFiles();
+
+	return Test::Finish("UtilsTests");
+}
\ No newline at end of file
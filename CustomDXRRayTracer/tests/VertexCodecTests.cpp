@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "Utils.h"
+#include "VertexCodec.h"
+
+#include <random>
+
+namespace
+{
+	// The decode in LoadPositionAndUv in Common.hlsl, written out on the CPU so the test also covers the shader's reading
+	// of the 12 byte layout
+	Vertex DecodeAsShader(const CompactVertex& vertex, const VertexQuantization& quantization)
+	{
+		UINT32 packed[3];
+		memcpy(packed, &vertex, sizeof(packed));
+
+		const int quantized[3] = { static_cast<int>(packed[0] << 16) >> 16, static_cast<int>(packed[0]) >> 16, static_cast<int>(packed[1] << 16) >> 16 };
+
+		Vertex result;
+		result.position.x = (std::max)(quantized[0] / 32767.f, -1.f) * quantization.scale.x + quantization.bias.x;
+		result.position.y = (std::max)(quantized[1] / 32767.f, -1.f) * quantization.scale.y + quantization.bias.y;
+		result.position.z = (std::max)(quantized[2] / 32767.f, -1.f) * quantization.scale.z + quantization.bias.z;
+		result.uv.x = (packed[2] & 0xFFFF) / 65535.f * quantization.uvScale.x + quantization.uvBias.x;
+		result.uv.y = (packed[2] >> 16) / 65535.f * quantization.uvScale.y + quantization.uvBias.y;
+		return result;
+	}
+
+	void CheckRoundTrip(const char* name, const std::vector<Vertex>& vertices)
+	{
+		const VertexQuantization quantization = VertexCodec::ComputeQuantization(vertices.data(), vertices.size());
+		std::vector<CompactVertex> compact(vertices.size());
+		VertexCodec::Encode(vertices.data(), vertices.size(), quantization, compact.data());
+
+		// Half a step of each encoding, plus float rounding
+		const float positionBound[3] = { quantization.scale.x / 32767.f * 0.51f + 1e-6f, quantization.scale.y / 32767.f * 0.51f + 1e-6f, quantization.scale.z / 32767.f * 0.51f + 1e-6f };
+		const float uvBound[2] = { quantization.uvScale.x / 65535.f * 0.51f + 1e-6f, quantization.uvScale.y / 65535.f * 0.51f + 1e-6f };
+
+		float worstPosition = 0.f, worstUv = 0.f;
+		size_t wrong = 0, mismatched = 0;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const Vertex decoded = VertexCodec::Decode(compact[i], quantization);
+			const Vertex shaded = DecodeAsShader(compact[i], quantization);
+			mismatched += (memcmp(&decoded, &shaded, sizeof(Vertex)) != 0);
+
+			const float position[3] = { fabsf(decoded.position.x - vertices[i].position.x), fabsf(decoded.position.y - vertices[i].position.y), fabsf(decoded.position.z - vertices[i].position.z) };
+			const float uv[2] = { fabsf(decoded.uv.x - vertices[i].uv.x), fabsf(decoded.uv.y - vertices[i].uv.y) };
+			wrong += (position[0] > positionBound[0] || position[1] > positionBound[1] || position[2] > positionBound[2] || uv[0] > uvBound[0] || uv[1] > uvBound[1]);
+
+			worstPosition = (std::max)(worstPosition, (std::max)(position[0], (std::max)(position[1], position[2])));
+			worstUv = (std::max)(worstUv, (std::max)(uv[0], uv[1]));
+		}
+
+		printf("%s: worst position error %g, worst UV error %g\n", name, worstPosition, worstUv);
+		CHECK(wrong == 0, "%s: %zu of %zu vertices decode further than half a step away", name, wrong, vertices.size());
+		CHECK(mismatched == 0, "%s: %zu vertices decode differently in the shader", name, mismatched);
+	}
+
+	void TestRoundTrip()
+	{
+		std::mt19937 random(6);
+		std::uniform_real_distribution<float> coordinate(-250.f, 1000.f);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		std::vector<Vertex> vertices(200000);
+		for (Vertex& vertex : vertices)
+		{
+			vertex.position = DirectX::XMFLOAT3(coordinate(random), coordinate(random) * 0.01f, coordinate(random));
+			vertex.uv = DirectX::XMFLOAT2(unit(random), unit(random));
+		}
+		CheckRoundTrip("unit UVs", vertices);
+
+		// Tiling UVs: half floats step by 1/32 near 40, the UV range keeps a 1/1600 step
+		for (Vertex& vertex : vertices) vertex.uv = DirectX::XMFLOAT2(vertex.uv.x * 40.f, 32.f + vertex.uv.y * 8.f);
+		CheckRoundTrip("tiling UVs", vertices);
+
+		// A flat quad with constant UVs on one axis
+		for (Vertex& vertex : vertices)
+		{
+			vertex.position.y = 3.f;
+			vertex.uv.y = 0.5f;
+		}
+		CheckRoundTrip("flat", vertices);
+	}
+
+	void TestSingleVertex()
+	{
+		Vertex vertex;
+		vertex.position = DirectX::XMFLOAT3(1.f, -2.f, 3.f);
+		vertex.uv = DirectX::XMFLOAT2(0.25f, 0.75f);
+
+		const VertexQuantization quantization = VertexCodec::ComputeQuantization(&vertex, 1);
+		CompactVertex compact;
+		VertexCodec::Encode(&vertex, 1, quantization, &compact);
+
+		const Vertex decoded = VertexCodec::Decode(compact, quantization);
+		CHECK(memcmp(&decoded, &vertex, sizeof(Vertex)) == 0, "a single vertex did not decode exactly");
+	}
+}
+
+int main()
+{
+	Utils::SetWorkerCount(4);
+	TestRoundTrip();
+	TestSingleVertex();
+
+	return Test::Finish("VertexCodecTests");
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "Utils.h"
+#include "VertexWelder.h"
+
+#include <random>
+#include <unordered_map>
+
+// Welds 10M corners, as BuildModel does for a 3.3M-triangle OBJ, and compares with the unordered_map BuildModel used
+// before. Usage: VertexWelderBenchmark [corner count]
+namespace
+{
+	struct VertexHash
+	{
+		size_t operator()(const Vertex& vertex) const
+		{
+			return static_cast<size_t>(Utils::Hash(&vertex, sizeof(Vertex), 0));
+		}
+	};
+
+	struct VertexBits
+	{
+		bool operator()(const Vertex& lhs, const Vertex& rhs) const
+		{
+			return memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+		}
+	};
+}
+
+int main(int argc, char** argv)
+{
+	const size_t cornerCount = (argc > 1) ? static_cast<size_t>(atoll(argv[1])) : 10000000;
+
+	// Grid corners shared by about six triangles each, as in a closed mesh
+	std::mt19937 random(3);
+	std::vector<Vertex> pool(cornerCount / 6 + 1);
+	for (Vertex& vertex : pool)
+	{
+		vertex.position = DirectX::XMFLOAT3(static_cast<float>(random() % 1000), static_cast<float>(random() % 1000), 1.f);
+		vertex.uv = DirectX::XMFLOAT2((random() % 4) * 0.25f, 0.5f);
+	}
+
+	std::vector<Vertex> corners(cornerCount);
+	for (Vertex& corner : corners) corner = pool[random() % pool.size()];
+
+	Utils::Timer timer;
+	std::unordered_map<Vertex, uint32_t, VertexHash, VertexBits> map;
+	std::vector<Vertex> mapVertices;
+	std::vector<uint32_t> mapIndices(cornerCount);
+	for (size_t i = 0; i < cornerCount; i++)
+	{
+		auto inserted = map.emplace(corners[i], static_cast<uint32_t>(mapVertices.size()));
+		if (inserted.second) mapVertices.push_back(corners[i]);
+		mapIndices[i] = inserted.first->second;
+	}
+	const float mapMilliseconds = timer.ElapsedMillis();
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	const WeldStats stats = VertexWelder::Weld(corners, vertices, indices);
+
+	printf("%zu corners -> %zu vertices, %u workers\n", stats.inputVertices, stats.uniqueVertices, Utils::GetWorkerCount());
+	printf("  unordered_map  %8.1f ms  %6.1f M corners/s\n", mapMilliseconds, cornerCount / (mapMilliseconds * 1000.0));
+	printf("  VertexWelder   %8.1f ms  %6.1f M corners/s  (%.1fx)\n", stats.milliseconds, cornerCount / (stats.milliseconds * 1000.0), mapMilliseconds / stats.milliseconds);
+
+	if (indices != mapIndices)
+	{
+		printf("VertexWelder and the map disagree\n");
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "Test.h"
+#include "Utils.h"
+#include "VertexWelder.h"
+
+#include <map>
+#include <random>
+
+namespace
+{
+	Vertex MakeVertex(float x, float y, float z, float u, float v)
+	{
+		Vertex vertex;
+		vertex.position = DirectX::XMFLOAT3(x, y, z);
+		vertex.uv = DirectX::XMFLOAT2(u, v);
+		return vertex;
+	}
+
+	void TestUvSeam()
+	{
+		// A cube corner on a UV seam: the same position with two UVs must stay two vertices
+		const std::vector<Vertex> corners =
+		{
+			MakeVertex(1.f, 1.f, 1.f, 0.f, 0.f),
+			MakeVertex(1.f, 1.f, 1.f, 1.f, 0.f),
+			MakeVertex(1.f, 1.f, 1.f, 0.f, 0.f),
+			MakeVertex(1.f, 1.f, 1.f, 1.f, 0.f),
+			MakeVertex(1.f, 1.f, 1.f, 1.f, 0.f),
+			MakeVertex(1.f, 1.f, 1.f, 0.f, 1.f),
+		};
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		const WeldStats stats = VertexWelder::Weld(corners, vertices, indices);
+
+		CHECK(stats.uniqueVertices == 3 && vertices.size() == 3, "welded the seam into %zu vertices instead of 3", vertices.size());
+		CHECK(indices == std::vector<uint32_t>({ 0, 1, 0, 1, 1, 2 }), "seam corners got the wrong indices");
+	}
+
+	void TestMatchesMap()
+	{
+		// Random corners drawn from a small pool, so most repeat; the result must match a map numbering them in first-use
+		// order, whatever the number of workers
+		std::mt19937 random(3);
+		std::vector<Vertex> pool(5000);
+		for (Vertex& vertex : pool)
+		{
+			vertex = MakeVertex(static_cast<float>(random() % 100), static_cast<float>(random() % 100), 1.f, (random() % 4) * 0.25f, 0.5f);
+		}
+
+		std::vector<Vertex> corners(300000);
+		for (Vertex& corner : corners) corner = pool[random() % pool.size()];
+
+		std::map<std::vector<UINT8>, uint32_t> reference;
+		std::vector<uint32_t> referenceIndices;
+		for (const Vertex& corner : corners)
+		{
+			const std::vector<UINT8> bytes(reinterpret_cast<const UINT8*>(&corner), reinterpret_cast<const UINT8*>(&corner) + sizeof(Vertex));
+			referenceIndices.push_back(reference.emplace(bytes, static_cast<uint32_t>(reference.size())).first->second);
+		}
+
+		for (UINT workerCount : { 1u, 3u, 8u })
+		{
+			Utils::SetWorkerCount(workerCount);
+
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			VertexWelder::Weld(corners, vertices, indices);
+
+			CHECK(vertices.size() == reference.size(), "%zu vertices instead of %zu with %u workers", vertices.size(), reference.size(), workerCount);
+			CHECK(indices == referenceIndices, "indices differ from the map with %u workers", workerCount);
+
+			size_t wrong = 0;
+			for (size_t i = 0; i < corners.size() && i < indices.size(); i++)
+			{
+				wrong += (memcmp(&vertices[indices[i]], &corners[i], sizeof(Vertex)) != 0);
+			}
+			CHECK(wrong == 0, "%zu corners resolve to a different vertex with %u workers", wrong, workerCount);
+		}
+
+		Utils::SetWorkerCount(0);
+	}
+
+	void TestEmpty()
+	{
+		std::vector<Vertex> vertices(1);
+		std::vector<uint32_t> indices(1);
+		VertexWelder::Weld(std::vector<Vertex>(), vertices, indices);
+		CHECK(vertices.empty() && indices.empty(), "welding nothing left %zu vertices and %zu indices", vertices.size(), indices.size());
+	}
+}
+
+int main()
+{
+	TestUvSeam();
+	TestMatchesMap();
+	TestEmpty();
+
+	return Test::Finish("VertexWelderTests");
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "AssetArchive.h"
+#include "Utils.h"
+
+// Bakes models and their textures into one archive that the renderer maps with -model <archive>.dxra. It runs without
+// a DXR device, so archives can be built on any machine. Textures are stored in their GPU form, so the texture options
+// are fixed here rather than when the archive is loaded; they take the same values as the renderer's.
+// Usage: bake [-mipFilter box|kaiser|lanczos] [-compression none|bc1|bc7 [fast|normal|high]] <archive.dxra> <model> ...
+int main(int argc, char** argv)
+{
+	TextureOptions options;
+	int i = 1;
+	while (i < argc && argv[i][0] == '-')
+	{
+		const std::string flag = argv[i++];
+		const std::string value = (i < argc) ? argv[i++] : "";
+		if (flag == "-mipFilter")
+		{
+			if (value == "kaiser") options.mipFilter = MipFilter::Kaiser;
+			else if (value == "lanczos") options.mipFilter = MipFilter::Lanczos;
+			else options.mipFilter = MipFilter::Box;
+		}
+		else if (flag == "-compression")
+		{
+			if (value == "bc1") options.compression = TextureCompression::BC1;
+			else if (value == "bc7") options.compression = TextureCompression::BC7;
+			else options.compression = TextureCompression::None;
+
+			const std::string quality = (i < argc) ? argv[i] : "";
+			if (quality == "fast" || quality == "normal" || quality == "high")
+			{
+				options.quality = (quality == "fast") ? CompressionQuality::Fast : (quality == "high") ? CompressionQuality::High : CompressionQuality::Normal;
+				i++;
+			}
+		}
+		else
+		{
+			i = argc;
+		}
+	}
+
+	if (argc - i < 2 || !AssetArchive::IsArchive(argv[i]))
+	{
+		printf("Usage: bake [-mipFilter box|kaiser|lanczos] [-compression none|bc1|bc7 [fast|normal|high]] <archive.dxra> <model> [<model> ...]\n");
+		return 1;
+	}
+
+	const std::string archivePath = argv[i];
+	const std::vector<std::string> modelPaths(argv + i + 1, argv + argc);
+
+	try
+	{
+		const BakeStats stats = AssetArchive::Bake(archivePath, modelPaths, options);
+		printf("Baked %zu models, %zu materials and %zu textures into %s (%llu bytes) in %.2f ms\n", stats.modelCount, stats.materialCount, stats.textureCount, archivePath.c_str(), static_cast<unsigned long long>(stats.archiveBytes), stats.milliseconds);
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file